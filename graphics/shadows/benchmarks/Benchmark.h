@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+// Minimal benchmark runner for the modules of the shadows project that don't depend on Direct3D.
+// Build it in Release, the numbers of a Debug build say nothing about the renderer.
+typedef void (*BenchmarkFunction)();
+
+bool RegisterBenchmark(const char* name, BenchmarkFunction function);
+
+// Calls the function until it ran for a while and prints the median time of one call in milliseconds.
+// The setup runs before every call and isn't timed.
+double Measure(const char* label, const std::function<void()>& function, const std::function<void()>& setup = nullptr);
+
+// Prints a time measured by the benchmark itself, in the format of Measure
+void ReportTime(const char* label, double milliseconds);
+
+// Prints the ratio of two results of Measure
+void ReportSpeedup(const char* label, double baseline, double optimized);
+
+// Threads of the machine, at least one
+unsigned int GetHardwareThreadCount();
+
+// Stores the value where the compiler can't see it, so the computation isn't removed as unused
+void KeepResult(uint64_t value);
+
+#define BENCHMARK(name) \
+    static void name(); \
+    static const bool name##Registered = RegisterBenchmark(#name, name); \
+    static void name()
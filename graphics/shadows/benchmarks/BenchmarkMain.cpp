@@ -0,0 +1,105 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    struct BenchmarkEntry
+    {
+        const char* name;
+        BenchmarkFunction function;
+    };
+
+    std::vector<BenchmarkEntry>& GetBenchmarks()
+    {
+        static std::vector<BenchmarkEntry> benchmarks;
+        return benchmarks;
+    }
+
+    // Every measurement takes at least this long and this many calls
+    const double minMeasureTime = 0.25;
+    const size_t minMeasureCalls = 5;
+
+    volatile uint64_t g_result = 0;
+}
+
+bool RegisterBenchmark(const char* name, BenchmarkFunction function)
+{
+    GetBenchmarks().push_back({ name, function });
+    return true;
+}
+
+double Measure(const char* label, const std::function<void()>& function, const std::function<void()>& setup)
+{
+    typedef std::chrono::steady_clock Clock;
+
+    // The first call warms up the caches and the allocator
+    if (setup)
+        setup();
+    function();
+
+    std::vector<double> times;
+    double total = 0.0;
+    while (total < minMeasureTime || times.size() < minMeasureCalls)
+    {
+        if (setup)
+            setup();
+        Clock::time_point start = Clock::now();
+        function();
+        double time = std::chrono::duration<double>(Clock::now() - start).count();
+        times.push_back(time);
+        total += time;
+    }
+
+    // The median ignores the calls that were interrupted by the system
+    std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+    double median = times[times.size() / 2] * 1000.0;
+    ReportTime(label, median);
+    return median;
+}
+
+void ReportTime(const char* label, double milliseconds)
+{
+    printf("  %-48s %10.4f ms\n", label, milliseconds);
+    fflush(stdout);
+}
+
+void ReportSpeedup(const char* label, double baseline, double optimized)
+{
+    printf("  %-48s %10.2fx\n", label, optimized > 0.0 ? baseline / optimized : 0.0);
+    fflush(stdout);
+}
+
+unsigned int GetHardwareThreadCount()
+{
+    unsigned int count = std::thread::hardware_concurrency();
+    return count > 0 ? count : 1;
+}
+
+void KeepResult(uint64_t value)
+{
+    g_result = g_result + value;
+}
+
+// Runs every benchmark, or the ones whose names contain one of the arguments
+int main(int argc, char** argv)
+{
+    for (const BenchmarkEntry& benchmark : GetBenchmarks())
+    {
+        bool selected = argc < 2;
+        for (int i = 1; i < argc && !selected; ++i)
+            selected = strstr(benchmark.name, argv[i]) != nullptr;
+        if (!selected)
+            continue;
+
+        printf("%s\n", benchmark.name);
+        fflush(stdout);
+        benchmark.function();
+    }
+    return 0;
+}
@@ -0,0 +1,185 @@
+#include "Benchmark.h"
+#include "../shadows/BoundingVolumeHierarchy.h"
+
+#include <random>
+#include <string>
+
+namespace
+{
+    // Same distribution as the tests, boxes of 0.2 to 10 units in a 200 unit cube
+    std::vector<AABB> RandomBoxes(std::mt19937& random, size_t count)
+    {
+        std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+        std::uniform_real_distribution<float> extent(0.1f, 5.0f);
+        std::vector<AABB> boxes(count);
+        for (AABB& box : boxes)
+        {
+            Float3 center = { position(random), position(random), position(random) };
+            Float3 half = { extent(random), extent(random), extent(random) };
+            box.min = { center.x - half.x, center.y - half.y, center.z - half.z };
+            box.max = { center.x + half.x, center.y + half.y, center.z + half.z };
+        }
+        return boxes;
+    }
+
+    // Camera at (0, 0, z) looking down -z with the projection of the renderer (XMMatrixPerspectiveFovRH)
+    Frustum CameraFrustum(float z)
+    {
+        const float aspect = 16.0f / 9.0f;
+        const float nearZ = 0.1f;
+        const float farZ = 10000.0f;
+        const float range = farZ / (nearZ - farZ);
+        const float viewProjection[4][4] = {
+            { 1.0f / aspect, 0.0f, 0.0f, 0.0f },
+            { 0.0f, 1.0f, 0.0f, 0.0f },
+            { 0.0f, 0.0f, range, -1.0f },
+            { 0.0f, 0.0f, range * (nearZ - z), z }
+        };
+        return FrustumFromMatrix(viewProjection);
+    }
+
+    std::vector<Ray> RandomRays(std::mt19937& random, size_t count)
+    {
+        std::uniform_real_distribution<float> direction(-1.0f, 1.0f);
+        std::vector<Ray> rays(count);
+        for (Ray& ray : rays)
+            ray = { { 0.0f, 0.0f, 150.0f }, { direction(random), direction(random), -1.0f } };
+        return rays;
+    }
+
+    void LinearFrustum(const std::vector<AABB>& boxes, const Frustum& frustum, std::vector<uint32_t>& result)
+    {
+        for (uint32_t i = 0; i < boxes.size(); ++i)
+            if (Intersects(boxes[i], frustum))
+                result.push_back(i);
+    }
+
+    bool LinearRay(const std::vector<AABB>& boxes, const Ray& ray, uint32_t& hitIndex, float& hitDistance)
+    {
+        bool hit = false;
+        hitDistance = 1e9f;
+        for (uint32_t i = 0; i < boxes.size(); ++i)
+        {
+            float distance;
+            if (Intersects(ray, boxes[i], hitDistance, distance) && distance < hitDistance)
+            {
+                hitIndex = i;
+                hitDistance = distance;
+                hit = true;
+            }
+        }
+        return hit;
+    }
+}
+
+BENCHMARK(BoundingVolumeHierarchyBuild)
+{
+    const size_t counts[] = { 10000, 100000 };
+    for (size_t count : counts)
+    {
+        std::mt19937 random(1);
+        std::vector<AABB> boxes = RandomBoxes(random, count);
+        BoundingVolumeHierarchy bvh;
+        unsigned int threads = GetHardwareThreadCount();
+
+        std::string label = std::to_string(count) + " boxes, 1 thread";
+        double single = Measure(label.c_str(), [&]() { bvh.Build(boxes, 1); });
+        label = std::to_string(count) + " boxes, " + std::to_string(threads) + " threads";
+        double parallel = Measure(label.c_str(), [&]() { bvh.Build(boxes, threads); });
+        ReportSpeedup("threads", single, parallel);
+    }
+}
+
+BENCHMARK(BoundingVolumeHierarchyRefit)
+{
+    std::mt19937 random(2);
+    std::vector<AABB> boxes = RandomBoxes(random, 100000);
+    BoundingVolumeHierarchy bvh;
+    bvh.Build(boxes);
+
+    // A few moving models among the static scene, as in UpdateShadowCasters
+    std::vector<uint32_t> moved;
+    for (uint32_t i = 0; i < boxes.size(); i += 100)
+        moved.push_back(i);
+
+    double rebuild = Measure("rebuild 100000 boxes", [&]() { bvh.Build(boxes); });
+    double all = Measure("refit 100000 boxes", [&]() { bvh.Refit(boxes); });
+    double some = Measure("refit 1000 of 100000 boxes", [&]() { bvh.Refit(moved, boxes); });
+    ReportSpeedup("full refit over rebuild", rebuild, all);
+    ReportSpeedup("partial refit over rebuild", rebuild, some);
+}
+
+BENCHMARK(BoundingVolumeHierarchyFrustum)
+{
+    // Outside of the scene almost every box is visible, inside about a quarter of them
+    const size_t counts[] = { 10000, 100000 };
+    const float cameraZ[] = { 150.0f, 0.0f };
+    for (size_t count : counts)
+    {
+        std::mt19937 random(3);
+        std::vector<AABB> boxes = RandomBoxes(random, count);
+        BoundingVolumeHierarchy bvh;
+        bvh.Build(boxes);
+        std::vector<uint32_t> result;
+        result.reserve(count);
+
+        for (float z : cameraZ)
+        {
+            Frustum frustum = CameraFrustum(z);
+            result.clear();
+            bvh.QueryFrustum(frustum, result);
+            std::string scene = std::to_string(count) + " boxes, " + std::to_string(result.size()) + " visible";
+
+            double linear = Measure((scene + ", linear scan").c_str(), [&]()
+            {
+                result.clear();
+                LinearFrustum(boxes, frustum, result);
+                KeepResult(result.size());
+            });
+            double hierarchy = Measure((scene + ", hierarchy").c_str(), [&]()
+            {
+                result.clear();
+                bvh.QueryFrustum(frustum, result);
+                KeepResult(result.size());
+            });
+            ReportSpeedup("hierarchy over linear scan", linear, hierarchy);
+        }
+    }
+}
+
+BENCHMARK(BoundingVolumeHierarchyRay)
+{
+    const size_t counts[] = { 10000, 100000 };
+    for (size_t count : counts)
+    {
+        std::mt19937 random(4);
+        std::vector<AABB> boxes = RandomBoxes(random, count);
+        BoundingVolumeHierarchy bvh;
+        bvh.Build(boxes);
+        std::vector<Ray> rays = RandomRays(random, 1000);
+
+        std::string label = std::to_string(count) + " boxes, 1000 rays, linear scan";
+        double linear = Measure(label.c_str(), [&]()
+        {
+            for (const Ray& ray : rays)
+            {
+                uint32_t index = 0;
+                float distance;
+                if (LinearRay(boxes, ray, index, distance))
+                    KeepResult(index);
+            }
+        });
+        label = std::to_string(count) + " boxes, 1000 rays, hierarchy";
+        double hierarchy = Measure(label.c_str(), [&]()
+        {
+            for (const Ray& ray : rays)
+            {
+                uint32_t index = 0;
+                float distance;
+                if (bvh.QueryRay(ray, 1e9f, index, distance))
+                    KeepResult(index);
+            }
+        });
+        ReportSpeedup("hierarchy over linear scan", linear, hierarchy);
+    }
+}
@@ -0,0 +1,62 @@
+#include "Benchmark.h"
+#include "../shadows/CpuTrace.h"
+
+#include <cstdio>
+#include <string>
+
+// Defined in CpuTraceDisabledBenchmarks.cpp, which is built with CPU_TRACE_ENABLED 0
+uint64_t RunZonesWithoutTracing(uint32_t zoneCount, uint64_t value);
+
+namespace
+{
+    // A zone around a few instructions of work, so the difference to the untraced loop is the cost of the macro
+    uint64_t RunZones(uint32_t zoneCount, uint64_t value)
+    {
+        for (uint32_t i = 0; i < zoneCount; ++i)
+        {
+            CPU_TRACE_SCOPE("Benchmark zone");
+            value = value * 6364136223846793005ull + 1442695040888963407ull;
+        }
+        return value;
+    }
+
+    // Zones recorded between two EndFrame calls, fewer than a thread buffer holds
+    const uint32_t zonesPerFrame = 8000;
+}
+
+BENCHMARK(CpuTraceScope)
+{
+    CpuTracer::Get().StopCapture();
+    std::string zones = std::to_string(zonesPerFrame) + " zones, ";
+    // The collected events of the previous call are summarized outside of the timing
+    double enabled = Measure((zones + "CPU_TRACE_ENABLED 1").c_str(), []() { KeepResult(RunZones(zonesPerFrame, 1)); },
+        []() { CPU_TRACE_END_FRAME(); });
+    double disabled = Measure((zones + "CPU_TRACE_ENABLED 0").c_str(), []() { KeepResult(RunZonesWithoutTracing(zonesPerFrame, 1)); });
+    printf("  %-48s %10.1f ns\n", "cost of one zone", (enabled - disabled) * 1e6 / zonesPerFrame);
+
+    // A zone reads the clock twice, on some systems that is most of its cost
+    double clock = Measure((std::to_string(zonesPerFrame) + " clock reads").c_str(), []()
+    {
+        for (uint32_t i = 0; i < zonesPerFrame; ++i)
+            KeepResult(CpuTracer::GetTime());
+    });
+    printf("  %-48s %10.1f ns\n", "cost of one clock read", clock * 1e6 / zonesPerFrame);
+}
+
+BENCHMARK(CpuTraceEndFrame)
+{
+    CpuTracer& tracer = CpuTracer::Get();
+    std::string zones = std::to_string(zonesPerFrame) + " zones";
+
+    tracer.StopCapture();
+    Measure((zones + ", summary").c_str(), [&]() { tracer.EndFrame(); }, []() { KeepResult(RunZones(zonesPerFrame, 1)); });
+
+    // Capturing also keeps every event for the Chrome trace. The capture is restarted before every
+    // frame, a full one would stop taking events.
+    Measure((zones + ", summary and capture").c_str(), [&]() { tracer.EndFrame(); }, [&]()
+    {
+        tracer.StartCapture();
+        KeepResult(RunZones(zonesPerFrame, 1));
+    });
+    tracer.StopCapture();
+}
@@ -0,0 +1,14 @@
+// The same zones as CpuTraceBenchmarks.cpp in a build without tracing, the macros expand to nothing here
+#define CPU_TRACE_ENABLED 0
+
+#include "../shadows/CpuTrace.h"
+
+uint64_t RunZonesWithoutTracing(uint32_t zoneCount, uint64_t value)
+{
+    for (uint32_t i = 0; i < zoneCount; ++i)
+    {
+        CPU_TRACE_SCOPE("Benchmark zone");
+        value = value * 6364136223846793005ull + 1442695040888963407ull;
+    }
+    return value;
+}
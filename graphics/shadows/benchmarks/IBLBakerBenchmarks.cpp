@@ -0,0 +1,109 @@
+#include "Benchmark.h"
+#include "../shadows/IBLBaker.h"
+#include "../tests/TestEnvironment.h"
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    // A full bake takes seconds, so every thread count runs a fixed number of them and reports the medians
+    const int bakeRepetitions = 3;
+
+    const char* const stageNames[] = { "environment cube", "texel solid angles", "environment mips", "irradiance SH", "prefiltered color" };
+    static_assert(sizeof(stageNames) / sizeof(stageNames[0]) == static_cast<size_t>(IBL_BAKE_STAGE::COUNT), "a name for every stage");
+
+    double Milliseconds(Clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    double Median(std::vector<double> values)
+    {
+        std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+        return values[values.size() / 2];
+    }
+
+    // 1, 2, 4, ... threads and the threads of the machine
+    std::vector<unsigned int> GetThreadCounts()
+    {
+        std::vector<unsigned int> counts;
+        unsigned int hardwareThreads = GetHardwareThreadCount();
+        for (unsigned int count = 1; count < hardwareThreads; count *= 2)
+            counts.push_back(count);
+        counts.push_back(hardwareThreads);
+        return counts;
+    }
+}
+
+// Bakes the procedural environment of the tests (2048 x 1024) with the settings of the renderer, the defaults of
+// IBLBakeSettings. The stages are the ones of IBLBakeJob, every step is run in one go.
+BENCHMARK(IBLBakeStages)
+{
+    const EnvironmentImage image = MakeTestEnvironment(2048, 1024);
+    IBLBakeSettings settings;
+    const size_t stageCount = static_cast<size_t>(IBL_BAKE_STAGE::COUNT);
+
+    double singleThreadTotal = 0.0;
+    for (unsigned int threads : GetThreadCounts())
+    {
+        std::vector<std::vector<double>> stageTimes(stageCount, std::vector<double>(bakeRepetitions, 0.0));
+        std::vector<double> totals(bakeRepetitions, 0.0);
+        for (int repetition = 0; repetition < bakeRepetitions; ++repetition)
+        {
+            IBLBakeJob job;
+            EnvironmentImage copy = image;
+            job.Start(std::move(copy), settings);
+            while (job.IsRunning())
+            {
+                size_t stage = static_cast<size_t>(job.GetStage());
+                Clock::time_point start = Clock::now();
+                job.Run(UINT32_MAX, threads);
+                double time = Milliseconds(start);
+                stageTimes[stage][repetition] += time;
+                totals[repetition] += time;
+            }
+        }
+
+        std::string suffix = ", " + std::to_string(threads) + (threads > 1 ? " threads" : " thread");
+        for (size_t stage = 0; stage < stageCount; ++stage)
+            ReportTime((stageNames[stage] + suffix).c_str(), Median(stageTimes[stage]));
+        double total = Median(totals);
+        ReportTime(("bake" + suffix).c_str(), total);
+        if (threads == 1)
+            singleThreadTotal = total;
+        else
+            ReportSpeedup(("bake" + suffix + " over 1 thread").c_str(), singleThreadTotal, total);
+    }
+}
+
+// The split sum table of the renderer, baked once and cached apart from the environment
+BENCHMARK(IBLBakePreintegratedBRDF)
+{
+    PreintegratedBRDFSettings settings;
+    std::vector<uint16_t> lut;
+
+    double singleThread = 0.0;
+    for (unsigned int threads : GetThreadCounts())
+    {
+        std::vector<double> times(bakeRepetitions);
+        for (double& time : times)
+        {
+            Clock::time_point start = Clock::now();
+            BakePreintegratedBRDF(settings, lut, threads);
+            time = Milliseconds(start);
+        }
+
+        std::string label = "BRDF LUT, " + std::to_string(threads) + (threads > 1 ? " threads" : " thread");
+        double time = Median(times);
+        ReportTime(label.c_str(), time);
+        if (threads == 1)
+            singleThread = time;
+        else
+            ReportSpeedup((label + " over 1 thread").c_str(), singleThread, time);
+    }
+    KeepResult(lut[0]);
+}
@@ -0,0 +1,120 @@
+#include "Benchmark.h"
+#include "../shadows/RadianceHdr.h"
+#include "../tests/TestEnvironment.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "../../stb_image.h"
+#undef STB_IMAGE_IMPLEMENTATION
+
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace
+{
+    // Runs of three or more equal bytes are encoded as runs, the rest as literal copies
+    void EncodeChannel(const uint8_t* values, uint32_t width, std::vector<uint8_t>& file)
+    {
+        uint32_t x = 0;
+        while (x < width)
+        {
+            uint32_t run = 1;
+            while (x + run < width && run < 127 && values[x + run] == values[x])
+                ++run;
+            if (run >= 3)
+            {
+                file.push_back(static_cast<uint8_t>(128 + run));
+                file.push_back(values[x]);
+                x += run;
+                continue;
+            }
+
+            uint32_t start = x;
+            uint32_t count = 0;
+            while (x < width && count < 128)
+            {
+                uint32_t equal = 1;
+                while (x + equal < width && equal < 3 && values[x + equal] == values[x])
+                    ++equal;
+                if (equal >= 3)
+                    break;
+                ++x;
+                ++count;
+            }
+            file.push_back(static_cast<uint8_t>(count));
+            file.insert(file.end(), values + start, values + start + count);
+        }
+    }
+
+    // The procedural environment of the tests as a run length encoded .hdr file, the way stb_image and
+    // most tools write the shared exponent
+    std::vector<uint8_t> MakeEnvironmentFile(uint32_t width, uint32_t height)
+    {
+        EnvironmentImage image = MakeTestEnvironment(width, height);
+        std::string header = "#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n-Y " + std::to_string(height) + " +X " + std::to_string(width) + "\n";
+        std::vector<uint8_t> file(header.begin(), header.end());
+
+        std::vector<uint8_t> channels(static_cast<size_t>(width) * 4);
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            for (uint32_t x = 0; x < width; ++x)
+            {
+                const float* color = &image.pixels[(static_cast<size_t>(y) * width + x) * 4];
+                float maximum = color[0] > color[1] ? color[0] : color[1];
+                maximum = maximum > color[2] ? maximum : color[2];
+                uint8_t rgbe[4] = { 0, 0, 0, 0 };
+                if (maximum > 1e-32f)
+                {
+                    int exponent;
+                    float scale = frexpf(maximum, &exponent) * 256.0f / maximum;
+                    for (int c = 0; c < 3; ++c)
+                        rgbe[c] = static_cast<uint8_t>(color[c] * scale);
+                    rgbe[3] = static_cast<uint8_t>(exponent + 128);
+                }
+                for (int c = 0; c < 4; ++c)
+                    channels[c * width + x] = rgbe[c];
+            }
+
+            file.push_back(2);
+            file.push_back(2);
+            file.push_back(static_cast<uint8_t>(width >> 8));
+            file.push_back(static_cast<uint8_t>(width & 255));
+            for (uint32_t c = 0; c < 4; ++c)
+                EncodeChannel(&channels[c * width], width, file);
+        }
+        return file;
+    }
+}
+
+// A wide environment, 8192 x 1024 texels or 128 MB of floats, decoded from memory so that only decoding is timed.
+// stb_image always runs on one thread.
+BENCHMARK(RadianceHdrDecode)
+{
+    const uint32_t width = 8192;
+    const uint32_t height = 1024;
+    const std::vector<uint8_t> file = MakeEnvironmentFile(width, height);
+    printf("  %u x %u, %.1f MB run length encoded\n", width, height, file.size() / (1024.0 * 1024.0));
+
+    double stbImage = Measure("stbi_loadf_from_memory", [&]()
+    {
+        int decodedWidth, decodedHeight, channels;
+        float* pixels = stbi_loadf_from_memory(file.data(), static_cast<int>(file.size()), &decodedWidth, &decodedHeight, &channels, 4);
+        KeepResult(pixels ? static_cast<uint64_t>(pixels[0] * 1000.0f) : 0);
+        stbi_image_free(pixels);
+    });
+
+    // One thread, then every hardware thread
+    unsigned int hardwareThreads = GetHardwareThreadCount();
+    for (unsigned int threads = 1; threads <= hardwareThreads; threads = threads < hardwareThreads ? hardwareThreads : threads + 1)
+    {
+        std::string label = "DecodeRadianceHdr, " + std::to_string(threads) + (threads > 1 ? " threads" : " thread");
+        double decode = Measure(label.c_str(), [&]()
+        {
+            EnvironmentImage image;
+            bool decoded = DecodeRadianceHdr(file.data(), file.size(), image, threads);
+            KeepResult(decoded ? static_cast<uint64_t>(image.pixels[0] * 1000.0f) : 0);
+        });
+        ReportSpeedup((label + " over stb_image").c_str(), stbImage, decode);
+    }
+}
@@ -0,0 +1,109 @@
+#include "Benchmark.h"
+#include "../shadows/ShadowCascades.h"
+
+#include <random>
+#include <string>
+
+namespace
+{
+    const uint32_t cascadeCount = 4;
+    const uint32_t mapSize = 2048;
+
+    std::vector<AABB> RandomCasters(std::mt19937& random, size_t count)
+    {
+        std::uniform_real_distribution<float> position(-1000.0f, 1000.0f);
+        std::uniform_real_distribution<float> extent(0.5f, 20.0f);
+        std::vector<AABB> boxes(count);
+        for (AABB& box : boxes)
+        {
+            Float3 center = { position(random), position(random) * 0.05f, position(random) };
+            Float3 half = { extent(random), extent(random), extent(random) };
+            box.min = { center.x - half.x, center.y - half.y, center.z - half.z };
+            box.max = { center.x + half.x, center.y + half.y, center.z + half.z };
+        }
+        return boxes;
+    }
+
+    // Camera of the renderer: 90 degree vertical field of view, 16:9 and the PSSM distance of 1000
+    CascadeCamera MakeCamera(float x)
+    {
+        CascadeCamera camera;
+        camera.position = { x, 10.0f, 0.0f };
+        camera.direction = { 0.0f, 0.0f, -1.0f };
+        camera.tanHalfFovY = 1.0f;
+        camera.tanHalfFovX = 16.0f / 9.0f;
+        return camera;
+    }
+}
+
+BENCHMARK(ShadowCascadesSplits)
+{
+    const CASCADE_SPLIT_SCHEME schemes[] = { CASCADE_SPLIT_SCHEME::UNIFORM, CASCADE_SPLIT_SCHEME::LOGARITHMIC, CASCADE_SPLIT_SCHEME::PRACTICAL };
+    const char* const names[] = { "uniform", "logarithmic", "practical" };
+    for (int i = 0; i < 3; ++i)
+    {
+        std::string label = std::string("10000 splits, ") + names[i];
+        Measure(label.c_str(), [&]()
+        {
+            float splits[cascadeCount + 1];
+            for (int k = 0; k < 10000; ++k)
+            {
+                ComputeCascadeSplits(schemes[i], 0.5f, 0.1f, 1000.0f + k, cascadeCount, splits);
+                KeepResult(static_cast<uint64_t>(splits[1]));
+            }
+        });
+    }
+}
+
+// Every frame of the PSSM pass fits the spheres and the bounds of all cascades against the casters
+BENCHMARK(ShadowCascadesFit)
+{
+    float lightView[4][4];
+    ComputeLightView({ 0.3f, 1.0f, 0.2f }, lightView);
+    float splits[cascadeCount + 1];
+    ComputeCascadeSplits(CASCADE_SPLIT_SCHEME::PRACTICAL, 0.5f, 0.1f, 1000.0f, cascadeCount, splits);
+
+    const size_t counts[] = { 100, 1000, 10000 };
+    for (size_t count : counts)
+    {
+        std::mt19937 random(1);
+        std::vector<AABB> casters = RandomCasters(random, count);
+        float x = 0.0f;
+        std::string label = std::to_string(cascadeCount) + " cascades, " + std::to_string(count) + " casters";
+        Measure(label.c_str(), [&]()
+        {
+            CascadeCamera camera = MakeCamera(x);
+            x += 0.37f;
+            for (uint32_t i = 0; i < cascadeCount; ++i)
+            {
+                BoundingSphere sphere = FitCascadeSphere(camera, splits[i], splits[i + 1]);
+                ShadowCascadeBounds bounds = FitCascadeBounds(sphere, lightView, mapSize, casters.data(), casters.size());
+                KeepResult(static_cast<uint64_t>(bounds.maxPoint[2] - bounds.minPoint[2]));
+            }
+        });
+    }
+}
+
+BENCHMARK(ShadowCascadesCornerTransform)
+{
+    float lightView[4][4];
+    ComputeLightView({ 0.3f, 1.0f, 0.2f }, lightView);
+    std::mt19937 random(2);
+    std::vector<AABB> boxes = RandomCasters(random, 100000);
+
+    double scalar = Measure("100000 boxes, scalar", [&]()
+    {
+        float depth = 0.0f;
+        for (const AABB& box : boxes)
+            depth += TransformAABB(box, lightView).max.z;
+        KeepResult(static_cast<uint64_t>(depth));
+    });
+    double simd = Measure("100000 boxes, SSE", [&]()
+    {
+        float depth = 0.0f;
+        for (const AABB& box : boxes)
+            depth += TransformAABBCorners(box, lightView).max.z;
+        KeepResult(static_cast<uint64_t>(depth));
+    });
+    ReportSpeedup("SSE over scalar", scalar, simd);
+}
@@ -0,0 +1,101 @@
+#include "Benchmark.h"
+#include "../shadows/TransparentSorter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <utility>
+
+namespace
+{
+    // What Model::RenderTransparent did before the sorter: a new list of (distance, index) pairs every call
+    uint32_t SortWithStdSort(const std::vector<float>& keys)
+    {
+        std::vector<std::pair<float, size_t>> distances;
+        for (size_t i = 0; i < keys.size(); ++i)
+            distances.push_back(std::pair<float, size_t>(keys[i], i));
+        std::sort(distances.begin(), distances.end(),
+            [](const std::pair<float, size_t>& a, const std::pair<float, size_t>& b) { return a.first < b.first; });
+        return static_cast<uint32_t>(distances.back().second);
+    }
+
+    uint32_t SortWithSorter(TransparentSorter& sorter, const std::vector<float>& keys)
+    {
+        sorter.Clear();
+        for (uint32_t i = 0; i < keys.size(); ++i)
+            sorter.Add(i, keys[i]);
+        return sorter.Sort().front();
+    }
+}
+
+// Draws are spread in a 2000 unit square and sorted along the view direction. Cold frames look in an unrelated
+// direction (a camera cut), warm frames turn the camera slowly or quickly. The sorter falls back to the radix
+// sort once refining would move the draws too far, the output says how many frames were refined.
+BENCHMARK(TransparentSorterFrames)
+{
+    const size_t counts[] = { 10000, 100000 };
+    for (size_t count : counts)
+    {
+        std::mt19937 random(1);
+        std::uniform_real_distribution<float> coordinate(-1000.0f, 1000.0f);
+        std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+        std::vector<float> positions(count * 2);
+        for (float& position : positions)
+            position = coordinate(random);
+
+        float yaw = 0.0f;
+        float turnRate = 0.0f;
+        std::vector<float> keys(count);
+        auto view = [&]()
+        {
+            float x = cosf(yaw);
+            float z = sinf(yaw);
+            for (size_t i = 0; i < count; ++i)
+                keys[i] = positions[2 * i] * x + positions[2 * i + 1] * z;
+        };
+        auto cut = [&]()
+        {
+            yaw = angle(random);
+            view();
+        };
+        auto turn = [&]()
+        {
+            yaw += turnRate;
+            view();
+        };
+
+        TransparentSorter sorter;
+        size_t frames = 0;
+        size_t refined = 0;
+        auto sort = [&]()
+        {
+            KeepResult(SortWithSorter(sorter, keys));
+            ++frames;
+            refined += sorter.WasRadixSorted() ? 0 : 1;
+        };
+        std::string draws = std::to_string(count) + " draws, ";
+
+        double coldSort = Measure((draws + "cold, std::sort").c_str(), [&]() { KeepResult(SortWithStdSort(keys)); }, cut);
+        double coldSorter = Measure((draws + "cold, sorter").c_str(), sort, cut);
+        printf("  %zu of %zu cold frames refined\n", refined, frames);
+        ReportSpeedup("sorter over std::sort", coldSort, coldSorter);
+
+        // Radians per frame, about 0.3 and 3 degrees per second at 60 fps
+        const float turnRates[] = { 0.0001f, 0.001f };
+        const char* const turnNames[] = { "slow", "fast" };
+        for (int i = 0; i < 2; ++i)
+        {
+            turnRate = turnRates[i];
+            std::string warm = draws + "warm, " + turnNames[i] + " turn, ";
+            double warmSort = Measure((warm + "std::sort").c_str(), [&]() { KeepResult(SortWithStdSort(keys)); }, turn);
+            SortWithSorter(sorter, keys);
+            frames = 0;
+            refined = 0;
+            double warmSorter = Measure((warm + "sorter").c_str(), sort, turn);
+            printf("  %zu of %zu warm frames refined\n", refined, frames);
+            ReportSpeedup("sorter over std::sort", warmSort, warmSorter);
+        }
+    }
+}
@@ -1,6 +1,7 @@
 #include "pch.h"
 
 #include "App.h"
+#include "CpuTrace.h"
 
 App::App() :
     m_hWnd(),
@@ -104,6 +105,9 @@ LRESULT App::MouseHandler(UINT uMsg, WPARAM wParam)
 
 HRESULT App::CreateDeviceResources()
 {
+    CPU_TRACE_THREAD_NAME("Main");
+    CPU_TRACE_SCOPE("App::CreateDeviceResources");
+
     HRESULT hr = S_OK;
 
     m_pCamera = std::shared_ptr<Camera>(new Camera());
@@ -132,6 +136,8 @@ HRESULT App::CreateDeviceResources()
 
 HRESULT App::Render()
 {
+    CPU_TRACE_SCOPE("App::Render");
+
     HRESULT hr = S_OK;
 
     m_pDeviceResources->GetAnnotation()->BeginEvent(L"Start rendering");
@@ -142,7 +148,12 @@ HRESULT App::Render()
 
     m_pRenderer->Render();
 
+    ID3D11DeviceContext* context = m_pDeviceResources->GetDeviceContext();
+    GpuProfiler* profiler = m_pRenderer->GetProfiler();
+    profiler->BeginPass(context, GPU_PROFILER_PASS::IMGUI);
     m_pSettings->Render();
+    profiler->EndPass(context, GPU_PROFILER_PASS::IMGUI);
+    profiler->EndFrame(context);
 
     m_pDeviceResources->Present();
 
@@ -167,6 +178,8 @@ void App::Run()
             hr = Render();
             if (FAILED(hr))
                 break;
+
+            CPU_TRACE_END_FRAME();
         }
     }
 }
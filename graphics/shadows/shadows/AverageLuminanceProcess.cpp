@@ -1,11 +1,13 @@
 #include "pch.h"
 
-#include <cmath>
-
 #include "AverageLuminanceProcess.h"
+#include "HdrPacking.h"
+#include "LuminanceHistogram.h"
 #include "Utils.h"
 
 AverageLuminanceProcess::AverageLuminanceProcess() :
+    m_sceneColorFormat(HDR_TEXEL_FORMAT::R32G32B32A32_FLOAT),
+    m_luminanceFormat(HDR_TEXEL_FORMAT::R32_FLOAT),
     m_adaptedLuminance(0.0)
 {
     QueryPerformanceFrequency(&m_qpcFrequency);
@@ -48,8 +50,11 @@ HRESULT AverageLuminanceProcess::CreateDeviceDependentResources(ID3D11Device* de
     if (FAILED(hr))
         return hr;
 
+    m_sceneColorFormat = SelectHdrFormat(device, HDR_TEXTURE_USAGE::SCENE_COLOR);
+    m_luminanceFormat = SelectHdrFormat(device, HDR_TEXTURE_USAGE::LUMINANCE);
+
     CD3D11_TEXTURE2D_DESC ltd(
-        DXGI_FORMAT_R32G32B32A32_FLOAT,
+        GetDXGIFormat(m_luminanceFormat),
         1,
         1,
         1,
@@ -87,7 +92,7 @@ HRESULT AverageLuminanceProcess::CreateWindowSizeDependentResources(ID3D11Device
     m_renderTextures.reserve(n + 2);
 
     UINT size = 1 << n;
-    RenderTexture initTexture(DXGI_FORMAT_R32G32B32A32_FLOAT);
+    RenderTexture initTexture(GetDXGIFormat(m_sceneColorFormat));
     hr = initTexture.CreateResources(device, size, size);
     if (FAILED(hr))
         return hr;
@@ -96,7 +101,7 @@ HRESULT AverageLuminanceProcess::CreateWindowSizeDependentResources(ID3D11Device
     for (size_t i = 0; i <= n; i++)
     {
         size = 1 << (n - i);
-        RenderTexture texture(DXGI_FORMAT_R32G32B32A32_FLOAT);
+        RenderTexture texture(GetDXGIFormat(m_luminanceFormat));
         hr = texture.CreateResources(device, size, size);
         if (FAILED(hr))
             return hr;
@@ -168,14 +173,23 @@ float AverageLuminanceProcess::Process(ID3D11DeviceContext* context, ID3D11Shade
     D3D11_MAPPED_SUBRESOURCE luminanceAccessor;
     context->CopyResource(m_pLuminanceTexture.Get(), m_renderTextures[m_renderTextures.size() - 1].GetRenderTarget());
     context->Map(m_pLuminanceTexture.Get(), 0, D3D11_MAP_READ, 0, &luminanceAccessor);
-    float luminance = *(float*)luminanceAccessor.pData;
+    float luminance = m_luminanceFormat == HDR_TEXEL_FORMAT::R16_FLOAT ?
+        UnpackHalf(*(uint16_t*)luminanceAccessor.pData) : *(float*)luminanceAccessor.pData;
     context->Unmap(m_pLuminanceTexture.Get(), 0);
 
-    float sigma = 0.04f / (0.04f + luminance);
-    float tau = sigma * 0.4f + (1 - sigma) * 0.1f;
-    m_adaptedLuminance += (luminance - m_adaptedLuminance) * static_cast<float>(1 - std::exp(-delta * tau));
+    m_adaptedLuminance = AdaptLuminance(m_adaptedLuminance, luminance, static_cast<float>(delta));
     return m_adaptedLuminance;
 }
 
+void AverageLuminanceProcess::AddVideoMemory(std::vector<VideoMemoryEntry>& entries) const
+{
+    for (size_t i = 0; i < m_renderTextures.size(); i++)
+    {
+        D3D11_VIEWPORT viewport = m_renderTextures[i].GetViewPort();
+        AddTextureMemory(entries, "Luminance " + std::to_string(static_cast<UINT>(viewport.Width)) + "x" +
+            std::to_string(static_cast<UINT>(viewport.Height)), m_renderTextures[i].GetRenderTarget());
+    }
+}
+
 AverageLuminanceProcess::~AverageLuminanceProcess()
 {}
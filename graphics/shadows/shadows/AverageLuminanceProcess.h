@@ -3,6 +3,7 @@
 #include <vector>
 
 #include "RenderTexture.h"
+#include "TextureFormats.h"
 
 class AverageLuminanceProcess
 {
@@ -15,6 +16,8 @@ public:
 
     float Process(ID3D11DeviceContext* context, ID3D11ShaderResourceView* sourceTexture);
 
+    void AddVideoMemory(std::vector<VideoMemoryEntry>& entries) const;
+
 private:
     void CopyTexture(ID3D11DeviceContext* context, ID3D11ShaderResourceView* sourceTexture, RenderTexture& dst, ID3D11PixelShader* pixelShader);
 
@@ -27,6 +30,10 @@ private:
     Microsoft::WRL::ComPtr<ID3D11Texture2D>    m_pLuminanceTexture;
     Microsoft::WRL::ComPtr<ID3D11RasterizerState> m_pRasterizerState;
 
+    // The first texture copies the scene, the rest hold the log luminance
+    HDR_TEXEL_FORMAT m_sceneColorFormat;
+    HDR_TEXEL_FORMAT m_luminanceFormat;
+
     float m_adaptedLuminance;
 
     LARGE_INTEGER m_qpcFrequency;
@@ -11,10 +11,11 @@ HRESULT BloomProcess::CreateDeviceDependentResources(ID3D11Device* device)
 {
     HRESULT hr = S_OK;
 
-    m_pBloomTexture = std::unique_ptr<RenderTexture>(new RenderTexture(DXGI_FORMAT_R32G32B32A32_FLOAT));
-    m_pMaskTextures[0] = std::unique_ptr<RenderTexture>(new RenderTexture(DXGI_FORMAT_R32G32B32A32_FLOAT));
-    m_pMaskTextures[1] = std::unique_ptr<RenderTexture>(new RenderTexture(DXGI_FORMAT_R32G32B32A32_FLOAT));
-    m_pResultTexture = std::unique_ptr<RenderTexture>(new RenderTexture(DXGI_FORMAT_R32G32B32A32_FLOAT));
+    DXGI_FORMAT format = GetDXGIFormat(SelectHdrFormat(device, HDR_TEXTURE_USAGE::SCENE_COLOR));
+    m_pBloomTexture = std::unique_ptr<RenderTexture>(new RenderTexture(format));
+    m_pMaskTextures[0] = std::unique_ptr<RenderTexture>(new RenderTexture(format));
+    m_pMaskTextures[1] = std::unique_ptr<RenderTexture>(new RenderTexture(format));
+    m_pResultTexture = std::unique_ptr<RenderTexture>(new RenderTexture(format));
 
     std::vector<BYTE> bytes;
 
@@ -108,5 +109,13 @@ void BloomProcess::Process(ID3D11DeviceContext* context, RenderTexture* sourceTe
     context->CopyResource(sourceTexture->GetRenderTarget(), m_pResultTexture->GetRenderTarget());
 }
 
+void BloomProcess::AddVideoMemory(std::vector<VideoMemoryEntry>& entries) const
+{
+    AddTextureMemory(entries, "Bloom", m_pBloomTexture->GetRenderTarget());
+    AddTextureMemory(entries, "Bloom mask 0", m_pMaskTextures[0]->GetRenderTarget());
+    AddTextureMemory(entries, "Bloom mask 1", m_pMaskTextures[1]->GetRenderTarget());
+    AddTextureMemory(entries, "Bloom result", m_pResultTexture->GetRenderTarget());
+}
+
 BloomProcess::~BloomProcess()
 {}
@@ -2,6 +2,7 @@
 
 #include "DeviceResources.h"
 #include "RenderTexture.h"
+#include "TextureFormats.h"
 
 class BloomProcess
 {
@@ -16,6 +17,8 @@ public:
 
     void Process(ID3D11DeviceContext* context, RenderTexture* sourceTexture, D3D11_VIEWPORT viewport);
 
+    void AddVideoMemory(std::vector<VideoMemoryEntry>& entries) const;
+
 private:
     Microsoft::WRL::ComPtr<ID3D11ComputeShader> m_pBlurComputeShader;
     Microsoft::WRL::ComPtr<ID3D11ComputeShader> m_pAddComputeShader;
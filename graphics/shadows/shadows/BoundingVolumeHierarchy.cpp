@@ -0,0 +1,531 @@
+#include "BoundingVolumeHierarchy.h"
+
+#include <algorithm>
+#include <future>
+#include <thread>
+
+#include <emmintrin.h>
+
+namespace
+{
+    const uint32_t BIN_COUNT = 16;
+    const uint32_t MAX_LEAF_SIZE = 4;
+    const uint32_t MIN_PARALLEL_COUNT = 1024;
+
+    float Component(const Float3& v, int axis)
+    {
+        return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+    }
+}
+
+const uint32_t BoundingVolumeHierarchy::INVALID_CHILD;
+
+struct BoundingVolumeHierarchy::BuildNode
+{
+    AABB bounds;
+    std::unique_ptr<BuildNode> children[2];
+    uint32_t first;
+    uint32_t count;
+};
+
+BoundingVolumeHierarchy::BoundingVolumeHierarchy() :
+    m_bounds(EmptyAABB())
+{};
+
+void BoundingVolumeHierarchy::Clear()
+{
+    m_nodes.clear();
+    m_indices.clear();
+    m_parents.clear();
+    m_leafNodes.clear();
+    m_boxes.clear();
+    m_bounds = EmptyAABB();
+}
+
+void BoundingVolumeHierarchy::Build(const std::vector<AABB>& boxes, unsigned int threadCount)
+{
+    Clear();
+    if (boxes.empty())
+        return;
+
+    m_boxes = boxes;
+
+    std::vector<Float3> centroids(boxes.size());
+    m_indices.resize(boxes.size());
+    for (size_t i = 0; i < boxes.size(); ++i)
+    {
+        centroids[i] = Center(boxes[i]);
+        m_indices[i] = static_cast<uint32_t>(i);
+    }
+
+    if (threadCount == 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    unsigned int parallelDepth = 0;
+    while ((1u << parallelDepth) < threadCount)
+        ++parallelDepth;
+
+    std::unique_ptr<BuildNode> root = BuildRecursive(centroids, 0, static_cast<uint32_t>(boxes.size()), parallelDepth);
+
+    m_nodes.reserve(boxes.size() / 2 + 1);
+    if (root->count > 0)
+    {
+        // Whole scene fits into one leaf
+        m_nodes.push_back(Node());
+        m_parents.push_back(INVALID_CHILD);
+        Node& node = m_nodes[0];
+        for (int i = 0; i < 4; ++i)
+        {
+            SetSlot(node, i, EmptyAABB());
+            node.child[i] = INVALID_CHILD;
+            node.count[i] = 0;
+        }
+        SetSlot(node, 0, root->bounds);
+        node.child[0] = root->first;
+        node.count[0] = root->count;
+    }
+    else
+    {
+        Flatten(root.get());
+        m_parents[0] = INVALID_CHILD;
+    }
+
+    m_leafNodes.resize(m_boxes.size());
+    for (uint32_t n = 0; n < m_nodes.size(); ++n)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            for (uint32_t k = 0; k < m_nodes[n].count[i]; ++k)
+                m_leafNodes[m_indices[m_nodes[n].child[i] + k]] = n;
+        }
+    }
+
+    m_bounds = root->bounds;
+}
+
+std::unique_ptr<BoundingVolumeHierarchy::BuildNode> BoundingVolumeHierarchy::BuildRecursive(std::vector<Float3>& centroids, uint32_t first, uint32_t count, unsigned int parallelDepth)
+{
+    std::unique_ptr<BuildNode> node(new BuildNode());
+    node->first = first;
+    node->count = count;
+
+    AABB bounds = EmptyAABB();
+    AABB centroidBounds = EmptyAABB();
+    for (uint32_t i = first; i < first + count; ++i)
+    {
+        Expand(bounds, m_boxes[m_indices[i]]);
+        Expand(centroidBounds, centroids[m_indices[i]]);
+    }
+    node->bounds = bounds;
+
+    if (count <= MAX_LEAF_SIZE)
+        return node;
+
+    // Binned SAH over all three axes
+    float bestCost = static_cast<float>(count) * SurfaceArea(bounds);
+    int bestAxis = -1;
+    uint32_t bestSplit = 0;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        float axisMin = Component(centroidBounds.min, axis);
+        float axisMax = Component(centroidBounds.max, axis);
+        if (axisMax - axisMin <= 0.0f)
+            continue;
+
+        AABB binBounds[BIN_COUNT];
+        uint32_t binCounts[BIN_COUNT] = {};
+        for (uint32_t b = 0; b < BIN_COUNT; ++b)
+            binBounds[b] = EmptyAABB();
+
+        float scale = BIN_COUNT / (axisMax - axisMin);
+        for (uint32_t i = first; i < first + count; ++i)
+        {
+            uint32_t index = m_indices[i];
+            uint32_t bin = std::min(BIN_COUNT - 1, static_cast<uint32_t>((Component(centroids[index], axis) - axisMin) * scale));
+            ++binCounts[bin];
+            Expand(binBounds[bin], m_boxes[index]);
+        }
+
+        float leftAreas[BIN_COUNT - 1];
+        uint32_t leftCounts[BIN_COUNT - 1];
+        AABB accumulated = EmptyAABB();
+        uint32_t accumulatedCount = 0;
+        for (uint32_t b = 0; b < BIN_COUNT - 1; ++b)
+        {
+            Expand(accumulated, binBounds[b]);
+            accumulatedCount += binCounts[b];
+            leftAreas[b] = SurfaceArea(accumulated);
+            leftCounts[b] = accumulatedCount;
+        }
+
+        accumulated = EmptyAABB();
+        accumulatedCount = 0;
+        for (uint32_t b = BIN_COUNT - 1; b > 0; --b)
+        {
+            Expand(accumulated, binBounds[b]);
+            accumulatedCount += binCounts[b];
+            if (leftCounts[b - 1] == 0 || accumulatedCount == 0)
+                continue;
+            float cost = leftAreas[b - 1] * leftCounts[b - 1] + SurfaceArea(accumulated) * accumulatedCount;
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = b;
+            }
+        }
+    }
+
+    uint32_t middle;
+    if (bestAxis >= 0)
+    {
+        float axisMin = Component(centroidBounds.min, bestAxis);
+        float scale = BIN_COUNT / (Component(centroidBounds.max, bestAxis) - axisMin);
+        uint32_t* split = std::partition(m_indices.data() + first, m_indices.data() + first + count, [&](uint32_t index)
+        {
+            uint32_t bin = std::min(BIN_COUNT - 1, static_cast<uint32_t>((Component(centroids[index], bestAxis) - axisMin) * scale));
+            return bin < bestSplit;
+        });
+        middle = static_cast<uint32_t>(split - m_indices.data());
+    }
+    else
+    {
+        // Splitting doesn't pay off or all centroids coincide, but keep leaves small
+        if (count <= 2 * MAX_LEAF_SIZE)
+            return node;
+        middle = first + count / 2;
+    }
+
+    if (middle == first || middle == first + count)
+        middle = first + count / 2;
+
+    // Children work on disjoint ranges of m_indices, so they can be built concurrently
+    if (parallelDepth > 0 && count >= MIN_PARALLEL_COUNT)
+    {
+        std::future<std::unique_ptr<BuildNode>> left = std::async(std::launch::async,
+            &BoundingVolumeHierarchy::BuildRecursive, this, std::ref(centroids), first, middle - first, parallelDepth - 1);
+        node->children[1] = BuildRecursive(centroids, middle, first + count - middle, parallelDepth - 1);
+        node->children[0] = left.get();
+    }
+    else
+    {
+        node->children[0] = BuildRecursive(centroids, first, middle - first, 0);
+        node->children[1] = BuildRecursive(centroids, middle, first + count - middle, 0);
+    }
+    node->count = 0;
+
+    return node;
+}
+
+uint32_t BoundingVolumeHierarchy::Flatten(const BuildNode* node)
+{
+    // Collapse binary nodes: keep opening the largest inner child until there are 4 children
+    const BuildNode* children[4] = { node->children[0].get(), node->children[1].get(), nullptr, nullptr };
+    int childCount = 2;
+    while (childCount < 4)
+    {
+        int largest = -1;
+        float largestArea = -1.0f;
+        for (int i = 0; i < childCount; ++i)
+        {
+            if (children[i]->count == 0 && SurfaceArea(children[i]->bounds) > largestArea)
+            {
+                largest = i;
+                largestArea = SurfaceArea(children[i]->bounds);
+            }
+        }
+        if (largest < 0)
+            break;
+        const BuildNode* opened = children[largest];
+        children[largest] = opened->children[0].get();
+        children[childCount++] = opened->children[1].get();
+    }
+
+    uint32_t index = static_cast<uint32_t>(m_nodes.size());
+    m_nodes.push_back(Node());
+    m_parents.push_back(INVALID_CHILD);
+    for (int i = 0; i < 4; ++i)
+    {
+        SetSlot(m_nodes[index], i, EmptyAABB());
+        m_nodes[index].child[i] = INVALID_CHILD;
+        m_nodes[index].count[i] = 0;
+    }
+
+    for (int i = 0; i < childCount; ++i)
+    {
+        SetSlot(m_nodes[index], i, children[i]->bounds);
+        if (children[i]->count > 0)
+        {
+            m_nodes[index].child[i] = children[i]->first;
+            m_nodes[index].count[i] = children[i]->count;
+        }
+        else
+        {
+            // Children are always stored after their parent, refit relies on it
+            uint32_t child = Flatten(children[i]);
+            m_nodes[index].child[i] = child;
+            m_parents[child] = index;
+        }
+    }
+
+    return index;
+}
+
+void BoundingVolumeHierarchy::SetSlot(Node& node, int slot, const AABB& box) const
+{
+    node.minX[slot] = box.min.x;
+    node.minY[slot] = box.min.y;
+    node.minZ[slot] = box.min.z;
+    node.maxX[slot] = box.max.x;
+    node.maxY[slot] = box.max.y;
+    node.maxZ[slot] = box.max.z;
+}
+
+AABB BoundingVolumeHierarchy::SlotBounds(const Node& node, int slot) const
+{
+    if (node.child[slot] == INVALID_CHILD)
+        return EmptyAABB();
+
+    AABB box = EmptyAABB();
+    if (node.count[slot] > 0)
+    {
+        for (uint32_t k = 0; k < node.count[slot]; ++k)
+            Expand(box, m_boxes[m_indices[node.child[slot] + k]]);
+    }
+    else
+    {
+        const Node& child = m_nodes[node.child[slot]];
+        for (int i = 0; i < 4; ++i)
+        {
+            if (child.child[i] != INVALID_CHILD)
+                Expand(box, { { child.minX[i], child.minY[i], child.minZ[i] }, { child.maxX[i], child.maxY[i], child.maxZ[i] } });
+        }
+    }
+    return box;
+}
+
+void BoundingVolumeHierarchy::RefitNodes()
+{
+    // Children have larger indices than parents, so a reverse sweep sees them first
+    for (size_t n = m_nodes.size(); n-- > 0;)
+    {
+        for (int i = 0; i < 4; ++i)
+            SetSlot(m_nodes[n], i, SlotBounds(m_nodes[n], i));
+    }
+
+    m_bounds = EmptyAABB();
+    for (int i = 0; i < 4; ++i)
+    {
+        if (m_nodes[0].child[i] != INVALID_CHILD)
+            Expand(m_bounds, SlotBounds(m_nodes[0], i));
+    }
+}
+
+void BoundingVolumeHierarchy::Refit(const std::vector<AABB>& boxes)
+{
+    if (boxes.size() != m_boxes.size())
+    {
+        Build(boxes);
+        return;
+    }
+
+    m_boxes = boxes;
+    if (!m_nodes.empty())
+        RefitNodes();
+}
+
+void BoundingVolumeHierarchy::Refit(const std::vector<uint32_t>& movedIndices, const std::vector<AABB>& boxes)
+{
+    if (boxes.size() != m_boxes.size())
+    {
+        Build(boxes);
+        return;
+    }
+
+    // Only the nodes on the paths from moved leaves to the root are updated
+    std::vector<bool> dirty(m_nodes.size(), false);
+    for (uint32_t index : movedIndices)
+    {
+        m_boxes[index] = boxes[index];
+        for (uint32_t n = m_leafNodes[index]; n != INVALID_CHILD && !dirty[n]; n = m_parents[n])
+            dirty[n] = true;
+    }
+
+    for (size_t n = m_nodes.size(); n-- > 0;)
+    {
+        if (!dirty[n])
+            continue;
+        for (int i = 0; i < 4; ++i)
+            SetSlot(m_nodes[n], i, SlotBounds(m_nodes[n], i));
+    }
+
+    m_bounds = EmptyAABB();
+    for (int i = 0; i < 4; ++i)
+    {
+        if (m_nodes[0].child[i] != INVALID_CHILD)
+            Expand(m_bounds, SlotBounds(m_nodes[0], i));
+    }
+}
+
+template<typename NodeTest, typename PrimitiveTest>
+void BoundingVolumeHierarchy::Traverse(NodeTest nodeTest, PrimitiveTest primitiveTest, std::vector<uint32_t>& result) const
+{
+    if (m_nodes.empty())
+        return;
+
+    std::vector<uint32_t> stack;
+    stack.reserve(64);
+    stack.push_back(0);
+    while (!stack.empty())
+    {
+        const Node& node = m_nodes[stack.back()];
+        stack.pop_back();
+        int mask = nodeTest(node);
+        for (int i = 0; i < 4; ++i)
+        {
+            if (!(mask & (1 << i)) || node.child[i] == INVALID_CHILD)
+                continue;
+
+            if (node.count[i] > 0)
+            {
+                for (uint32_t k = 0; k < node.count[i]; ++k)
+                {
+                    uint32_t index = m_indices[node.child[i] + k];
+                    if (primitiveTest(m_boxes[index]))
+                        result.push_back(index);
+                }
+            }
+            else
+                stack.push_back(node.child[i]);
+        }
+    }
+}
+
+void BoundingVolumeHierarchy::QueryFrustum(const Frustum& frustum, std::vector<uint32_t>& result) const
+{
+    Traverse([&frustum](const Node& node)
+    {
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (const Plane& plane : frustum.planes)
+        {
+            // Positive vertex of each box relative to the plane normal
+            __m128 x = _mm_loadu_ps(plane.normal.x >= 0 ? node.maxX : node.minX);
+            __m128 y = _mm_loadu_ps(plane.normal.y >= 0 ? node.maxY : node.minY);
+            __m128 z = _mm_loadu_ps(plane.normal.z >= 0 ? node.maxZ : node.minZ);
+            __m128 distance = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane.normal.x)), _mm_mul_ps(y, _mm_set1_ps(plane.normal.y))),
+                _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(plane.normal.z)), _mm_set1_ps(plane.d)));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, _mm_setzero_ps()));
+        }
+        return _mm_movemask_ps(inside);
+    },
+    [&frustum](const AABB& box) { return Intersects(box, frustum); }, result);
+}
+
+void BoundingVolumeHierarchy::QuerySphere(const BoundingSphere& sphere, std::vector<uint32_t>& result) const
+{
+    __m128 cx = _mm_set1_ps(sphere.center.x);
+    __m128 cy = _mm_set1_ps(sphere.center.y);
+    __m128 cz = _mm_set1_ps(sphere.center.z);
+    __m128 r2 = _mm_set1_ps(sphere.radius * sphere.radius);
+    Traverse([&](const Node& node)
+    {
+        __m128 zero = _mm_setzero_ps();
+        __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(node.minX), cx), _mm_sub_ps(cx, _mm_loadu_ps(node.maxX))), zero);
+        __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(node.minY), cy), _mm_sub_ps(cy, _mm_loadu_ps(node.maxY))), zero);
+        __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(node.minZ), cz), _mm_sub_ps(cz, _mm_loadu_ps(node.maxZ))), zero);
+        __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+        return _mm_movemask_ps(_mm_cmple_ps(d2, r2));
+    },
+    [&sphere](const AABB& box) { return Intersects(box, sphere); }, result);
+}
+
+void BoundingVolumeHierarchy::QueryAABB(const AABB& box, std::vector<uint32_t>& result) const
+{
+    Traverse([&box](const Node& node)
+    {
+        __m128 overlap = _mm_and_ps(
+            _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(node.minX), _mm_set1_ps(box.max.x)), _mm_cmpge_ps(_mm_loadu_ps(node.maxX), _mm_set1_ps(box.min.x))),
+            _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(node.minY), _mm_set1_ps(box.max.y)), _mm_cmpge_ps(_mm_loadu_ps(node.maxY), _mm_set1_ps(box.min.y))));
+        overlap = _mm_and_ps(overlap,
+            _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(node.minZ), _mm_set1_ps(box.max.z)), _mm_cmpge_ps(_mm_loadu_ps(node.maxZ), _mm_set1_ps(box.min.z))));
+        return _mm_movemask_ps(overlap);
+    },
+    [&box](const AABB& other) { return Intersects(box, other); }, result);
+}
+
+bool BoundingVolumeHierarchy::QueryRay(const Ray& ray, float maxDistance, uint32_t& hitIndex, float& hitDistance, const RayPrimitiveTest& test) const
+{
+    if (m_nodes.empty())
+        return false;
+
+    // Zero direction components give infinite slabs, which the min/max below handle
+    __m128 ox = _mm_set1_ps(ray.origin.x);
+    __m128 oy = _mm_set1_ps(ray.origin.y);
+    __m128 oz = _mm_set1_ps(ray.origin.z);
+    __m128 ix = _mm_set1_ps(1.0f / ray.direction.x);
+    __m128 iy = _mm_set1_ps(1.0f / ray.direction.y);
+    __m128 iz = _mm_set1_ps(1.0f / ray.direction.z);
+
+    bool hit = false;
+    float closest = maxDistance;
+
+    std::vector<uint32_t> stack;
+    stack.reserve(64);
+    stack.push_back(0);
+    while (!stack.empty())
+    {
+        const Node& node = m_nodes[stack.back()];
+        stack.pop_back();
+
+        __m128 tx0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minX), ox), ix);
+        __m128 tx1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxX), ox), ix);
+        __m128 ty0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minY), oy), iy);
+        __m128 ty1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxY), oy), iy);
+        __m128 tz0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minZ), oz), iz);
+        __m128 tz1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxZ), oz), iz);
+        __m128 tNear = _mm_max_ps(_mm_max_ps(_mm_min_ps(tx0, tx1), _mm_min_ps(ty0, ty1)), _mm_max_ps(_mm_min_ps(tz0, tz1), _mm_setzero_ps()));
+        __m128 tFar = _mm_min_ps(_mm_min_ps(_mm_max_ps(tx0, tx1), _mm_max_ps(ty0, ty1)), _mm_min_ps(_mm_max_ps(tz0, tz1), _mm_set1_ps(closest)));
+        int mask = _mm_movemask_ps(_mm_cmple_ps(tNear, tFar));
+
+        float nearDistances[4];
+        _mm_storeu_ps(nearDistances, tNear);
+
+        // Push far children first so the nearest one is popped next
+        int order[4] = { 0, 1, 2, 3 };
+        std::sort(order, order + 4, [&nearDistances](int a, int b) { return nearDistances[a] > nearDistances[b]; });
+        for (int k = 0; k < 4; ++k)
+        {
+            int i = order[k];
+            if (!(mask & (1 << i)) || node.child[i] == INVALID_CHILD || nearDistances[i] > closest)
+                continue;
+
+            if (node.count[i] > 0)
+            {
+                for (uint32_t p = 0; p < node.count[i]; ++p)
+                {
+                    uint32_t index = m_indices[node.child[i] + p];
+                    float distance;
+                    if (!Intersects(ray, m_boxes[index], closest, distance))
+                        continue;
+                    if (test && !test(index, distance))
+                        continue;
+                    if (distance <= closest)
+                    {
+                        closest = distance;
+                        hitIndex = index;
+                        hit = true;
+                    }
+                }
+            }
+            else
+                stack.push_back(node.child[i]);
+        }
+    }
+
+    if (hit)
+        hitDistance = closest;
+    return hit;
+}
+
+BoundingVolumeHierarchy::~BoundingVolumeHierarchy()
+{}
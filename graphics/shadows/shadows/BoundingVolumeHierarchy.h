@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "Bounds.h"
+
+// Four-wide bounding volume hierarchy over primitive AABBs.
+// Built with binned SAH (subtrees in parallel), collapsed to 4-child nodes stored
+// as SoA so every node is tested against a query with one SSE pass.
+class BoundingVolumeHierarchy
+{
+public:
+    // Called with a primitive index and the distance to its AABB, returns true and
+    // updates the distance if the primitive is really hit
+    typedef std::function<bool(uint32_t index, float& distance)> RayPrimitiveTest;
+
+    BoundingVolumeHierarchy();
+    ~BoundingVolumeHierarchy();
+
+    void Build(const std::vector<AABB>& boxes, unsigned int threadCount = 0);
+    void Refit(const std::vector<AABB>& boxes);
+    void Refit(const std::vector<uint32_t>& movedIndices, const std::vector<AABB>& boxes);
+    void Clear();
+
+    bool IsEmpty() const { return m_nodes.empty(); };
+    AABB GetBounds() const { return m_bounds; };
+    size_t GetNodeCount() const { return m_nodes.size(); };
+    size_t GetPrimitiveCount() const { return m_boxes.size(); };
+
+    void QueryFrustum(const Frustum& frustum, std::vector<uint32_t>& result) const;
+    void QuerySphere(const BoundingSphere& sphere, std::vector<uint32_t>& result) const;
+    void QueryAABB(const AABB& box, std::vector<uint32_t>& result) const;
+    bool QueryRay(const Ray& ray, float maxDistance, uint32_t& hitIndex, float& hitDistance, const RayPrimitiveTest& test = nullptr) const;
+
+private:
+    static const uint32_t INVALID_CHILD = 0xFFFFFFFF;
+
+    // Slot i is empty if child[i] == INVALID_CHILD, a leaf if count[i] > 0 (child is the first
+    // entry in m_indices) and an inner node otherwise
+    struct Node
+    {
+        float minX[4];
+        float minY[4];
+        float minZ[4];
+        float maxX[4];
+        float maxY[4];
+        float maxZ[4];
+        uint32_t child[4];
+        uint32_t count[4];
+    };
+
+    struct BuildNode;
+
+    std::unique_ptr<BuildNode> BuildRecursive(std::vector<Float3>& centroids, uint32_t first, uint32_t count, unsigned int parallelDepth);
+    uint32_t Flatten(const BuildNode* node);
+    void SetSlot(Node& node, int slot, const AABB& box) const;
+    void RefitNodes();
+    AABB SlotBounds(const Node& node, int slot) const;
+
+    template<typename NodeTest, typename PrimitiveTest>
+    void Traverse(NodeTest nodeTest, PrimitiveTest primitiveTest, std::vector<uint32_t>& result) const;
+
+    std::vector<Node>     m_nodes;
+    std::vector<uint32_t> m_indices;
+    std::vector<uint32_t> m_parents;
+    std::vector<uint32_t> m_leafNodes;
+    std::vector<AABB>     m_boxes;
+
+    AABB m_bounds;
+};
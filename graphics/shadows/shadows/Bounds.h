@@ -0,0 +1,201 @@
+#pragma once
+
+#include <cfloat>
+
+// Plain geometry types shared by the CPU-side scene queries. They don't depend on
+// DirectXMath or Windows headers so the query code can be built on any platform.
+
+struct Float3
+{
+    float x;
+    float y;
+    float z;
+};
+
+struct AABB
+{
+    Float3 min;
+    Float3 max;
+};
+
+struct BoundingSphere
+{
+    Float3 center;
+    float radius;
+};
+
+struct Ray
+{
+    Float3 origin;
+    Float3 direction;
+};
+
+// Points p with dot(normal, p) + d >= 0 are inside
+struct Plane
+{
+    Float3 normal;
+    float d;
+};
+
+struct Frustum
+{
+    Plane planes[6];
+};
+
+inline AABB EmptyAABB()
+{
+    return { { FLT_MAX, FLT_MAX, FLT_MAX }, { -FLT_MAX, -FLT_MAX, -FLT_MAX } };
+}
+
+inline bool IsEmpty(const AABB& box)
+{
+    return box.min.x > box.max.x || box.min.y > box.max.y || box.min.z > box.max.z;
+}
+
+inline void Expand(AABB& box, const Float3& point)
+{
+    box.min.x = point.x < box.min.x ? point.x : box.min.x;
+    box.min.y = point.y < box.min.y ? point.y : box.min.y;
+    box.min.z = point.z < box.min.z ? point.z : box.min.z;
+    box.max.x = point.x > box.max.x ? point.x : box.max.x;
+    box.max.y = point.y > box.max.y ? point.y : box.max.y;
+    box.max.z = point.z > box.max.z ? point.z : box.max.z;
+}
+
+inline void Expand(AABB& box, const AABB& other)
+{
+    Expand(box, other.min);
+    Expand(box, other.max);
+}
+
+inline Float3 Center(const AABB& box)
+{
+    return { (box.min.x + box.max.x) * 0.5f, (box.min.y + box.max.y) * 0.5f, (box.min.z + box.max.z) * 0.5f };
+}
+
+inline Float3 Extents(const AABB& box)
+{
+    return { (box.max.x - box.min.x) * 0.5f, (box.max.y - box.min.y) * 0.5f, (box.max.z - box.min.z) * 0.5f };
+}
+
+inline float SurfaceArea(const AABB& box)
+{
+    if (IsEmpty(box))
+        return 0.0f;
+    float dx = box.max.x - box.min.x;
+    float dy = box.max.y - box.min.y;
+    float dz = box.max.z - box.min.z;
+    return 2.0f * (dx * dy + dy * dz + dz * dx);
+}
+
+// Transforms the 8 corners of the box by a row-major matrix (row vector convention, as DirectXMath)
+inline AABB TransformAABB(const AABB& box, const float matrix[4][4])
+{
+    AABB result = EmptyAABB();
+    for (int i = 0; i < 8; ++i)
+    {
+        float x = (i & 1) ? box.max.x : box.min.x;
+        float y = (i & 2) ? box.max.y : box.min.y;
+        float z = (i & 4) ? box.max.z : box.min.z;
+        Float3 p = {
+            x * matrix[0][0] + y * matrix[1][0] + z * matrix[2][0] + matrix[3][0],
+            x * matrix[0][1] + y * matrix[1][1] + z * matrix[2][1] + matrix[3][1],
+            x * matrix[0][2] + y * matrix[1][2] + z * matrix[2][2] + matrix[3][2]
+        };
+        Expand(result, p);
+    }
+    return result;
+}
+
+inline bool Intersects(const AABB& a, const AABB& b)
+{
+    return a.min.x <= b.max.x && a.max.x >= b.min.x &&
+        a.min.y <= b.max.y && a.max.y >= b.min.y &&
+        a.min.z <= b.max.z && a.max.z >= b.min.z;
+}
+
+inline bool Intersects(const AABB& box, const BoundingSphere& sphere)
+{
+    float d = 0.0f;
+    float v;
+    v = sphere.center.x < box.min.x ? box.min.x - sphere.center.x : (sphere.center.x > box.max.x ? sphere.center.x - box.max.x : 0.0f);
+    d += v * v;
+    v = sphere.center.y < box.min.y ? box.min.y - sphere.center.y : (sphere.center.y > box.max.y ? sphere.center.y - box.max.y : 0.0f);
+    d += v * v;
+    v = sphere.center.z < box.min.z ? box.min.z - sphere.center.z : (sphere.center.z > box.max.z ? sphere.center.z - box.max.z : 0.0f);
+    d += v * v;
+    return d <= sphere.radius * sphere.radius;
+}
+
+// Conservative test: false only if the box is completely outside of one of the planes
+inline bool Intersects(const AABB& box, const Frustum& frustum)
+{
+    for (const Plane& plane : frustum.planes)
+    {
+        float x = plane.normal.x >= 0 ? box.max.x : box.min.x;
+        float y = plane.normal.y >= 0 ? box.max.y : box.min.y;
+        float z = plane.normal.z >= 0 ? box.max.z : box.min.z;
+        if (plane.normal.x * x + plane.normal.y * y + plane.normal.z * z + plane.d < 0)
+            return false;
+    }
+    return true;
+}
+
+// Slab test, distance is set to the entry point (0 if the origin is inside)
+inline bool Intersects(const Ray& ray, const AABB& box, float maxDistance, float& distance)
+{
+    float tMin = 0.0f;
+    float tMax = maxDistance;
+    const float origin[3] = { ray.origin.x, ray.origin.y, ray.origin.z };
+    const float direction[3] = { ray.direction.x, ray.direction.y, ray.direction.z };
+    const float boxMin[3] = { box.min.x, box.min.y, box.min.z };
+    const float boxMax[3] = { box.max.x, box.max.y, box.max.z };
+    for (int i = 0; i < 3; ++i)
+    {
+        if (direction[i] == 0.0f)
+        {
+            if (origin[i] < boxMin[i] || origin[i] > boxMax[i])
+                return false;
+            continue;
+        }
+        float inv = 1.0f / direction[i];
+        float t0 = (boxMin[i] - origin[i]) * inv;
+        float t1 = (boxMax[i] - origin[i]) * inv;
+        if (t0 > t1)
+        {
+            float t = t0;
+            t0 = t1;
+            t1 = t;
+        }
+        tMin = t0 > tMin ? t0 : tMin;
+        tMax = t1 < tMax ? t1 : tMax;
+        if (tMin > tMax)
+            return false;
+    }
+    distance = tMin;
+    return true;
+}
+
+// Gribb-Hartmann plane extraction for a row-major view-projection matrix with D3D clip space (0 <= z <= w)
+inline Frustum FrustumFromMatrix(const float m[4][4])
+{
+    Frustum frustum;
+    float columns[4][4];
+    for (int i = 0; i < 4; ++i)
+        for (int j = 0; j < 4; ++j)
+            columns[i][j] = m[j][i];
+
+    const float signs[6] = { 1.0f, -1.0f, 1.0f, -1.0f, 0.0f, -1.0f };
+    const int axes[6] = { 0, 0, 1, 1, 2, 2 };
+    for (int i = 0; i < 6; ++i)
+    {
+        // Left, right, bottom, top use w +- axis, near is z, far is w - z
+        float* axis = columns[axes[i]];
+        float* w = columns[3];
+        float p[4];
+        for (int k = 0; k < 4; ++k)
+            p[k] = (i == 4) ? axis[k] : w[k] + signs[i] * axis[k];
+        frustum.planes[i] = { { p[0], p[1], p[2] }, p[3] };
+    }
+    return frustum;
+}
@@ -0,0 +1,57 @@
+#include "CacheFile.h"
+
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <thread>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+std::string CreateCacheDirectory(const std::string& directory)
+{
+    std::string path = directory;
+    if (!path.empty() && path.back() != '/' && path.back() != '\\')
+        path += '/';
+
+#ifdef _WIN32
+    _mkdir(path.c_str());
+#else
+    mkdir(path.c_str(), 0755);
+#endif
+    return path;
+}
+
+bool WriteCacheFile(const std::string& path, const CacheFileChunk* chunks, size_t chunkCount)
+{
+    std::ostringstream temporaryPath;
+    temporaryPath << path << "." << std::hash<std::thread::id>()(std::this_thread::get_id()) << ".tmp";
+
+    {
+        std::ofstream file(temporaryPath.str(), std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+            return false;
+
+        for (size_t i = 0; i < chunkCount; ++i)
+            file.write(static_cast<const char*>(chunks[i].data), chunks[i].size);
+        if (!file)
+        {
+            file.close();
+            std::remove(temporaryPath.str().c_str());
+            return false;
+        }
+    }
+
+    // Rename doesn't replace an existing file on Windows, a file written meanwhile has the same contents
+    std::remove(path.c_str());
+    if (std::rename(temporaryPath.str().c_str(), path.c_str()) != 0)
+    {
+        std::remove(temporaryPath.str().c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Files of the on-disk caches (compiled shaders, baked lighting)
+
+// Adds the trailing separator and creates the directory. An existing directory is fine, if it can't be created
+// every write into it simply fails.
+std::string CreateCacheDirectory(const std::string& directory);
+
+struct CacheFileChunk
+{
+    const void* data;
+    size_t      size;
+};
+
+// Writes the chunks one after another under a temporary name and renames the file to its path once it is complete,
+// so a crash while writing never leaves a truncated file behind. Threads writing the same path don't share the
+// temporary file, the last rename wins.
+bool WriteCacheFile(const std::string& path, const CacheFileChunk* chunks, size_t chunkCount);
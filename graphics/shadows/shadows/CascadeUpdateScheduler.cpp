@@ -0,0 +1,65 @@
+#include "CascadeUpdateScheduler.h"
+
+CascadeUpdateScheduler::CascadeUpdateScheduler(uint32_t cascadeCount) :
+    m_budget(0),
+    m_interval(1),
+    m_refresh(false)
+{
+    SetCascadeCount(cascadeCount);
+};
+
+CascadeUpdateScheduler::~CascadeUpdateScheduler()
+{};
+
+void CascadeUpdateScheduler::SetCascadeCount(uint32_t cascadeCount)
+{
+    // Cascades start as old as possible, so the first frame renders everything the budget allows
+    m_ages.assign(cascadeCount, UINT32_MAX);
+}
+
+uint32_t CascadeUpdateScheduler::Schedule(uint32_t dirtyMask)
+{
+    uint32_t cascadeCount = static_cast<uint32_t>(m_ages.size());
+    uint32_t interval = m_interval > 0 ? m_interval : 1;
+    uint32_t minAge = interval - 1;
+    // Every farther cascade gets its turn within this many frames even when none of them moves
+    uint32_t refreshAge = cascadeCount > 1 ? interval * (cascadeCount - 1) - 1 : 0;
+    uint32_t scheduled = 0;
+    uint32_t count = 0;
+    // Without refreshing there is no turn for clean cascades to take
+    bool refreshed = !m_refresh;
+
+    if (cascadeCount > 0 && (dirtyMask & 1))
+        scheduled |= 1;
+
+    // Picks the oldest eligible cascade until the budget is spent. A single refresh per frame staggers the turns.
+    while (m_budget == 0 || count < m_budget)
+    {
+        uint32_t oldest = cascadeCount;
+        for (uint32_t cascade = 1; cascade < cascadeCount; ++cascade)
+        {
+            uint32_t bit = 1u << cascade;
+            bool dirty = (dirtyMask & bit) != 0;
+            if ((scheduled & bit) || (!dirty && refreshed) || m_ages[cascade] < (dirty ? minAge : refreshAge))
+                continue;
+            if (oldest == cascadeCount || m_ages[cascade] > m_ages[oldest])
+                oldest = cascade;
+        }
+        if (oldest == cascadeCount)
+            break;
+
+        refreshed = refreshed || !(dirtyMask & (1u << oldest));
+        scheduled |= 1u << oldest;
+        ++count;
+    }
+
+    for (uint32_t cascade = 0; cascade < cascadeCount; ++cascade)
+    {
+        if (scheduled & (1u << cascade))
+            m_ages[cascade] = 0;
+        else if (m_ages[cascade] != UINT32_MAX)
+            ++m_ages[cascade];
+    }
+
+    return scheduled;
+}
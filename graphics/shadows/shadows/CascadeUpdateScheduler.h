@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Spreads shadow cascade updates over frames. The first cascade is rendered every frame it needs it and outside of
+// the budget, farther cascades only once their update interval has passed, and at most a budget of them per frame.
+// Cascades that need an update but aren't picked wait, the oldest ones go first (round-robin). Cascades that don't
+// need an update are kept, unless refreshing is enabled: then farther cascades are also rendered in turn without
+// being moved, each at least once per interval times their count frames.
+class CascadeUpdateScheduler
+{
+public:
+    explicit CascadeUpdateScheduler(uint32_t cascadeCount = 0);
+    ~CascadeUpdateScheduler();
+
+    void SetCascadeCount(uint32_t cascadeCount);
+
+    // Maximum number of farther cascades rendered per frame, 0 means no limit
+    void SetBudget(uint32_t maxCascadesPerFrame) { m_budget = maxCascadesPerFrame; };
+    // Minimum number of frames between updates of the farther cascades
+    void SetInterval(uint32_t frames) { m_interval = frames; };
+    // Renders farther cascades that didn't move in turn, one per frame. Off by default, it's only
+    // needed when the casters can change without the cascades needing an update.
+    void SetRefresh(bool refresh) { m_refresh = refresh; };
+
+    // Takes the cascades that need an update and returns the ones to render this frame
+    uint32_t Schedule(uint32_t dirtyMask);
+
+    uint32_t GetAge(uint32_t cascade) const { return m_ages[cascade]; };
+
+private:
+    std::vector<uint32_t> m_ages;
+
+    uint32_t m_budget;
+    uint32_t m_interval;
+    bool     m_refresh;
+};
@@ -0,0 +1,157 @@
+#include "pch.h"
+
+#include "ClusteredLights.h"
+#include "ShaderStructures.h"
+#include "CpuTrace.h"
+
+#include <cmath>
+
+const UINT clusterTilesX = 16;
+const UINT clusterTilesY = 9;
+const UINT clusterSlices = 24;
+// Depths closer than this share the first slice, the last slice ends at the far plane of the projection
+const float clusterNear = 1.0f;
+
+// Initial sizes of the buffers, they only grow afterwards
+const UINT initialLightCapacity = 1024;
+const UINT initialIndexCapacity = 16384;
+
+ClusteredLights::ClusteredLights() :
+    m_lightCapacity(0),
+    m_clusterCapacity(0),
+    m_indexCapacity(0)
+{};
+
+HRESULT ClusteredLights::CreateDeviceDependentResources(ID3D11Device* device)
+{
+    HRESULT hr = S_OK;
+
+    CD3D11_BUFFER_DESC cb(sizeof(LightClustersConstantBuffer), D3D11_BIND_CONSTANT_BUFFER);
+    hr = device->CreateBuffer(&cb, nullptr, &m_pConstantBuffer);
+    if (FAILED(hr))
+        return hr;
+
+    // Shaders read all three buffers even without lights, so they exist from the start
+    hr = ReserveBuffer(device, initialLightCapacity, sizeof(PointLight), m_lightCapacity, m_pLightBuffer, m_pLightShaderResourceView);
+    if (FAILED(hr))
+        return hr;
+
+    hr = ReserveBuffer(device, clusterTilesX * clusterTilesY * clusterSlices, sizeof(LightClusterRange), m_clusterCapacity, m_pClusterBuffer, m_pClusterShaderResourceView);
+    if (FAILED(hr))
+        return hr;
+
+    hr = ReserveBuffer(device, initialIndexCapacity, sizeof(UINT), m_indexCapacity, m_pIndexBuffer, m_pIndexShaderResourceView);
+    return hr;
+}
+
+HRESULT ClusteredLights::ReserveBuffer(ID3D11Device* device, UINT count, UINT stride, UINT& capacity,
+    Microsoft::WRL::ComPtr<ID3D11Buffer>& buffer, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& shaderResourceView)
+{
+    if (count <= capacity)
+        return S_OK;
+
+    // Capacity doubles, so a growing light count doesn't recreate the buffer every frame
+    UINT newCapacity = capacity > 0 ? capacity : 1;
+    while (newCapacity < count)
+        newCapacity *= 2;
+
+    buffer.Reset();
+    shaderResourceView.Reset();
+    capacity = 0;
+
+    CD3D11_BUFFER_DESC bd(newCapacity * stride, D3D11_BIND_SHADER_RESOURCE, D3D11_USAGE_DYNAMIC, D3D11_CPU_ACCESS_WRITE,
+        D3D11_RESOURCE_MISC_BUFFER_STRUCTURED, stride);
+    HRESULT hr = device->CreateBuffer(&bd, nullptr, &buffer);
+    if (FAILED(hr))
+        return hr;
+
+    CD3D11_SHADER_RESOURCE_VIEW_DESC srvd(D3D11_SRV_DIMENSION_BUFFER, DXGI_FORMAT_UNKNOWN, 0, newCapacity);
+    hr = device->CreateShaderResourceView(buffer.Get(), &srvd, &shaderResourceView);
+    if (FAILED(hr))
+        return hr;
+
+    capacity = newCapacity;
+    return hr;
+}
+
+HRESULT ClusteredLights::UploadBuffer(ID3D11DeviceContext* context, ID3D11Buffer* buffer, const void* data, size_t size)
+{
+    if (size == 0)
+        return S_OK;
+
+    D3D11_MAPPED_SUBRESOURCE mapped;
+    HRESULT hr = context->Map(buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped);
+    if (FAILED(hr))
+        return hr;
+
+    memcpy(mapped.pData, data, size);
+    context->Unmap(buffer, 0);
+    return hr;
+}
+
+HRESULT ClusteredLights::Update(ID3D11Device* device, ID3D11DeviceContext* context, const std::vector<PointLight>& lights, DirectX::FXMMATRIX view,
+    float tanHalfFovX, float tanHalfFovY, float farDistance, UINT width, UINT height)
+{
+    CPU_TRACE_SCOPE("ClusteredLights::Update");
+
+    HRESULT hr = S_OK;
+
+    const LightClusterGrid& grid = m_builder.GetGrid();
+    if (grid.slices == 0 || grid.farDistance != farDistance || grid.tanHalfFovX != tanHalfFovX || grid.tanHalfFovY != tanHalfFovY)
+        m_builder.SetGrid({ clusterTilesX, clusterTilesY, clusterSlices, clusterNear, farDistance, tanHalfFovX, tanHalfFovY });
+
+    // The builder looks along +z, the camera along -z
+    DirectX::XMFLOAT4X4 builderView;
+    DirectX::XMStoreFloat4x4(&builderView, DirectX::XMMatrixMultiply(view, DirectX::XMMatrixScaling(1.0f, 1.0f, -1.0f)));
+
+    UINT lightCount = static_cast<UINT>(lights.size());
+    m_builder.Build(lights.data(), lightCount, builderView.m);
+
+    const std::vector<LightClusterRange>& clusters = m_builder.GetClusters();
+    const std::vector<uint32_t>& indices = m_builder.GetIndices();
+
+    hr = ReserveBuffer(device, lightCount, sizeof(PointLight), m_lightCapacity, m_pLightBuffer, m_pLightShaderResourceView);
+    if (FAILED(hr))
+        return hr;
+
+    hr = ReserveBuffer(device, static_cast<UINT>(indices.size()), sizeof(UINT), m_indexCapacity, m_pIndexBuffer, m_pIndexShaderResourceView);
+    if (FAILED(hr))
+        return hr;
+
+    hr = UploadBuffer(context, m_pLightBuffer.Get(), lights.data(), lights.size() * sizeof(PointLight));
+    if (FAILED(hr))
+        return hr;
+
+    hr = UploadBuffer(context, m_pClusterBuffer.Get(), clusters.data(), clusters.size() * sizeof(LightClusterRange));
+    if (FAILED(hr))
+        return hr;
+
+    hr = UploadBuffer(context, m_pIndexBuffer.Get(), indices.data(), indices.size() * sizeof(uint32_t));
+    if (FAILED(hr))
+        return hr;
+
+    // Slice of a view depth d is log(d) * scale + bias, the same split the builder uses
+    float sliceScale = clusterSlices / std::log(farDistance / clusterNear);
+
+    LightClustersConstantBuffer clustersData;
+    clustersData.ClusterGrid = DirectX::XMUINT4(clusterTilesX, clusterTilesY, clusterSlices, lightCount);
+    clustersData.ClusterParams = DirectX::XMFLOAT4(sliceScale, -std::log(clusterNear) * sliceScale, 1.0f / width, 1.0f / height);
+    context->UpdateSubresource(m_pConstantBuffer.Get(), 0, nullptr, &clustersData, 0, 0);
+
+    return hr;
+}
+
+void ClusteredLights::Bind(ID3D11DeviceContext* context, UINT firstSlot, UINT constantBufferSlot)
+{
+    ID3D11ShaderResourceView* resources[3] = {
+        m_pLightShaderResourceView.Get(),
+        m_pClusterShaderResourceView.Get(),
+        m_pIndexShaderResourceView.Get()
+    };
+
+    context->PSSetShaderResources(firstSlot, 3, resources);
+    context->PSSetConstantBuffers(constantBufferSlot, 1, m_pConstantBuffer.GetAddressOf());
+}
+
+ClusteredLights::~ClusteredLights()
+{};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "DeviceResources.h"
+#include "LightClusters.h"
+
+// Point lights for clustered forward shading. Lights are assigned to the clusters of the view frustum on the CPU,
+// the lights, cluster ranges and index lists go to structured buffers the pixel shader reads from.
+class ClusteredLights
+{
+public:
+    ClusteredLights();
+    ~ClusteredLights();
+
+    HRESULT CreateDeviceDependentResources(ID3D11Device* device);
+
+    // View is right-handed as the camera one, the field of view and the far distance are the ones of its projection.
+    // The buffers grow when there are more lights or indices than fit.
+    HRESULT Update(ID3D11Device* device, ID3D11DeviceContext* context, const std::vector<PointLight>& lights, DirectX::FXMMATRIX view,
+        float tanHalfFovX, float tanHalfFovY, float farDistance, UINT width, UINT height);
+
+    // Binds the lights, clusters and indices to three slots from firstSlot on
+    void Bind(ID3D11DeviceContext* context, UINT firstSlot, UINT constantBufferSlot);
+
+    UINT GetIndexCount() const { return static_cast<UINT>(m_builder.GetIndices().size()); };
+    UINT GetClusterCount() const { return m_builder.GetClusterCount(); };
+
+private:
+    HRESULT ReserveBuffer(ID3D11Device* device, UINT count, UINT stride, UINT& capacity,
+        Microsoft::WRL::ComPtr<ID3D11Buffer>& buffer, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& shaderResourceView);
+    HRESULT UploadBuffer(ID3D11DeviceContext* context, ID3D11Buffer* buffer, const void* data, size_t size);
+
+    LightClusterBuilder m_builder;
+
+    Microsoft::WRL::ComPtr<ID3D11Buffer>             m_pConstantBuffer;
+    Microsoft::WRL::ComPtr<ID3D11Buffer>             m_pLightBuffer;
+    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_pLightShaderResourceView;
+    Microsoft::WRL::ComPtr<ID3D11Buffer>             m_pClusterBuffer;
+    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_pClusterShaderResourceView;
+    Microsoft::WRL::ComPtr<ID3D11Buffer>             m_pIndexBuffer;
+    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_pIndexShaderResourceView;
+
+    UINT m_lightCapacity;
+    UINT m_clusterCapacity;
+    UINT m_indexCapacity;
+};
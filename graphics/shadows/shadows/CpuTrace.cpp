@@ -0,0 +1,274 @@
+#include "CpuTrace.h"
+
+#if CPU_TRACE_ENABLED
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+
+// Events one thread can record between two frames before the oldest ones are lost
+const uint32_t threadBufferCapacity = 1 << 14;
+// Events kept for a trace, about 10 MB, later ones are counted as lost
+const size_t maxCapturedEvents = 1 << 18;
+const float zoneSmoothing = 0.1f;
+// Zones that haven't run for this many frames leave the summary
+const uint32_t zoneIdleFrames = 120;
+
+CpuTraceBuffer::CpuTraceBuffer(uint32_t capacity) :
+    m_mask(0),
+    m_written(0)
+{
+    uint64_t size = 1;
+    while (size < capacity)
+        size <<= 1;
+    m_events.resize(size);
+    m_mask = size - 1;
+};
+
+uint64_t CpuTraceBuffer::Read(uint64_t position, std::vector<CpuTraceEvent>& events, uint64_t& lost) const
+{
+    uint64_t capacity = m_mask + 1;
+    uint64_t written = m_written.load(std::memory_order_acquire);
+    if (written - position > capacity)
+    {
+        lost += written - capacity - position;
+        position = written - capacity;
+    }
+
+    size_t first = events.size();
+    for (uint64_t i = position; i < written; ++i)
+        events.push_back(m_events[i & m_mask]);
+
+    // The writer may have wrapped around onto the oldest copies meanwhile, those are dropped
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t latest = m_written.load(std::memory_order_relaxed);
+    if (latest - position > capacity)
+    {
+        uint64_t dropped = std::min(latest - capacity - position, written - position);
+        events.erase(events.begin() + first, events.begin() + first + static_cast<size_t>(dropped));
+        lost += dropped;
+    }
+
+    return written;
+}
+
+CpuTraceBuffer::~CpuTraceBuffer()
+{};
+
+CpuTracer::ThreadState::ThreadState() :
+    buffer(nullptr),
+    threadId(0),
+    depth(0)
+{
+    buffer = CpuTracer::Get().AcquireBuffer(threadId);
+};
+
+CpuTracer::ThreadState::~ThreadState()
+{
+    CpuTracer::Get().ReleaseBuffer(buffer);
+};
+
+CpuTracer::CpuTracer() :
+    m_startTime(GetTime()),
+    m_nextThreadId(0),
+    m_capturing(true),
+    m_lostEvents(0)
+{};
+
+CpuTracer& CpuTracer::Get()
+{
+    static CpuTracer tracer;
+    return tracer;
+}
+
+uint64_t CpuTracer::GetTime()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+CpuTracer::ThreadState& CpuTracer::GetThreadState()
+{
+    thread_local ThreadState state;
+    return state;
+}
+
+CpuTraceBuffer* CpuTracer::AcquireBuffer(uint32_t& threadId)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    threadId = m_nextThreadId++;
+
+    if (!m_freeBuffers.empty())
+    {
+        CpuTraceBuffer* buffer = m_freeBuffers.back();
+        m_freeBuffers.pop_back();
+        return buffer;
+    }
+
+    m_buffers.push_back(std::unique_ptr<CpuTraceBuffer>(new CpuTraceBuffer(threadBufferCapacity)));
+    m_readPositions.push_back(0);
+    return m_buffers.back().get();
+}
+
+void CpuTracer::ReleaseBuffer(CpuTraceBuffer* buffer)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_freeBuffers.push_back(buffer);
+}
+
+void CpuTracer::SetThreadName(const char* name)
+{
+    uint32_t threadId = GetThreadState().threadId;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (ThreadName& threadName : m_threadNames)
+    {
+        if (threadName.threadId == threadId)
+        {
+            threadName.name = name;
+            return;
+        }
+    }
+    m_threadNames.push_back({ threadId, name });
+}
+
+void CpuTracer::Collect(std::vector<CpuTraceEvent>& events)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (size_t i = 0; i < m_buffers.size(); ++i)
+        m_readPositions[i] = m_buffers[i]->Read(m_readPositions[i], events, m_lostEvents);
+}
+
+void CpuTracer::EndFrame()
+{
+    m_frameEvents.clear();
+    Collect(m_frameEvents);
+
+    // Buffers hold events in the order the zones ended, parents are wanted before their children
+    std::sort(m_frameEvents.begin(), m_frameEvents.end(), [](const CpuTraceEvent& a, const CpuTraceEvent& b)
+    {
+        return a.threadId != b.threadId ? a.threadId < b.threadId : a.begin < b.begin;
+    });
+
+    Summarize(m_frameEvents);
+
+    if (m_capturing)
+    {
+        size_t count = std::min(m_frameEvents.size(), maxCapturedEvents - m_captured.size());
+        m_captured.insert(m_captured.end(), m_frameEvents.begin(), m_frameEvents.begin() + count);
+        m_lostEvents += m_frameEvents.size() - count;
+    }
+}
+
+void CpuTracer::Summarize(const std::vector<CpuTraceEvent>& events)
+{
+    for (CpuZoneSummary& zone : m_zones)
+    {
+        zone.last = 0.0f;
+        zone.calls = 0;
+    }
+
+    size_t firstNewZone = m_zones.size();
+    for (const CpuTraceEvent& event : events)
+    {
+        if (event.type == CPU_TRACE_EVENT_TYPE::COUNTER)
+        {
+            auto counter = std::find_if(m_counters.begin(), m_counters.end(), [&](const CpuCounterSummary& c) { return strcmp(c.name, event.name) == 0; });
+            if (counter == m_counters.end())
+                m_counters.push_back({ event.name, event.value });
+            else
+                counter->value = event.value;
+            continue;
+        }
+
+        // The same name at another nesting level is listed separately, so the overlay can indent it
+        auto zone = std::find_if(m_zones.begin(), m_zones.end(), [&](const CpuZoneSummary& z) { return z.depth == event.depth && strcmp(z.name, event.name) == 0; });
+        if (zone == m_zones.end())
+        {
+            m_zones.push_back({ event.name, event.depth, 0.0f, 0.0f, 0, 0 });
+            zone = m_zones.end() - 1;
+        }
+        zone->last += static_cast<float>(static_cast<double>(event.end - event.begin) * 1e-6);
+        ++zone->calls;
+    }
+
+    // Averages are seeded by the first frame of a zone, frames without it count as zero
+    for (size_t i = 0; i < m_zones.size(); ++i)
+    {
+        CpuZoneSummary& zone = m_zones[i];
+        if (i >= firstNewZone)
+            zone.average = zone.last;
+        else
+            zone.average += zoneSmoothing * (zone.last - zone.average);
+        zone.idleFrames = zone.calls > 0 ? 0 : zone.idleFrames + 1;
+    }
+
+    m_zones.erase(std::remove_if(m_zones.begin(), m_zones.end(), [](const CpuZoneSummary& zone) { return zone.idleFrames > zoneIdleFrames; }), m_zones.end());
+}
+
+void CpuTracer::StartCapture()
+{
+    m_captured.clear();
+    m_capturing = true;
+}
+
+static void WriteJsonString(std::ofstream& file, const char* text)
+{
+    file << '"';
+    for (const char* c = text; *c; ++c)
+    {
+        if (*c == '"' || *c == '\\')
+            file << '\\' << *c;
+        else if (static_cast<unsigned char>(*c) >= 0x20)
+            file << *c;
+    }
+    file << '"';
+}
+
+bool CpuTracer::WriteChromeTrace(const std::string& path) const
+{
+    std::ofstream file(path, std::ios::out | std::ios::trunc);
+    if (!file.is_open())
+        return false;
+
+    file.setf(std::ios::fixed);
+    file.precision(3);
+
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+    bool first = true;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const ThreadName& threadName : m_threadNames)
+        {
+            file << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << threadName.threadId << ",\"args\":{\"name\":";
+            WriteJsonString(file, threadName.name.c_str());
+            file << "}}";
+            first = false;
+        }
+    }
+
+    // Timestamps are microseconds since the tracer started
+    for (const CpuTraceEvent& event : m_captured)
+    {
+        file << (first ? "" : ",\n") << "{\"name\":";
+        WriteJsonString(file, event.name);
+        double begin = static_cast<double>(event.begin - m_startTime) * 1e-3;
+        if (event.type == CPU_TRACE_EVENT_TYPE::ZONE)
+            file << ",\"cat\":\"cpu\",\"ph\":\"X\",\"ts\":" << begin << ",\"dur\":" << static_cast<double>(event.end - event.begin) * 1e-3;
+        else
+            file << ",\"ph\":\"C\",\"ts\":" << begin << ",\"args\":{\"value\":" << event.value << "}";
+        file << ",\"pid\":1,\"tid\":" << event.threadId << "}";
+        first = false;
+    }
+
+    file << "\n]}\n";
+
+    return file.good();
+}
+
+CpuTracer::~CpuTracer()
+{};
+
+#endif
@@ -0,0 +1,208 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// CPU zones are recorded with CPU_TRACE_SCOPE("Name") at the start of a block, names have to be string literals
+// (only the pointer is kept). Building with CPU_TRACE_ENABLED defined to 0 removes every macro, and with them all the tracing code.
+#ifndef CPU_TRACE_ENABLED
+#define CPU_TRACE_ENABLED 1
+#endif
+
+// Per frame time of one zone name, summed over all its calls on all threads
+struct CpuZoneSummary
+{
+    const char* name;
+    uint32_t    depth;
+    float       last;
+    float       average;
+    uint32_t    calls;
+    uint32_t    idleFrames;
+};
+
+struct CpuCounterSummary
+{
+    const char* name;
+    int64_t     value;
+};
+
+#if CPU_TRACE_ENABLED
+
+enum class CPU_TRACE_EVENT_TYPE : uint16_t
+{
+    ZONE = 0,
+    COUNTER
+};
+
+struct CpuTraceEvent
+{
+    const char*          name;
+    uint64_t             begin;
+    uint64_t             end;
+    int64_t              value;
+    uint32_t             threadId;
+    uint16_t             depth;
+    CPU_TRACE_EVENT_TYPE type;
+};
+
+// Events of one thread. The owning thread is the only writer, readers copy events out without locking
+// and drop the ones the writer has overwritten while they were copied.
+class CpuTraceBuffer
+{
+public:
+    // Capacity is rounded up to a power of two
+    explicit CpuTraceBuffer(uint32_t capacity);
+    ~CpuTraceBuffer();
+
+    void Push(const CpuTraceEvent& event)
+    {
+        uint64_t written = m_written.load(std::memory_order_relaxed);
+        m_events[written & m_mask] = event;
+        m_written.store(written + 1, std::memory_order_release);
+    };
+
+    // Appends the events written since position and returns the new position. Events lost to wrapping are counted in lost.
+    uint64_t Read(uint64_t position, std::vector<CpuTraceEvent>& events, uint64_t& lost) const;
+
+    uint64_t GetWritten() const { return m_written.load(std::memory_order_acquire); };
+
+private:
+    std::vector<CpuTraceEvent> m_events;
+    uint64_t                   m_mask;
+    std::atomic<uint64_t>      m_written;
+};
+
+// Collects the events of all threads once per frame. It keeps a per frame summary for the overlay
+// and, while capturing, every event for a Chrome trace (chrome://tracing or ui.perfetto.dev).
+class CpuTracer
+{
+public:
+    static CpuTracer& Get();
+
+    // Nanoseconds of a steady clock
+    static uint64_t GetTime();
+
+    void SetThreadName(const char* name);
+
+    void AddZone(const char* name, uint64_t begin, uint64_t end, uint32_t depth)
+    {
+        ThreadState& state = GetThreadState();
+        state.buffer->Push({ name, begin, end, 0, state.threadId, static_cast<uint16_t>(depth), CPU_TRACE_EVENT_TYPE::ZONE });
+    };
+    void AddCounter(const char* name, int64_t value)
+    {
+        ThreadState& state = GetThreadState();
+        uint64_t time = GetTime();
+        state.buffer->Push({ name, time, time, value, state.threadId, 0, CPU_TRACE_EVENT_TYPE::COUNTER });
+    };
+
+    // Nesting level of the open zones on the calling thread
+    static uint32_t& GetThreadDepth() { return GetThreadState().depth; };
+
+    // Gathers the events of all threads and updates the summary, called by the main thread after every frame
+    void EndFrame();
+
+    const std::vector<CpuZoneSummary>& GetZoneSummary() const { return m_zones; };
+    const std::vector<CpuCounterSummary>& GetCounterSummary() const { return m_counters; };
+
+    // Capturing starts with the tracer, so a trace includes the startup
+    void StartCapture();
+    void StopCapture() { m_capturing = false; };
+    bool IsCapturing() const { return m_capturing; };
+    bool WriteChromeTrace(const std::string& path) const;
+
+    uint64_t GetLostEventCount() const { return m_lostEvents; };
+
+private:
+    struct ThreadState
+    {
+        CpuTraceBuffer* buffer;
+        uint32_t        threadId;
+        uint32_t        depth;
+
+        ThreadState();
+        ~ThreadState();
+    };
+
+    struct ThreadName
+    {
+        uint32_t    threadId;
+        std::string name;
+    };
+
+    CpuTracer();
+    ~CpuTracer();
+
+    static ThreadState& GetThreadState();
+
+    CpuTraceBuffer* AcquireBuffer(uint32_t& threadId);
+    void ReleaseBuffer(CpuTraceBuffer* buffer);
+
+    void Collect(std::vector<CpuTraceEvent>& events);
+    void Summarize(const std::vector<CpuTraceEvent>& events);
+
+    uint64_t m_startTime;
+
+    // Buffers outlive their threads, a finished thread's buffer is handed to the next new one
+    mutable std::mutex                           m_mutex;
+    std::vector<std::unique_ptr<CpuTraceBuffer>> m_buffers;
+    std::vector<uint64_t>                        m_readPositions;
+    std::vector<CpuTraceBuffer*>                 m_freeBuffers;
+    std::vector<ThreadName>                      m_threadNames;
+    uint32_t                                     m_nextThreadId;
+
+    std::vector<CpuTraceEvent>     m_frameEvents;
+    std::vector<CpuZoneSummary>    m_zones;
+    std::vector<CpuCounterSummary> m_counters;
+
+    bool                       m_capturing;
+    std::vector<CpuTraceEvent> m_captured;
+    uint64_t                   m_lostEvents;
+};
+
+// Records the time from its construction to the end of the enclosing block as a zone
+class CpuTraceScope
+{
+public:
+    explicit CpuTraceScope(const char* name) :
+        m_name(name),
+        m_depth(CpuTracer::GetThreadDepth()++),
+        m_begin(CpuTracer::GetTime())
+    {};
+
+    ~CpuTraceScope()
+    {
+        uint64_t end = CpuTracer::GetTime();
+        --CpuTracer::GetThreadDepth();
+        CpuTracer::Get().AddZone(m_name, m_begin, end, m_depth);
+    };
+
+private:
+    CpuTraceScope(const CpuTraceScope&) = delete;
+    CpuTraceScope& operator=(const CpuTraceScope&) = delete;
+
+    const char* m_name;
+    uint32_t    m_depth;
+    uint64_t    m_begin;
+};
+
+#define CPU_TRACE_CONCAT_IMPL(a, b) a##b
+#define CPU_TRACE_CONCAT(a, b) CPU_TRACE_CONCAT_IMPL(a, b)
+
+#define CPU_TRACE_SCOPE(name) CpuTraceScope CPU_TRACE_CONCAT(cpuTraceScope, __LINE__)(name)
+#define CPU_TRACE_COUNTER(name, value) CpuTracer::Get().AddCounter(name, static_cast<int64_t>(value))
+#define CPU_TRACE_THREAD_NAME(name) CpuTracer::Get().SetThreadName(name)
+#define CPU_TRACE_END_FRAME() CpuTracer::Get().EndFrame()
+
+#else
+
+#define CPU_TRACE_SCOPE(name) ((void)0)
+#define CPU_TRACE_COUNTER(name, value) ((void)0)
+#define CPU_TRACE_THREAD_NAME(name) ((void)0)
+#define CPU_TRACE_END_FRAME() ((void)0)
+
+#endif
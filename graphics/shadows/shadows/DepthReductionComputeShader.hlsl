@@ -0,0 +1 @@
+#include "DepthReductionShaders.fx"
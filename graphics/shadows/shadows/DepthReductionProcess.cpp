@@ -0,0 +1,123 @@
+#include "pch.h"
+
+#include "DepthReductionProcess.h"
+#include "ShaderStructures.h"
+#include "Utils.h"
+
+const UINT DepthReductionProcess::READBACK_LATENCY;
+
+DepthReductionProcess::DepthReductionProcess() :
+    m_writeIndex(0),
+    m_pendingCount(0),
+    m_minDepth(1.0f),
+    m_maxDepth(0.0f),
+    m_hasResult(false)
+{};
+
+HRESULT DepthReductionProcess::CreateDeviceDependentResources(ID3D11Device* device)
+{
+    HRESULT hr = S_OK;
+
+    std::vector<BYTE> bytes;
+
+    hr = CreateComputeShader(device, L"DepthReductionComputeShader.cso", bytes, &m_pComputeShader);
+    if (FAILED(hr))
+        return hr;
+
+    CD3D11_BUFFER_DESC cb(sizeof(DepthReductionConstantBuffer), D3D11_BIND_CONSTANT_BUFFER);
+    hr = device->CreateBuffer(&cb, nullptr, &m_pConstantBuffer);
+    if (FAILED(hr))
+        return hr;
+
+    // Create the min and max buffer
+    CD3D11_BUFFER_DESC rbd(2 * sizeof(UINT), D3D11_BIND_UNORDERED_ACCESS);
+    hr = device->CreateBuffer(&rbd, nullptr, &m_pResultBuffer);
+    if (FAILED(hr))
+        return hr;
+
+    CD3D11_UNORDERED_ACCESS_VIEW_DESC uavd(D3D11_UAV_DIMENSION_BUFFER, DXGI_FORMAT_R32_UINT, 0, 2);
+    hr = device->CreateUnorderedAccessView(m_pResultBuffer.Get(), &uavd, &m_pResultUnorderedAccessView);
+    if (FAILED(hr))
+        return hr;
+
+    // Create the readback buffers
+    CD3D11_BUFFER_DESC sbd(2 * sizeof(UINT), 0, D3D11_USAGE_STAGING, D3D11_CPU_ACCESS_READ);
+    for (UINT i = 0; i < READBACK_LATENCY; ++i)
+    {
+        hr = device->CreateBuffer(&sbd, nullptr, &m_pReadbackBuffers[i]);
+        if (FAILED(hr))
+            return hr;
+    }
+
+    return hr;
+}
+
+void DepthReductionProcess::Process(ID3D11DeviceContext* context, ID3D11ShaderResourceView* depthTexture, UINT width, UINT height)
+{
+    ReadBack(context);
+
+    // All copies are still in flight, this frame is skipped
+    if (m_pendingCount == READBACK_LATENCY)
+        return;
+
+    DepthReductionConstantBuffer reductionData;
+    reductionData.ImageSize = DirectX::XMUINT2(width, height);
+    context->UpdateSubresource(m_pConstantBuffer.Get(), 0, nullptr, &reductionData, 0, 0);
+
+    float initialDepth[2] = { 1.0f, 0.0f };
+    context->UpdateSubresource(m_pResultBuffer.Get(), 0, nullptr, initialDepth, 0, 0);
+
+    ID3D11UnorderedAccessView* nulluav[1] = { nullptr };
+    ID3D11ShaderResourceView* nullsrv[1] = { nullptr };
+
+    context->CSSetShader(m_pComputeShader.Get(), nullptr, 0);
+    context->CSSetShaderResources(0, 1, &depthTexture);
+    context->CSSetUnorderedAccessViews(0, 1, m_pResultUnorderedAccessView.GetAddressOf(), nullptr);
+    context->CSSetConstantBuffers(0, 1, m_pConstantBuffer.GetAddressOf());
+
+    context->Dispatch((width + 16 - 1) / 16, (height + 16 - 1) / 16, 1);
+
+    context->CSSetShader(nullptr, nullptr, 0);
+    context->CSSetUnorderedAccessViews(0, 1, nulluav, nullptr);
+    context->CSSetShaderResources(0, 1, nullsrv);
+
+    context->CopyResource(m_pReadbackBuffers[m_writeIndex].Get(), m_pResultBuffer.Get());
+    m_writeIndex = (m_writeIndex + 1) % READBACK_LATENCY;
+    ++m_pendingCount;
+}
+
+void DepthReductionProcess::ReadBack(ID3D11DeviceContext* context)
+{
+    // Oldest copies first, stop at the first one the GPU hasn't finished
+    while (m_pendingCount > 0)
+    {
+        UINT readIndex = (m_writeIndex + READBACK_LATENCY - m_pendingCount) % READBACK_LATENCY;
+
+        D3D11_MAPPED_SUBRESOURCE mapped;
+        HRESULT hr = context->Map(m_pReadbackBuffers[readIndex].Get(), 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped);
+        if (FAILED(hr))
+            return;
+
+        const float* depth = static_cast<const float*>(mapped.pData);
+        m_minDepth = depth[0];
+        m_maxDepth = depth[1];
+        m_hasResult = true;
+        context->Unmap(m_pReadbackBuffers[readIndex].Get(), 0);
+
+        --m_pendingCount;
+    }
+}
+
+bool DepthReductionProcess::GetDepthRange(float nearZ, float farZ, DepthRange& range) const
+{
+    if (!m_hasResult)
+        return false;
+
+    range.valid = m_minDepth <= m_maxDepth;
+    range.minDistance = range.valid ? LinearizeDepth(m_minDepth, nearZ, farZ) : farZ;
+    range.maxDistance = range.valid ? LinearizeDepth(m_maxDepth, nearZ, farZ) : nearZ;
+    return true;
+}
+
+DepthReductionProcess::~DepthReductionProcess()
+{}
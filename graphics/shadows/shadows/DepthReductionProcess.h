@@ -0,0 +1,40 @@
+#pragma once
+
+#include "DeviceResources.h"
+#include "SampleDistribution.h"
+
+// Visible depth range of the scene for sample distribution shadow maps.
+// A compute shader reduces the depth buffer to its min and max, the result is read back a few frames later
+// through a ring of staging buffers, so the CPU never waits for the GPU.
+class DepthReductionProcess
+{
+public:
+    DepthReductionProcess();
+    ~DepthReductionProcess();
+
+    HRESULT CreateDeviceDependentResources(ID3D11Device* device);
+
+    // Depth buffer has to be unbound from the output merger
+    void Process(ID3D11DeviceContext* context, ID3D11ShaderResourceView* depthTexture, UINT width, UINT height);
+
+    // Latest range that reached the CPU, false if there is none yet
+    bool GetDepthRange(float nearZ, float farZ, DepthRange& range) const;
+
+private:
+    static const UINT READBACK_LATENCY = 3;
+
+    void ReadBack(ID3D11DeviceContext* context);
+
+    Microsoft::WRL::ComPtr<ID3D11ComputeShader>       m_pComputeShader;
+    Microsoft::WRL::ComPtr<ID3D11Buffer>              m_pConstantBuffer;
+    Microsoft::WRL::ComPtr<ID3D11Buffer>              m_pResultBuffer;
+    Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView> m_pResultUnorderedAccessView;
+    Microsoft::WRL::ComPtr<ID3D11Buffer>              m_pReadbackBuffers[READBACK_LATENCY];
+
+    UINT m_writeIndex;
+    UINT m_pendingCount;
+
+    float m_minDepth;
+    float m_maxDepth;
+    bool  m_hasResult;
+};
@@ -0,0 +1,39 @@
+Texture2D<float> depthTexture : register(t0);
+RWBuffer<uint> depthRange : register(u0);
+
+cbuffer DepthReductionConstantBuffer : register(b0)
+{
+    uint2 ImageSize;
+}
+
+groupshared uint groupMin;
+groupshared uint groupMax;
+
+// Min and max of the depth that isn't at the far plane, depth is positive so its bits compare as uints
+[numthreads(16, 16, 1)]
+void cs_depth_reduction_main(uint3 id : SV_DispatchThreadID, uint index : SV_GroupIndex)
+{
+    if (index == 0)
+    {
+        groupMin = asuint(1.0f);
+        groupMax = 0;
+    }
+    GroupMemoryBarrierWithGroupSync();
+
+    if (all(id.xy < ImageSize))
+    {
+        float depth = depthTexture.Load(int3(id.xy, 0));
+        if (depth < 1.0f)
+        {
+            InterlockedMin(groupMin, asuint(depth));
+            InterlockedMax(groupMax, asuint(depth));
+        }
+    }
+    GroupMemoryBarrierWithGroupSync();
+
+    if (index == 0)
+    {
+        InterlockedMin(depthRange[0], groupMin);
+        InterlockedMax(depthRange[1], groupMax);
+    }
+}
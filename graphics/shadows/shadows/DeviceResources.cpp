@@ -129,11 +129,11 @@ HRESULT DeviceResources::ConfigureBackBuffer()
     dd.Height = m_backBufferDesc.Height;
     dd.MipLevels = 1;
     dd.ArraySize = 1;
-    dd.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
+    dd.Format = DXGI_FORMAT_R24G8_TYPELESS;
     dd.SampleDesc.Count = 1;
     dd.SampleDesc.Quality = 0;
     dd.Usage = D3D11_USAGE_DEFAULT;
-    dd.BindFlags = D3D11_BIND_DEPTH_STENCIL;
+    dd.BindFlags = D3D11_BIND_DEPTH_STENCIL | D3D11_BIND_SHADER_RESOURCE;
     dd.CPUAccessFlags = 0;
     dd.MiscFlags = 0;
     hr = m_pd3dDevice->CreateTexture2D(&dd, nullptr, &pDepthStencil);
@@ -143,13 +143,19 @@ HRESULT DeviceResources::ConfigureBackBuffer()
     // Create the depth stencil view
     D3D11_DEPTH_STENCIL_VIEW_DESC dsvd;
     ZeroMemory(&dsvd, sizeof(dsvd));
-    dsvd.Format = dd.Format;
+    dsvd.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
     dsvd.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
     dsvd.Texture2D.MipSlice = 0;
     hr = m_pd3dDevice->CreateDepthStencilView(pDepthStencil.Get(), &dsvd, &m_pDepthStencilView);
     if (FAILED(hr))
         return hr;
 
+    // Create the depth shader resource view
+    D3D11_SHADER_RESOURCE_VIEW_DESC srvd = CD3D11_SHADER_RESOURCE_VIEW_DESC(D3D11_SRV_DIMENSION_TEXTURE2D, DXGI_FORMAT_R24_UNORM_X8_TYPELESS);
+    hr = m_pd3dDevice->CreateShaderResourceView(pDepthStencil.Get(), &srvd, &m_pDepthShaderResourceView);
+    if (FAILED(hr))
+        return hr;
+
     // Create the depth stencil for transparent objects
     D3D11_DEPTH_STENCIL_DESC dsd;
     ZeroMemory(&dsd, sizeof(dsd));
@@ -182,6 +188,7 @@ HRESULT DeviceResources::OnResize()
     m_pd3dDeviceContext->OMSetRenderTargets(0, 0, 0);
     m_pRenderTargetView.Reset();
     m_pDepthStencilView.Reset();
+    m_pDepthShaderResourceView.Reset();
     m_pd3dDeviceContext->Flush();
 
     hr = m_pSwapChain->ResizeBuffers(0, 0, 0, DXGI_FORMAT_UNKNOWN, 0);
@@ -20,6 +20,7 @@ public:
     IDXGISwapChain*            GetSwapChain() const         { return m_pSwapChain.Get(); };
     ID3D11RenderTargetView*    GetRenderTarget() const      { return m_pRenderTargetView.Get(); };
     ID3D11DepthStencilView*    GetDepthStencil() const      { return m_pDepthStencilView.Get(); };
+    ID3D11ShaderResourceView*  GetDepthShaderResourceView() const { return m_pDepthShaderResourceView.Get(); };
     ID3D11DepthStencilState*   GetTransDepthStencil() const { return m_pTransDepthStencilState.Get(); };
     ID3DUserDefinedAnnotation* GetAnnotation() const        { return m_pAnnotation.Get(); };
 
@@ -35,6 +36,7 @@ private:
     Microsoft::WRL::ComPtr<IDXGISwapChain>          m_pSwapChain;
     Microsoft::WRL::ComPtr<ID3D11RenderTargetView>  m_pRenderTargetView;
     Microsoft::WRL::ComPtr<ID3D11DepthStencilView>  m_pDepthStencilView;
+    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_pDepthShaderResourceView;
     Microsoft::WRL::ComPtr<ID3D11DepthStencilState> m_pTransDepthStencilState;
 
     Microsoft::WRL::ComPtr<ID3DUserDefinedAnnotation> m_pAnnotation;
@@ -1 +0,0 @@
-#include "EnvironmentCubeShaders.fx"
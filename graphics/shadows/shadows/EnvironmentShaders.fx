@@ -2,38 +2,30 @@ TextureCube cubeTexture : register(t0);
 
 SamplerState MinMagMipLinear : register(s0);
 
-cbuffer Transformation: register(b0)
+cbuffer Environment : register(b0)
 {
-    matrix World;
-    matrix View;
-    matrix Projection;
-	float4 CameraPos;
+    // See SkyRay.h
+    matrix SkyRayTransform;
 }
 
-struct VS_INPUT
-{
-    float3 Normal : NORMAL;
-    float3 Pos : POSITION;
-    float2 Tex : TEXCOORD_0;
-};
-
 struct PS_INPUT
 {
     float4 Pos : SV_POSITION;
-    float3 Tex : TEXCOORD_0;
+    float4 Ray : TEXCOORD_0;
 };
 
-PS_INPUT vs_main(VS_INPUT input)
+// One triangle over the whole screen at the far plane, the depth test leaves the pixels of the opaque geometry
+PS_INPUT vs_main(uint input : SV_VERTEXID)
 {
     PS_INPUT output = (PS_INPUT)0;
-    output.Pos = mul(float4(input.Pos, 1.0f), World);
-    output.Pos = mul(output.Pos, View);
-    output.Pos = mul(output.Pos, Projection);
-    output.Tex = input.Pos;
+    float2 uv = float2((input << 1) & 2, input & 2);
+    output.Pos = float4(uv.x * 2 - 1, 1 - uv.y * 2, 1, 1);
+    // Interpolated as a homogeneous point, divided per pixel
+    output.Ray = mul(output.Pos, SkyRayTransform);
     return output;
 }
 
 float4 ps_main(PS_INPUT input) : SV_TARGET
 {
-    return cubeTexture.Sample(MinMagMipLinear, input.Tex);
+    return cubeTexture.Sample(MinMagMipLinear, input.Ray.xyz / input.Ray.w);
 }
@@ -0,0 +1,175 @@
+#include "pch.h"
+
+#include "GpuProfiler.h"
+
+const UINT GpuProfiler::READBACK_LATENCY;
+const UINT GpuProfiler::PASS_COUNT;
+
+const char* const passNames[] = {
+    "Shadows",
+    "Environment",
+    "Plane",
+    "Sphere",
+    "Models opaque",
+    "Models transparent",
+    "OIT resolve",
+    "Bloom",
+    "Depth reduction",
+    "Luminance",
+    "Tone map",
+    "ImGui"
+};
+
+static_assert(ARRAYSIZE(passNames) == static_cast<size_t>(GPU_PROFILER_PASS::COUNT), "every pass needs a name");
+
+GpuProfiler::GpuProfiler() :
+    m_ring(READBACK_LATENCY),
+    m_currentSlot(0),
+    m_frameActive(false),
+    m_frameCount(0),
+    m_stats(PASS_COUNT),
+    m_pixelShaderInvocations()
+{};
+
+HRESULT GpuProfiler::CreateDeviceDependentResources(ID3D11Device* device)
+{
+    HRESULT hr = S_OK;
+
+    // Create the disjoint, timestamp and statistics queries of every frame in the ring
+    CD3D11_QUERY_DESC disjointDesc(D3D11_QUERY_TIMESTAMP_DISJOINT);
+    CD3D11_QUERY_DESC timestampDesc(D3D11_QUERY_TIMESTAMP);
+    CD3D11_QUERY_DESC statisticsDesc(D3D11_QUERY_PIPELINE_STATISTICS);
+    for (FrameQueries& frame : m_frames)
+    {
+        hr = device->CreateQuery(&disjointDesc, &frame.pDisjoint);
+        if (FAILED(hr))
+            return hr;
+
+        for (UINT pass = 0; pass < PASS_COUNT; ++pass)
+        {
+            hr = device->CreateQuery(&timestampDesc, &frame.pBegin[pass]);
+            if (FAILED(hr))
+                return hr;
+
+            hr = device->CreateQuery(&timestampDesc, &frame.pEnd[pass]);
+            if (FAILED(hr))
+                return hr;
+
+            hr = device->CreateQuery(&statisticsDesc, &frame.pStatistics[pass]);
+            if (FAILED(hr))
+                return hr;
+        }
+    }
+
+    return hr;
+}
+
+void GpuProfiler::BeginFrame(ID3D11DeviceContext* context)
+{
+    ReadBack(context);
+
+    ++m_frameCount;
+
+    // All query sets are still in flight, this frame is skipped
+    m_frameActive = m_ring.CanBegin();
+    if (!m_frameActive)
+        return;
+
+    m_currentSlot = m_ring.Begin();
+    FrameQueries& frame = m_frames[m_currentSlot];
+    for (UINT pass = 0; pass < PASS_COUNT; ++pass)
+        frame.issued[pass] = false;
+    frame.frame = m_frameCount;
+
+    context->Begin(frame.pDisjoint.Get());
+}
+
+void GpuProfiler::EndFrame(ID3D11DeviceContext* context)
+{
+    if (!m_frameActive)
+        return;
+
+    context->End(m_frames[m_currentSlot].pDisjoint.Get());
+    m_frameActive = false;
+}
+
+void GpuProfiler::BeginPass(ID3D11DeviceContext* context, GPU_PROFILER_PASS pass)
+{
+    if (!m_frameActive)
+        return;
+
+    FrameQueries& frame = m_frames[m_currentSlot];
+    context->End(frame.pBegin[static_cast<UINT>(pass)].Get());
+    context->Begin(frame.pStatistics[static_cast<UINT>(pass)].Get());
+}
+
+void GpuProfiler::EndPass(ID3D11DeviceContext* context, GPU_PROFILER_PASS pass)
+{
+    if (!m_frameActive)
+        return;
+
+    FrameQueries& frame = m_frames[m_currentSlot];
+    context->End(frame.pStatistics[static_cast<UINT>(pass)].Get());
+    context->End(frame.pEnd[static_cast<UINT>(pass)].Get());
+    frame.issued[static_cast<UINT>(pass)] = true;
+}
+
+void GpuProfiler::ReadBack(ID3D11DeviceContext* context)
+{
+    // Oldest frames first, stop at the first one the GPU hasn't finished
+    while (m_ring.HasPending())
+    {
+        FrameQueries& frame = m_frames[m_ring.GetOldest()];
+
+        D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint;
+        if (context->GetData(frame.pDisjoint.Get(), &disjoint, sizeof(disjoint), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+            return;
+
+        // Timestamps of a disjoint frame (e.g. the clock changed) are meaningless, the frame is dropped
+        float times[PASS_COUNT];
+        UINT64 invocations[PASS_COUNT];
+        bool valid = !disjoint.Disjoint;
+        for (UINT pass = 0; pass < PASS_COUNT && valid; ++pass)
+        {
+            times[pass] = -1.0f;
+            invocations[pass] = 0;
+            if (!frame.issued[pass])
+                continue;
+
+            UINT64 begin, end;
+            D3D11_QUERY_DATA_PIPELINE_STATISTICS statistics;
+            if (context->GetData(frame.pBegin[pass].Get(), &begin, sizeof(begin), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK ||
+                context->GetData(frame.pEnd[pass].Get(), &end, sizeof(end), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK ||
+                context->GetData(frame.pStatistics[pass].Get(), &statistics, sizeof(statistics), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+            {
+                valid = false;
+                break;
+            }
+            times[pass] = TimestampsToMilliseconds(begin, end, disjoint.Frequency);
+            invocations[pass] = statistics.PSInvocations;
+        }
+
+        if (valid)
+        {
+            m_stats.AddFrame(times);
+            m_log.Write(frame.frame, times);
+            for (UINT pass = 0; pass < PASS_COUNT; ++pass)
+                m_pixelShaderInvocations[pass] = invocations[pass];
+        }
+
+        m_ring.Complete();
+    }
+}
+
+bool GpuProfiler::OpenLog(const std::string& path)
+{
+    return m_log.Open(path, passNames, PASS_COUNT);
+}
+
+const char* GpuProfiler::GetPassName(GPU_PROFILER_PASS pass)
+{
+    return passNames[static_cast<UINT>(pass)];
+}
+
+GpuProfiler::~GpuProfiler()
+{};
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "DeviceResources.h"
+#include "GpuTimings.h"
+
+enum class GPU_PROFILER_PASS
+{
+    SHADOWS = 0,
+    ENVIRONMENT,
+    PLANE,
+    SPHERE,
+    MODELS_OPAQUE,
+    MODELS_TRANSPARENT,
+    OIT_RESOLVE,
+    BLOOM,
+    DEPTH_REDUCTION,
+    LUMINANCE,
+    TONE_MAP,
+    IMGUI,
+    COUNT
+};
+
+// GPU time of the frame passes from timestamp queries inside one disjoint query per frame, and the pixel shader
+// invocations of every pass from pipeline statistics queries.
+// Results are read a few frames late through a ring of query sets, the CPU never waits for them;
+// when every set is still in flight the frame simply isn't measured.
+class GpuProfiler
+{
+public:
+    GpuProfiler();
+    ~GpuProfiler();
+
+    HRESULT CreateDeviceDependentResources(ID3D11Device* device);
+
+    void BeginFrame(ID3D11DeviceContext* context);
+    void EndFrame(ID3D11DeviceContext* context);
+
+    // Every pass is measured at most once per frame, passes may nest
+    void BeginPass(ID3D11DeviceContext* context, GPU_PROFILER_PASS pass);
+    void EndPass(ID3D11DeviceContext* context, GPU_PROFILER_PASS pass);
+
+    // Frames that reach the CPU are appended to the CSV file while the log is open
+    bool OpenLog(const std::string& path);
+    void CloseLog() { m_log.Close(); };
+    bool IsLogging() const { return m_log.IsOpen(); };
+
+    const PassTimingStats& GetStats() const { return m_stats; };
+    // Of the latest measured frame, 0 for passes it didn't run
+    UINT64 GetPixelShaderInvocations(GPU_PROFILER_PASS pass) const { return m_pixelShaderInvocations[static_cast<UINT>(pass)]; };
+
+    static const char* GetPassName(GPU_PROFILER_PASS pass);
+
+private:
+    static const UINT READBACK_LATENCY = 4;
+    static const UINT PASS_COUNT = static_cast<UINT>(GPU_PROFILER_PASS::COUNT);
+
+    struct FrameQueries
+    {
+        Microsoft::WRL::ComPtr<ID3D11Query> pDisjoint;
+        Microsoft::WRL::ComPtr<ID3D11Query> pBegin[PASS_COUNT];
+        Microsoft::WRL::ComPtr<ID3D11Query> pEnd[PASS_COUNT];
+        Microsoft::WRL::ComPtr<ID3D11Query> pStatistics[PASS_COUNT];
+        bool issued[PASS_COUNT];
+        UINT64 frame;
+    };
+
+    void ReadBack(ID3D11DeviceContext* context);
+
+    FrameQueries m_frames[READBACK_LATENCY];
+    QueryRing    m_ring;
+    UINT         m_currentSlot;
+    bool         m_frameActive;
+    UINT64       m_frameCount;
+
+    PassTimingStats m_stats;
+    UINT64          m_pixelShaderInvocations[PASS_COUNT];
+    PassTimingLog   m_log;
+};
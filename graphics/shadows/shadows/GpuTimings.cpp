@@ -0,0 +1,153 @@
+#include "GpuTimings.h"
+
+#include <algorithm>
+
+QueryRing::QueryRing(uint32_t size) :
+    m_size(size),
+    m_writeIndex(0),
+    m_pendingCount(0)
+{};
+
+uint32_t QueryRing::Begin()
+{
+    uint32_t slot = m_writeIndex;
+    m_writeIndex = (m_writeIndex + 1) % m_size;
+    ++m_pendingCount;
+    return slot;
+}
+
+uint32_t QueryRing::GetOldest() const
+{
+    return (m_writeIndex + m_size - m_pendingCount) % m_size;
+}
+
+void QueryRing::Complete()
+{
+    if (m_pendingCount > 0)
+        --m_pendingCount;
+}
+
+QueryRing::~QueryRing()
+{};
+
+float TimestampsToMilliseconds(uint64_t begin, uint64_t end, uint64_t frequency)
+{
+    if (end < begin || frequency == 0)
+        return -1.0f;
+
+    return static_cast<float>(static_cast<double>(end - begin) * 1000.0 / static_cast<double>(frequency));
+}
+
+PassTimingStats::PassTimingStats(uint32_t passCount, float smoothing, uint32_t window) :
+    m_window(std::max(window, 1u)),
+    m_smoothing(smoothing)
+{
+    Reset(passCount);
+};
+
+void PassTimingStats::Reset(uint32_t passCount)
+{
+    m_passCount = passCount;
+    m_frameCount = 0;
+    m_averages.assign(passCount, 0.0f);
+    m_last.assign(passCount, 0.0f);
+    m_started.assign(passCount, false);
+    m_history.assign(static_cast<size_t>(passCount) * m_window, -1.0f);
+    m_historyCount = 0;
+    m_historyIndex = 0;
+}
+
+void PassTimingStats::AddFrame(const float* times)
+{
+    float* row = &m_history[static_cast<size_t>(m_historyIndex) * m_passCount];
+    for (uint32_t pass = 0; pass < m_passCount; ++pass)
+    {
+        row[pass] = times[pass];
+        if (times[pass] < 0.0f)
+            continue;
+
+        // The first time a pass runs starts its average, so it doesn't creep up from zero
+        m_last[pass] = times[pass];
+        m_averages[pass] = m_started[pass] ? m_averages[pass] + (times[pass] - m_averages[pass]) * m_smoothing : times[pass];
+        m_started[pass] = true;
+    }
+
+    m_historyIndex = (m_historyIndex + 1) % m_window;
+    m_historyCount = std::min(m_historyCount + 1, m_window);
+    ++m_frameCount;
+}
+
+float PassTimingStats::GetMin(uint32_t pass) const
+{
+    float result = -1.0f;
+    for (uint32_t i = 0; i < m_historyCount; ++i)
+    {
+        float time = m_history[static_cast<size_t>(i) * m_passCount + pass];
+        if (time >= 0.0f && (result < 0.0f || time < result))
+            result = time;
+    }
+    return std::max(result, 0.0f);
+}
+
+float PassTimingStats::GetMax(uint32_t pass) const
+{
+    float result = 0.0f;
+    for (uint32_t i = 0; i < m_historyCount; ++i)
+        result = std::max(result, m_history[static_cast<size_t>(i) * m_passCount + pass]);
+    return result;
+}
+
+float PassTimingStats::GetTotal() const
+{
+    float total = 0.0f;
+    for (float average : m_averages)
+        total += average;
+    return total;
+}
+
+PassTimingStats::~PassTimingStats()
+{};
+
+PassTimingLog::PassTimingLog() :
+    m_passCount(0)
+{};
+
+bool PassTimingLog::Open(const std::string& path, const char* const* passNames, uint32_t passCount)
+{
+    Close();
+
+    m_file.open(path, std::ios::out | std::ios::trunc);
+    if (!m_file.is_open())
+        return false;
+
+    m_passCount = passCount;
+    m_file << "frame";
+    for (uint32_t pass = 0; pass < passCount; ++pass)
+        m_file << "," << passNames[pass];
+    m_file << "\n";
+    return true;
+}
+
+void PassTimingLog::Write(uint64_t frame, const float* times)
+{
+    if (!m_file.is_open())
+        return;
+
+    m_file << frame;
+    for (uint32_t pass = 0; pass < m_passCount; ++pass)
+    {
+        m_file << ",";
+        if (times[pass] >= 0.0f)
+            m_file << times[pass];
+    }
+    m_file << "\n";
+}
+
+void PassTimingLog::Close()
+{
+    if (m_file.is_open())
+        m_file.close();
+}
+
+PassTimingLog::~PassTimingLog()
+{};
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Frames whose queries are still in flight on the GPU. A new frame takes the next slot unless all of them are pending,
+// results are read back from the oldest slot first, so reading never waits for a frame the GPU hasn't finished.
+class QueryRing
+{
+public:
+    explicit QueryRing(uint32_t size = 0);
+    ~QueryRing();
+
+    bool CanBegin() const { return m_pendingCount < m_size; };
+    // Slot for the queries of a new frame, only valid when CanBegin() is true
+    uint32_t Begin();
+
+    bool HasPending() const { return m_pendingCount > 0; };
+    uint32_t GetOldest() const;
+    // Frees the oldest slot once its results are read (or dropped)
+    void Complete();
+
+    uint32_t GetSize() const { return m_size; };
+    uint32_t GetPendingCount() const { return m_pendingCount; };
+
+private:
+    uint32_t m_size;
+    uint32_t m_writeIndex;
+    uint32_t m_pendingCount;
+};
+
+// Milliseconds between two timestamps of a counter running at the given frequency, negative if they aren't ordered
+float TimestampsToMilliseconds(uint64_t begin, uint64_t end, uint64_t frequency);
+
+// Smoothed per pass times. Every frame gives a time per pass, a negative time means the pass didn't run.
+// Averages are exponential moving averages, minimum and maximum cover a window of the latest frames.
+class PassTimingStats
+{
+public:
+    PassTimingStats(uint32_t passCount = 0, float smoothing = 0.1f, uint32_t window = 120);
+    ~PassTimingStats();
+
+    void Reset(uint32_t passCount);
+    void AddFrame(const float* times);
+
+    // Zero for passes that haven't run yet
+    float GetAverage(uint32_t pass) const { return m_averages[pass]; };
+    float GetLast(uint32_t pass) const { return m_last[pass]; };
+    float GetMin(uint32_t pass) const;
+    float GetMax(uint32_t pass) const;
+    // Sum of the averages of all passes
+    float GetTotal() const;
+
+    uint32_t GetPassCount() const { return m_passCount; };
+    uint64_t GetFrameCount() const { return m_frameCount; };
+
+private:
+    uint32_t m_passCount;
+    uint32_t m_window;
+    float    m_smoothing;
+    uint64_t m_frameCount;
+
+    std::vector<float> m_averages;
+    std::vector<float> m_last;
+    std::vector<bool>  m_started;
+
+    // Frame by frame times of the window, m_window rows of m_passCount values
+    std::vector<float> m_history;
+    uint32_t           m_historyCount;
+    uint32_t           m_historyIndex;
+};
+
+// Per frame pass times as CSV: a header with the pass names, then one row per frame (empty cells for passes that didn't run)
+class PassTimingLog
+{
+public:
+    PassTimingLog();
+    ~PassTimingLog();
+
+    bool Open(const std::string& path, const char* const* passNames, uint32_t passCount);
+    void Write(uint64_t frame, const float* times);
+    void Close();
+
+    bool IsOpen() const { return m_file.is_open(); };
+
+private:
+    std::ofstream m_file;
+    uint32_t      m_passCount;
+};
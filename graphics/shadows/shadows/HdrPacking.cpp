@@ -0,0 +1,568 @@
+#include "HdrPacking.h"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+// Interpolation weights of 4-bit BC6H indices, out of 64
+const uint32_t bc6hWeights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+const uint32_t bc6hMode11 = 0x03;
+const uint32_t bc6hEndpointBits = 10;
+const uint32_t bc6hMaxEndpoint = (1u << bc6hEndpointBits) - 1u;
+
+const char* GetHdrTexelFormatName(HDR_TEXEL_FORMAT format)
+{
+    switch (format)
+    {
+    case HDR_TEXEL_FORMAT::R32G32B32A32_FLOAT:
+        return "R32G32B32A32_FLOAT";
+    case HDR_TEXEL_FORMAT::R16G16B16A16_FLOAT:
+        return "R16G16B16A16_FLOAT";
+    case HDR_TEXEL_FORMAT::R11G11B10_FLOAT:
+        return "R11G11B10_FLOAT";
+    case HDR_TEXEL_FORMAT::R9G9B9E5_SHAREDEXP:
+        return "R9G9B9E5_SHAREDEXP";
+    case HDR_TEXEL_FORMAT::R32_FLOAT:
+        return "R32_FLOAT";
+    case HDR_TEXEL_FORMAT::R16_FLOAT:
+        return "R16_FLOAT";
+    case HDR_TEXEL_FORMAT::BC6H_UF16:
+        return "BC6H_UF16";
+    default:
+        return "UNKNOWN";
+    }
+}
+
+static uint32_t GetTexelBytes(HDR_TEXEL_FORMAT format)
+{
+    switch (format)
+    {
+    case HDR_TEXEL_FORMAT::R32G32B32A32_FLOAT:
+        return 16;
+    case HDR_TEXEL_FORMAT::R16G16B16A16_FLOAT:
+        return 8;
+    case HDR_TEXEL_FORMAT::R11G11B10_FLOAT:
+    case HDR_TEXEL_FORMAT::R9G9B9E5_SHAREDEXP:
+    case HDR_TEXEL_FORMAT::R32_FLOAT:
+        return 4;
+    case HDR_TEXEL_FORMAT::R16_FLOAT:
+        return 2;
+    default:
+        return 0;
+    }
+}
+
+uint32_t GetHdrRowPitch(HDR_TEXEL_FORMAT format, uint32_t width)
+{
+    if (format == HDR_TEXEL_FORMAT::BC6H_UF16)
+        return (width + 3) / 4 * 16;
+    return width * GetTexelBytes(format);
+}
+
+uint32_t GetHdrRowCount(HDR_TEXEL_FORMAT format, uint32_t height)
+{
+    if (format == HDR_TEXEL_FORMAT::BC6H_UF16)
+        return (height + 3) / 4;
+    return height;
+}
+
+// Shifts right rounding to the nearest value, ties to even
+static uint32_t ShiftRightRounded(uint32_t value, uint32_t shift)
+{
+    if (shift == 0)
+        return value;
+    if (shift >= 32)
+        return 0;
+
+    uint32_t result = value >> shift;
+    uint32_t remainder = value & ((1u << shift) - 1u);
+    uint32_t half = 1u << (shift - 1);
+    if (remainder > half || (remainder == half && (result & 1u)))
+        ++result;
+    return result;
+}
+
+// A non negative float with a 5-bit exponent (bias 15) and the given number of mantissa bits,
+// the layout of a half float magnitude and of the R11G11B10 channels
+static uint32_t PackSmallFloat(float value, uint32_t mantissaBits)
+{
+    uint32_t maxFinite = (30u << mantissaBits) | ((1u << mantissaBits) - 1u);
+    // Negatives, zeros and NaNs
+    if (!(value > 0.0f))
+        return 0;
+
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    if (bits >= 0x7F800000u)
+        return maxFinite;
+
+    int exponent = static_cast<int>(bits >> 23) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFFu;
+    uint32_t packed;
+    if (exponent > 0)
+    {
+        // A carry out of the mantissa moves to the exponent on its own
+        packed = ShiftRightRounded((static_cast<uint32_t>(exponent) << 23) | mantissa, 23 - mantissaBits);
+    }
+    else
+    {
+        // Denormal, the implicit one becomes explicit
+        packed = ShiftRightRounded(mantissa | 0x800000u, 23 - mantissaBits + static_cast<uint32_t>(1 - exponent));
+    }
+    return packed < maxFinite ? packed : maxFinite;
+}
+
+static float UnpackSmallFloat(uint32_t bits, uint32_t mantissaBits)
+{
+    uint32_t exponent = bits >> mantissaBits;
+    uint32_t mantissa = bits & ((1u << mantissaBits) - 1u);
+    if (exponent == 0)
+        return std::ldexp(static_cast<float>(mantissa), -14 - static_cast<int>(mantissaBits));
+    if (exponent == 31)
+        return mantissa != 0 ? std::numeric_limits<float>::quiet_NaN() : std::numeric_limits<float>::infinity();
+    return std::ldexp(static_cast<float>(mantissa | (1u << mantissaBits)), static_cast<int>(exponent) - 15 - static_cast<int>(mantissaBits));
+}
+
+uint16_t PackHalf(float value)
+{
+    uint32_t sign = value < 0.0f ? 0x8000u : 0u;
+    return static_cast<uint16_t>(sign | PackSmallFloat(std::fabs(value), 10));
+}
+
+float UnpackHalf(uint16_t bits)
+{
+    float magnitude = UnpackSmallFloat(bits & 0x7FFFu, 10);
+    return (bits & 0x8000u) ? -magnitude : magnitude;
+}
+
+uint32_t PackR11G11B10(const float rgb[3])
+{
+    return PackSmallFloat(rgb[0], 6) | (PackSmallFloat(rgb[1], 6) << 11) | (PackSmallFloat(rgb[2], 5) << 22);
+}
+
+void UnpackR11G11B10(uint32_t bits, float rgb[3])
+{
+    rgb[0] = UnpackSmallFloat(bits & 0x7FFu, 6);
+    rgb[1] = UnpackSmallFloat((bits >> 11) & 0x7FFu, 6);
+    rgb[2] = UnpackSmallFloat(bits >> 22, 5);
+}
+
+uint32_t PackRGB9E5(const float rgb[3])
+{
+    // 511 / 512 * 2^16, the largest value with the maximum exponent
+    const float maxValue = 65408.0f;
+
+    float clamped[3];
+    for (int i = 0; i < 3; ++i)
+        clamped[i] = rgb[i] > 0.0f ? (rgb[i] < maxValue ? rgb[i] : maxValue) : 0.0f;
+
+    float maxChannel = clamped[0] > clamped[1] ? clamped[0] : clamped[1];
+    maxChannel = maxChannel > clamped[2] ? maxChannel : clamped[2];
+    if (maxChannel == 0.0f)
+        return 0;
+
+    // floor(log2(maxChannel)) is exponent - 1, the shared exponent is biased by 15 and can't go below 0
+    int exponent;
+    std::frexp(maxChannel, &exponent);
+    int sharedExponent = exponent + 15 > 0 ? exponent + 15 : 0;
+
+    float scale = std::ldexp(1.0f, 9 + 15 - sharedExponent);
+    if (std::floor(maxChannel * scale + 0.5f) == 512.0f)
+    {
+        ++sharedExponent;
+        scale *= 0.5f;
+    }
+
+    uint32_t bits = static_cast<uint32_t>(sharedExponent) << 27;
+    for (int i = 0; i < 3; ++i)
+        bits |= static_cast<uint32_t>(std::floor(clamped[i] * scale + 0.5f)) << (9 * i);
+    return bits;
+}
+
+void UnpackRGB9E5(uint32_t bits, float rgb[3])
+{
+    int exponent = static_cast<int>(bits >> 27) - 15 - 9;
+    for (int i = 0; i < 3; ++i)
+        rgb[i] = std::ldexp(static_cast<float>((bits >> (9 * i)) & 0x1FFu), exponent);
+}
+
+static void WriteBits(uint8_t block[16], uint32_t& position, uint32_t value, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; ++i, ++position)
+    {
+        if (value & (1u << i))
+            block[position >> 3] |= static_cast<uint8_t>(1u << (position & 7));
+    }
+}
+
+static uint32_t ReadBits(const uint8_t block[16], uint32_t& position, uint32_t count)
+{
+    uint32_t value = 0;
+    for (uint32_t i = 0; i < count; ++i, ++position)
+        value |= ((block[position >> 3] >> (position & 7)) & 1u) << i;
+    return value;
+}
+
+// Endpoint of the interpolation domain, 0 and the maximum are exact ends of the 16-bit range
+static int32_t UnquantizeBC6HEndpoint(uint32_t endpoint)
+{
+    if (endpoint == 0)
+        return 0;
+    if (endpoint == bc6hMaxEndpoint)
+        return 0xFFFF;
+    return static_cast<int32_t>(((endpoint << 16) + 0x8000u) >> bc6hEndpointBits);
+}
+
+static uint32_t QuantizeBC6HEndpoint(float value)
+{
+    // The inverse of (endpoint << 16 + 0x8000) >> 10, that is 64 endpoint + 32
+    float endpoint = std::floor((value - 32.0f) / 64.0f + 0.5f);
+    return endpoint <= 0.0f ? 0 : (endpoint >= bc6hMaxEndpoint ? bc6hMaxEndpoint : static_cast<uint32_t>(endpoint));
+}
+
+// The half float bit patterns of the 16 palette entries between two endpoints
+static void GetBC6HPalette(const uint32_t endpoints[2][3], int32_t palette[16][3])
+{
+    for (int channel = 0; channel < 3; ++channel)
+    {
+        int32_t a = UnquantizeBC6HEndpoint(endpoints[0][channel]);
+        int32_t b = UnquantizeBC6HEndpoint(endpoints[1][channel]);
+        for (int i = 0; i < 16; ++i)
+        {
+            int32_t weight = static_cast<int32_t>(bc6hWeights[i]);
+            int32_t value = ((64 - weight) * a + weight * b + 32) >> 6;
+            palette[i][channel] = (value * 31) >> 6;
+        }
+    }
+}
+
+// Picks the closest entry for every texel, returns the total squared error
+static float SelectBC6HIndices(const uint32_t endpoints[2][3], const int32_t targets[16][3], uint32_t indices[16])
+{
+    int32_t palette[16][3];
+    GetBC6HPalette(endpoints, palette);
+
+    float totalError = 0.0f;
+    for (int texel = 0; texel < 16; ++texel)
+    {
+        float bestError = std::numeric_limits<float>::max();
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            float error = 0.0f;
+            for (int channel = 0; channel < 3; ++channel)
+            {
+                float difference = static_cast<float>(palette[i][channel] - targets[texel][channel]);
+                error += difference * difference;
+            }
+            if (error < bestError)
+            {
+                bestError = error;
+                indices[texel] = i;
+            }
+        }
+        totalError += bestError;
+    }
+    return totalError;
+}
+
+void CompressBC6HBlock(const float texels[16 * 4], uint8_t block[16])
+{
+    // Texels as half float bit patterns and in the domain the endpoints are interpolated in (64 / 31 of the bits)
+    int32_t targets[16][3];
+    float points[16][3];
+    float mean[3] = { 0.0f, 0.0f, 0.0f };
+    for (int texel = 0; texel < 16; ++texel)
+    {
+        for (int channel = 0; channel < 3; ++channel)
+        {
+            float value = texels[texel * 4 + channel];
+            // Saturates at 0x7BFF, the largest value the unsigned mode decodes to
+            targets[texel][channel] = static_cast<int32_t>(PackSmallFloat(value, 10));
+            points[texel][channel] = targets[texel][channel] * (64.0f / 31.0f);
+            mean[channel] += points[texel][channel] / 16.0f;
+        }
+    }
+
+    // Principal axis by power iteration on the covariance
+    float covariance[3][3] = {};
+    for (int texel = 0; texel < 16; ++texel)
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            for (int j = 0; j < 3; ++j)
+                covariance[i][j] += (points[texel][i] - mean[i]) * (points[texel][j] - mean[j]);
+        }
+    }
+    float axis[3] = { 1.0f, 1.0f, 1.0f };
+    for (int iteration = 0; iteration < 8; ++iteration)
+    {
+        float next[3];
+        for (int i = 0; i < 3; ++i)
+            next[i] = covariance[i][0] * axis[0] + covariance[i][1] * axis[1] + covariance[i][2] * axis[2];
+        float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+        if (length == 0.0f)
+            break;
+        for (int i = 0; i < 3; ++i)
+            axis[i] = next[i] / length;
+    }
+
+    float minProjection = std::numeric_limits<float>::max();
+    float maxProjection = -std::numeric_limits<float>::max();
+    for (int texel = 0; texel < 16; ++texel)
+    {
+        float projection = 0.0f;
+        for (int i = 0; i < 3; ++i)
+            projection += (points[texel][i] - mean[i]) * axis[i];
+        minProjection = projection < minProjection ? projection : minProjection;
+        maxProjection = projection > maxProjection ? projection : maxProjection;
+    }
+
+    uint32_t endpoints[2][3];
+    for (int i = 0; i < 3; ++i)
+    {
+        endpoints[0][i] = QuantizeBC6HEndpoint(mean[i] + minProjection * axis[i]);
+        endpoints[1][i] = QuantizeBC6HEndpoint(mean[i] + maxProjection * axis[i]);
+    }
+    uint32_t indices[16];
+    float error = SelectBC6HIndices(endpoints, targets, indices);
+
+    // Least squares endpoints for the chosen indices, kept while they lower the error
+    for (int iteration = 0; iteration < 2 && error > 0.0f; ++iteration)
+    {
+        float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+        float ax[3] = { 0.0f, 0.0f, 0.0f }, bx[3] = { 0.0f, 0.0f, 0.0f };
+        for (int texel = 0; texel < 16; ++texel)
+        {
+            float b = bc6hWeights[indices[texel]] / 64.0f;
+            float a = 1.0f - b;
+            aa += a * a;
+            ab += a * b;
+            bb += b * b;
+            for (int i = 0; i < 3; ++i)
+            {
+                ax[i] += a * points[texel][i];
+                bx[i] += b * points[texel][i];
+            }
+        }
+        float determinant = aa * bb - ab * ab;
+        if (std::fabs(determinant) < 1e-6f)
+            break;
+
+        uint32_t refined[2][3];
+        for (int i = 0; i < 3; ++i)
+        {
+            refined[0][i] = QuantizeBC6HEndpoint((bb * ax[i] - ab * bx[i]) / determinant);
+            refined[1][i] = QuantizeBC6HEndpoint((aa * bx[i] - ab * ax[i]) / determinant);
+        }
+        uint32_t refinedIndices[16];
+        float refinedError = SelectBC6HIndices(refined, targets, refinedIndices);
+        if (refinedError >= error)
+            break;
+
+        error = refinedError;
+        memcpy(endpoints, refined, sizeof(endpoints));
+        memcpy(indices, refinedIndices, sizeof(indices));
+    }
+
+    // The first index is stored without its top bit, the weights are symmetric so swapping the ends mirrors the indices
+    if (indices[0] >= 8)
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            uint32_t endpoint = endpoints[0][i];
+            endpoints[0][i] = endpoints[1][i];
+            endpoints[1][i] = endpoint;
+        }
+        for (int texel = 0; texel < 16; ++texel)
+            indices[texel] = 15 - indices[texel];
+    }
+
+    memset(block, 0, 16);
+    uint32_t position = 0;
+    WriteBits(block, position, bc6hMode11, 5);
+    for (int end = 0; end < 2; ++end)
+    {
+        for (int i = 0; i < 3; ++i)
+            WriteBits(block, position, endpoints[end][i], bc6hEndpointBits);
+    }
+    for (int texel = 0; texel < 16; ++texel)
+        WriteBits(block, position, indices[texel], texel == 0 ? 3 : 4);
+}
+
+void DecompressBC6HBlock(const uint8_t block[16], float texels[16 * 4])
+{
+    uint32_t position = 0;
+    if (ReadBits(block, position, 5) != bc6hMode11)
+    {
+        for (int texel = 0; texel < 16; ++texel)
+        {
+            texels[texel * 4] = texels[texel * 4 + 1] = texels[texel * 4 + 2] = 0.0f;
+            texels[texel * 4 + 3] = 1.0f;
+        }
+        return;
+    }
+
+    uint32_t endpoints[2][3];
+    for (int end = 0; end < 2; ++end)
+    {
+        for (int i = 0; i < 3; ++i)
+            endpoints[end][i] = ReadBits(block, position, bc6hEndpointBits);
+    }
+    int32_t palette[16][3];
+    GetBC6HPalette(endpoints, palette);
+
+    for (int texel = 0; texel < 16; ++texel)
+    {
+        uint32_t index = ReadBits(block, position, texel == 0 ? 3 : 4);
+        for (int i = 0; i < 3; ++i)
+            texels[texel * 4 + i] = UnpackSmallFloat(static_cast<uint32_t>(palette[index][i]), 10);
+        texels[texel * 4 + 3] = 1.0f;
+    }
+}
+
+void PackHdrImage(HDR_TEXEL_FORMAT format, const float* rgba, uint32_t width, uint32_t height, std::vector<uint8_t>& data)
+{
+    uint32_t rowPitch = GetHdrRowPitch(format, width);
+    data.assign(static_cast<size_t>(rowPitch) * GetHdrRowCount(format, height), 0);
+
+    if (format == HDR_TEXEL_FORMAT::BC6H_UF16)
+    {
+        float texels[16 * 4];
+        for (uint32_t blockY = 0; blockY < GetHdrRowCount(format, height); ++blockY)
+        {
+            for (uint32_t blockX = 0; blockX < (width + 3) / 4; ++blockX)
+            {
+                for (uint32_t texel = 0; texel < 16; ++texel)
+                {
+                    uint32_t x = blockX * 4 + texel % 4;
+                    uint32_t y = blockY * 4 + texel / 4;
+                    x = x < width ? x : width - 1;
+                    y = y < height ? y : height - 1;
+                    memcpy(texels + texel * 4, rgba + (static_cast<size_t>(y) * width + x) * 4, 4 * sizeof(float));
+                }
+                CompressBC6HBlock(texels, data.data() + static_cast<size_t>(blockY) * rowPitch + blockX * 16);
+            }
+        }
+        return;
+    }
+
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        uint8_t* row = data.data() + static_cast<size_t>(y) * rowPitch;
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            const float* texel = rgba + (static_cast<size_t>(y) * width + x) * 4;
+            switch (format)
+            {
+            case HDR_TEXEL_FORMAT::R32G32B32A32_FLOAT:
+                memcpy(row + x * 16, texel, 16);
+                break;
+            case HDR_TEXEL_FORMAT::R16G16B16A16_FLOAT:
+            {
+                uint16_t halves[4] = { PackHalf(texel[0]), PackHalf(texel[1]), PackHalf(texel[2]), PackHalf(texel[3]) };
+                memcpy(row + x * 8, halves, 8);
+                break;
+            }
+            case HDR_TEXEL_FORMAT::R11G11B10_FLOAT:
+            {
+                uint32_t bits = PackR11G11B10(texel);
+                memcpy(row + x * 4, &bits, 4);
+                break;
+            }
+            case HDR_TEXEL_FORMAT::R9G9B9E5_SHAREDEXP:
+            {
+                uint32_t bits = PackRGB9E5(texel);
+                memcpy(row + x * 4, &bits, 4);
+                break;
+            }
+            case HDR_TEXEL_FORMAT::R32_FLOAT:
+                memcpy(row + x * 4, texel, 4);
+                break;
+            case HDR_TEXEL_FORMAT::R16_FLOAT:
+            {
+                uint16_t half = PackHalf(texel[0]);
+                memcpy(row + x * 2, &half, 2);
+                break;
+            }
+            default:
+                break;
+            }
+        }
+    }
+}
+
+void UnpackHdrImage(HDR_TEXEL_FORMAT format, const uint8_t* data, uint32_t width, uint32_t height, std::vector<float>& rgba)
+{
+    uint32_t rowPitch = GetHdrRowPitch(format, width);
+    rgba.assign(static_cast<size_t>(width) * height * 4, 0.0f);
+
+    if (format == HDR_TEXEL_FORMAT::BC6H_UF16)
+    {
+        float texels[16 * 4];
+        for (uint32_t blockY = 0; blockY < GetHdrRowCount(format, height); ++blockY)
+        {
+            for (uint32_t blockX = 0; blockX < (width + 3) / 4; ++blockX)
+            {
+                DecompressBC6HBlock(data + static_cast<size_t>(blockY) * rowPitch + blockX * 16, texels);
+                for (uint32_t texel = 0; texel < 16; ++texel)
+                {
+                    uint32_t x = blockX * 4 + texel % 4;
+                    uint32_t y = blockY * 4 + texel / 4;
+                    if (x < width && y < height)
+                        memcpy(rgba.data() + (static_cast<size_t>(y) * width + x) * 4, texels + texel * 4, 4 * sizeof(float));
+                }
+            }
+        }
+        return;
+    }
+
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        const uint8_t* row = data + static_cast<size_t>(y) * rowPitch;
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            float* texel = rgba.data() + (static_cast<size_t>(y) * width + x) * 4;
+            texel[3] = 1.0f;
+            switch (format)
+            {
+            case HDR_TEXEL_FORMAT::R32G32B32A32_FLOAT:
+                memcpy(texel, row + x * 16, 16);
+                break;
+            case HDR_TEXEL_FORMAT::R16G16B16A16_FLOAT:
+            {
+                uint16_t halves[4];
+                memcpy(halves, row + x * 8, 8);
+                for (int i = 0; i < 4; ++i)
+                    texel[i] = UnpackHalf(halves[i]);
+                break;
+            }
+            case HDR_TEXEL_FORMAT::R11G11B10_FLOAT:
+            {
+                uint32_t bits;
+                memcpy(&bits, row + x * 4, 4);
+                UnpackR11G11B10(bits, texel);
+                break;
+            }
+            case HDR_TEXEL_FORMAT::R9G9B9E5_SHAREDEXP:
+            {
+                uint32_t bits;
+                memcpy(&bits, row + x * 4, 4);
+                UnpackRGB9E5(bits, texel);
+                break;
+            }
+            case HDR_TEXEL_FORMAT::R32_FLOAT:
+                memcpy(texel, row + x * 4, 4);
+                break;
+            case HDR_TEXEL_FORMAT::R16_FLOAT:
+            {
+                uint16_t half;
+                memcpy(&half, row + x * 2, 2);
+                texel[0] = UnpackHalf(half);
+                break;
+            }
+            default:
+                break;
+            }
+        }
+    }
+}
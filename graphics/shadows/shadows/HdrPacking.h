@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Layouts of HDR texel data, each matches the DXGI format of the same name
+enum class HDR_TEXEL_FORMAT
+{
+    R32G32B32A32_FLOAT = 0,
+    R16G16B16A16_FLOAT,
+    R11G11B10_FLOAT,
+    R9G9B9E5_SHAREDEXP,
+    R32_FLOAT,
+    R16_FLOAT,
+    BC6H_UF16,
+    COUNT
+};
+
+const char* GetHdrTexelFormatName(HDR_TEXEL_FORMAT format);
+
+// Bytes of a tightly packed row of texels (of 4x4 blocks for BC6H) and the number of such rows in an image
+uint32_t GetHdrRowPitch(HDR_TEXEL_FORMAT format, uint32_t width);
+uint32_t GetHdrRowCount(HDR_TEXEL_FORMAT format, uint32_t height);
+
+// Conversions of single values and texels. Floats are rounded to the nearest representable value with ties to even,
+// values out of range saturate to the largest finite one and NaNs become 0. The unsigned formats clamp negatives to 0.
+uint16_t PackHalf(float value);
+float UnpackHalf(uint16_t bits);
+uint32_t PackR11G11B10(const float rgb[3]);
+void UnpackR11G11B10(uint32_t bits, float rgb[3]);
+// Rounds the mantissas as the D3D specification does, half away from zero
+uint32_t PackRGB9E5(const float rgb[3]);
+void UnpackRGB9E5(uint32_t bits, float rgb[3]);
+
+// One 4x4 block of RGBA texels (alpha is ignored) in BC6H unsigned mode 11: a single line between two 10-bit endpoints
+// with 4-bit indices. The endpoints lie on the principal axis of the block and are refined by least squares, the error
+// is measured on the half float bit patterns the format interpolates.
+void CompressBC6HBlock(const float texels[16 * 4], uint8_t block[16]);
+// Decodes any block that uses mode 11, others decode to black
+void DecompressBC6HBlock(const uint8_t block[16], float texels[16 * 4]);
+
+// Packs an RGBA float image with rows from the top, the result has GetHdrRowCount rows GetHdrRowPitch bytes apart.
+// BC6H blocks that reach past the edge of the image repeat its last row and column.
+void PackHdrImage(HDR_TEXEL_FORMAT format, const float* rgba, uint32_t width, uint32_t height, std::vector<uint8_t>& data);
+// Back to RGBA floats, missing channels read as the GPU reads them: 0 for green and blue, 1 for alpha
+void UnpackHdrImage(HDR_TEXEL_FORMAT format, const uint8_t* data, uint32_t width, uint32_t height, std::vector<float>& rgba);
@@ -0,0 +1,78 @@
+#include "IBLBakeScheduler.h"
+
+#include <chrono>
+
+// Weight of the previous estimate of a stage's time per cost
+const float costSmoothing = 0.75f;
+
+static double SteadyClock()
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+IBLBakeScheduler::IBLBakeScheduler(unsigned int threadCount, Clock clock) :
+    m_threadCount(threadCount),
+    m_clock(clock ? clock : Clock(SteadyClock)),
+    m_updateCount(0)
+{
+    for (float& msPerCost : m_msPerCost)
+        msPerCost = 0.0f;
+};
+
+void IBLBakeScheduler::Start(EnvironmentImage&& image, const IBLBakeSettings& settings)
+{
+    // Measured times are kept, the stages cost the same per unit for every environment
+    m_job.Start(std::move(image), settings);
+    m_updateCount = 0;
+}
+
+void IBLBakeScheduler::Cancel()
+{
+    m_job.Reset();
+}
+
+bool IBLBakeScheduler::Update(float budget)
+{
+    if (!m_job.IsRunning())
+        return false;
+
+    ++m_updateCount;
+    double start = m_clock();
+    double now = start;
+    do
+    {
+        float& msPerCost = m_msPerCost[static_cast<size_t>(m_job.GetStage())];
+        float rowCost = m_job.GetRowCost();
+        uint32_t remainingRows = m_job.GetRemainingRows();
+
+        // One row when the stage hasn't been measured yet, otherwise as many as the rest of the budget is predicted to take
+        uint32_t rowCount = remainingRows;
+        if (budget > 0.0f)
+        {
+            double rowMs = static_cast<double>(msPerCost) * rowCost;
+            double rows = rowMs > 0.0 ? (budget - (now - start)) / rowMs : 1.0;
+            rowCount = rows < 1.0 ? 1 : rows < remainingRows ? static_cast<uint32_t>(rows) : remainingRows;
+        }
+
+        double batchStart = now;
+        uint32_t rowsRun = m_job.Run(rowCount, m_threadCount);
+        now = m_clock();
+
+        float measured = static_cast<float>((now - batchStart) / (static_cast<double>(rowsRun) * rowCost));
+        msPerCost = msPerCost > 0.0f ? costSmoothing * msPerCost + (1.0f - costSmoothing) * measured : measured;
+
+        if (!m_job.IsRunning() || budget <= 0.0f)
+            continue;
+
+        // Stops when the next row isn't predicted to fit
+        float nextMsPerCost = m_msPerCost[static_cast<size_t>(m_job.GetStage())];
+        if (now - start + static_cast<double>(nextMsPerCost) * m_job.GetRowCost() > budget)
+            break;
+    }
+    while (m_job.IsRunning());
+
+    return !m_job.IsRunning();
+}
+
+IBLBakeScheduler::~IBLBakeScheduler()
+{};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+#include "IBLBaker.h"
+
+// Bakes a new environment over several frames. Every update runs rows of the bake until its budget is spent; how many
+// rows fit is predicted from the time per unit of row cost measured so far for each stage.
+class IBLBakeScheduler
+{
+public:
+    // Milliseconds since any fixed point, a steady clock unless one is given
+    typedef std::function<double()> Clock;
+
+    explicit IBLBakeScheduler(unsigned int threadCount = 0, Clock clock = Clock());
+    ~IBLBakeScheduler();
+
+    // Replaces a bake in progress
+    void Start(EnvironmentImage&& image, const IBLBakeSettings& settings);
+    void Cancel();
+
+    // Runs the bake for about budget milliseconds, a budget of 0 finishes it. At least one batch of rows is run, so a
+    // budget below the cost of a row is exceeded. Returns true in the update that finished the bake.
+    bool Update(float budget);
+
+    bool IsBaking() const { return m_job.IsRunning(); };
+    float GetProgress() const { return m_job.GetProgress(); };
+    // Updates the current or last bake took
+    uint32_t GetUpdateCount() const { return m_updateCount; };
+
+    bool TakeResult(CubeMap& environment, IBLBakeResult& result) { return m_job.TakeResult(environment, result); };
+
+private:
+    IBLBakeJob   m_job;
+    unsigned int m_threadCount;
+    Clock        m_clock;
+    uint32_t     m_updateCount;
+
+    // Milliseconds per unit of row cost of every stage, 0 until measured
+    float        m_msPerCost[static_cast<size_t>(IBL_BAKE_STAGE::COUNT)];
+};
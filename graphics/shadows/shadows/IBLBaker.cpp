@@ -0,0 +1,1141 @@
+#include "IBLBaker.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+#include "CacheFile.h"
+#include "CpuTrace.h"
+#include "ParallelFor.h"
+#include "ShaderCache.h"
+#include "SimdFloat4.h"
+
+const float PI = 3.14159265358979323846f;
+
+// Bumped whenever the bakers or the file layout change, old entries become misses then
+const uint32_t iblCacheVersion = 6;
+const uint32_t iblCacheMagic = 0x4C424943; // "CIBL"
+const uint32_t brdfCacheMagic = 0x44524243; // "CBRD"
+
+struct IBLBakeCacheHeader
+{
+    uint32_t        magic;
+    uint32_t        version;
+    uint64_t        key;
+    IBLBakeSettings settings;
+    uint64_t        size;
+};
+
+struct PreintegratedBRDFCacheHeader
+{
+    uint32_t                  magic;
+    uint32_t                  version;
+    uint64_t                  key;
+    PreintegratedBRDFSettings settings;
+    uint32_t                  reserved;
+    uint64_t                  size;
+};
+
+CubeMap::CubeMap() :
+    m_size(0),
+    m_mipLevels(0),
+    m_faceFloats(0)
+{};
+
+void CubeMap::Resize(uint32_t size, uint32_t mipLevels)
+{
+    m_size = size;
+    m_mipLevels = mipLevels;
+
+    m_mipOffsets.resize(mipLevels);
+    m_faceFloats = 0;
+    for (uint32_t mip = 0; mip < mipLevels; ++mip)
+    {
+        m_mipOffsets[mip] = m_faceFloats;
+        m_faceFloats += static_cast<size_t>(GetSize(mip)) * GetSize(mip) * 4;
+    }
+
+    m_data.resize(m_faceFloats * 6);
+}
+
+CubeMap::~CubeMap()
+{};
+
+// Unit direction through the point (u, v) of a face, both in [-1, 1]
+static void FaceDirection(uint32_t face, float u, float v, float direction[3])
+{
+    switch (face)
+    {
+    case 0: direction[0] = 1.0f; direction[1] = -v; direction[2] = -u; break;
+    case 1: direction[0] = -1.0f; direction[1] = -v; direction[2] = u; break;
+    case 2: direction[0] = u; direction[1] = 1.0f; direction[2] = v; break;
+    case 3: direction[0] = u; direction[1] = -1.0f; direction[2] = -v; break;
+    case 4: direction[0] = u; direction[1] = -v; direction[2] = 1.0f; break;
+    default: direction[0] = -u; direction[1] = -v; direction[2] = -1.0f; break;
+    }
+
+    float length = std::sqrt(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+    for (int i = 0; i < 3; ++i)
+        direction[i] /= length;
+}
+
+void CubeTexelDirection(uint32_t face, uint32_t x, uint32_t y, uint32_t size, float direction[3])
+{
+    FaceDirection(face, 2.0f * (x + 0.5f) / size - 1.0f, 2.0f * (y + 0.5f) / size - 1.0f, direction);
+}
+
+// Solid angle between the face center and the corner (x, y), in [-1, 1] face coordinates
+static double CornerSolidAngle(double x, double y)
+{
+    return std::atan2(x * y, std::sqrt(x * x + y * y + 1.0));
+}
+
+// Exact solid angles of the texels of row y of a face with the given size, the same for all six faces
+static void TexelSolidAngleRow(uint32_t size, uint32_t y, float* solidAngles)
+{
+    // Corners along the top and the bottom edge of the row
+    std::vector<double> corners(static_cast<size_t>(2) * (size + 1));
+    for (uint32_t j = 0; j < 2; ++j)
+    {
+        for (uint32_t x = 0; x <= size; ++x)
+            corners[j * (size + 1) + x] = CornerSolidAngle(2.0 * x / size - 1.0, 2.0 * (y + j) / size - 1.0);
+    }
+
+    for (uint32_t x = 0; x < size; ++x)
+    {
+        const double* corner = &corners[x];
+        solidAngles[x] = static_cast<float>(corner[0] - corner[1] - corner[size + 1] + corner[size + 2]);
+    }
+}
+
+static void TexelSolidAngles(uint32_t size, std::vector<float>& solidAngles)
+{
+    solidAngles.resize(static_cast<size_t>(size) * size);
+    for (uint32_t y = 0; y < size; ++y)
+        TexelSolidAngleRow(size, y, &solidAngles[static_cast<size_t>(y) * size]);
+}
+
+// Face of the major axis and the [0, 1] coordinates on it, inverse of CubeTexelDirection
+static uint32_t DirectionToFace(const float direction[3], float& s, float& t)
+{
+    float ax = std::fabs(direction[0]);
+    float ay = std::fabs(direction[1]);
+    float az = std::fabs(direction[2]);
+
+    uint32_t face;
+    float major, sc, tc;
+    if (ax >= ay && ax >= az)
+    {
+        face = direction[0] >= 0.0f ? 0 : 1;
+        major = ax;
+        sc = direction[0] >= 0.0f ? -direction[2] : direction[2];
+        tc = -direction[1];
+    }
+    else if (ay >= az)
+    {
+        face = direction[1] >= 0.0f ? 2 : 3;
+        major = ay;
+        sc = direction[0];
+        tc = direction[1] >= 0.0f ? direction[2] : -direction[2];
+    }
+    else
+    {
+        face = direction[2] >= 0.0f ? 4 : 5;
+        major = az;
+        sc = direction[2] >= 0.0f ? direction[0] : -direction[0];
+        tc = -direction[1];
+    }
+
+    float scale = 0.5f / major;
+    s = sc * scale + 0.5f;
+    t = tc * scale + 0.5f;
+    return face;
+}
+
+// Texel a bilinear tap past one edge of a face reads, as seamless cube sampling does: the direction through the
+// tap's texel center is taken to the face it points at. Works in half texels, so the mapping is exact.
+static const float* WrapCubeTexel(const CubeMap& cube, uint32_t mip, uint32_t face, int x, int y)
+{
+    int size = static_cast<int>(cube.GetSize(mip));
+    int u = 2 * x + 1 - size;
+    int v = 2 * y + 1 - size;
+
+    // Same axes as FaceDirection with the face at distance size
+    int direction[3];
+    switch (face)
+    {
+    case 0: direction[0] = size; direction[1] = -v; direction[2] = -u; break;
+    case 1: direction[0] = -size; direction[1] = -v; direction[2] = u; break;
+    case 2: direction[0] = u; direction[1] = size; direction[2] = v; break;
+    case 3: direction[0] = u; direction[1] = -size; direction[2] = -v; break;
+    case 4: direction[0] = u; direction[1] = -v; direction[2] = size; break;
+    default: direction[0] = -u; direction[1] = -v; direction[2] = -size; break;
+    }
+
+    // Same choices as DirectionToFace
+    int ax = std::abs(direction[0]);
+    int ay = std::abs(direction[1]);
+    int az = std::abs(direction[2]);
+    int major, sc, tc;
+    if (ax >= ay && ax >= az)
+    {
+        face = direction[0] >= 0 ? 0 : 1;
+        major = ax;
+        sc = direction[0] >= 0 ? -direction[2] : direction[2];
+        tc = -direction[1];
+    }
+    else if (ay >= az)
+    {
+        face = direction[1] >= 0 ? 2 : 3;
+        major = ay;
+        sc = direction[0];
+        tc = direction[1] >= 0 ? direction[2] : -direction[2];
+    }
+    else
+    {
+        face = direction[2] >= 0 ? 4 : 5;
+        major = az;
+        sc = direction[2] >= 0 ? direction[0] : -direction[0];
+        tc = -direction[1];
+    }
+
+    // Coordinates are within [-major, major], the divisions round down
+    int wrappedX = (sc + major) * size / (2 * major);
+    int wrappedY = (tc + major) * size / (2 * major);
+    wrappedX = wrappedX < size ? wrappedX : size - 1;
+    wrappedY = wrappedY < size ? wrappedY : size - 1;
+    return cube.GetFace(face, mip) + (static_cast<size_t>(wrappedY) * size + wrappedX) * 4;
+}
+
+// Taps past a corner, where three faces meet, read the average of the three corner texels as D3D does
+static SimdFloat4 LoadCubeTexel(const CubeMap& cube, uint32_t mip, uint32_t face, int x, int y)
+{
+    int size = static_cast<int>(cube.GetSize(mip));
+    int clampedX = x < 0 ? 0 : (x >= size ? size - 1 : x);
+    int clampedY = y < 0 ? 0 : (y >= size ? size - 1 : y);
+    if (clampedX == x && clampedY == y)
+        return SimdFloat4::Load(cube.GetFace(face, mip) + (static_cast<size_t>(y) * size + x) * 4);
+    if (clampedX != x && clampedY != y)
+    {
+        SimdFloat4 sum = SimdFloat4::Load(cube.GetFace(face, mip) + (static_cast<size_t>(clampedY) * size + clampedX) * 4);
+        sum = sum + SimdFloat4::Load(WrapCubeTexel(cube, mip, face, x, clampedY));
+        sum = sum + SimdFloat4::Load(WrapCubeTexel(cube, mip, face, clampedX, y));
+        return sum * SimdFloat4::Replicate(1.0f / 3.0f);
+    }
+    return SimdFloat4::Load(WrapCubeTexel(cube, mip, face, x, y));
+}
+
+static SimdFloat4 SampleFace(const CubeMap& cube, uint32_t face, uint32_t mip, float s, float t)
+{
+    uint32_t size = cube.GetSize(mip);
+
+    // Coordinates are at least -0.5, shifting them by one truncates like floor
+    float x = s * size + 0.5f;
+    float y = t * size + 0.5f;
+    int ix = static_cast<int>(x);
+    int iy = static_cast<int>(y);
+    float fx = static_cast<float>(ix);
+    float fy = static_cast<float>(iy);
+
+    int x0 = ix - 1;
+    int y0 = iy - 1;
+    int isize = static_cast<int>(size);
+    SimdFloat4 texels[4];
+    if (x0 >= 0 && y0 >= 0 && ix < isize && iy < isize)
+    {
+        const float* row0 = cube.GetFace(face, mip) + static_cast<size_t>(y0) * size * 4;
+        const float* row1 = row0 + size * 4;
+        texels[0] = SimdFloat4::Load(row0 + x0 * 4);
+        texels[1] = SimdFloat4::Load(row0 + ix * 4);
+        texels[2] = SimdFloat4::Load(row1 + x0 * 4);
+        texels[3] = SimdFloat4::Load(row1 + ix * 4);
+    }
+    else
+    {
+        // Taps past the edges read the neighbouring faces
+        texels[0] = LoadCubeTexel(cube, mip, face, x0, y0);
+        texels[1] = LoadCubeTexel(cube, mip, face, ix, y0);
+        texels[2] = LoadCubeTexel(cube, mip, face, x0, iy);
+        texels[3] = LoadCubeTexel(cube, mip, face, ix, iy);
+    }
+
+    SimdFloat4 top = Lerp(texels[0], texels[1], x - fx);
+    SimdFloat4 bottom = Lerp(texels[2], texels[3], x - fx);
+    return Lerp(top, bottom, y - fy);
+}
+
+static SimdFloat4 SampleCubeMip(const CubeMap& cube, const float direction[3], uint32_t mip)
+{
+    float s, t;
+    uint32_t face = DirectionToFace(direction, s, t);
+    return SampleFace(cube, face, mip, s, t);
+}
+
+static SimdFloat4 SampleCubeTrilinear(const CubeMap& cube, const float direction[3], float level)
+{
+    float maxLevel = static_cast<float>(cube.GetMipLevels() - 1);
+    level = level < 0.0f ? 0.0f : (level > maxLevel ? maxLevel : level);
+
+    float s, t;
+    uint32_t face = DirectionToFace(direction, s, t);
+
+    uint32_t mip = static_cast<uint32_t>(level);
+    float blend = level - mip;
+    SimdFloat4 color = SampleFace(cube, face, mip, s, t);
+    if (blend > 0.0f)
+        color = Lerp(color, SampleFace(cube, face, mip + 1, s, t), blend);
+    return color;
+}
+
+void SampleCube(const CubeMap& cube, const float direction[3], uint32_t mip, float color[4])
+{
+    SampleCubeMip(cube, direction, mip).Store(color);
+}
+
+void SampleCubeLevel(const CubeMap& cube, const float direction[3], float level, float color[4])
+{
+    SampleCubeTrilinear(cube, direction, level).Store(color);
+}
+
+static SimdFloat4 SampleEquirectTexel(const EnvironmentImage& image, const float direction[3])
+{
+    float length = std::sqrt(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+    float y = direction[1] / length;
+    y = y < -1.0f ? -1.0f : (y > 1.0f ? 1.0f : y);
+
+    float u = 1.0f - std::atan2(direction[2], direction[0]) / (2.0f * PI);
+    float v = 0.5f - std::asin(y) / PI;
+
+    float x = u * image.width - 0.5f;
+    float row = v * image.height - 0.5f;
+    float fx = std::floor(x);
+    float fy = std::floor(row);
+
+    int width = static_cast<int>(image.width);
+    int height = static_cast<int>(image.height);
+    int x0 = ((static_cast<int>(fx) % width) + width) % width;
+    int x1 = (x0 + 1) % width;
+    int y0 = ((static_cast<int>(fy) % height) + height) % height;
+    int y1 = (y0 + 1) % height;
+
+    const float* row0 = image.pixels.data() + static_cast<size_t>(y0) * width * 4;
+    const float* row1 = image.pixels.data() + static_cast<size_t>(y1) * width * 4;
+    SimdFloat4 top = Lerp(SimdFloat4::Load(row0 + x0 * 4), SimdFloat4::Load(row0 + x1 * 4), x - fx);
+    SimdFloat4 bottom = Lerp(SimdFloat4::Load(row1 + x0 * 4), SimdFloat4::Load(row1 + x1 * 4), x - fx);
+    return Lerp(top, bottom, row - fy);
+}
+
+void SampleEquirect(const EnvironmentImage& image, const float direction[3], float color[4])
+{
+    SampleEquirectTexel(image, direction).Store(color);
+}
+
+// Tangent and bitangent around a normal, the same frame the shaders built
+static void TangentFrame(const float normal[3], float tangent[3], float bitangent[3])
+{
+    float up[3] = { 0.0f, 0.0f, 1.0f };
+    if (std::fabs(normal[2]) >= 0.999f)
+    {
+        up[0] = 1.0f;
+        up[2] = 0.0f;
+    }
+
+    tangent[0] = up[1] * normal[2] - up[2] * normal[1];
+    tangent[1] = up[2] * normal[0] - up[0] * normal[2];
+    tangent[2] = up[0] * normal[1] - up[1] * normal[0];
+    float length = std::sqrt(tangent[0] * tangent[0] + tangent[1] * tangent[1] + tangent[2] * tangent[2]);
+    for (int i = 0; i < 3; ++i)
+        tangent[i] /= length;
+
+    bitangent[0] = normal[1] * tangent[2] - normal[2] * tangent[1];
+    bitangent[1] = normal[2] * tangent[0] - normal[0] * tangent[2];
+    bitangent[2] = normal[0] * tangent[1] - normal[1] * tangent[0];
+}
+
+// Sample directions in a tangent frame as components along the tangent, bitangent and normal, four at a time.
+// The table is padded with zero weights to a multiple of four.
+struct HemisphereSamples
+{
+    std::vector<float> t;
+    std::vector<float> b;
+    std::vector<float> n;
+    std::vector<float> level;
+    std::vector<float> weight;
+
+    void Add(float tangent, float bitangent, float normal, float sampleLevel, float sampleWeight)
+    {
+        t.push_back(tangent);
+        b.push_back(bitangent);
+        n.push_back(normal);
+        level.push_back(sampleLevel);
+        weight.push_back(sampleWeight);
+    };
+
+    void Pad()
+    {
+        while (t.size() % 4 != 0)
+            Add(0.0f, 0.0f, 1.0f, 0.0f, 0.0f);
+    };
+
+    uint32_t GetCount() const { return static_cast<uint32_t>(t.size()); };
+};
+
+// Weighted sum of the samples around the normal, with trilinear lookups at the levels of the samples
+static SimdFloat4 IntegrateHemisphere(const CubeMap& cube, const HemisphereSamples& samples, const float normal[3])
+{
+    float tangent[3], bitangent[3];
+    TangentFrame(normal, tangent, bitangent);
+
+    SimdFloat4 frame[9];
+    for (int i = 0; i < 3; ++i)
+    {
+        frame[i] = SimdFloat4::Replicate(tangent[i]);
+        frame[3 + i] = SimdFloat4::Replicate(bitangent[i]);
+        frame[6 + i] = SimdFloat4::Replicate(normal[i]);
+    }
+
+    SimdFloat4 sum = SimdFloat4::Zero();
+    float directions[3][4];
+    for (uint32_t i = 0; i < samples.GetCount(); i += 4)
+    {
+        // Directions of four samples are rotated into the world together
+        SimdFloat4 st = SimdFloat4::Load(&samples.t[i]);
+        SimdFloat4 sb = SimdFloat4::Load(&samples.b[i]);
+        SimdFloat4 sn = SimdFloat4::Load(&samples.n[i]);
+        for (int axis = 0; axis < 3; ++axis)
+            (st * frame[axis] + sb * frame[3 + axis] + sn * frame[6 + axis]).Store(directions[axis]);
+
+        for (uint32_t lane = 0; lane < 4; ++lane)
+        {
+            float weight = samples.weight[i + lane];
+            if (weight == 0.0f)
+                continue;
+
+            float direction[3] = { directions[0][lane], directions[1][lane], directions[2][lane] };
+            SimdFloat4 color = SampleCubeTrilinear(cube, direction, samples.level[i + lane]);
+            sum = sum + color * SimdFloat4::Replicate(weight);
+        }
+    }
+    return sum;
+}
+
+static uint32_t GetCubeMipLevels(uint32_t size)
+{
+    uint32_t mipLevels = 1;
+    while ((size >> mipLevels) > 0)
+        ++mipLevels;
+    return mipLevels;
+}
+
+// A face spans a quarter of the image width, when that is more than one image texel per cube texel
+// every cube texel averages a grid of bilinear samples over its area
+static uint32_t GetEquirectSubsamples(const EnvironmentImage& image, uint32_t size)
+{
+    uint32_t subsamples = (image.width / 4 + size - 1) / size;
+    return subsamples > 0 ? subsamples : 1;
+}
+
+// Rows count through the faces: row / size is the face and row % size the y of a texel
+static void ConvertEquirectRow(const EnvironmentImage& image, uint32_t subsamples, CubeMap& cube, uint32_t row)
+{
+    uint32_t size = cube.GetSize();
+    uint32_t face = row / size;
+    uint32_t y = row % size;
+    SimdFloat4 subsampleScale = SimdFloat4::Replicate(1.0f / (subsamples * subsamples));
+    float* texels = cube.GetFace(face, 0) + static_cast<size_t>(y) * size * 4;
+    for (uint32_t x = 0; x < size; ++x)
+    {
+        SimdFloat4 sum = SimdFloat4::Zero();
+        for (uint32_t j = 0; j < subsamples; ++j)
+        {
+            float v = 2.0f * (y + (j + 0.5f) / subsamples) / size - 1.0f;
+            for (uint32_t i = 0; i < subsamples; ++i)
+            {
+                float direction[3];
+                FaceDirection(face, 2.0f * (x + (i + 0.5f) / subsamples) / size - 1.0f, v, direction);
+                sum = sum + SampleEquirectTexel(image, direction);
+            }
+        }
+        (sum * subsampleScale).Store(texels + x * 4);
+        texels[x * 4 + 3] = 1.0f;
+    }
+}
+
+// Every texel of a mip covers exactly its 2x2 children, so it is their average weighted by solid angle.
+// That is the mean radiance over the texel: the integral over the sphere stays the same on every level,
+// where an unweighted average would overweight the small texels near the face corners.
+static void DownsampleCubeRow(CubeMap& cube, uint32_t mip, const std::vector<float>& childSolidAngles, uint32_t row)
+{
+    uint32_t mipSize = cube.GetSize(mip);
+    uint32_t childSize = 2 * mipSize;
+    uint32_t face = row / mipSize;
+    uint32_t y = row % mipSize;
+    const float* source = cube.GetFace(face, mip - 1) + static_cast<size_t>(2 * y) * childSize * 4;
+    const float* sourceNext = source + static_cast<size_t>(childSize) * 4;
+    const float* weights = &childSolidAngles[static_cast<size_t>(2 * y) * childSize];
+    const float* weightsNext = weights + childSize;
+    float* texels = cube.GetFace(face, mip) + static_cast<size_t>(y) * mipSize * 4;
+    for (uint32_t x = 0; x < mipSize; ++x)
+    {
+        const float w[4] = { weights[2 * x], weights[2 * x + 1], weightsNext[2 * x], weightsNext[2 * x + 1] };
+        SimdFloat4 sum = SimdFloat4::Load(source + x * 8) * SimdFloat4::Replicate(w[0]) +
+            SimdFloat4::Load(source + x * 8 + 4) * SimdFloat4::Replicate(w[1]) +
+            SimdFloat4::Load(sourceNext + x * 8) * SimdFloat4::Replicate(w[2]) +
+            SimdFloat4::Load(sourceNext + x * 8 + 4) * SimdFloat4::Replicate(w[3]);
+        (sum * SimdFloat4::Replicate(1.0f / (w[0] + w[1] + w[2] + w[3]))).Store(texels + x * 4);
+        texels[x * 4 + 3] = 1.0f;
+    }
+}
+
+void EquirectToCube(const EnvironmentImage& image, uint32_t size, CubeMap& cube, unsigned int threadCount)
+{
+    CPU_TRACE_SCOPE("EquirectToCube");
+
+    uint32_t mipLevels = GetCubeMipLevels(size);
+    cube.Resize(size, mipLevels);
+
+    uint32_t subsamples = GetEquirectSubsamples(image, size);
+    ParallelFor(6 * size, threadCount, [&](uint32_t row)
+    {
+        ConvertEquirectRow(image, subsamples, cube, row);
+    });
+
+    std::vector<float> childSolidAngles;
+    TexelSolidAngles(size, childSolidAngles);
+    for (uint32_t mip = 1; mip < mipLevels; ++mip)
+    {
+        ParallelFor(6 * cube.GetSize(mip), threadCount, [&](uint32_t row)
+        {
+            DownsampleCubeRow(cube, mip, childSolidAngles, row);
+        });
+        TexelSolidAngles(cube.GetSize(mip), childSolidAngles);
+    }
+}
+
+// Sums of the nine basis functions times the radiance over one row of the top level, padded to four floats each
+static void ProjectIrradianceRow(const CubeMap& environment, const std::vector<float>& solidAngles, uint32_t row, float* sums)
+{
+    uint32_t size = environment.GetSize();
+    uint32_t face = row / size;
+    uint32_t y = row % size;
+    const float* texels = environment.GetFace(face, 0) + static_cast<size_t>(y) * size * 4;
+    const float* weights = &solidAngles[static_cast<size_t>(y) * size];
+
+    SimdFloat4 rowSums[9];
+    for (SimdFloat4& sum : rowSums)
+        sum = SimdFloat4::Zero();
+
+    for (uint32_t x = 0; x < size; ++x)
+    {
+        float d[3];
+        CubeTexelDirection(face, x, y, size, d);
+        SimdFloat4 color = SimdFloat4::Load(texels + x * 4) * SimdFloat4::Replicate(weights[x]);
+
+        float basis[9] = { 1.0f, d[1], d[2], d[0], d[0] * d[1], d[1] * d[2], 3.0f * d[2] * d[2] - 1.0f, d[0] * d[2], d[0] * d[0] - d[1] * d[1] };
+        for (int i = 0; i < 9; ++i)
+            rowSums[i] = rowSums[i] + color * SimdFloat4::Replicate(basis[i]);
+    }
+
+    for (int i = 0; i < 9; ++i)
+        rowSums[i].Store(sums + i * 4);
+}
+
+// Rows are added up in order, so the result doesn't depend on the threads or the order the rows were projected in
+static void SumIrradianceRows(const std::vector<float>& rowSums, uint32_t rowCount, IrradianceSH& irradiance)
+{
+    double totals[9][3] = {};
+    for (uint32_t row = 0; row < rowCount; ++row)
+    {
+        for (int i = 0; i < 9; ++i)
+        {
+            for (int c = 0; c < 3; ++c)
+                totals[i][c] += rowSums[(static_cast<size_t>(row) * 9 + i) * 4 + c];
+        }
+    }
+
+    // Squared basis constants (once from the projection, once from the evaluation) times the cosine lobe factors
+    // pi, 2 pi / 3 and pi / 4 of the bands, divided by pi
+    const double band0 = 0.282094791773878 * 0.282094791773878;
+    const double band1 = 0.488602511902920 * 0.488602511902920 * 2.0 / 3.0;
+    const double band2 = 1.092548430592079 * 1.092548430592079 / 4.0;
+    const double band2Zonal = 0.315391565252520 * 0.315391565252520 / 4.0;
+    const double band2Sectoral = 0.546274215296040 * 0.546274215296040 / 4.0;
+    const double scales[9] = { band0, band1, band1, band1, band2, band2, band2Zonal, band2, band2Sectoral };
+    for (int i = 0; i < 9; ++i)
+    {
+        for (int c = 0; c < 3; ++c)
+            irradiance.coefficients[i][c] = static_cast<float>(totals[i][c] * scales[i]);
+        irradiance.coefficients[i][3] = 0.0f;
+    }
+}
+
+void ProjectIrradianceSH(const CubeMap& environment, IrradianceSH& irradiance, unsigned int threadCount)
+{
+    CPU_TRACE_SCOPE("ProjectIrradianceSH");
+
+    uint32_t size = environment.GetSize();
+
+    std::vector<float> solidAngles;
+    TexelSolidAngles(size, solidAngles);
+
+    std::vector<float> rowSums(static_cast<size_t>(6) * size * 9 * 4);
+    ParallelFor(6 * size, threadCount, [&](uint32_t row)
+    {
+        ProjectIrradianceRow(environment, solidAngles, row, &rowSums[static_cast<size_t>(row) * 9 * 4]);
+    });
+
+    SumIrradianceRows(rowSums, 6 * size, irradiance);
+}
+
+void EvaluateIrradianceSH(const IrradianceSH& irradiance, const float normal[3], float color[3])
+{
+    float x = normal[0];
+    float y = normal[1];
+    float z = normal[2];
+    float basis[9] = { 1.0f, y, z, x, x * y, y * z, 3.0f * z * z - 1.0f, x * z, x * x - y * y };
+
+    for (int c = 0; c < 3; ++c)
+    {
+        float sum = 0.0f;
+        for (int i = 0; i < 9; ++i)
+            sum += irradiance.coefficients[i][c] * basis[i];
+        color[c] = sum;
+    }
+}
+
+static float RadicalInverse(uint32_t bits)
+{
+    bits = (bits << 16u) | (bits >> 16u);
+    bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+    bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+    bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+    bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+    return static_cast<float>(bits) * 2.3283064365386963e-10f;
+}
+
+// GGX distributed half vector around +y (the normal), x and z are along the tangent and bitangent
+static void ImportanceSampleGGX(uint32_t i, uint32_t sampleCount, float roughness, float h[3])
+{
+    float a = roughness * roughness;
+    float phi = 2.0f * PI * (static_cast<float>(i) / sampleCount);
+    float xi = RadicalInverse(i);
+    float cosTheta = std::sqrt((1.0f - xi) / (1.0f + (a * a - 1.0f) * xi));
+    float sinTheta = std::sqrt(1.0f - cosTheta * cosTheta);
+
+    h[0] = std::cos(phi) * sinTheta;
+    h[1] = cosTheta;
+    h[2] = std::sin(phi) * sinTheta;
+}
+
+uint32_t GetPrefilteredSampleCount(const IBLBakeSettings& settings, uint32_t level)
+{
+    if (level == 0 || settings.prefilteredLevels < 2)
+        return 1;
+
+    // Geometric steps from the first rough level to the last, rounded up to whole groups of four
+    float t = settings.prefilteredLevels > 2 ? static_cast<float>(level - 1) / (settings.prefilteredLevels - 2) : 1.0f;
+    float count = settings.prefilteredMinSamples * std::pow(static_cast<float>(settings.prefilteredMaxSamples) / settings.prefilteredMinSamples, t);
+    return (static_cast<uint32_t>(std::ceil(count)) + 3u) & ~3u;
+}
+
+// Samples of one roughness level in the frame of the normal. With v = n every reflected direction, weight and source
+// mip is the same for all texels, so the table is built once per level. Every sample reads the mip whose texels cover
+// the solid angle the sample stands for (filtered importance sampling), which is what keeps small counts smooth.
+static void BuildPrefilterKernel(float roughness, uint32_t sampleCount, uint32_t environmentSize, HemisphereSamples& samples)
+{
+    // A smooth surface only reflects the normal direction
+    if (roughness == 0.0f)
+    {
+        samples.Add(0.0f, 0.0f, 1.0f, 0.0f, 1.0f);
+        return;
+    }
+
+    float texelSolidAngle = 4.0f * PI / (6.0f * environmentSize * environmentSize);
+    float roughnessSqr = (roughness > 0.01f ? roughness : 0.01f) * (roughness > 0.01f ? roughness : 0.01f);
+    for (uint32_t i = 0; i < sampleCount; ++i)
+    {
+        float h[3];
+        ImportanceSampleGGX(i, sampleCount, roughness, h);
+
+        float l[3] = { 2.0f * h[1] * h[0], 2.0f * h[1] * h[1] - 1.0f, 2.0f * h[1] * h[2] };
+        float ndotl = l[1];
+        if (ndotl <= 0.0f)
+            continue;
+
+        // The pdf of l is D(h) (n.h) / (4 (v.h)) and v.h = n.h here
+        float ndoth = h[1];
+        float d = ndoth * ndoth * (roughnessSqr - 1.0f) + 1.0f;
+        float distribution = roughnessSqr / (PI * d * d);
+        float pdf = distribution / 4.0f + 0.0001f;
+        float sampleSolidAngle = 1.0f / (sampleCount * pdf + 0.0001f);
+        samples.Add(l[0], l[2], l[1], 0.5f * std::log2(sampleSolidAngle / texelSolidAngle), ndotl);
+    }
+}
+
+// The kernel of a level padded for IntegrateHemisphere, returns the normalization of its weights
+static float BuildPrefilterLevel(const IBLBakeSettings& settings, uint32_t level, uint32_t environmentSize, HemisphereSamples& samples)
+{
+    float roughness = settings.prefilteredLevels > 1 ? static_cast<float>(level) / (settings.prefilteredLevels - 1) : 0.0f;
+    BuildPrefilterKernel(roughness, GetPrefilteredSampleCount(settings, level), environmentSize, samples);
+
+    float totalWeight = 0.0f;
+    for (float weight : samples.weight)
+        totalWeight += weight;
+    samples.Pad();
+    return 1.0f / totalWeight;
+}
+
+static void PrefilterRow(const CubeMap& environment, const HemisphereSamples& samples, float scale, CubeMap& prefilteredColor,
+    uint32_t level, uint32_t row)
+{
+    uint32_t size = prefilteredColor.GetSize(level);
+    uint32_t face = row / size;
+    uint32_t y = row % size;
+    float* texels = prefilteredColor.GetFace(face, level) + static_cast<size_t>(y) * size * 4;
+    for (uint32_t x = 0; x < size; ++x)
+    {
+        float normal[3];
+        CubeTexelDirection(face, x, y, size, normal);
+        (IntegrateHemisphere(environment, samples, normal) * SimdFloat4::Replicate(scale)).Store(texels + x * 4);
+        texels[x * 4 + 3] = 1.0f;
+    }
+}
+
+void BakePrefilteredColor(const CubeMap& environment, const IBLBakeSettings& settings, CubeMap& prefilteredColor, unsigned int threadCount)
+{
+    CPU_TRACE_SCOPE("BakePrefilteredColor");
+
+    prefilteredColor.Resize(settings.prefilteredSize, settings.prefilteredLevels);
+
+    for (uint32_t level = 0; level < settings.prefilteredLevels; ++level)
+    {
+        HemisphereSamples samples;
+        float scale = BuildPrefilterLevel(settings, level, environment.GetSize(), samples);
+
+        ParallelFor(6 * prefilteredColor.GetSize(level), threadCount, [&](uint32_t row)
+        {
+            PrefilterRow(environment, samples, scale, prefilteredColor, level, row);
+        });
+    }
+}
+
+static float SchlickGGX(float ndotv, float k)
+{
+    float value = ndotv > 0.0f ? ndotv : 0.0f;
+    return value / (value * (1.0f - k) + k);
+}
+
+static uint16_t ToUnorm16(float value)
+{
+    value = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+    return static_cast<uint16_t>(value * 65535.0f + 0.5f);
+}
+
+void FitPreintegratedBRDF(float ndotv, float roughness, float& scale, float& bias)
+{
+    const float c0[4] = { -1.0f, -0.0275f, -0.572f, 0.022f };
+    const float c1[4] = { 1.0f, 0.0425f, 1.04f, -0.04f };
+
+    float r[4];
+    for (int i = 0; i < 4; ++i)
+        r[i] = roughness * c0[i] + c1[i];
+
+    float falloff = std::exp2(-9.28f * ndotv);
+    float a004 = (r[0] * r[0] < falloff ? r[0] * r[0] : falloff) * r[0] + r[1];
+    scale = -1.04f * a004 + r[2];
+    bias = 1.04f * a004 + r[3];
+}
+
+void BakePreintegratedBRDF(const PreintegratedBRDFSettings& settings, std::vector<uint16_t>& lut, unsigned int threadCount)
+{
+    CPU_TRACE_SCOPE("BakePreintegratedBRDF");
+
+    uint32_t size = settings.size;
+    uint32_t sampleCount = settings.sampleCount;
+    lut.resize(static_cast<size_t>(size) * size * 2);
+
+    ParallelFor(size, threadCount, [&](uint32_t y)
+    {
+        float roughness = (y + 0.5f) / size;
+        uint16_t* texels = &lut[static_cast<size_t>(y) * size * 2];
+
+        if (settings.analyticFit)
+        {
+            for (uint32_t x = 0; x < size; ++x)
+            {
+                float scale, bias;
+                FitPreintegratedBRDF((x + 0.5f) / size, roughness, scale, bias);
+                texels[x * 2] = ToUnorm16(scale);
+                texels[x * 2 + 1] = ToUnorm16(bias);
+            }
+            return;
+        }
+
+        float k = roughness * roughness / 2.0f;
+
+        // Half vectors only depend on the row's roughness
+        std::vector<float> halfVectors(sampleCount * 3);
+        for (uint32_t i = 0; i < sampleCount; ++i)
+        {
+            float h[3];
+            ImportanceSampleGGX(i, sampleCount, roughness, h);
+            // The frame IntegrateBRDF built around n = +y has the tangent along -x and the bitangent along +z
+            halfVectors[i * 3] = -h[0];
+            halfVectors[i * 3 + 1] = h[1];
+            halfVectors[i * 3 + 2] = h[2];
+        }
+
+        for (uint32_t x = 0; x < size; ++x)
+        {
+            float ndotv = (x + 0.5f) / size;
+            float v[3] = { std::sqrt(1.0f - ndotv * ndotv), ndotv, 0.0f };
+
+            float a = 0.0f;
+            float b = 0.0f;
+            for (uint32_t i = 0; i < sampleCount; ++i)
+            {
+                const float* h = &halfVectors[i * 3];
+                float vdoth = v[0] * h[0] + v[1] * h[1] + v[2] * h[2];
+                float ndotl = 2.0f * vdoth * h[1] - v[1];
+                if (ndotl <= 0.0f)
+                    continue;
+
+                vdoth = vdoth > 0.0f ? vdoth : 0.0f;
+                float ndoth = h[1] > 0.0f ? h[1] : 0.0f;
+                float g = SchlickGGX(ndotv, k) * SchlickGGX(ndotl, k);
+                float gVis = g * vdoth / (ndoth * ndotv);
+                float fc = std::pow(1.0f - vdoth, 5.0f);
+                a += (1.0f - fc) * gVis;
+                b += fc * gVis;
+            }
+
+            texels[x * 2] = ToUnorm16(a / sampleCount);
+            texels[x * 2 + 1] = ToUnorm16(b / sampleCount);
+        }
+    });
+}
+
+static float MillisecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void BakeIBL(const CubeMap& environment, const IBLBakeSettings& settings, IBLBakeResult& result, IBLBakeTimings* timings, unsigned int threadCount)
+{
+    CPU_TRACE_SCOPE("BakeIBL");
+
+    IBLBakeTimings stageTimings = {};
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    ProjectIrradianceSH(environment, result.irradiance, threadCount);
+    stageTimings.irradiance = MillisecondsSince(start);
+
+    start = std::chrono::steady_clock::now();
+    BakePrefilteredColor(environment, settings, result.prefilteredColor, threadCount);
+    stageTimings.prefilteredColor = MillisecondsSince(start);
+
+    if (timings)
+        *timings = stageTimings;
+}
+
+IBLBakeJob::IBLBakeJob() :
+    m_finished(false),
+    m_step(0),
+    m_nextRow(0),
+    m_totalCost(0.0),
+    m_doneCost(0.0),
+    m_subsamples(1),
+    m_samplesScale(0.0f)
+{};
+
+void IBLBakeJob::Start(EnvironmentImage&& image, const IBLBakeSettings& settings)
+{
+    Reset();
+
+    m_settings = settings;
+    m_image = std::move(image);
+
+    uint32_t size = settings.cubeSize;
+    uint32_t mipLevels = GetCubeMipLevels(size);
+    m_environment.Resize(size, mipLevels);
+    m_result.prefilteredColor.Resize(settings.prefilteredSize, settings.prefilteredLevels);
+    m_subsamples = GetEquirectSubsamples(m_image, size);
+
+    // Solid angle tables are built as the mip below needs them, their corners cost two arc tangents per texel
+    m_steps.push_back({ IBL_BAKE_STAGE::ENVIRONMENT_CUBE, 0, 6 * size, static_cast<float>(size * m_subsamples * m_subsamples) });
+    for (uint32_t mip = 1; mip < mipLevels; ++mip)
+    {
+        uint32_t childSize = m_environment.GetSize(mip - 1);
+        m_steps.push_back({ IBL_BAKE_STAGE::TEXEL_SOLID_ANGLES, mip - 1, childSize, 2.0f * (childSize + 1) });
+        m_steps.push_back({ IBL_BAKE_STAGE::ENVIRONMENT_MIPS, mip, 6 * m_environment.GetSize(mip), static_cast<float>(m_environment.GetSize(mip)) });
+    }
+    if (mipLevels == 1)
+        m_steps.push_back({ IBL_BAKE_STAGE::TEXEL_SOLID_ANGLES, 0, size, 2.0f * (size + 1) });
+    m_steps.push_back({ IBL_BAKE_STAGE::IRRADIANCE, 0, 6 * size, static_cast<float>(size) });
+    for (uint32_t level = 0; level < settings.prefilteredLevels; ++level)
+    {
+        uint32_t levelSize = m_result.prefilteredColor.GetSize(level);
+        m_steps.push_back({ IBL_BAKE_STAGE::PREFILTERED_COLOR, level, 6 * levelSize,
+            static_cast<float>(levelSize * GetPrefilteredSampleCount(settings, level)) });
+    }
+
+    for (const Step& step : m_steps)
+        m_totalCost += static_cast<double>(step.rowCount) * step.rowCost;
+
+    BeginStep();
+}
+
+void IBLBakeJob::Reset()
+{
+    m_image = EnvironmentImage();
+    m_environment = CubeMap();
+    m_result = IBLBakeResult();
+    m_finished = false;
+
+    m_steps.clear();
+    m_step = 0;
+    m_nextRow = 0;
+    m_totalCost = 0.0;
+    m_doneCost = 0.0;
+
+    m_topSolidAngles.clear();
+    m_mipSolidAngles.clear();
+    m_irradianceRowSums.clear();
+    m_pSamples.reset();
+}
+
+float IBLBakeJob::GetProgress() const
+{
+    if (m_finished)
+        return 1.0f;
+    return m_totalCost > 0.0 ? static_cast<float>(m_doneCost / m_totalCost) : 0.0f;
+}
+
+void IBLBakeJob::BeginStep()
+{
+    const Step& step = m_steps[m_step];
+    switch (step.stage)
+    {
+    case IBL_BAKE_STAGE::TEXEL_SOLID_ANGLES:
+    {
+        std::vector<float>& solidAngles = step.level == 0 ? m_topSolidAngles : m_mipSolidAngles;
+        solidAngles.resize(static_cast<size_t>(step.rowCount) * step.rowCount);
+        break;
+    }
+    case IBL_BAKE_STAGE::IRRADIANCE:
+        m_irradianceRowSums.resize(static_cast<size_t>(step.rowCount) * 9 * 4);
+        break;
+    case IBL_BAKE_STAGE::PREFILTERED_COLOR:
+        m_pSamples.reset(new HemisphereSamples());
+        m_samplesScale = BuildPrefilterLevel(m_settings, step.level, m_environment.GetSize(), *m_pSamples);
+        break;
+    default:
+        break;
+    }
+}
+
+void IBLBakeJob::EndStep()
+{
+    const Step& step = m_steps[m_step];
+    switch (step.stage)
+    {
+    case IBL_BAKE_STAGE::ENVIRONMENT_CUBE:
+        m_image = EnvironmentImage();
+        break;
+    case IBL_BAKE_STAGE::IRRADIANCE:
+        SumIrradianceRows(m_irradianceRowSums, step.rowCount, m_result.irradiance);
+        m_irradianceRowSums = std::vector<float>();
+        m_topSolidAngles = std::vector<float>();
+        m_mipSolidAngles = std::vector<float>();
+        break;
+    default:
+        break;
+    }
+}
+
+uint32_t IBLBakeJob::Run(uint32_t rowCount, unsigned int threadCount)
+{
+    if (!IsRunning())
+        return 0;
+
+    const Step& step = m_steps[m_step];
+    uint32_t remainingRows = step.rowCount - m_nextRow;
+    rowCount = rowCount < remainingRows ? rowCount : remainingRows;
+    uint32_t firstRow = m_nextRow;
+
+    ParallelFor(rowCount, threadCount, [&](uint32_t i)
+    {
+        uint32_t row = firstRow + i;
+        switch (step.stage)
+        {
+        case IBL_BAKE_STAGE::ENVIRONMENT_CUBE:
+            ConvertEquirectRow(m_image, m_subsamples, m_environment, row);
+            break;
+        case IBL_BAKE_STAGE::TEXEL_SOLID_ANGLES:
+        {
+            std::vector<float>& solidAngles = step.level == 0 ? m_topSolidAngles : m_mipSolidAngles;
+            TexelSolidAngleRow(step.rowCount, row, &solidAngles[static_cast<size_t>(row) * step.rowCount]);
+            break;
+        }
+        case IBL_BAKE_STAGE::ENVIRONMENT_MIPS:
+            DownsampleCubeRow(m_environment, step.level, step.level == 1 ? m_topSolidAngles : m_mipSolidAngles, row);
+            break;
+        case IBL_BAKE_STAGE::IRRADIANCE:
+            ProjectIrradianceRow(m_environment, m_topSolidAngles, row, &m_irradianceRowSums[static_cast<size_t>(row) * 9 * 4]);
+            break;
+        case IBL_BAKE_STAGE::PREFILTERED_COLOR:
+            PrefilterRow(m_environment, *m_pSamples, m_samplesScale, m_result.prefilteredColor, step.level, row);
+            break;
+        default:
+            break;
+        }
+    });
+
+    m_nextRow += rowCount;
+    m_doneCost += static_cast<double>(rowCount) * step.rowCost;
+    if (m_nextRow == step.rowCount)
+    {
+        EndStep();
+        ++m_step;
+        m_nextRow = 0;
+        if (IsRunning())
+            BeginStep();
+        else
+            m_finished = true;
+    }
+    return rowCount;
+}
+
+bool IBLBakeJob::TakeResult(CubeMap& environment, IBLBakeResult& result)
+{
+    if (!m_finished)
+        return false;
+
+    environment = std::move(m_environment);
+    result = std::move(m_result);
+    Reset();
+    return true;
+}
+
+IBLBakeJob::~IBLBakeJob()
+{};
+
+uint64_t ComputeIBLBakeKey(const void* environmentFile, size_t size, const IBLBakeSettings& settings)
+{
+    uint64_t hash = HashShaderBytes(environmentFile, size);
+    hash = HashShaderBytes(&settings, sizeof(settings), hash);
+    hash = HashShaderBytes(&iblCacheVersion, sizeof(iblCacheVersion), hash);
+    return hash;
+}
+
+IBLBakeCache::IBLBakeCache(const std::string& directory) :
+    m_directory(CreateCacheDirectory(directory))
+{};
+
+std::string IBLBakeCache::GetPath(uint64_t key) const
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.ibl", static_cast<unsigned long long>(key));
+    return m_directory + name;
+}
+
+static uint64_t GetBakeSize(const IBLBakeResult& result)
+{
+    return sizeof(result.irradiance) + result.prefilteredColor.GetData().size() * sizeof(float);
+}
+
+bool IBLBakeCache::Load(uint64_t key, const IBLBakeSettings& settings, IBLBakeResult& result) const
+{
+    std::ifstream file(GetPath(key), std::ios::in | std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    IBLBakeCacheHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+        return false;
+
+    if (header.magic != iblCacheMagic || header.version != iblCacheVersion || header.key != key ||
+        memcmp(&header.settings, &settings, sizeof(settings)) != 0)
+        return false;
+
+    result.prefilteredColor.Resize(settings.prefilteredSize, settings.prefilteredLevels);
+    if (header.size != GetBakeSize(result))
+        return false;
+
+    std::vector<float, UninitializedAllocator<float>>& prefilteredColor = result.prefilteredColor.GetData();
+    if (!file.read(reinterpret_cast<char*>(&result.irradiance), sizeof(result.irradiance)) ||
+        !file.read(reinterpret_cast<char*>(prefilteredColor.data()), prefilteredColor.size() * sizeof(float)))
+        return false;
+
+    return file.peek() == std::ifstream::traits_type::eof();
+}
+
+bool IBLBakeCache::Store(uint64_t key, const IBLBakeSettings& settings, const IBLBakeResult& result) const
+{
+    IBLBakeCacheHeader header = {};
+    header.magic = iblCacheMagic;
+    header.version = iblCacheVersion;
+    header.key = key;
+    header.settings = settings;
+    header.size = GetBakeSize(result);
+
+    const std::vector<float, UninitializedAllocator<float>>& prefilteredColor = result.prefilteredColor.GetData();
+    CacheFileChunk chunks[] =
+    {
+        { &header, sizeof(header) },
+        { &result.irradiance, sizeof(result.irradiance) },
+        { prefilteredColor.data(), prefilteredColor.size() * sizeof(float) }
+    };
+    return WriteCacheFile(GetPath(key), chunks, 3);
+}
+
+static uint64_t ComputeBRDFKey(const PreintegratedBRDFSettings& settings)
+{
+    uint64_t hash = HashShaderBytes(&brdfCacheMagic, sizeof(brdfCacheMagic));
+    hash = HashShaderBytes(&settings, sizeof(settings), hash);
+    hash = HashShaderBytes(&iblCacheVersion, sizeof(iblCacheVersion), hash);
+    return hash;
+}
+
+bool IBLBakeCache::Load(const PreintegratedBRDFSettings& settings, std::vector<uint16_t>& lut) const
+{
+    uint64_t key = ComputeBRDFKey(settings);
+    std::ifstream file(GetPath(key), std::ios::in | std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    PreintegratedBRDFCacheHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+        return false;
+
+    lut.resize(static_cast<size_t>(settings.size) * settings.size * 2);
+    if (header.magic != brdfCacheMagic || header.version != iblCacheVersion || header.key != key ||
+        memcmp(&header.settings, &settings, sizeof(settings)) != 0 || header.size != lut.size() * sizeof(uint16_t))
+        return false;
+
+    if (!file.read(reinterpret_cast<char*>(lut.data()), lut.size() * sizeof(uint16_t)))
+        return false;
+
+    return file.peek() == std::ifstream::traits_type::eof();
+}
+
+bool IBLBakeCache::Store(const PreintegratedBRDFSettings& settings, const std::vector<uint16_t>& lut) const
+{
+    uint64_t key = ComputeBRDFKey(settings);
+
+    PreintegratedBRDFCacheHeader header = {};
+    header.magic = brdfCacheMagic;
+    header.version = iblCacheVersion;
+    header.key = key;
+    header.settings = settings;
+    header.size = lut.size() * sizeof(uint16_t);
+
+    CacheFileChunk chunks[] = { { &header, sizeof(header) }, { lut.data(), lut.size() * sizeof(uint16_t) } };
+    return WriteCacheFile(GetPath(key), chunks, 2);
+}
+
+IBLBakeCache::~IBLBakeCache()
+{};
@@ -0,0 +1,247 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Leaves elements added by resize uninitialized, for buffers that are written in full right after they are sized
+template <typename T>
+struct UninitializedAllocator : std::allocator<T>
+{
+    template <typename U>
+    struct rebind
+    {
+        typedef UninitializedAllocator<U> other;
+    };
+
+    UninitializedAllocator() = default;
+    template <typename U>
+    UninitializedAllocator(const UninitializedAllocator<U>&) {};
+
+    template <typename U>
+    void construct(U* p) { ::new (static_cast<void*>(p)) U; };
+    template <typename U, typename... Args>
+    void construct(U* p, Args&&... args) { ::new (static_cast<void*>(p)) U(std::forward<Args>(args)...); };
+};
+
+// Equirectangular RGBA float image, rows from the top. The pixels of a large image take long to clear, the decoder
+// writes them without that.
+struct EnvironmentImage
+{
+    uint32_t                                         width;
+    uint32_t                                         height;
+    std::vector<float, UninitializedAllocator<float>> pixels;
+};
+
+// RGBA float cube map with a mip chain. Faces are ordered +X, -X, +Y, -Y, +Z, -Z as in D3D, texel (0, 0) of a face
+// is its top left corner. Data is laid out by subresources (all mips of face 0, then face 1, ...), ready for upload.
+class CubeMap
+{
+public:
+    CubeMap();
+    ~CubeMap();
+
+    // New texels are left uninitialized, every baker writes all of them
+    void Resize(uint32_t size, uint32_t mipLevels);
+
+    uint32_t GetSize(uint32_t mip = 0) const { return m_size >> mip; };
+    uint32_t GetMipLevels() const { return m_mipLevels; };
+
+    float* GetFace(uint32_t face, uint32_t mip) { return m_data.data() + GetOffset(face, mip); };
+    const float* GetFace(uint32_t face, uint32_t mip) const { return m_data.data() + GetOffset(face, mip); };
+
+    std::vector<float, UninitializedAllocator<float>>& GetData() { return m_data; };
+    const std::vector<float, UninitializedAllocator<float>>& GetData() const { return m_data; };
+
+private:
+    size_t GetOffset(uint32_t face, uint32_t mip) const { return m_faceFloats * face + m_mipOffsets[mip]; };
+
+    uint32_t                                          m_size;
+    uint32_t                                          m_mipLevels;
+    size_t                                            m_faceFloats;
+    std::vector<size_t>                               m_mipOffsets;
+    std::vector<float, UninitializedAllocator<float>> m_data;
+};
+
+// Unit direction through the center of texel (x, y) of a face with the given size
+void CubeTexelDirection(uint32_t face, uint32_t x, uint32_t y, uint32_t size, float direction[3]);
+
+// Bilinear sample of one mip filtered across the face edges like a seamless cube, direction doesn't have to be normalized
+void SampleCube(const CubeMap& cube, const float direction[3], uint32_t mip, float color[4]);
+// Trilinear sample, the level is clamped to the mip chain
+void SampleCubeLevel(const CubeMap& cube, const float direction[3], float level, float color[4]);
+
+// Bilinear sample with wrapping at u = 1 - atan2(z, x) / 2pi, v = 0.5 - asin(y) / pi (the lookup the GPU conversion made)
+void SampleEquirect(const EnvironmentImage& image, const float direction[3], float color[4]);
+
+// Diffuse environment lighting as L2 spherical harmonics, nine RGB coefficients padded to four floats
+// (the layout of IrradianceConstantBuffer). The cosine lobe convolution, the 1 / pi of a Lambertian surface and the
+// basis constants are folded in, so the irradiance is the polynomial EvaluateIrradianceSH and the shaders compute:
+// c0 + c1 y + c2 z + c3 x + c4 xy + c5 yz + c6 (3z^2 - 1) + c7 xz + c8 (x^2 - y^2)
+struct IrradianceSH
+{
+    float coefficients[9][4];
+};
+
+// Sizes and sample counts of the baked resources
+struct IBLBakeSettings
+{
+    uint32_t cubeSize              = 512;
+    uint32_t prefilteredSize       = 128;
+    // Roughness levels, at most log2(prefilteredSize) + 1
+    uint32_t prefilteredLevels     = 5;
+    // Samples of the first rough level and of the roughest one, see GetPrefilteredSampleCount
+    uint32_t prefilteredMinSamples = 512;
+    uint32_t prefilteredMaxSamples = 1024;
+};
+
+struct IBLBakeResult
+{
+    IrradianceSH       irradiance;
+    // Level i holds roughness i / (prefilteredLevels - 1)
+    CubeMap            prefilteredColor;
+};
+
+// Milliseconds spent on every stage of a bake
+struct IBLBakeTimings
+{
+    float irradiance;
+    float prefilteredColor;
+};
+
+// The split sum lookup table doesn't depend on the environment, it is baked and cached on its own
+struct PreintegratedBRDFSettings
+{
+    uint32_t size        = 128;
+    uint32_t sampleCount = 1024;
+    // Nonzero fills the table from the analytic fit of FitPreintegratedBRDF instead of integrating it
+    uint32_t analyticFit = 0;
+};
+
+// The bakers split their texels between worker threads, 0 threads means one per hardware thread
+
+// Environment cube of the given size with a full mip chain. The top level is bilinear from the image, averaged over
+// the texel area when the image has more detail than the cube. Every further level is the solid angle weighted
+// average of the texels below it, so the mean radiance over any texel and the total over the sphere are kept.
+void EquirectToCube(const EnvironmentImage& image, uint32_t size, CubeMap& cube, unsigned int threadCount = 0);
+// Projects the top mip of the environment, every texel weighted by its exact solid angle
+void ProjectIrradianceSH(const CubeMap& environment, IrradianceSH& irradiance, unsigned int threadCount = 0);
+// Irradiance divided by pi around a unit normal, what the shaders evaluate
+void EvaluateIrradianceSH(const IrradianceSH& irradiance, const float normal[3], float color[3]);
+// Samples taken per texel of a prefiltered level: one for the mirror level, then geometric steps from
+// prefilteredMinSamples to prefilteredMaxSamples. The first rough level has most of the texels and so most of the cost,
+// the rough levels are small and lose part of their samples below the horizon.
+uint32_t GetPrefilteredSampleCount(const IBLBakeSettings& settings, uint32_t level);
+// GGX importance sampled radiance with the solid angle mip selection, v = n = r
+void BakePrefilteredColor(const CubeMap& environment, const IBLBakeSettings& settings, CubeMap& prefilteredColor, unsigned int threadCount = 0);
+// Split sum scale and bias of F0 as RG pairs of 16-bit unorms (R16G16_UNORM), x is dot(n, v) and y the roughness
+void BakePreintegratedBRDF(const PreintegratedBRDFSettings& settings, std::vector<uint16_t>& lut, unsigned int threadCount = 0);
+// Karis' fit of the split sum for mobile (Physically Based Shading on Mobile, 2014). It is coarse: off by 0.035 on average
+// and by up to 0.3 at grazing angles of rough surfaces.
+void FitPreintegratedBRDF(float ndotv, float roughness, float& scale, float& bias);
+
+// The environment is an EquirectToCube result of settings.cubeSize
+void BakeIBL(const CubeMap& environment, const IBLBakeSettings& settings, IBLBakeResult& result, IBLBakeTimings* timings = nullptr,
+    unsigned int threadCount = 0);
+
+enum class IBL_BAKE_STAGE
+{
+    ENVIRONMENT_CUBE = 0,
+    TEXEL_SOLID_ANGLES,
+    ENVIRONMENT_MIPS,
+    IRRADIANCE,
+    PREFILTERED_COLOR,
+    COUNT
+};
+
+struct HemisphereSamples;
+
+// EquirectToCube followed by BakeIBL, split into rows so that a new environment can be baked a little at a time
+// (see IBLBakeScheduler). The steps are the top level of the cube, the solid angle table and then every further mip,
+// the irradiance projection and every prefiltered level. Rows of a step are independent of each other, and running
+// all of them gives exactly the data of the two functions.
+class IBLBakeJob
+{
+public:
+    IBLBakeJob();
+    ~IBLBakeJob();
+
+    // Drops a bake in progress
+    void Start(EnvironmentImage&& image, const IBLBakeSettings& settings);
+    void Reset();
+
+    bool IsRunning() const { return m_step < m_steps.size(); };
+    bool IsFinished() const { return m_finished; };
+
+    IBL_BAKE_STAGE GetStage() const { return m_steps[m_step].stage; };
+    uint32_t GetRemainingRows() const { return m_steps[m_step].rowCount - m_nextRow; };
+    // Texels times samples per texel of a row of the current step, and the share of all of them that has been run
+    float GetRowCost() const { return m_steps[m_step].rowCost; };
+    float GetProgress() const;
+
+    // Runs up to rowCount rows of the current step and moves on when it is done, returns the rows run
+    uint32_t Run(uint32_t rowCount, unsigned int threadCount = 0);
+
+    // Moves the data of a finished bake out
+    bool TakeResult(CubeMap& environment, IBLBakeResult& result);
+
+private:
+    struct Step
+    {
+        IBL_BAKE_STAGE stage;
+        uint32_t       level;
+        uint32_t       rowCount;
+        float          rowCost;
+    };
+
+    void BeginStep();
+    void EndStep();
+
+    IBLBakeSettings   m_settings;
+    EnvironmentImage  m_image;
+    CubeMap           m_environment;
+    IBLBakeResult     m_result;
+    bool              m_finished;
+
+    std::vector<Step> m_steps;
+    size_t            m_step;
+    uint32_t          m_nextRow;
+    double            m_totalCost;
+    double            m_doneCost;
+
+    // Shared by the rows of the steps. The top level's solid angles weight both its first mip and the irradiance.
+    uint32_t                           m_subsamples;
+    std::vector<float>                 m_topSolidAngles;
+    std::vector<float>                 m_mipSolidAngles;
+    std::vector<float>                 m_irradianceRowSums;
+    std::unique_ptr<HemisphereSamples> m_pSamples;
+    float                              m_samplesScale;
+};
+
+// Key of a bake: the environment file contents together with the settings
+uint64_t ComputeIBLBakeKey(const void* environmentFile, size_t size, const IBLBakeSettings& settings);
+
+// Bakes stored on disk, one file per key. Files are written under a temporary name and renamed (as the shader cache does),
+// files with another key, other settings or a wrong size are treated as misses.
+class IBLBakeCache
+{
+public:
+    explicit IBLBakeCache(const std::string& directory);
+    ~IBLBakeCache();
+
+    bool Load(uint64_t key, const IBLBakeSettings& settings, IBLBakeResult& result) const;
+    bool Store(uint64_t key, const IBLBakeSettings& settings, const IBLBakeResult& result) const;
+
+    // The BRDF table is keyed by its settings alone
+    bool Load(const PreintegratedBRDFSettings& settings, std::vector<uint16_t>& lut) const;
+    bool Store(const PreintegratedBRDFSettings& settings, const std::vector<uint16_t>& lut) const;
+
+    std::string GetPath(uint64_t key) const;
+
+private:
+    std::string m_directory;
+};
@@ -0,0 +1,250 @@
+#include "LightClusters.h"
+
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <thread>
+
+// Below this many lights the bounds are computed on the calling thread only
+const uint32_t parallelLightCount = 256;
+
+LightClusterBuilder::LightClusterBuilder() :
+    m_grid(),
+    m_sliceScale(0.0f)
+{};
+
+void LightClusterBuilder::SetGrid(const LightClusterGrid& grid)
+{
+    m_grid = grid;
+
+    // Unit normals point towards the growing tile index, x to the right and y down the screen
+    m_planesX.resize((grid.tilesX + 1) * 2);
+    for (uint32_t i = 0; i <= grid.tilesX; ++i)
+    {
+        float tangent = (-1.0f + 2.0f * i / grid.tilesX) * grid.tanHalfFovX;
+        float length = std::sqrt(1.0f + tangent * tangent);
+        m_planesX[i * 2] = 1.0f / length;
+        m_planesX[i * 2 + 1] = -tangent / length;
+    }
+
+    m_planesY.resize((grid.tilesY + 1) * 2);
+    for (uint32_t i = 0; i <= grid.tilesY; ++i)
+    {
+        float tangent = (1.0f - 2.0f * i / grid.tilesY) * grid.tanHalfFovY;
+        float length = std::sqrt(1.0f + tangent * tangent);
+        m_planesY[i * 2] = -1.0f / length;
+        m_planesY[i * 2 + 1] = tangent / length;
+    }
+
+    m_sliceDepths.resize(grid.slices + 1);
+    for (uint32_t i = 0; i <= grid.slices; ++i)
+        m_sliceDepths[i] = grid.nearDistance * std::pow(grid.farDistance / grid.nearDistance, static_cast<float>(i) / grid.slices);
+    m_sliceDepths[0] = 0.0f;
+    m_sliceScale = grid.slices / std::log(grid.farDistance / grid.nearDistance);
+
+    m_clusters.assign(GetClusterCount(), { 0, 0 });
+}
+
+bool LightClusterBuilder::IsLightInCluster(const Float3& viewPosition, float range, uint32_t x, uint32_t y, uint32_t slice) const
+{
+    if (viewPosition.z + range < m_sliceDepths[slice] || viewPosition.z - range > m_sliceDepths[slice + 1])
+        return false;
+
+    const float* left = &m_planesX[x * 2];
+    if (left[0] * viewPosition.x + left[1] * viewPosition.z < -range || left[2] * viewPosition.x + left[3] * viewPosition.z > range)
+        return false;
+
+    const float* top = &m_planesY[y * 2];
+    if (top[0] * viewPosition.y + top[1] * viewPosition.z < -range || top[2] * viewPosition.y + top[3] * viewPosition.z > range)
+        return false;
+
+    return true;
+}
+
+uint32_t LightClusterBuilder::GetSlice(float depth) const
+{
+    if (depth <= m_grid.nearDistance)
+        return 0;
+
+    float slice = std::log(depth / m_grid.nearDistance) * m_sliceScale;
+    return std::min(static_cast<uint32_t>(slice), m_grid.slices - 1);
+}
+
+bool LightClusterBuilder::GetLightBounds(const Float3& viewPosition, float range, LightBounds& bounds) const
+{
+    // Slices, tile columns and tile rows are tested separately. Slices touched by a sphere are contiguous,
+    // tiles aren't when the sphere reaches behind the camera, so they are kept as masks.
+    if (viewPosition.z + range < 0.0f || viewPosition.z - range > m_sliceDepths[m_grid.slices])
+        return false;
+
+    // Slice guesses from the depth are corrected with the same comparisons IsLightInCluster makes
+    bounds.minSlice = GetSlice(viewPosition.z - range);
+    while (bounds.minSlice > 0 && viewPosition.z - range <= m_sliceDepths[bounds.minSlice])
+        --bounds.minSlice;
+    while (viewPosition.z - range > m_sliceDepths[bounds.minSlice + 1])
+        ++bounds.minSlice;
+
+    bounds.maxSlice = GetSlice(viewPosition.z + range);
+    while (bounds.maxSlice + 1 < m_grid.slices && viewPosition.z + range >= m_sliceDepths[bounds.maxSlice + 1])
+        ++bounds.maxSlice;
+    while (viewPosition.z + range < m_sliceDepths[bounds.maxSlice])
+        --bounds.maxSlice;
+
+    bounds.maskX = 0;
+    for (uint32_t x = 0; x < m_grid.tilesX; ++x)
+    {
+        const float* left = &m_planesX[x * 2];
+        if (left[0] * viewPosition.x + left[1] * viewPosition.z < -range || left[2] * viewPosition.x + left[3] * viewPosition.z > range)
+            continue;
+        if (bounds.maskX == 0)
+            bounds.minX = x;
+        bounds.maxX = x;
+        bounds.maskX |= 1u << x;
+    }
+
+    bounds.maskY = 0;
+    for (uint32_t y = 0; y < m_grid.tilesY; ++y)
+    {
+        const float* top = &m_planesY[y * 2];
+        if (top[0] * viewPosition.y + top[1] * viewPosition.z < -range || top[2] * viewPosition.y + top[3] * viewPosition.z > range)
+            continue;
+        if (bounds.maskY == 0)
+            bounds.minY = y;
+        bounds.maxY = y;
+        bounds.maskY |= 1u << y;
+    }
+
+    return bounds.maskX != 0 && bounds.maskY != 0;
+}
+
+void LightClusterBuilder::Build(const PointLight* lights, uint32_t lightCount, const float view[4][4], unsigned int threadCount)
+{
+    if (threadCount == 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+    m_viewPositions.resize(lightCount);
+    m_bounds.resize(lightCount);
+    std::vector<uint8_t> visible(lightCount);
+
+    // Lights are moved to view space and bounded in chunks, one per thread
+    auto boundLights = [&](uint32_t first, uint32_t last)
+    {
+        for (uint32_t i = first; i < last; ++i)
+        {
+            const Float3& p = lights[i].position;
+            Float3& v = m_viewPositions[i];
+            v.x = p.x * view[0][0] + p.y * view[1][0] + p.z * view[2][0] + view[3][0];
+            v.y = p.x * view[0][1] + p.y * view[1][1] + p.z * view[2][1] + view[3][1];
+            v.z = p.x * view[0][2] + p.y * view[1][2] + p.z * view[2][2] + view[3][2];
+            visible[i] = GetLightBounds(v, lights[i].range, m_bounds[i]) ? 1 : 0;
+        }
+    };
+
+    unsigned int lightThreads = lightCount < parallelLightCount ? 1 : threadCount;
+    std::vector<std::future<void>> tasks;
+    uint32_t chunk = (lightCount + lightThreads - 1) / lightThreads;
+    for (unsigned int t = 1; t < lightThreads; ++t)
+    {
+        uint32_t first = std::min(lightCount, t * chunk);
+        uint32_t last = std::min(lightCount, first + chunk);
+        tasks.push_back(std::async(std::launch::async, boundLights, first, last));
+    }
+    boundLights(0, std::min(lightCount, chunk));
+    for (std::future<void>& task : tasks)
+        task.get();
+    tasks.clear();
+
+    m_visibleLights.clear();
+    for (uint32_t i = 0; i < lightCount; ++i)
+    {
+        if (visible[i])
+            m_visibleLights.push_back(i);
+    }
+
+    // Every thread fills the clusters of its own slices, the index lists are joined afterwards
+    unsigned int sliceThreads = std::min(threadCount, m_grid.slices);
+    if (m_visibleLights.size() < parallelLightCount)
+        sliceThreads = 1;
+
+    std::vector<std::vector<uint32_t>> indices(sliceThreads);
+    std::vector<uint32_t> firstSlices(sliceThreads + 1);
+    for (unsigned int t = 0; t <= sliceThreads; ++t)
+        firstSlices[t] = m_grid.slices * t / sliceThreads;
+
+    for (unsigned int t = 1; t < sliceThreads; ++t)
+        tasks.push_back(std::async(std::launch::async, &LightClusterBuilder::BuildSlices, this, firstSlices[t], firstSlices[t + 1], std::ref(indices[t])));
+    BuildSlices(firstSlices[0], firstSlices[1], indices[0]);
+    for (std::future<void>& task : tasks)
+        task.get();
+
+    size_t indexCount = 0;
+    for (const std::vector<uint32_t>& threadIndices : indices)
+        indexCount += threadIndices.size();
+
+    m_indices.resize(indexCount);
+    uint32_t offset = 0;
+    uint32_t tileCount = m_grid.tilesX * m_grid.tilesY;
+    for (unsigned int t = 0; t < sliceThreads; ++t)
+    {
+        std::copy(indices[t].begin(), indices[t].end(), m_indices.begin() + offset);
+        for (uint32_t cluster = firstSlices[t] * tileCount; cluster < firstSlices[t + 1] * tileCount; ++cluster)
+            m_clusters[cluster].offset += offset;
+        offset += static_cast<uint32_t>(indices[t].size());
+    }
+}
+
+void LightClusterBuilder::BuildSlices(uint32_t firstSlice, uint32_t lastSlice, std::vector<uint32_t>& indices)
+{
+    uint32_t tileCount = m_grid.tilesX * m_grid.tilesY;
+    LightClusterRange* clusters = m_clusters.data() + firstSlice * tileCount;
+    uint32_t clusterCount = (lastSlice - firstSlice) * tileCount;
+
+    for (uint32_t i = 0; i < clusterCount; ++i)
+        clusters[i] = { 0, 0 };
+
+    // Counts first, then the lights are written in their order into the prefix summed ranges
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        for (uint32_t light : m_visibleLights)
+        {
+            const LightBounds& bounds = m_bounds[light];
+            uint32_t minSlice = std::max(bounds.minSlice, firstSlice);
+            uint32_t maxSlice = std::min(bounds.maxSlice + 1, lastSlice);
+            for (uint32_t slice = minSlice; slice < maxSlice; ++slice)
+            {
+                for (uint32_t y = bounds.minY; y <= bounds.maxY; ++y)
+                {
+                    if (!(bounds.maskY & (1u << y)))
+                        continue;
+
+                    LightClusterRange* row = clusters + ((slice - firstSlice) * m_grid.tilesY + y) * m_grid.tilesX;
+                    for (uint32_t x = bounds.minX; x <= bounds.maxX; ++x)
+                    {
+                        if (!(bounds.maskX & (1u << x)))
+                            continue;
+
+                        if (pass == 0)
+                            ++row[x].count;
+                        else
+                            indices[row[x].offset + row[x].count++] = light;
+                    }
+                }
+            }
+        }
+
+        if (pass == 0)
+        {
+            uint32_t offset = 0;
+            for (uint32_t i = 0; i < clusterCount; ++i)
+            {
+                clusters[i].offset = offset;
+                offset += clusters[i].count;
+                clusters[i].count = 0;
+            }
+            indices.resize(offset);
+        }
+    }
+}
+
+LightClusterBuilder::~LightClusterBuilder()
+{};
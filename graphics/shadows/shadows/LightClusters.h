@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Bounds.h"
+
+// Same layout as PointLight in PBRShaders.fx
+struct PointLight
+{
+    Float3 position;
+    float  range;
+    Float3 color;
+    float  intensity;
+};
+
+// Clusters (froxels) split the view frustum into screen tiles and exponential depth slices.
+// There are at most 32 tiles along x and y. Tile (0, 0) is the top left one, slice k covers view depths nearDistance * (farDistance / nearDistance)^(k / slices)
+// to the next one, except the first one, which starts at the camera.
+struct LightClusterGrid
+{
+    uint32_t tilesX;
+    uint32_t tilesY;
+    uint32_t slices;
+    float    nearDistance;
+    float    farDistance;
+    float    tanHalfFovX;
+    float    tanHalfFovY;
+};
+
+struct LightClusterRange
+{
+    uint32_t offset;
+    uint32_t count;
+};
+
+// Assigns point lights to the clusters they touch. Every cluster gets a range of a compact index list,
+// ranges of the clusters are ordered as (slice * tilesY + y) * tilesX + x.
+class LightClusterBuilder
+{
+public:
+    LightClusterBuilder();
+    ~LightClusterBuilder();
+
+    void SetGrid(const LightClusterGrid& grid);
+    const LightClusterGrid& GetGrid() const { return m_grid; };
+    uint32_t GetClusterCount() const { return m_grid.tilesX * m_grid.tilesY * m_grid.slices; };
+
+    // View is row-major with the row vector convention (as DirectXMath) and looks along +z.
+    // Slices are split between the worker threads, 0 threads means one per hardware thread.
+    void Build(const PointLight* lights, uint32_t lightCount, const float view[4][4], unsigned int threadCount = 0);
+
+    const std::vector<LightClusterRange>& GetClusters() const { return m_clusters; };
+    const std::vector<uint32_t>& GetIndices() const { return m_indices; };
+
+    // Exact test the builder uses, the light position is in view space
+    bool IsLightInCluster(const Float3& viewPosition, float range, uint32_t x, uint32_t y, uint32_t slice) const;
+
+    float GetSliceDepth(uint32_t slice) const { return m_sliceDepths[slice]; };
+
+private:
+    // Tile columns and rows one light touches as bit masks with their first and last set bits, its slices as a range
+    struct LightBounds
+    {
+        uint32_t maskX;
+        uint32_t maskY;
+        uint32_t minX, maxX;
+        uint32_t minY, maxY;
+        uint32_t minSlice, maxSlice;
+    };
+
+    uint32_t GetSlice(float depth) const;
+    bool GetLightBounds(const Float3& viewPosition, float range, LightBounds& bounds) const;
+    void BuildSlices(uint32_t firstSlice, uint32_t lastSlice, std::vector<uint32_t>& indices);
+
+    LightClusterGrid m_grid;
+
+    // Planes through the camera between the tiles, as (normal x or y, normal z) of unit normals
+    std::vector<float> m_planesX;
+    std::vector<float> m_planesY;
+    std::vector<float> m_sliceDepths;
+    float              m_sliceScale;
+
+    std::vector<Float3>      m_viewPositions;
+    std::vector<LightBounds> m_bounds;
+    std::vector<uint32_t>    m_visibleLights;
+
+    std::vector<LightClusterRange> m_clusters;
+    std::vector<uint32_t>          m_indices;
+};
@@ -0,0 +1 @@
+#include "LuminanceHistogramShaders.fx"
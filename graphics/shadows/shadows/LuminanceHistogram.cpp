@@ -0,0 +1,84 @@
+#include "LuminanceHistogram.h"
+
+#include <cmath>
+#include <cstring>
+
+// The start of the bins, 2^-16, and its bits
+const float minimumLuminance = 1.0f / 65536.0f;
+const uint32_t minimumBits = 0x37800000;
+// The exponent starts at bit 23, the bins keep 4 mantissa bits below it
+const uint32_t binShift = 19;
+// Fixed point steps of the bin weights. log(2^16 + 1) takes 24 bits, the shader multiplies them as 32-bit values.
+const float weightScale = 1048576.0f;
+
+static_assert(LUMINANCE_HISTOGRAM_BINS_PER_OCTAVE == 1u << (23 - binShift), "the shift keeps log2 of the bins per octave mantissa bits");
+static_assert(LUMINANCE_HISTOGRAM_BINS == 32 * LUMINANCE_HISTOGRAM_BINS_PER_OCTAVE, "the bins span 2^-16 to 2^16");
+
+float ComputeLuminance(float r, float g, float b)
+{
+    float luminance = 0.2126f * r;
+    luminance += 0.7151f * g;
+    luminance += 0.0722f * b;
+    return luminance;
+}
+
+uint32_t GetLuminanceHistogramBin(float luminance)
+{
+    if (!(luminance >= minimumLuminance))
+        return 0;
+
+    uint32_t bits;
+    std::memcpy(&bits, &luminance, sizeof(bits));
+    uint32_t bin = (bits - minimumBits) >> binShift;
+    return bin < LUMINANCE_HISTOGRAM_BINS - 1 ? bin : LUMINANCE_HISTOGRAM_BINS - 1;
+}
+
+uint32_t GetLuminanceHistogramBinWeight(uint32_t bin)
+{
+    // The bins split an octave evenly, the piecewise log2 is linear within it
+    double octaveStart = std::ldexp(1.0, static_cast<int>(bin / LUMINANCE_HISTOGRAM_BINS_PER_OCTAVE) - 16);
+    double middle = octaveStart * (1.0 + (bin % LUMINANCE_HISTOGRAM_BINS_PER_OCTAVE + 0.5) / LUMINANCE_HISTOGRAM_BINS_PER_OCTAVE);
+    return static_cast<uint32_t>(std::log1p(middle) * weightScale + 0.5);
+}
+
+void BuildLuminanceHistogram(const float* rgba, uint32_t width, uint32_t height, uint32_t bins[LUMINANCE_HISTOGRAM_BINS])
+{
+    for (uint32_t bin = 0; bin < LUMINANCE_HISTOGRAM_BINS; ++bin)
+        bins[bin] = 0;
+
+    size_t pixelCount = static_cast<size_t>(width) * height;
+    for (size_t pixel = 0; pixel < pixelCount; ++pixel)
+    {
+        const float* color = rgba + pixel * 4;
+        ++bins[GetLuminanceHistogramBin(ComputeLuminance(color[0], color[1], color[2]))];
+    }
+}
+
+bool ComputeHistogramLogLuminance(const uint32_t bins[LUMINANCE_HISTOGRAM_BINS], float& logLuminance)
+{
+    // The shader keeps the 64-bit sum as two uints
+    uint64_t weightedSum = 0;
+    uint32_t pixelCount = 0;
+    for (uint32_t bin = 0; bin < LUMINANCE_HISTOGRAM_BINS; ++bin)
+    {
+        weightedSum += static_cast<uint64_t>(bins[bin]) * GetLuminanceHistogramBinWeight(bin);
+        pixelCount += bins[bin];
+    }
+    if (pixelCount == 0)
+        return false;
+
+    float sum = static_cast<float>(static_cast<uint32_t>(weightedSum >> 32)) * 4294967296.0f;
+    sum += static_cast<float>(static_cast<uint32_t>(weightedSum));
+    float meanWeight = sum / static_cast<float>(pixelCount);
+    logLuminance = meanWeight / weightScale;
+    return true;
+}
+
+float AdaptLuminance(float adaptedLuminance, float luminance, float deltaTime)
+{
+    float sigma = 0.04f / (0.04f + luminance);
+    float tau = sigma * 0.4f;
+    tau += (1.0f - sigma) * 0.1f;
+    float rate = 1.0f - std::exp(-deltaTime * tau);
+    return adaptedLuminance + (luminance - adaptedLuminance) * rate;
+}
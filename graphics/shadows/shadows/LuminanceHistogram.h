@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+
+// Math of the histogram exposure (LuminanceHistogramShaders.fx) on the CPU, with the same operations in the same order.
+// Bins are found from the bits of luminance: the exponent and the top mantissa bits are a piecewise linear log2, exact
+// at powers of two, so the bin of a pixel doesn't depend on how a GPU approximates log. Luminance below 1 spans 16 octaves
+// of bins, so dark scenes are measured as finely as bright ones.
+
+const uint32_t LUMINANCE_HISTOGRAM_BINS = 512;
+// Bins per doubling of luminance, from 2^-16 to 2^16. The first bin also takes everything below, the last one
+// everything above.
+const uint32_t LUMINANCE_HISTOGRAM_BINS_PER_OCTAVE = 16;
+
+float ComputeLuminance(float r, float g, float b);
+// Negative and NaN luminance go to the first bin
+uint32_t GetLuminanceHistogramBin(float luminance);
+
+// Counts the pixels of an RGBA image
+void BuildLuminanceHistogram(const float* rgba, uint32_t width, uint32_t height, uint32_t bins[LUMINANCE_HISTOGRAM_BINS]);
+
+// log(luminance + 1) at the middle of a bin in 1 / 2^20 steps, the shader reads these values from a buffer. The first
+// bin's weight, about 0.000016, is the lowest mean a scene can have.
+uint32_t GetLuminanceHistogramBinWeight(uint32_t bin);
+
+// Mean of log(luminance + 1) over the pixels, the tone mapping's exposure takes this value. The weights are integers,
+// so the order of the GPU reduction doesn't change the sums. False for an empty histogram.
+bool ComputeHistogramLogLuminance(const uint32_t bins[LUMINANCE_HISTOGRAM_BINS], float& logLuminance);
+
+// Moves the adapted luminance towards the measured one. The rate blends 0.4 and 0.1 by how dark the measured scene is
+// (as the readback exposure did), so a dark scene is adapted to faster than a bright one.
+float AdaptLuminance(float adaptedLuminance, float luminance, float deltaTime);
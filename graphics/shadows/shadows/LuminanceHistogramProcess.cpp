@@ -0,0 +1,98 @@
+#include "pch.h"
+
+#include "LuminanceHistogramProcess.h"
+#include "ShaderStructures.h"
+#include "Utils.h"
+
+LuminanceHistogramProcess::LuminanceHistogramProcess()
+{
+    QueryPerformanceFrequency(&m_qpcFrequency);
+    QueryPerformanceCounter(&m_qpcLastTime);
+}
+
+HRESULT LuminanceHistogramProcess::CreateDeviceDependentResources(ID3D11Device* device)
+{
+    HRESULT hr = S_OK;
+
+    std::vector<BYTE> bytes;
+
+    hr = CreateComputeShader(device, L"LuminanceHistogramComputeShader.cso", bytes, &m_pHistogramComputeShader);
+    if (FAILED(hr))
+        return hr;
+
+    hr = CreateComputeShader(device, L"LuminanceAdaptationComputeShader.cso", bytes, &m_pAdaptationComputeShader);
+    if (FAILED(hr))
+        return hr;
+
+    CD3D11_BUFFER_DESC cb(sizeof(LuminanceHistogramConstantBuffer), D3D11_BIND_CONSTANT_BUFFER);
+    hr = device->CreateBuffer(&cb, nullptr, &m_pConstantBuffer);
+    if (FAILED(hr))
+        return hr;
+
+    // Create the histogram buffer
+    CD3D11_BUFFER_DESC hbd(LUMINANCE_HISTOGRAM_BINS * sizeof(UINT), D3D11_BIND_UNORDERED_ACCESS);
+    hr = device->CreateBuffer(&hbd, nullptr, &m_pHistogramBuffer);
+    if (FAILED(hr))
+        return hr;
+
+    CD3D11_UNORDERED_ACCESS_VIEW_DESC uavd(D3D11_UAV_DIMENSION_BUFFER, DXGI_FORMAT_R32_UINT, 0, LUMINANCE_HISTOGRAM_BINS);
+    hr = device->CreateUnorderedAccessView(m_pHistogramBuffer.Get(), &uavd, &m_pHistogramUnorderedAccessView);
+    if (FAILED(hr))
+        return hr;
+
+    // The weights of the bins are computed once on the CPU, the shader and ComputeHistogramLogLuminance share them
+    UINT binWeights[LUMINANCE_HISTOGRAM_BINS];
+    for (UINT bin = 0; bin < LUMINANCE_HISTOGRAM_BINS; ++bin)
+        binWeights[bin] = GetLuminanceHistogramBinWeight(bin);
+    CD3D11_BUFFER_DESC wbd(sizeof(binWeights), D3D11_BIND_SHADER_RESOURCE, D3D11_USAGE_IMMUTABLE);
+    D3D11_SUBRESOURCE_DATA initData;
+    ZeroMemory(&initData, sizeof(D3D11_SUBRESOURCE_DATA));
+    initData.pSysMem = binWeights;
+    hr = device->CreateBuffer(&wbd, &initData, &m_pBinWeightBuffer);
+    if (FAILED(hr))
+        return hr;
+
+    CD3D11_SHADER_RESOURCE_VIEW_DESC srvd(D3D11_SRV_DIMENSION_BUFFER, DXGI_FORMAT_R32_UINT, 0, LUMINANCE_HISTOGRAM_BINS);
+    hr = device->CreateShaderResourceView(m_pBinWeightBuffer.Get(), &srvd, &m_pBinWeightShaderResourceView);
+
+    return hr;
+}
+
+void LuminanceHistogramProcess::Process(ID3D11DeviceContext* context, ID3D11ShaderResourceView* sourceTexture, UINT width, UINT height,
+    ID3D11UnorderedAccessView* adaptedLuminance)
+{
+    LARGE_INTEGER currentTime;
+    QueryPerformanceCounter(&currentTime);
+    double delta = static_cast<double>(currentTime.QuadPart - m_qpcLastTime.QuadPart) / m_qpcFrequency.QuadPart;
+    m_qpcLastTime = currentTime;
+
+    LuminanceHistogramConstantBuffer histogramData;
+    histogramData.ImageSize = DirectX::XMUINT2(width, height);
+    histogramData.DeltaTime = static_cast<float>(delta);
+    context->UpdateSubresource(m_pConstantBuffer.Get(), 0, nullptr, &histogramData, 0, 0);
+
+    UINT zeros[4] = { 0, 0, 0, 0 };
+    context->ClearUnorderedAccessViewUint(m_pHistogramUnorderedAccessView.Get(), zeros);
+
+    ID3D11UnorderedAccessView* unorderedAccessViews[2] = { m_pHistogramUnorderedAccessView.Get(), adaptedLuminance };
+    ID3D11UnorderedAccessView* nulluav[2] = { nullptr, nullptr };
+    ID3D11ShaderResourceView* shaderResourceViews[2] = { sourceTexture, m_pBinWeightShaderResourceView.Get() };
+    ID3D11ShaderResourceView* nullsrv[2] = { nullptr, nullptr };
+
+    context->CSSetShaderResources(0, 2, shaderResourceViews);
+    context->CSSetUnorderedAccessViews(0, 2, unorderedAccessViews, nullptr);
+    context->CSSetConstantBuffers(0, 1, m_pConstantBuffer.GetAddressOf());
+
+    context->CSSetShader(m_pHistogramComputeShader.Get(), nullptr, 0);
+    context->Dispatch((width + 16 - 1) / 16, (height + 16 - 1) / 16, 1);
+
+    context->CSSetShader(m_pAdaptationComputeShader.Get(), nullptr, 0);
+    context->Dispatch(1, 1, 1);
+
+    context->CSSetShader(nullptr, nullptr, 0);
+    context->CSSetShaderResources(0, 2, nullsrv);
+    context->CSSetUnorderedAccessViews(0, 2, nulluav, nullptr);
+}
+
+LuminanceHistogramProcess::~LuminanceHistogramProcess()
+{}
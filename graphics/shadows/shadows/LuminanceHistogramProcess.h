@@ -0,0 +1,32 @@
+#pragma once
+
+#include "DeviceResources.h"
+#include "LuminanceHistogram.h"
+
+// Adapted luminance for the exposure without a readback. A compute shader counts the scene's pixels in a log luminance
+// histogram, a single group reduces it and moves the adapted luminance towards the result. The value stays in a buffer
+// the tone mapping reads; LuminanceHistogram.h has the same math on the CPU.
+class LuminanceHistogramProcess
+{
+public:
+    LuminanceHistogramProcess();
+    ~LuminanceHistogramProcess();
+
+    HRESULT CreateDeviceDependentResources(ID3D11Device* device);
+
+    // Adapted luminance is a single float of an R32_FLOAT buffer, it keeps its value between frames
+    void Process(ID3D11DeviceContext* context, ID3D11ShaderResourceView* sourceTexture, UINT width, UINT height,
+        ID3D11UnorderedAccessView* adaptedLuminance);
+
+private:
+    Microsoft::WRL::ComPtr<ID3D11ComputeShader>       m_pHistogramComputeShader;
+    Microsoft::WRL::ComPtr<ID3D11ComputeShader>       m_pAdaptationComputeShader;
+    Microsoft::WRL::ComPtr<ID3D11Buffer>              m_pConstantBuffer;
+    Microsoft::WRL::ComPtr<ID3D11Buffer>              m_pHistogramBuffer;
+    Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView> m_pHistogramUnorderedAccessView;
+    Microsoft::WRL::ComPtr<ID3D11Buffer>              m_pBinWeightBuffer;
+    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>  m_pBinWeightShaderResourceView;
+
+    LARGE_INTEGER m_qpcFrequency;
+    LARGE_INTEGER m_qpcLastTime;
+};
@@ -0,0 +1,114 @@
+// Histogram exposure, LuminanceHistogram.cpp has the same math on the CPU. Operations that could be fused or
+// reordered are precise, so both give the same bits wherever the GPU rounds as IEEE does.
+
+#define HISTOGRAM_BINS 512
+
+Texture2D<float4> sourceTexture : register(t0);
+RWBuffer<uint> histogram : register(u0);
+RWBuffer<float> adaptedLuminance : register(u1);
+// log(luminance + 1) at the middle of the bins in 1 / 2^20 steps, from GetLuminanceHistogramBinWeight
+Buffer<uint> binWeights : register(t1);
+
+cbuffer LuminanceHistogramConstantBuffer : register(b0)
+{
+    uint2 ImageSize;
+    float DeltaTime;
+}
+
+static const float WEIGHT_SCALE = 1048576.0f;
+// The start of the bins
+static const float MINIMUM_LUMINANCE = 1.0f / 65536.0f;
+
+float Luminance(float3 color)
+{
+    precise float luminance = 0.2126f * color.r;
+    luminance += 0.7151f * color.g;
+    luminance += 0.0722f * color.b;
+    return luminance;
+}
+
+// The exponent and the top 4 mantissa bits of luminance, a piecewise linear log2 with 16 bins per octave
+uint HistogramBin(float luminance)
+{
+    if (!(luminance >= MINIMUM_LUMINANCE))
+        return 0;
+    return min((asuint(luminance) - asuint(MINIMUM_LUMINANCE)) >> 19, HISTOGRAM_BINS - 1);
+}
+
+groupshared uint groupBins[HISTOGRAM_BINS];
+
+// Every group counts its pixels in shared memory first, then adds the bins it used to the histogram. A thread clears
+// and adds two bins.
+[numthreads(16, 16, 1)]
+void cs_luminance_histogram_main(uint3 id : SV_DispatchThreadID, uint index : SV_GroupIndex)
+{
+    groupBins[index] = 0;
+    groupBins[index + 256] = 0;
+    GroupMemoryBarrierWithGroupSync();
+
+    if (all(id.xy < ImageSize))
+        InterlockedAdd(groupBins[HistogramBin(Luminance(sourceTexture.Load(int3(id.xy, 0)).rgb))], 1);
+    GroupMemoryBarrierWithGroupSync();
+
+    if (groupBins[index] > 0)
+        InterlockedAdd(histogram[index], groupBins[index]);
+    if (groupBins[index + 256] > 0)
+        InterlockedAdd(histogram[index + 256], groupBins[index + 256]);
+}
+
+// 64-bit sums as (low, high)
+uint2 Add64(uint2 a, uint2 b)
+{
+    uint low = a.x + b.x;
+    return uint2(low, a.y + b.y + (low < a.x ? 1 : 0));
+}
+
+// The full product of two uints from their 16-bit halves
+uint2 Multiply64(uint count, uint weight)
+{
+    uint low = (count & 0xFFFF) * (weight & 0xFFFF);
+    uint high = (count >> 16) * (weight >> 16);
+    uint middle = (count & 0xFFFF) * (weight >> 16);
+    uint otherMiddle = (count >> 16) * (weight & 0xFFFF);
+    uint2 product = Add64(uint2(low, high), uint2(middle << 16, middle >> 16));
+    return Add64(product, uint2(otherMiddle << 16, otherMiddle >> 16));
+}
+
+groupshared uint2 groupWeightedSums[HISTOGRAM_BINS];
+groupshared uint groupCounts[HISTOGRAM_BINS];
+
+// A single group, one thread per bin. The sums are integers, so the tree gives what a serial loop gives.
+[numthreads(HISTOGRAM_BINS, 1, 1)]
+void cs_luminance_adaptation_main(uint index : SV_GroupIndex)
+{
+    uint count = histogram[index];
+    groupWeightedSums[index] = Multiply64(count, binWeights[index]);
+    groupCounts[index] = count;
+    GroupMemoryBarrierWithGroupSync();
+
+    [unroll]
+    for (uint stride = HISTOGRAM_BINS / 2; stride > 0; stride >>= 1)
+    {
+        if (index < stride)
+        {
+            groupWeightedSums[index] = Add64(groupWeightedSums[index], groupWeightedSums[index + stride]);
+            groupCounts[index] += groupCounts[index + stride];
+        }
+        GroupMemoryBarrierWithGroupSync();
+    }
+
+    if (index == 0 && groupCounts[0] > 0)
+    {
+        precise float sum = (float)groupWeightedSums[0].y * 4294967296.0f;
+        sum += (float)groupWeightedSums[0].x;
+        precise float meanWeight = sum / (float)groupCounts[0];
+        precise float luminance = meanWeight / WEIGHT_SCALE;
+
+        precise float sigma = 0.04f / (0.04f + luminance);
+        precise float tau = sigma * 0.4f;
+        tau += (1.0f - sigma) * 0.1f;
+        precise float rate = 1.0f - exp(-DeltaTime * tau);
+        precise float adapted = adaptedLuminance[0];
+        adaptedLuminance[0] = adapted + (luminance - adapted) * rate;
+    }
+}
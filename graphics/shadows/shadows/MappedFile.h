@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Read only view of a whole file. Pages are loaded by the system as they are touched, nothing is copied.
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Fails for missing and empty files
+    bool Open(const char* path);
+    void Close();
+
+    const uint8_t* GetData() const { return m_pData; };
+    size_t GetSize() const { return m_size; };
+
+private:
+    const uint8_t* m_pData;
+    size_t         m_size;
+};
@@ -11,24 +11,35 @@
 #undef TINYGLTF_IMPLEMENTATION
 
 #include "Utils.h"
+#include "CpuTrace.h"
 
-Model::Model(const char* modelPath, const std::shared_ptr<ModelShaders>& modelShaders, DirectX::XMMATRIX globalWorldMatrix) :
+Model::Model(const char* modelPath, const std::shared_ptr<ModelShaders>& modelShaders, const std::shared_ptr<StateObjectCache>& stateCache,
+    DirectX::XMMATRIX globalWorldMatrix) :
     m_modelPath(modelsPath + modelPath),
     m_globalWorldMatrix(globalWorldMatrix),
     m_pModelShaders(modelShaders),
+    m_pStateCache(stateCache),
     m_max(),
-    m_min()
+    m_min(),
+    m_drawCount(0)
 {};
 
 HRESULT Model::CreateDeviceDependentResources(ID3D11Device* device)
 {
+    CPU_TRACE_SCOPE("Model::CreateDeviceDependentResources");
+
     HRESULT hr = S_OK;
 
     tinygltf::TinyGLTF loader;
 
     tinygltf::Model model;
 
-    bool ret = loader.LoadASCIIFromFile(&model, nullptr, nullptr, m_modelPath.c_str());
+    // Parses the JSON and decodes the images
+    bool ret = false;
+    {
+        CPU_TRACE_SCOPE("Load glTF");
+        ret = loader.LoadASCIIFromFile(&model, nullptr, nullptr, m_modelPath.c_str());
+    }
     if (!ret)
         return E_FAIL;
 
@@ -46,6 +57,14 @@ HRESULT Model::CreateDeviceDependentResources(ID3D11Device* device)
     m_min = DirectX::XMVectorSet(INFINITY, INFINITY, INFINITY, 0);
 
     hr = CreatePrimitives(device, model);
+    if (FAILED(hr))
+        return hr;
+
+    // Opaque primitives are drawn grouped by their pipeline state, transparent ones keep their order for sorting by depth
+    std::stable_sort(m_primitives.begin(), m_primitives.end(), [this](const Primitive& a, const Primitive& b)
+    {
+        return m_materials[a.material].sortKey < m_materials[b.material].sortKey;
+    });
 
     return hr;
 }
@@ -153,21 +172,27 @@ HRESULT Model::CreateSamplerState(ID3D11Device* device, tinygltf::Model& model)
     sd.ComparisonFunc = D3D11_COMPARISON_NEVER;
     sd.MinLOD = 0;
     sd.MaxLOD = D3D11_FLOAT32_MAX;
-    hr = device->CreateSamplerState(&sd, &m_pSamplerState);
+    hr = m_pStateCache->GetSamplerState(device, sd, &m_pSamplerState);
 
     return hr;
 }
 
 HRESULT Model::CreateMaterials(ID3D11Device* device, tinygltf::Model& model)
 {
+    CPU_TRACE_SCOPE("Model::CreateMaterials");
+
     HRESULT hr = S_OK;
 
+    // Pixel shaders of all materials are compiled together once the materials are known
+    std::vector<UINT> pixelShaderDefinesFlags;
+
     for (tinygltf::Material& gltfMaterial : model.materials)
     {
         Material material = {};
         material.name = gltfMaterial.name;
         material.blend = false;
 
+        UINT blendStateId = 0;
         D3D11_BLEND_DESC bd = {};
         // All materials have alpha mode "BLEND" or "OPAQUE"
         if (gltfMaterial.alphaMode == "BLEND")
@@ -181,7 +206,7 @@ HRESULT Model::CreateMaterials(ID3D11Device* device, tinygltf::Model& model)
             bd.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_ONE;
             bd.RenderTarget[0].BlendOpAlpha = D3D11_BLEND_OP_ADD;
             bd.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
-            hr = device->CreateBlendState(&bd, &material.pBlendState);
+            hr = m_pStateCache->GetBlendState(device, bd, &material.pBlendState, &blendStateId);
             if (FAILED(hr))
                 return hr;
         }
@@ -196,7 +221,8 @@ HRESULT Model::CreateMaterials(ID3D11Device* device, tinygltf::Model& model)
         rd.DepthBias = D3D11_DEFAULT_DEPTH_BIAS;
         rd.DepthBiasClamp = D3D11_DEFAULT_DEPTH_BIAS_CLAMP;
         rd.SlopeScaledDepthBias = D3D11_DEFAULT_SLOPE_SCALED_DEPTH_BIAS;
-        hr = device->CreateRasterizerState(&rd, &material.pRasterizerState);
+        UINT rasterizerStateId = 0;
+        hr = m_pStateCache->GetRasterizerState(device, rd, &material.pRasterizerState, &rasterizerStateId);
         if (FAILED(hr))
             return hr;
 
@@ -239,21 +265,27 @@ HRESULT Model::CreateMaterials(ID3D11Device* device, tinygltf::Model& model)
         if (gltfMaterial.occlusionTexture.index >= 0)
             material.pixelShaderDefinesFlags |= ModelShaders::MATERIAL_HAS_OCCLUSION_TEXTURE;
 
-        hr = m_pModelShaders->CreatePixelShader(device, material.pixelShaderDefinesFlags);
-        if (FAILED(hr))
-            return hr;
-
         material.emissiveTexture = gltfMaterial.emissiveTexture.index;
         if (material.emissiveTexture >= 0)
         {
+            material.pixelShaderDefinesFlags |= ModelShaders::MATERIAL_HAS_EMISSIVE_TEXTURE;
             hr = CreateTexture(device, model, material.emissiveTexture, true);
             if (FAILED(hr))
                 return hr;
         }
 
+        material.sortKey = (static_cast<UINT64>(material.pixelShaderDefinesFlags) << 48) | (static_cast<UINT64>(blendStateId) << 32) |
+            (static_cast<UINT64>(rasterizerStateId) << 16) | static_cast<UINT64>(m_materials.size());
+
+        pixelShaderDefinesFlags.push_back(material.pixelShaderDefinesFlags);
+        if (material.blend)
+            pixelShaderDefinesFlags.push_back(material.pixelShaderDefinesFlags | ModelShaders::WEIGHTED_OIT);
+
         m_materials.push_back(material);
     }
 
+    hr = m_pModelShaders->CreatePixelShaders(device, pixelShaderDefinesFlags);
+
     return hr;
 }
 
@@ -344,9 +376,18 @@ HRESULT Model::CreatePrimitive(ID3D11Device* device, tinygltf::Model& model, tin
             DirectX::XMFLOAT3 maxPosition(static_cast<float>(gltfAccessor.maxValues[0]), static_cast<float>(gltfAccessor.maxValues[1]), static_cast<float>(gltfAccessor.maxValues[2]));
             DirectX::XMFLOAT3 minPosition(static_cast<float>(gltfAccessor.minValues[0]), static_cast<float>(gltfAccessor.minValues[1]), static_cast<float>(gltfAccessor.minValues[2]));
 
-            DirectX::XMMATRIX world = DirectX::XMMatrixMultiply(m_worldMatricies[primitive.matrix], m_globalWorldMatrix);
-            primitive.max = DirectX::XMVector3Transform(DirectX::XMLoadFloat3(&maxPosition), world);
-            primitive.min = DirectX::XMVector3Transform(DirectX::XMLoadFloat3(&minPosition), world);
+            DirectX::XMFLOAT4X4 world;
+            DirectX::XMStoreFloat4x4(&world, DirectX::XMMatrixMultiply(m_worldMatricies[primitive.matrix], m_globalWorldMatrix));
+
+            // Transform all corners, two opposite ones aren't enough for rotated nodes
+            AABB localBounds = { { minPosition.x, minPosition.y, minPosition.z }, { maxPosition.x, maxPosition.y, maxPosition.z } };
+            AABB bounds = TransformAABB(localBounds, world.m);
+            primitive.max = DirectX::XMVectorSet(bounds.max.x, bounds.max.y, bounds.max.z, 1);
+            primitive.min = DirectX::XMVectorSet(bounds.min.x, bounds.min.y, bounds.min.z, 1);
+
+            primitive.id = static_cast<UINT>(m_primitiveBounds.size());
+            m_primitiveBounds.push_back(bounds);
+            m_primitiveVisibility.push_back(true);
 
             for (size_t i = 0; i < 3; ++i)
             {
@@ -407,17 +448,9 @@ HRESULT Model::CreatePrimitive(ID3D11Device* device, tinygltf::Model& model, tin
 
     primitive.material = gltfPrimitive.material;
     if (m_materials[primitive.material].blend)
-    {
         m_transparentPrimitives.push_back(primitive);
-        if (m_materials[primitive.material].emissiveTexture >= 0)
-            m_emissiveTransparentPrimitives.push_back(primitive);
-    }
     else
-    {
         m_primitives.push_back(primitive);
-        if (m_materials[primitive.material].emissiveTexture >= 0)
-            m_emissivePrimitives.push_back(primitive);
-    }
 
     return hr;
 }
@@ -459,6 +492,8 @@ HRESULT Model::ProcessNode(ID3D11Device* device, tinygltf::Model& model, int nod
 
 HRESULT Model::CreatePrimitives(ID3D11Device* device, tinygltf::Model& model)
 {
+    CPU_TRACE_SCOPE("Model::CreatePrimitives");
+
     HRESULT hr = S_OK;
 
     tinygltf::Scene& gltfScene = model.scenes[model.defaultScene];
@@ -475,53 +510,96 @@ HRESULT Model::CreatePrimitives(ID3D11Device* device, tinygltf::Model& model)
     return hr;
 }
 
-void Model::Render(ID3D11DeviceContext* context, WorldViewProjectionConstantBuffer transformationData, ID3D11Buffer* transformationConstantBuffer, ID3D11Buffer* materialConstantBuffer, ShadersSlots slots, bool emissive, bool usePS)
+void Model::BindResources(ID3D11DeviceContext* context, ID3D11Buffer* transformationConstantBuffer, ID3D11Buffer* materialConstantBuffer, ShadersSlots slots)
 {
     context->VSSetConstantBuffers(slots.transformationConstantBufferSlot, 1, &transformationConstantBuffer);
     context->PSSetConstantBuffers(slots.transformationConstantBufferSlot, 1, &transformationConstantBuffer);
     context->PSSetConstantBuffers(slots.materialConstantBufferSlot, 1, &materialConstantBuffer);
     context->PSSetSamplers(slots.samplerStateSlot, 1, m_pSamplerState.GetAddressOf());
+}
+
+void Model::Render(ID3D11DeviceContext* context, WorldViewProjectionConstantBuffer transformationData, ID3D11Buffer* transformationConstantBuffer, ID3D11Buffer* materialConstantBuffer, ShadersSlots slots, bool usePS)
+{
+    BindResources(context, transformationConstantBuffer, materialConstantBuffer, slots);
 
     transformationData.World = DirectX::XMMatrixIdentity();
-    std::vector<Primitive>& primitives = emissive ? m_emissivePrimitives : m_primitives;
-    for (Primitive& primitive : primitives)
-        RenderPrimitive(primitive, context, transformationData, transformationConstantBuffer, materialConstantBuffer, slots, emissive, usePS);
+    for (Primitive& primitive : m_primitives)
+        if (!usePS || m_primitiveVisibility[primitive.id])
+            RenderPrimitive(primitive, context, transformationData, transformationConstantBuffer, materialConstantBuffer, slots, usePS);
 }
 
-bool CompareDistancePairs(const std::pair<float, size_t>& p1, const std::pair<float, size_t>& p2)
+void Model::SetPrimitivesVisible(bool visible)
 {
-    return p1.first < p2.first;
+    std::fill(m_primitiveVisibility.begin(), m_primitiveVisibility.end(), visible);
 }
 
-void Model::RenderTransparent(ID3D11DeviceContext* context, WorldViewProjectionConstantBuffer transformationData, ID3D11Buffer* transformationConstantBuffer, ID3D11Buffer* materialConstantBuffer, ShadersSlots slots, DirectX::XMVECTOR cameraDir, bool emissive, bool usePS)
+void Model::RenderTransparent(ID3D11DeviceContext* context, WorldViewProjectionConstantBuffer transformationData, ID3D11Buffer* transformationConstantBuffer, ID3D11Buffer* materialConstantBuffer, ShadersSlots slots, bool usePS, bool weightedOIT)
 {
-    context->VSSetConstantBuffers(slots.transformationConstantBufferSlot, 1, &transformationConstantBuffer);
-    context->PSSetConstantBuffers(slots.transformationConstantBufferSlot, 1, &transformationConstantBuffer);
-    context->PSSetConstantBuffers(slots.materialConstantBufferSlot, 1, &materialConstantBuffer);
-    context->PSSetSamplers(slots.samplerStateSlot, 1, m_pSamplerState.GetAddressOf());
+    BindResources(context, transformationConstantBuffer, materialConstantBuffer, slots);
 
     transformationData.World = DirectX::XMMatrixIdentity();
+    for (Primitive& primitive : m_transparentPrimitives)
+        if (!usePS || m_primitiveVisibility[primitive.id])
+            RenderPrimitive(primitive, context, transformationData, transformationConstantBuffer, materialConstantBuffer, slots, usePS, weightedOIT);
+}
 
-    std::vector<Primitive>& primitives = emissive ? m_emissiveTransparentPrimitives : m_transparentPrimitives;
-    
-    std::vector<std::pair<float, size_t>> distances;
-    float distance;
-    DirectX::XMVECTOR center;
-    DirectX::XMVECTOR cameraPos = DirectX::XMLoadFloat4(&transformationData.CameraPos);
-    for (size_t i = 0; i < primitives.size(); ++i)
+void Model::RenderTransparentPrimitive(ID3D11DeviceContext* context, WorldViewProjectionConstantBuffer& transformationData, ID3D11Buffer* transformationConstantBuffer, ID3D11Buffer* materialConstantBuffer, ShadersSlots slots, size_t index)
+{
+    RenderPrimitive(m_transparentPrimitives[index], context, transformationData, transformationConstantBuffer, materialConstantBuffer, slots);
+}
+
+bool Model::IsTransparentPrimitiveVisible(size_t index) const
+{
+    return m_primitiveVisibility[m_transparentPrimitives[index].id];
+}
+
+DirectX::XMVECTOR Model::GetTransparentPrimitiveCenter(size_t index) const
+{
+    const Primitive& primitive = m_transparentPrimitives[index];
+    return DirectX::XMVectorScale(DirectX::XMVectorAdd(primitive.max, primitive.min), 0.5f);
+}
+
+void Model::RenderCascades(ID3D11DeviceContext* context, WorldViewProjectionConstantBuffer transformationData, ID3D11Buffer* transformationConstantBuffer, ShadowCascadesConstantBuffer& cascadesData, ID3D11Buffer* cascadesConstantBuffer, ShadersSlots slots, const uint8_t* cascadeMasks)
+{
+    context->VSSetConstantBuffers(slots.transformationConstantBufferSlot, 1, &transformationConstantBuffer);
+    context->IASetInputLayout(m_pModelShaders->GetInputLayout());
+    context->VSSetShader(m_pModelShaders->GetCascadeVertexShader(), nullptr, 0);
+    context->GSSetShader(m_pModelShaders->GetCascadeGeometryShader(), nullptr, 0);
+    context->PSSetShader(nullptr, nullptr, 0);
+
+    uint8_t boundMask = 0;
+    for (const std::vector<Primitive>* primitives : { &m_primitives, &m_transparentPrimitives })
     {
-        center = DirectX::XMVectorDivide(DirectX::XMVectorAdd(primitives[i].max, primitives[i].min), DirectX::XMVectorReplicate(2));
-        distance = DirectX::XMVector3Dot(DirectX::XMVectorSubtract(center, cameraPos), cameraDir).m128_f32[0];
-        distances.push_back(std::pair<float, size_t>(distance, i));
-    }
+        for (const Primitive& primitive : *primitives)
+        {
+            // Cascade geometry shader takes triangles only, lines and points don't cast shadows there
+            uint8_t mask = cascadeMasks[primitive.id];
+            if (mask == 0 || (primitive.primitiveTopology != D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST &&
+                primitive.primitiveTopology != D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP))
+                continue;
+
+            CascadeInstances instances = GetCascadeInstances(mask);
+            if (mask != boundMask)
+            {
+                cascadesData.CascadeSlices = DirectX::XMUINT4(instances.slices);
+                context->UpdateSubresource(cascadesConstantBuffer, 0, NULL, &cascadesData, 0, 0);
+                boundMask = mask;
+            }
 
-    std::sort(distances.begin(), distances.end(), CompareDistancePairs);
+            BindPrimitiveGeometry(primitive, context);
 
-    for (auto iter = distances.rbegin(); iter != distances.rend(); ++iter)
-        RenderPrimitive(primitives[(*iter).second], context, transformationData, transformationConstantBuffer, materialConstantBuffer, slots, emissive, usePS);
+            transformationData.World = DirectX::XMMatrixMultiplyTranspose(m_worldMatricies[primitive.matrix], m_globalWorldMatrix);
+            context->UpdateSubresource(transformationConstantBuffer, 0, NULL, &transformationData, 0, 0);
+
+            context->DrawIndexedInstanced(primitive.indexCount, instances.count, 0, 0, 0);
+            ++m_drawCount;
+        }
+    }
+
+    context->GSSetShader(nullptr, nullptr, 0);
 }
 
-void Model::RenderPrimitive(Primitive& primitive, ID3D11DeviceContext* context, WorldViewProjectionConstantBuffer& transformationData, ID3D11Buffer* transformationConstantBuffer, ID3D11Buffer* materialConstantBuffer, ShadersSlots& slots, bool emissive, bool usePS)
+void Model::BindPrimitiveGeometry(const Primitive& primitive, ID3D11DeviceContext* context)
 {
     std::vector<ID3D11Buffer*> combined;
     std::vector<UINT> offset;
@@ -540,9 +618,15 @@ void Model::RenderPrimitive(Primitive& primitive, ID3D11DeviceContext* context,
 
     context->IASetIndexBuffer(primitive.pIndexBuffer.Get(), primitive.indexFormat, 0);
     context->IASetPrimitiveTopology(primitive.primitiveTopology);
+}
+
+void Model::RenderPrimitive(Primitive& primitive, ID3D11DeviceContext* context, WorldViewProjectionConstantBuffer& transformationData, ID3D11Buffer* transformationConstantBuffer, ID3D11Buffer* materialConstantBuffer, ShadersSlots& slots, bool usePS, bool weightedOIT)
+{
+    BindPrimitiveGeometry(primitive, context);
 
     Material& material = m_materials[primitive.material];
-    if (material.blend)
+    // Weighted OIT blend state is set once for all transparent primitives
+    if (material.blend && !weightedOIT)
         context->OMSetBlendState(material.pBlendState.Get(), nullptr, 0xFFFFFFFF);
 
     context->IASetInputLayout(m_pModelShaders->GetInputLayout());
@@ -552,25 +636,20 @@ void Model::RenderPrimitive(Primitive& primitive, ID3D11DeviceContext* context,
 
     context->UpdateSubresource(transformationConstantBuffer, 0, NULL, &transformationData, 0, 0);
 
-    MaterialConstantBuffer materialBufferData = material.materialBufferData;
     if (usePS)
     {
-        if (emissive)
-        {
-            materialBufferData.Albedo = DirectX::XMFLOAT4(1, 1, 1, materialBufferData.Albedo.w);
-            context->PSSetShaderResources(slots.baseColorTextureSlot, 1, m_pShaderResourceViews[material.emissiveTexture].GetAddressOf());
-            context->PSSetShader(m_pModelShaders->GetEmissivePixelShader(), nullptr, 0);
-        }
-        else
-        {
-            context->PSSetShader(m_pModelShaders->GetPixelShader(material.pixelShaderDefinesFlags), nullptr, 0);
-            if (material.baseColorTexture >= 0)
-                context->PSSetShaderResources(slots.baseColorTextureSlot, 1, m_pShaderResourceViews[material.baseColorTexture].GetAddressOf());
-            if (material.metallicRoughnessTexture >= 0)
-                context->PSSetShaderResources(slots.metallicRoughnessTextureSlot, 1, m_pShaderResourceViews[material.metallicRoughnessTexture].GetAddressOf());
-            if (material.normalTexture >= 0)
-                context->PSSetShaderResources(slots.normalTextureSlot, 1, m_pShaderResourceViews[material.normalTexture].GetAddressOf());
-        }
+        UINT definesFlags = material.pixelShaderDefinesFlags;
+        if (weightedOIT)
+            definesFlags |= ModelShaders::WEIGHTED_OIT;
+        context->PSSetShader(m_pModelShaders->GetPixelShader(definesFlags), nullptr, 0);
+        if (material.baseColorTexture >= 0)
+            context->PSSetShaderResources(slots.baseColorTextureSlot, 1, m_pShaderResourceViews[material.baseColorTexture].GetAddressOf());
+        if (material.metallicRoughnessTexture >= 0)
+            context->PSSetShaderResources(slots.metallicRoughnessTextureSlot, 1, m_pShaderResourceViews[material.metallicRoughnessTexture].GetAddressOf());
+        if (material.normalTexture >= 0)
+            context->PSSetShaderResources(slots.normalTextureSlot, 1, m_pShaderResourceViews[material.normalTexture].GetAddressOf());
+        if (material.emissiveTexture >= 0)
+            context->PSSetShaderResources(slots.emissiveTextureSlot, 1, m_pShaderResourceViews[material.emissiveTexture].GetAddressOf());
         context->RSSetState(material.pRasterizerState.Get());
     }
     else
@@ -578,8 +657,9 @@ void Model::RenderPrimitive(Primitive& primitive, ID3D11DeviceContext* context,
     context->UpdateSubresource(materialConstantBuffer, 0, NULL, &material.materialBufferData, 0, 0);
 
     context->DrawIndexed(primitive.indexCount, 0, 0);
+    ++m_drawCount;
 
-    if (material.blend)
+    if (material.blend && !weightedOIT)
         context->OMSetBlendState(nullptr, nullptr, 0xFFFFFFFF);
 }
 
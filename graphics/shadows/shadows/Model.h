@@ -2,6 +2,9 @@
 
 #include "ShaderStructures.h"
 #include "ModelShaders.h"
+#include "StateObjectCache.h"
+#include "Bounds.h"
+#include "ShadowCascadePlanner.h"
 #include "../../tiny_gltf.h"
 
 const std::string modelsPath = srcPath + "../../models/";
@@ -14,21 +17,48 @@ public:
         UINT baseColorTextureSlot;
         UINT metallicRoughnessTextureSlot;
         UINT normalTextureSlot;
+        UINT emissiveTextureSlot;
         UINT samplerStateSlot;
         UINT transformationConstantBufferSlot;
         UINT materialConstantBufferSlot;
     };
 
-    Model(const char* modelPath, const std::shared_ptr<ModelShaders>& modelShaders, DirectX::XMMATRIX globalWorldMatrix = DirectX::XMMatrixIdentity());
+    Model(const char* modelPath, const std::shared_ptr<ModelShaders>& modelShaders, const std::shared_ptr<StateObjectCache>& stateCache,
+        DirectX::XMMATRIX globalWorldMatrix = DirectX::XMMatrixIdentity());
     ~Model();
 
     HRESULT CreateDeviceDependentResources(ID3D11Device* device);
 
-    void Render(ID3D11DeviceContext* context, WorldViewProjectionConstantBuffer transformationData, ID3D11Buffer* transformationConstantBuffer, ID3D11Buffer* materialConstantBuffer, ShadersSlots slots, bool emissive = false, bool usePS = true);
-    void RenderTransparent(ID3D11DeviceContext* context, WorldViewProjectionConstantBuffer transformationData, ID3D11Buffer* transformationConstantBuffer, ID3D11Buffer* materialConstantBuffer, ShadersSlots slots, DirectX::XMVECTOR cameraDir, bool emissive = false, bool usePS = true);
+    void Render(ID3D11DeviceContext* context, WorldViewProjectionConstantBuffer transformationData, ID3D11Buffer* transformationConstantBuffer, ID3D11Buffer* materialConstantBuffer, ShadersSlots slots, bool usePS = true);
+    // Draws transparent primitives in storage order, for depth only passes and weighted OIT. Other color
+    // passes sort the primitives of all models together and draw them one by one with RenderTransparentPrimitive
+    void RenderTransparent(ID3D11DeviceContext* context, WorldViewProjectionConstantBuffer transformationData, ID3D11Buffer* transformationConstantBuffer, ID3D11Buffer* materialConstantBuffer, ShadersSlots slots, bool usePS = true, bool weightedOIT = false);
+    void RenderTransparentPrimitive(ID3D11DeviceContext* context, WorldViewProjectionConstantBuffer& transformationData, ID3D11Buffer* transformationConstantBuffer, ID3D11Buffer* materialConstantBuffer, ShadersSlots slots, size_t index);
+
+    // Draws every primitive once into all cascades of its mask (indexed by primitive id) with instancing
+    void RenderCascades(ID3D11DeviceContext* context, WorldViewProjectionConstantBuffer transformationData, ID3D11Buffer* transformationConstantBuffer, ShadowCascadesConstantBuffer& cascadesData, ID3D11Buffer* cascadesConstantBuffer, ShadersSlots slots, const uint8_t* cascadeMasks);
+
+    void BindResources(ID3D11DeviceContext* context, ID3D11Buffer* transformationConstantBuffer, ID3D11Buffer* materialConstantBuffer, ShadersSlots slots);
+
+    size_t GetTransparentPrimitiveCount() const { return m_transparentPrimitives.size(); };
+    bool IsTransparentPrimitiveVisible(size_t index) const;
+    DirectX::XMVECTOR GetTransparentPrimitiveCenter(size_t index) const;
+
+    // Number of draw calls issued since the last reset
+    UINT GetDrawCount() const { return m_drawCount; };
+    void ResetDrawCount() { m_drawCount = 0; };
 
     DirectX::XMVECTOR GetMaximumPosition() const { return m_max; };
     DirectX::XMVECTOR GetMinimumPosition() const { return m_min; };
+    DirectX::XMMATRIX GetGlobalWorldMatrix() const { return m_globalWorldMatrix; };
+
+    // World space bounds of every primitive, indexed by primitive id
+    const std::vector<AABB>& GetPrimitiveBounds() const { return m_primitiveBounds; };
+    size_t GetPrimitiveCount() const { return m_primitiveBounds.size(); };
+
+    // Invisible primitives are skipped by the color passes, depth only passes (usePS == false) draw everything
+    void SetPrimitivesVisible(bool visible);
+    void SetPrimitiveVisible(UINT id, bool visible) { m_primitiveVisibility[id] = visible; };
 
 private:
     struct Material
@@ -43,6 +73,8 @@ private:
         int normalTexture;
         int emissiveTexture;
         UINT pixelShaderDefinesFlags;
+        // Pixel shader, blend and rasterizer state ids, materials with equal keys draw with the same pipeline state
+        UINT64 sortKey;
     };
 
     struct Attribute
@@ -57,6 +89,7 @@ private:
         UINT vertexCount;
         DirectX::XMVECTOR max;
         DirectX::XMVECTOR min;
+        UINT id;
         D3D11_PRIMITIVE_TOPOLOGY primitiveTopology;
         DXGI_FORMAT indexFormat;
         Microsoft::WRL::ComPtr<ID3D11Buffer> pIndexBuffer;
@@ -72,11 +105,13 @@ private:
     HRESULT ProcessNode(ID3D11Device* device, tinygltf::Model& model, int node, DirectX::XMMATRIX worldMatrix);
     HRESULT CreatePrimitive(ID3D11Device* device, tinygltf::Model& model, tinygltf::Primitive& gltfPrimitive, UINT matrix);
     
-    void RenderPrimitive(Primitive& primitive, ID3D11DeviceContext* context, WorldViewProjectionConstantBuffer& transformationData, ID3D11Buffer* transformationConstantBuffer, ID3D11Buffer* materialConstantBuffer, ShadersSlots& slots, bool emissive = false, bool usePS = true);
+    void BindPrimitiveGeometry(const Primitive& primitive, ID3D11DeviceContext* context);
+    void RenderPrimitive(Primitive& primitive, ID3D11DeviceContext* context, WorldViewProjectionConstantBuffer& transformationData, ID3D11Buffer* transformationConstantBuffer, ID3D11Buffer* materialConstantBuffer, ShadersSlots& slots, bool usePS = true, bool weightedOIT = false);
 
     std::string m_modelPath;
 
     std::shared_ptr<ModelShaders> m_pModelShaders;
+    std::shared_ptr<StateObjectCache> m_pStateCache;
 
     std::vector<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> m_pShaderResourceViews;
     
@@ -88,11 +123,14 @@ private:
     
     std::vector<Primitive> m_primitives;
     std::vector<Primitive> m_transparentPrimitives;
-    std::vector<Primitive> m_emissivePrimitives;
-    std::vector<Primitive> m_emissiveTransparentPrimitives;
+
+    std::vector<AABB> m_primitiveBounds;
+    std::vector<bool> m_primitiveVisibility;
 
     DirectX::XMMATRIX m_globalWorldMatrix;
 
     DirectX::XMVECTOR m_max;
     DirectX::XMVECTOR m_min;
+
+    UINT m_drawCount;
 };
@@ -0,0 +1,47 @@
+#include "ModelPassPlanner.h"
+
+void PlanModelPasses(bool weightedOIT, std::vector<ModelPass>& passes)
+{
+    passes.clear();
+    passes.push_back({ MODEL_PASS_TYPE::OPAQUE_PRIMITIVES, MODEL_PASS_TARGET_SCENE | MODEL_PASS_TARGET_BLOOM, true });
+    passes.push_back({ MODEL_PASS_TYPE::ENVIRONMENT, MODEL_PASS_TARGET_SCENE, false });
+    if (weightedOIT)
+    {
+        passes.push_back({ MODEL_PASS_TYPE::OIT_TRANSPARENT_PRIMITIVES, MODEL_PASS_TARGET_OIT | MODEL_PASS_TARGET_BLOOM, false });
+        passes.push_back({ MODEL_PASS_TYPE::OIT_RESOLVE, MODEL_PASS_TARGET_SCENE, false });
+    }
+    else
+        passes.push_back({ MODEL_PASS_TYPE::SORTED_TRANSPARENT_PRIMITIVES, MODEL_PASS_TARGET_SCENE | MODEL_PASS_TARGET_BLOOM, false });
+}
+
+void ExecuteModelPasses(const std::vector<ModelPass>& passes, ModelPassContext& context)
+{
+    for (const ModelPass& pass : passes)
+    {
+        context.BeginPass(pass);
+        context.DrawPass(pass);
+    }
+}
+
+unsigned int CountModelPassDraws(const std::vector<ModelPass>& passes, unsigned int opaqueCount, unsigned int transparentCount)
+{
+    unsigned int count = 0;
+    for (const ModelPass& pass : passes)
+    {
+        switch (pass.type)
+        {
+        case MODEL_PASS_TYPE::OPAQUE_PRIMITIVES:
+            count += opaqueCount;
+            break;
+        case MODEL_PASS_TYPE::SORTED_TRANSPARENT_PRIMITIVES:
+        case MODEL_PASS_TYPE::OIT_TRANSPARENT_PRIMITIVES:
+            count += transparentCount;
+            break;
+        case MODEL_PASS_TYPE::ENVIRONMENT:
+        case MODEL_PASS_TYPE::OIT_RESOLVE:
+            count += 1;
+            break;
+        }
+    }
+    return count;
+}
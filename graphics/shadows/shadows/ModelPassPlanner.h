@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vector>
+
+// Order of the model passes of a frame, kept apart from D3D so it can be checked with a mock context.
+// Emissive output goes to the bloom target from the same pass as the scene color (MRT), so every
+// primitive is drawn once per frame.
+
+enum class MODEL_PASS_TYPE
+{
+    OPAQUE_PRIMITIVES = 0,
+    // The sky, after the opaque primitives so that the depth test rejects the pixels they cover
+    ENVIRONMENT,
+    SORTED_TRANSPARENT_PRIMITIVES,
+    OIT_TRANSPARENT_PRIMITIVES,
+    OIT_RESOLVE
+};
+
+enum MODEL_PASS_TARGETS
+{
+    MODEL_PASS_TARGET_SCENE = 0x1,
+    MODEL_PASS_TARGET_BLOOM = 0x2,
+    MODEL_PASS_TARGET_OIT = 0x4
+};
+
+struct ModelPass
+{
+    MODEL_PASS_TYPE type;
+    unsigned int targets;
+    bool depthWrite;
+};
+
+class ModelPassContext
+{
+public:
+    virtual ~ModelPassContext() {};
+
+    virtual void BeginPass(const ModelPass& pass) = 0;
+    virtual void DrawPass(const ModelPass& pass) = 0;
+};
+
+void PlanModelPasses(bool weightedOIT, std::vector<ModelPass>& passes);
+void ExecuteModelPasses(const std::vector<ModelPass>& passes, ModelPassContext& context);
+
+// Draw calls the passes issue for the given numbers of visible primitives
+unsigned int CountModelPassDraws(const std::vector<ModelPass>& passes, unsigned int opaqueCount, unsigned int transparentCount);
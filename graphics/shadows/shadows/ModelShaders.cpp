@@ -2,6 +2,8 @@
 
 #include "ModelShaders.h"
 
+#include <algorithm>
+
 #include "Utils.h"
 
 ModelShaders::ModelShaders()
@@ -11,18 +13,19 @@ HRESULT ModelShaders::CreateDeviceDependentResources(ID3D11Device* device)
 {
     HRESULT hr = S_OK;
 
-    m_pPixelShaders.resize(16);
-
-    Microsoft::WRL::ComPtr<ID3DBlob> blob;
+    m_pPixelShaders.resize(64);
 
-    std::vector<D3D_SHADER_MACRO> defines;
-    defines.push_back({ "HAS_TANGENT", "1" });
-    defines.push_back({ nullptr, nullptr });
+    // Vertex shaders and the shaders for rendering all shadow cascades in one pass are compiled together
+    std::vector<ShaderCompileTask> tasks(3);
+    tasks[0] = { wsrcPath + L"PBRShaders.fx", "vs_main", "vs_5_0", { { "HAS_TANGENT", "1" } } };
+    tasks[1] = { wsrcPath + L"PBRShaders.fx", "vs_cascade_main", "vs_5_0", { { "HAS_TANGENT", "1" } } };
+    tasks[2] = { wsrcPath + L"PBRShaders.fx", "gs_cascade_main", "gs_5_0", { { "HAS_TANGENT", "1" } } };
 
-    hr = CompileShaderFromFile((wsrcPath + L"PBRShaders.fx").c_str(), "vs_main", "vs_5_0", &blob, defines.data());
+    hr = CompileShadersFromFile(tasks);
     if (FAILED(hr))
         return hr;
 
+    ID3DBlob* blob = tasks[0].blob.Get();
     hr = device->CreateVertexShader(blob->GetBufferPointer(), blob->GetBufferSize(), nullptr, &m_pVertexShader);
     if (FAILED(hr))
         return hr;
@@ -39,50 +42,75 @@ HRESULT ModelShaders::CreateDeviceDependentResources(ID3D11Device* device)
     if (FAILED(hr))
         return hr;
 
-    defines.resize(1);
-    defines.push_back({ "HAS_EMISSIVE", "1" });
-    defines.push_back({ nullptr, nullptr });
-
-    hr = CompileShaderFromFile((wsrcPath + L"PBRShaders.fx").c_str(), "ps_main", "ps_5_0", &blob, defines.data());
+    blob = tasks[1].blob.Get();
+    hr = device->CreateVertexShader(blob->GetBufferPointer(), blob->GetBufferSize(), nullptr, &m_pCascadeVertexShader);
     if (FAILED(hr))
         return hr;
 
-    hr = device->CreatePixelShader(blob->GetBufferPointer(), blob->GetBufferSize(), nullptr, &m_pEmissivePixelShader);
+    blob = tasks[2].blob.Get();
+    hr = device->CreateGeometryShader(blob->GetBufferPointer(), blob->GetBufferSize(), nullptr, &m_pCascadeGeometryShader);
 
     return hr;
 }
 
 HRESULT ModelShaders::CreatePixelShader(ID3D11Device* device, UINT definesFlags)
+{
+    return CreatePixelShaders(device, std::vector<UINT>(1, definesFlags));
+}
+
+HRESULT ModelShaders::CreatePixelShaders(ID3D11Device* device, const std::vector<UINT>& definesFlags)
 {
     HRESULT hr = S_OK;
 
-    if (m_pPixelShaders[definesFlags])
-        return hr;
+    // Permutations that don't exist yet, each one once
+    std::vector<UINT> missingFlags;
+    for (UINT flags : definesFlags)
+    {
+        if (!m_pPixelShaders[flags] && std::find(missingFlags.begin(), missingFlags.end(), flags) == missingFlags.end())
+            missingFlags.push_back(flags);
+    }
 
-    Microsoft::WRL::ComPtr<ID3DBlob> blob;
+    std::vector<ShaderCompileTask> tasks(missingFlags.size());
+    for (size_t i = 0; i < missingFlags.size(); ++i)
+    {
+        UINT flags = missingFlags[i];
+        ShaderCompileTask& task = tasks[i];
+        task.fileName = wsrcPath + L"PBRShaders.fx";
+        task.entryPoint = "ps_main";
+        task.shaderModel = "ps_5_0";
 
-    std::vector<D3D_SHADER_MACRO> defines;
-    defines.push_back({ "HAS_TANGENT", "1" });
+        task.defines.push_back({ "HAS_TANGENT", "1" });
+        task.defines.push_back({ "HAS_BLOOM_OUTPUT", "1" });
 
-    if (definesFlags & MATERIAL_HAS_COLOR_TEXTURE)
-        defines.push_back({ "HAS_COLOR_TEXTURE", "1" });
+        if (flags & MATERIAL_HAS_COLOR_TEXTURE)
+            task.defines.push_back({ "HAS_COLOR_TEXTURE", "1" });
 
-    if (definesFlags & MATERIAL_HAS_METAL_ROUGH_TEXTURE)
-        defines.push_back({ "HAS_METAL_ROUGH_TEXTURE", "1" });
+        if (flags & MATERIAL_HAS_METAL_ROUGH_TEXTURE)
+            task.defines.push_back({ "HAS_METAL_ROUGH_TEXTURE", "1" });
 
-    if (definesFlags & MATERIAL_HAS_NORMAL_TEXTURE)
-        defines.push_back({ "HAS_NORMAL_TEXTURE", "1" });
+        if (flags & MATERIAL_HAS_NORMAL_TEXTURE)
+            task.defines.push_back({ "HAS_NORMAL_TEXTURE", "1" });
 
-    if (definesFlags & MATERIAL_HAS_OCCLUSION_TEXTURE)
-        defines.push_back({ "HAS_OCCLUSION_TEXTURE", "1" });
+        if (flags & MATERIAL_HAS_OCCLUSION_TEXTURE)
+            task.defines.push_back({ "HAS_OCCLUSION_TEXTURE", "1" });
 
-    defines.push_back({ nullptr, nullptr });
+        if (flags & MATERIAL_HAS_EMISSIVE_TEXTURE)
+            task.defines.push_back({ "HAS_EMISSIVE_TEXTURE", "1" });
 
-    hr = CompileShaderFromFile((wsrcPath + L"PBRShaders.fx").c_str(), "ps_main", "ps_5_0", &blob, defines.data());
+        if (flags & WEIGHTED_OIT)
+            task.defines.push_back({ "WEIGHTED_OIT", "1" });
+    }
+
+    hr = CompileShadersFromFile(tasks);
     if (FAILED(hr))
         return hr;
 
-    hr = device->CreatePixelShader(blob->GetBufferPointer(), blob->GetBufferSize(), nullptr, &m_pPixelShaders[definesFlags]);
+    for (size_t i = 0; i < missingFlags.size(); ++i)
+    {
+        hr = device->CreatePixelShader(tasks[i].blob->GetBufferPointer(), tasks[i].blob->GetBufferSize(), nullptr, &m_pPixelShaders[missingFlags[i]]);
+        if (FAILED(hr))
+            return hr;
+    }
 
     return hr;
 }
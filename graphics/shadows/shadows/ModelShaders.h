@@ -10,7 +10,9 @@ public:
         MATERIAL_HAS_COLOR_TEXTURE = 0x1,
         MATERIAL_HAS_METAL_ROUGH_TEXTURE = 0x2,
         MATERIAL_HAS_NORMAL_TEXTURE = 0x4,
-        MATERIAL_HAS_OCCLUSION_TEXTURE = 0x8
+        MATERIAL_HAS_OCCLUSION_TEXTURE = 0x8,
+        MATERIAL_HAS_EMISSIVE_TEXTURE = 0x10,
+        WEIGHTED_OIT = 0x20
     } MODEL_PIXEL_SHADER_DEFINES;
 
     ModelShaders();
@@ -19,16 +21,21 @@ public:
     HRESULT CreateDeviceDependentResources(ID3D11Device* device);
 
     HRESULT CreatePixelShader(ID3D11Device* device, UINT definesFlags);
+    // All missing permutations at once, they are compiled in parallel
+    HRESULT CreatePixelShaders(ID3D11Device* device, const std::vector<UINT>& definesFlags);
 
     ID3D11InputLayout* GetInputLayout() const { return m_pInputLayout.Get(); };
     ID3D11VertexShader* GetVertexShader() const { return m_pVertexShader.Get(); };
-    ID3D11PixelShader* GetEmissivePixelShader() const { return m_pEmissivePixelShader.Get(); };
+    ID3D11VertexShader* GetCascadeVertexShader() const { return m_pCascadeVertexShader.Get(); };
+    ID3D11GeometryShader* GetCascadeGeometryShader() const { return m_pCascadeGeometryShader.Get(); };
     ID3D11PixelShader* GetPixelShader(UINT definesFlags) const { return m_pPixelShaders[definesFlags].Get(); };
 
 private:
     Microsoft::WRL::ComPtr<ID3D11InputLayout>  m_pInputLayout;
     Microsoft::WRL::ComPtr<ID3D11VertexShader> m_pVertexShader;
-    Microsoft::WRL::ComPtr<ID3D11PixelShader>  m_pEmissivePixelShader;
+
+    Microsoft::WRL::ComPtr<ID3D11VertexShader>   m_pCascadeVertexShader;
+    Microsoft::WRL::ComPtr<ID3D11GeometryShader> m_pCascadeGeometryShader;
 
     std::vector<Microsoft::WRL::ComPtr<ID3D11PixelShader>> m_pPixelShaders;
 };
@@ -0,0 +1,122 @@
+#include "pch.h"
+
+#include "OITProcess.h"
+#include "Utils.h"
+
+OITProcess::OITProcess()
+{};
+
+HRESULT OITProcess::CreateDeviceDependentResources(ID3D11Device* device)
+{
+    HRESULT hr = S_OK;
+
+    m_pAccumulationTexture = std::unique_ptr<RenderTexture>(new RenderTexture(GetDXGIFormat(SelectHdrFormat(device, HDR_TEXTURE_USAGE::OIT_ACCUMULATION))));
+    m_pRevealageTexture = std::unique_ptr<RenderTexture>(new RenderTexture(DXGI_FORMAT_R16_FLOAT));
+
+    std::vector<BYTE> bytes;
+
+    // Create the vertex shader
+    hr = CreateVertexShader(device, L"CopyVertexShader.cso", bytes, &m_pVertexShader);
+    if (FAILED(hr))
+        return hr;
+
+    // Create the pixel shader
+    hr = CreatePixelShader(device, L"OITResolvePixelShader.cso", bytes, &m_pResolvePixelShader);
+    if (FAILED(hr))
+        return hr;
+
+    // Create the blend state for transparent primitives: weighted colors and emissive are summed, revealage is multiplied by (1 - alpha)
+    D3D11_BLEND_DESC bd = {};
+    bd.IndependentBlendEnable = true;
+    bd.RenderTarget[0].BlendEnable = true;
+    bd.RenderTarget[0].SrcBlend = D3D11_BLEND_ONE;
+    bd.RenderTarget[0].DestBlend = D3D11_BLEND_ONE;
+    bd.RenderTarget[0].BlendOp = D3D11_BLEND_OP_ADD;
+    bd.RenderTarget[0].SrcBlendAlpha = D3D11_BLEND_ONE;
+    bd.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_ONE;
+    bd.RenderTarget[0].BlendOpAlpha = D3D11_BLEND_OP_ADD;
+    bd.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
+    bd.RenderTarget[1].BlendEnable = true;
+    bd.RenderTarget[1].SrcBlend = D3D11_BLEND_ZERO;
+    bd.RenderTarget[1].DestBlend = D3D11_BLEND_INV_SRC_COLOR;
+    bd.RenderTarget[1].BlendOp = D3D11_BLEND_OP_ADD;
+    bd.RenderTarget[1].SrcBlendAlpha = D3D11_BLEND_ZERO;
+    bd.RenderTarget[1].DestBlendAlpha = D3D11_BLEND_INV_SRC_ALPHA;
+    bd.RenderTarget[1].BlendOpAlpha = D3D11_BLEND_OP_ADD;
+    bd.RenderTarget[1].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_RED;
+    bd.RenderTarget[2] = bd.RenderTarget[0];
+    hr = device->CreateBlendState(&bd, &m_pAccumulationBlendState);
+    if (FAILED(hr))
+        return hr;
+
+    // Create the blend state for the resolve pass
+    bd = {};
+    bd.RenderTarget[0].BlendEnable = true;
+    bd.RenderTarget[0].SrcBlend = D3D11_BLEND_SRC_ALPHA;
+    bd.RenderTarget[0].DestBlend = D3D11_BLEND_INV_SRC_ALPHA;
+    bd.RenderTarget[0].BlendOp = D3D11_BLEND_OP_ADD;
+    bd.RenderTarget[0].SrcBlendAlpha = D3D11_BLEND_ZERO;
+    bd.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_ONE;
+    bd.RenderTarget[0].BlendOpAlpha = D3D11_BLEND_OP_ADD;
+    bd.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
+    hr = device->CreateBlendState(&bd, &m_pResolveBlendState);
+
+    return hr;
+}
+
+HRESULT OITProcess::CreateWindowSizeDependentResources(ID3D11Device* device, UINT width, UINT height)
+{
+    HRESULT hr = S_OK;
+
+    hr = m_pAccumulationTexture->CreateResources(device, width, height);
+    if (FAILED(hr))
+        return hr;
+
+    hr = m_pRevealageTexture->CreateResources(device, width, height);
+
+    return hr;
+}
+
+void OITProcess::Begin(ID3D11DeviceContext* context, ID3D11RenderTargetView* bloomRenderTarget, ID3D11DepthStencilView* depthStencil, ID3D11DepthStencilState* depthStencilState)
+{
+    float zero[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    float one[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    context->ClearRenderTargetView(m_pAccumulationTexture->GetRenderTargetView(), zero);
+    context->ClearRenderTargetView(m_pRevealageTexture->GetRenderTargetView(), one);
+
+    ID3D11RenderTargetView* renderTargets[3] = { m_pAccumulationTexture->GetRenderTargetView(), m_pRevealageTexture->GetRenderTargetView(), bloomRenderTarget };
+    context->OMSetRenderTargets(3, renderTargets, depthStencil);
+    context->OMSetBlendState(m_pAccumulationBlendState.Get(), nullptr, 0xFFFFFFFF);
+    context->OMSetDepthStencilState(depthStencilState, 0);
+}
+
+void OITProcess::Resolve(ID3D11DeviceContext* context, ID3D11RenderTargetView* renderTarget, D3D11_VIEWPORT viewport)
+{
+    context->OMSetRenderTargets(1, &renderTarget, nullptr);
+    context->OMSetBlendState(m_pResolveBlendState.Get(), nullptr, 0xFFFFFFFF);
+    context->RSSetState(nullptr);
+    context->RSSetViewports(1, &viewport);
+
+    context->IASetInputLayout(nullptr);
+    context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+
+    ID3D11ShaderResourceView* srvs[2] = { m_pAccumulationTexture->GetShaderResourceView(), m_pRevealageTexture->GetShaderResourceView() };
+    context->VSSetShader(m_pVertexShader.Get(), nullptr, 0);
+    context->PSSetShader(m_pResolvePixelShader.Get(), nullptr, 0);
+    context->PSSetShaderResources(0, 2, srvs);
+
+    context->Draw(4, 0);
+
+    ID3D11ShaderResourceView* nullsrv[2] = { nullptr, nullptr };
+    context->PSSetShaderResources(0, 2, nullsrv);
+    context->OMSetBlendState(nullptr, nullptr, 0xFFFFFFFF);
+}
+
+void OITProcess::AddVideoMemory(std::vector<VideoMemoryEntry>& entries) const
+{
+    AddTextureMemory(entries, "OIT accumulation", m_pAccumulationTexture->GetRenderTarget());
+    AddTextureMemory(entries, "OIT revealage", m_pRevealageTexture->GetRenderTarget());
+}
+
+OITProcess::~OITProcess()
+{}
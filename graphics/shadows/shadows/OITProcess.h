@@ -0,0 +1,32 @@
+#pragma once
+
+#include "DeviceResources.h"
+#include "RenderTexture.h"
+#include "TextureFormats.h"
+
+// Weighted blended order independent transparency. Transparent primitives are drawn in any order
+// into the accumulation and revealage targets, then the resolve pass composites them over the scene
+class OITProcess
+{
+public:
+    OITProcess();
+    ~OITProcess();
+
+    HRESULT CreateDeviceDependentResources(ID3D11Device* device);
+    HRESULT CreateWindowSizeDependentResources(ID3D11Device* device, UINT width, UINT height);
+
+    // Clears and binds the targets, the scene depth is tested but not written. Emissive output is added to the bloom target
+    void Begin(ID3D11DeviceContext* context, ID3D11RenderTargetView* bloomRenderTarget, ID3D11DepthStencilView* depthStencil, ID3D11DepthStencilState* depthStencilState);
+    void Resolve(ID3D11DeviceContext* context, ID3D11RenderTargetView* renderTarget, D3D11_VIEWPORT viewport);
+
+    void AddVideoMemory(std::vector<VideoMemoryEntry>& entries) const;
+
+private:
+    Microsoft::WRL::ComPtr<ID3D11VertexShader> m_pVertexShader;
+    Microsoft::WRL::ComPtr<ID3D11PixelShader>  m_pResolvePixelShader;
+    Microsoft::WRL::ComPtr<ID3D11BlendState>   m_pAccumulationBlendState;
+    Microsoft::WRL::ComPtr<ID3D11BlendState>   m_pResolveBlendState;
+
+    std::unique_ptr<RenderTexture> m_pAccumulationTexture;
+    std::unique_ptr<RenderTexture> m_pRevealageTexture;
+};
@@ -0,0 +1 @@
+#include "OITShaders.fx"
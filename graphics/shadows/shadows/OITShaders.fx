@@ -0,0 +1,22 @@
+Texture2D<float4> accumulationTexture : register(t0);
+Texture2D<float> revealageTexture : register(t1);
+
+static const float MIN_ACCUMULATED_ALPHA = 1e-5f;
+
+struct PS_INPUT
+{
+    float4 Pos : SV_POSITION;
+    float2 Tex : TEXCOORD;
+};
+
+// Keep in sync with ResolveOIT in WeightedBlendedOIT.cpp, the result is blended with SRC_ALPHA, INV_SRC_ALPHA
+float4 ps_oit_resolve_main(PS_INPUT input) : SV_TARGET
+{
+    int3 coord = int3(input.Pos.xy, 0);
+    float revealage = revealageTexture.Load(coord);
+    if (revealage == 1.0f)
+        discard;
+
+    float4 accumulation = accumulationTexture.Load(coord);
+    return float4(accumulation.rgb / max(accumulation.a, MIN_ACCUMULATED_ALPHA), 1.0f - revealage);
+}
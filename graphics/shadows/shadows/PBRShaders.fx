@@ -1,15 +1,29 @@
-#define NUM_LIGHTS 1
+#define NUM_LIGHTS 3
 
-TextureCube irradianceTexture : register(t0);
 TextureCube prefilteredColorTexture : register(t1);
-Texture2D<float4> preintegratedBRDFTexture : register(t2);
+Texture2D<float2> preintegratedBRDFTexture : register(t2);
 
 Texture2D<float4> diffuseTexture : register(t3);
 Texture2D<float4> metallicRoughnessTexture : register(t4);
 Texture2D<float4> normalTexture : register(t5);
 
-Texture2D simpleShadowMapTexture : register(t6);
-Texture2DArray PSSMTexture : register(t7);
+Texture2D shadowAtlasTexture : register(t6);
+
+Texture2D<float4> emissiveTexture : register(t8);
+
+// Same layout as PointLight in LightClusters.h
+struct PointLight
+{
+    float3 Position;
+    float Range;
+    float3 Color;
+    float Intensity;
+};
+
+// Lights of every cluster are the range (offset, count) of the index list
+StructuredBuffer<PointLight> pointLights : register(t9);
+StructuredBuffer<uint2> lightClusters : register(t10);
+StructuredBuffer<uint> lightIndices : register(t11);
 
 SamplerState MinMagMipLinear : register(s0);
 SamplerState MinMagLinearMipPointClamp : register(s1);
@@ -18,7 +32,6 @@ SamplerState MinMagMipLinearBorder : register(s3);
 SamplerComparisonState MinMagMipLinearBorderLess : register(s4);
 
 static const float PI = 3.14159265358979323846f;
-static const float MAX_REFLECTION_LOD = 4.0f;
 
 cbuffer Transformation: register(b0)
 {
@@ -43,16 +56,39 @@ cbuffer Material : register(b2)
 	float Metalness;
 }
 
+// Shadow maps of all lights are tiles of one atlas, the transforms map into the atlas
+// and the rects are the tile bounds in atlas uv
 cbuffer Shadows : register(b3)
 {
-    matrix SimpleShadowTransform;
-    matrix PSSMTransform[4];
+    matrix SimpleShadowTransforms[NUM_LIGHTS];
+    float4 SimpleShadowRects[NUM_LIGHTS];
+    matrix PSSMTransforms[NUM_LIGHTS * 4];
+    float4 PSSMRects[NUM_LIGHTS * 4];
     float4 PSSMBorders;
     bool UseShadowPCF;
     bool UseShadowPSSM;
     bool ShowPSSMSplits;
 }
 
+cbuffer ShadowCascades : register(b4)
+{
+    matrix CascadeViewProjection[4];
+    uint4 CascadeSlices;
+}
+
+// Grid is (tiles x, tiles y, slices, light count), params are (slice scale, slice bias, 1 / width, 1 / height)
+cbuffer LightClusters : register(b5)
+{
+    uint4 ClusterGrid;
+    float4 ClusterParams;
+}
+
+// L2 spherical harmonics of the environment's irradiance divided by pi, the basis constants are folded in (IBLBaker.h)
+cbuffer Irradiance : register(b6)
+{
+    float4 IrradianceSH[9];
+}
+
 struct VS_INPUT
 {
     float3 Normal : NORMAL;
@@ -91,6 +127,39 @@ PS_INPUT vs_main(VS_INPUT input)
     return output;
 }
 
+struct VS_CASCADE_OUTPUT
+{
+    float4 Pos : SV_POSITION;
+    uint Slice : SLICE;
+};
+
+struct GS_CASCADE_OUTPUT
+{
+    float4 Pos : SV_POSITION;
+    uint Slice : SV_ViewportArrayIndex;
+};
+
+// Every instance draws the primitive into one cascade, the viewport of its atlas tile
+VS_CASCADE_OUTPUT vs_cascade_main(VS_INPUT input, uint instance : SV_InstanceID)
+{
+    VS_CASCADE_OUTPUT output = (VS_CASCADE_OUTPUT)0;
+    output.Slice = CascadeSlices[instance];
+    output.Pos = mul(mul(float4(input.Pos, 1.0f), World), CascadeViewProjection[output.Slice]);
+    return output;
+}
+
+[maxvertexcount(3)]
+void gs_cascade_main(triangle VS_CASCADE_OUTPUT input[3], inout TriangleStream<GS_CASCADE_OUTPUT> stream)
+{
+    GS_CASCADE_OUTPUT output;
+    for (uint i = 0; i < 3; ++i)
+    {
+        output.Pos = input[i].Pos;
+        output.Slice = input[i].Slice;
+        stream.Append(output);
+    }
+}
+
 float3 h(float3 v, float3 l) 
 {
     return normalize(v + l);
@@ -151,67 +220,130 @@ float Attenuation(float3 lightDir, float2 attenuation)
     return 1 / max(factor, 1e-9);
 }
 
-float GetShadowFactor(matrix transformation, float3 pos)
+// Rects are shrunk by half a texel, so filtering inside them never reads the neighbour tiles
+bool IsInShadowTile(float4 proj, float4 rect)
 {
-    float4 proj = mul(float4(pos, 1.0f), transformation);
-    if (UseShadowPCF)
-        return simpleShadowMapTexture.SampleCmpLevelZero(MinMagMipLinearBorderLess, proj.xy, proj.z).r;
-    else
-        return (simpleShadowMapTexture.Sample(MinMagMipLinearBorder, proj.xy).r > proj.z) ? 1 : 0;
+    return all(proj.xy >= rect.xy) && all(proj.xy <= rect.zw);
 }
 
-float GetShadowFactorArray(matrix transformation, float3 pos, int idx)
+float SampleShadowAtlas(float4 proj)
 {
-    float4 proj = mul(float4(pos, 1.0f), transformation);
     if (UseShadowPCF)
-        return PSSMTexture.SampleCmpLevelZero(MinMagMipLinearBorderLess, float3(proj.xy, idx), proj.z).r;
+        return shadowAtlasTexture.SampleCmpLevelZero(MinMagMipLinearBorderLess, proj.xy, proj.z).r;
     else
-        return (PSSMTexture.Sample(MinMagMipLinearBorder, float3(proj.xy, idx)).r > proj.z) ? 1 : 0;
+        return (shadowAtlasTexture.Sample(MinMagMipLinearBorder, proj.xy).r > proj.z) ? 1 : 0;
 }
 
-float GetShadowPSSMFactor(float3 pos)
+float GetShadowFactor(uint lightIndex, float3 pos)
 {
-    float dist = dot(pos - CameraPos.xyz, CameraDir.xyz);
-    if (dist < PSSMBorders.x)
-        return GetShadowFactorArray(PSSMTransform[0], pos, 0);
-    else if (dist < PSSMBorders.y)
-        return GetShadowFactorArray(PSSMTransform[1], pos, 1);
-    else if (dist < PSSMBorders.z)
-        return GetShadowFactorArray(PSSMTransform[2], pos, 2);
-    else if (dist < PSSMBorders.w)
-        return GetShadowFactorArray(PSSMTransform[3], pos, 3);
-    else
+    float4 proj = mul(float4(pos, 1.0f), SimpleShadowTransforms[lightIndex]);
+    if (!IsInShadowTile(proj, SimpleShadowRects[lightIndex]))
         return 1.0f;
+    return SampleShadowAtlas(proj);
+}
+
+// Cascades that weren't rendered this frame keep the transform of their map,
+// positions outside of such a cascade fall back to the next (coarser) one
+float GetShadowPSSMFactor(uint lightIndex, float3 pos)
+{
+    float dist = dot(pos - CameraPos.xyz, CameraDir.xyz);
+    float borders[4] = { PSSMBorders.x, PSSMBorders.y, PSSMBorders.z, PSSMBorders.w };
+    [unroll]
+    for (uint i = 0; i < 4; ++i)
+    {
+        if (dist < borders[i])
+        {
+            uint cascade = lightIndex * 4 + i;
+            float4 proj = mul(float4(pos, 1.0f), PSSMTransforms[cascade]);
+            if (IsInShadowTile(proj, PSSMRects[cascade]))
+                return SampleShadowAtlas(proj);
+        }
+    }
+    return 1.0f;
 }
 
 float3 LO_i(float3 p, float3 n, float3 v, uint lightIndex, float3 pos, float3 albedo, float metalness, float roughness)
 {
-    float3 lightDir = LightPositions[lightIndex].xyz;
+    // Lights that are off have no shadow tiles to sample
     float4 lightColor = LightColors[lightIndex];
+    if (lightColor.a <= 0)
+        return 0.0f;
+
+    float3 lightDir = LightPositions[lightIndex].xyz;
     float atten = Attenuation(lightDir, LightAttenuations[lightIndex].xy);
 	float3 l = normalize(lightDir);
     float shadowFactor = 1;
     if (UseShadowPSSM)
-        shadowFactor = GetShadowPSSMFactor(pos);
+        shadowFactor = GetShadowPSSMFactor(lightIndex, pos);
     else
-        shadowFactor = GetShadowFactor(SimpleShadowTransform, pos);
+        shadowFactor = GetShadowFactor(lightIndex, pos);
     return BRDF(p, n, v, l, albedo, metalness, roughness) * lightColor.rgb * atten * max(dot(l, n), 0) * lightColor.a * shadowFactor;
 }
 
+// Falloff reaches zero at the light range, so lights never touch clusters they weren't assigned to
+float PointLightFalloff(float d, float range)
+{
+    float ratio = d / range;
+    float window = saturate(1 - ratio * ratio * ratio * ratio);
+    return window * window / (d * d + 1);
+}
+
+float3 ClusteredPointLights(float3 pos, float2 screenPos, float3 n, float3 v, float3 albedo, float metalness, float roughness)
+{
+    if (ClusterGrid.w == 0)
+        return 0.0f;
+
+    // Slices are exponential in the view depth, everything closer than the near distance is in the first one
+    float depth = dot(pos - CameraPos.xyz, CameraDir.xyz);
+    int slice = max(int(floor(log(max(depth, 1e-4f)) * ClusterParams.x + ClusterParams.y)), 0);
+    if (slice >= int(ClusterGrid.z))
+        return 0.0f;
+
+    uint2 tile = min(uint2(screenPos * ClusterParams.zw * ClusterGrid.xy), ClusterGrid.xy - 1);
+    uint2 range = lightClusters[(slice * ClusterGrid.y + tile.y) * ClusterGrid.x + tile.x];
+
+    float3 color = 0.0f;
+    for (uint i = 0; i < range.y; ++i)
+    {
+        PointLight light = pointLights[lightIndices[range.x + i]];
+        float3 lightDir = light.Position - pos;
+        float d = length(lightDir);
+        if (d >= light.Range)
+            continue;
+
+        float3 l = lightDir / max(d, 1e-4f);
+        float atten = PointLightFalloff(d, light.Range);
+        color += BRDF(pos, n, v, l, albedo, metalness, roughness) * light.Color * light.Intensity * atten * max(dot(l, n), 0);
+    }
+    return color;
+}
+
 float3 FresnelSchlickRoughnessFunction(float3 F0, float3 n, float3 v, float roughness)
 {
     return F0 + (max(1 - roughness, F0) - F0) * pow(1 - max(dot(n, v), 0), 5);
 }
 
+float3 IrradianceFromSH(float3 n)
+{
+    float3 irradiance = IrradianceSH[0].rgb;
+    irradiance += IrradianceSH[1].rgb * n.y + IrradianceSH[2].rgb * n.z + IrradianceSH[3].rgb * n.x;
+    irradiance += IrradianceSH[4].rgb * (n.x * n.y) + IrradianceSH[5].rgb * (n.y * n.z) + IrradianceSH[6].rgb * (3.0f * n.z * n.z - 1.0f);
+    irradiance += IrradianceSH[7].rgb * (n.x * n.z) + IrradianceSH[8].rgb * (n.x * n.x - n.y * n.y);
+    return max(irradiance, 0.0f);
+}
+
 float3 Ambient(float3 n, float3 v, float3 albedo, float metalness, float roughness)
 {
     float3 r = normalize(reflect(-v, n));
-    float3 prefilteredColor = prefilteredColorTexture.SampleLevel(MinMagMipLinear, r, roughness * MAX_REFLECTION_LOD).rgb;
+    // Levels of the prefiltered cube span roughness 0 to 1, their count is a bake setting
+    uint size, levels;
+    prefilteredColorTexture.GetDimensions(0, size, size, levels);
+    float3 prefilteredColor = prefilteredColorTexture.SampleLevel(MinMagMipLinear, r, roughness * (levels - 1)).rgb;
     float3 F0 = lerp(float3(0.04, 0.04, 0.04), albedo, metalness);
-    float2 envBRDF = preintegratedBRDFTexture.Sample(MinMagLinearMipPointClamp, float2(dot(n, v), roughness)).xy;
+    float2 envBRDF = preintegratedBRDFTexture.Sample(MinMagLinearMipPointClamp, float2(dot(n, v), roughness));
     float3 specular = prefilteredColor * (F0 * envBRDF.x + envBRDF.y);
 
-    float3 irradiance = irradianceTexture.Sample(MinMagMipLinear, n).rgb;
+    float3 irradiance = IrradianceFromSH(n);
     float3 F = FresnelSchlickRoughnessFunction(F0, n, v, roughness);
     return (1 - F) * irradiance * albedo * (1 - metalness) + specular;
 }
@@ -254,15 +386,12 @@ float3 GetPSSMSplitColor(float3 pos)
         return float3(0.5f, 0.5f, 0.5f);
 }
 
-float4 ps_main(PS_INPUT input) : SV_TARGET
+float4 Shade(PS_INPUT input)
 {
 	float3 color1, color2, color3;
 	float3 v = normalize(CameraPos.xyz - input.WorldPos.xyz);
     float3 n = normalize(input.Normal);
 
-#ifdef HAS_EMISSIVE
-    return diffuseTexture.Sample(ModelSampler, input.Tex);
-#else
 #ifdef HAS_NORMAL_TEXTURE
     float3 nm = (normalTexture.Sample(ModelSampler, input.Tex) * 2.0f - 1.0f).xyz;
     float3 tangent = input.Tangent;
@@ -281,6 +410,7 @@ float4 ps_main(PS_INPUT input) : SV_TARGET
     [unroll]
     for (uint i = 0; i < NUM_LIGHTS; ++i)
         color += LO_i(input.WorldPos.xyz, n, v, i, input.WorldPos.xyz, albedo.rgb, metalness, roughness);
+    color += ClusteredPointLights(input.WorldPos.xyz, input.Pos.xy, n, v, albedo.rgb, metalness, roughness);
 
     float3 ambient = Ambient(n, v, albedo.rgb, metalness, roughness);
 
@@ -293,5 +423,63 @@ float4 ps_main(PS_INPUT input) : SV_TARGET
     }
 
     return result;
+}
+
+float4 GetEmissive(float2 uv)
+{
+#ifdef HAS_EMISSIVE_TEXTURE
+    return emissiveTexture.Sample(ModelSampler, uv);
+#else
+    return 0.0f;
 #endif
 }
+
+#if defined(WEIGHTED_OIT)
+struct PS_OIT_OUTPUT
+{
+    float4 Accumulation : SV_TARGET0;
+    float Revealage : SV_TARGET1;
+    float4 Bloom : SV_TARGET2;
+};
+
+// Keep in sync with OITWeight in WeightedBlendedOIT.cpp
+float OITWeight(float alpha, float viewDepth)
+{
+    float z = abs(viewDepth);
+    float weight = 10.0f / (1e-5f + pow(z / 5.0f, 2) + pow(z / 200.0f, 6));
+    return alpha * clamp(weight, 1e-2f, 3e3f);
+}
+
+PS_OIT_OUTPUT ps_main(PS_INPUT input)
+{
+    float4 color = Shade(input);
+    float weight = OITWeight(color.a, dot(input.WorldPos.xyz - CameraPos.xyz, CameraDir.xyz));
+
+    PS_OIT_OUTPUT output;
+    output.Accumulation = float4(color.rgb * color.a, color.a) * weight;
+    output.Revealage = color.a;
+    // Bloom target is additive in this mode
+    output.Bloom = float4(GetEmissive(input.Tex).rgb * color.a, 0.0f);
+    return output;
+}
+#elif defined(HAS_BLOOM_OUTPUT)
+struct PS_OUTPUT
+{
+    float4 Color : SV_TARGET0;
+    float4 Bloom : SV_TARGET1;
+};
+
+// Emissive part goes to the bloom target in the same pass, it is zero (and fully transparent) for other materials
+PS_OUTPUT ps_main(PS_INPUT input)
+{
+    PS_OUTPUT output;
+    output.Color = Shade(input);
+    output.Bloom = GetEmissive(input.Tex);
+    return output;
+}
+#else
+float4 ps_main(PS_INPUT input) : SV_TARGET
+{
+    return Shade(input);
+}
+#endif
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <future>
+#include <thread>
+#include <vector>
+
+// Runs function(i) for every i below count, workers take the next index until none are left.
+// A thread count of 0 means one worker per hardware thread.
+template <typename Function>
+void ParallelFor(uint32_t count, unsigned int threadCount, const Function& function)
+{
+    if (threadCount == 0)
+        threadCount = std::thread::hardware_concurrency();
+    if (threadCount == 0)
+        threadCount = 1;
+    if (threadCount > count)
+        threadCount = count;
+
+    std::atomic<uint32_t> next(0);
+    auto work = [&]()
+    {
+        for (uint32_t i = next++; i < count; i = next++)
+            function(i);
+    };
+
+    std::vector<std::future<void>> workers;
+    for (unsigned int t = 1; t < threadCount; ++t)
+        workers.push_back(std::async(std::launch::async, work));
+    work();
+    for (std::future<void>& worker : workers)
+        worker.get();
+}
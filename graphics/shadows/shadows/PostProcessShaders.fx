@@ -4,10 +4,8 @@ SamplerState MinMagMipLinear : register(s0);
 
 static const float EXPOSURE_RATIO = 7.0f;
 
-cbuffer AverageLuminanceBuffer : register(b0)
-{
-    float AverageLuminance;
-}
+// Written by the luminance histogram on the GPU or uploaded from the average luminance readback
+Buffer<float> adaptedLuminance : register(t1);
 
 struct PS_INPUT
 {
@@ -37,7 +35,7 @@ float4 ps_luminance_main(PS_INPUT input) : SV_TARGET
 
 float Exposure()
 {
-    float luminance = AverageLuminance;
+    float luminance = adaptedLuminance[0];
     float keyValue = 1.03 - 2 / (2 + log10(luminance + 1));
     return keyValue / luminance;
 }
@@ -1 +0,0 @@
-#include "IBLShaders.fx"
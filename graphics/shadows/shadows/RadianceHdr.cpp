@@ -0,0 +1,236 @@
+#include "RadianceHdr.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "CpuTrace.h"
+#include "ParallelFor.h"
+#include "SimdFloat4.h"
+
+// stb_image cuts header lines at this length and rejects larger images
+const size_t hdrMaxLineLength = 1023;
+const long hdrMaxDimension = 1 << 24;
+// Only scanlines of these widths can be run length encoded
+const uint32_t hdrMinEncodedWidth = 8;
+const uint32_t hdrMaxEncodedWidth = 32767;
+const uint32_t hdrRowsPerTask = 16;
+
+// Up to the next new line or the end of the data
+static void ReadHeaderLine(const uint8_t* data, size_t size, size_t& offset, std::string& line)
+{
+    line.clear();
+    for (; offset < size && data[offset] != '\n'; ++offset)
+    {
+        if (line.size() < hdrMaxLineLength)
+            line.push_back(static_cast<char>(data[offset]));
+    }
+    if (offset < size)
+        ++offset;
+}
+
+static bool ReadHeader(const uint8_t* data, size_t size, uint32_t& width, uint32_t& height, size_t& offset)
+{
+    offset = 0;
+    std::string line;
+    ReadHeaderLine(data, size, offset, line);
+    if (line != "#?RADIANCE" && line != "#?RGBE")
+        return false;
+
+    // The variables end with an empty line
+    bool rgbe = false;
+    do
+    {
+        if (offset == size)
+            return false;
+        ReadHeaderLine(data, size, offset, line);
+        if (line == "FORMAT=32-bit_rle_rgbe")
+            rgbe = true;
+    } while (!line.empty());
+    if (!rgbe)
+        return false;
+
+    ReadHeaderLine(data, size, offset, line);
+    const char* token = line.c_str();
+    if (strncmp(token, "-Y ", 3) != 0)
+        return false;
+    char* end = nullptr;
+    long rows = strtol(token + 3, &end, 10);
+    for (token = end; *token == ' '; ++token);
+    if (strncmp(token, "+X ", 3) != 0)
+        return false;
+    long columns = strtol(token + 3, nullptr, 10);
+
+    if (rows <= 0 || rows > hdrMaxDimension || columns <= 0 || columns > hdrMaxDimension)
+        return false;
+    width = static_cast<uint32_t>(columns);
+    height = static_cast<uint32_t>(rows);
+    return true;
+}
+
+// Encoded scanlines start with 2, 2 and the width in two bytes, a flat texel can't since one of its colors is at least 128
+static bool IsEncodedScanline(const uint8_t* data, size_t size)
+{
+    return size >= 4 && data[0] == 2 && data[1] == 2 && (data[2] & 0x80) == 0;
+}
+
+// Walks the run lengths without decoding them, every run has to stay within its scanline and the data
+static bool IndexScanlines(const uint8_t* data, size_t size, size_t offset, uint32_t width, uint32_t height, std::vector<size_t>& scanlines)
+{
+    scanlines.resize(height);
+    for (uint32_t row = 0; row < height; ++row)
+    {
+        if (!IsEncodedScanline(data + offset, size - offset) || static_cast<uint32_t>((data[offset + 2] << 8) | data[offset + 3]) != width)
+            return false;
+        scanlines[row] = offset;
+        offset += 4;
+
+        for (uint32_t channel = 0; channel < 4; ++channel)
+        {
+            for (uint32_t x = 0; x < width;)
+            {
+                if (offset == size)
+                    return false;
+                uint32_t count = data[offset];
+                if (count > 128)
+                {
+                    count -= 128;
+                    if (count > width - x || size - offset < 2)
+                        return false;
+                    offset += 2;
+                }
+                else
+                {
+                    // stb_image never finishes a scanline with an empty copy in it
+                    if (count == 0 || count > width - x || size - offset - 1 < count)
+                        return false;
+                    offset += 1 + count;
+                }
+                x += count;
+            }
+        }
+    }
+    return true;
+}
+
+// Red, green, blue and exponent planes of width bytes each
+static void DecodeScanline(const uint8_t* data, uint32_t width, uint8_t* planes)
+{
+    data += 4;
+    for (uint32_t channel = 0; channel < 4; ++channel)
+    {
+        uint8_t* plane = planes + channel * width;
+        for (uint32_t x = 0; x < width;)
+        {
+            uint32_t count = *data++;
+            if (count > 128)
+            {
+                count -= 128;
+                memset(plane + x, *data++, count);
+            }
+            else
+            {
+                memcpy(plane + x, data, count);
+                data += count;
+            }
+            x += count;
+        }
+    }
+}
+
+static void DeinterleaveScanline(const uint8_t* data, uint32_t width, uint8_t* planes)
+{
+    for (uint32_t x = 0; x < width; ++x)
+    {
+        for (uint32_t channel = 0; channel < 4; ++channel)
+            planes[channel * width + x] = data[4 * x + channel];
+    }
+}
+
+// Four texels at a time: the colors are scaled as four components each and transposed into texels. The products are
+// the same single rounding of a byte times a power of two that stb_image does.
+static void ConvertScanline(const uint8_t* planes, uint32_t width, const float scales[256], float* pixels)
+{
+    const uint8_t* red = planes;
+    const uint8_t* green = planes + width;
+    const uint8_t* blue = planes + 2 * width;
+    const uint8_t* exponent = planes + 3 * width;
+
+    uint32_t x = 0;
+    for (; x + 4 <= width; x += 4)
+    {
+        float texelScales[4] = { scales[exponent[x]], scales[exponent[x + 1]], scales[exponent[x + 2]], scales[exponent[x + 3]] };
+        SimdFloat4 scale = SimdFloat4::Load(texelScales);
+        SimdFloat4 r = SimdFloat4::LoadBytes(red + x) * scale;
+        SimdFloat4 g = SimdFloat4::LoadBytes(green + x) * scale;
+        SimdFloat4 b = SimdFloat4::LoadBytes(blue + x) * scale;
+        SimdFloat4 a = SimdFloat4::Replicate(1.0f);
+        Transpose(r, g, b, a);
+        r.Store(pixels + 4 * x);
+        g.Store(pixels + 4 * x + 4);
+        b.Store(pixels + 4 * x + 8);
+        a.Store(pixels + 4 * x + 12);
+    }
+    for (; x < width; ++x)
+    {
+        float scale = scales[exponent[x]];
+        pixels[4 * x] = red[x] * scale;
+        pixels[4 * x + 1] = green[x] * scale;
+        pixels[4 * x + 2] = blue[x] * scale;
+        pixels[4 * x + 3] = 1.0f;
+    }
+}
+
+bool DecodeRadianceHdr(const uint8_t* data, size_t size, EnvironmentImage& image, unsigned int threadCount)
+{
+    CPU_TRACE_SCOPE("DecodeRadianceHdr");
+
+    uint32_t width, height;
+    size_t offset;
+    if (!ReadHeader(data, size, width, height, offset))
+        return false;
+
+    // Images too narrow or too wide for the encoding are flat, and so are those whose first scanline isn't encoded
+    bool flat = width < hdrMinEncodedWidth || width > hdrMaxEncodedWidth || !IsEncodedScanline(data + offset, size - offset);
+    std::vector<size_t> scanlines;
+    if (flat)
+    {
+        if ((size - offset) / 4 / width < height)
+            return false;
+    }
+    else
+    {
+        CPU_TRACE_SCOPE("IndexScanlines");
+        if (!IndexScanlines(data, size, offset, width, height, scanlines))
+            return false;
+    }
+
+    // A zero exponent is black whatever the colors are
+    float scales[256];
+    scales[0] = 0.0f;
+    for (int e = 1; e < 256; ++e)
+        scales[e] = static_cast<float>(std::ldexp(1.0, e - 136));
+
+    image.width = width;
+    image.height = height;
+    image.pixels.resize(4 * static_cast<size_t>(width) * height);
+
+    uint32_t taskCount = (height + hdrRowsPerTask - 1) / hdrRowsPerTask;
+    ParallelFor(taskCount, threadCount, [&](uint32_t task)
+    {
+        std::vector<uint8_t> planes(4 * static_cast<size_t>(width));
+        uint32_t endRow = (task + 1) * hdrRowsPerTask < height ? (task + 1) * hdrRowsPerTask : height;
+        for (uint32_t row = task * hdrRowsPerTask; row < endRow; ++row)
+        {
+            if (flat)
+                DeinterleaveScanline(data + offset + 4 * static_cast<size_t>(width) * row, width, planes.data());
+            else
+                DecodeScanline(data + scanlines[row], width, planes.data());
+            ConvertScanline(planes.data(), width, scales, image.pixels.data() + 4 * static_cast<size_t>(width) * row);
+        }
+    });
+
+    return true;
+}
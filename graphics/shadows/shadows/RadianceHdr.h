@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "IBLBaker.h"
+
+// Decodes a Radiance RGBE image (.hdr) to RGBA floats with alpha 1. The result is bit for bit what stb_image's
+// stbi_loadf gives for every file it reads correctly; like stb_image only the -Y +X orientation is supported and
+// scanlines are either all run length encoded or all flat. Truncated and corrupt files fail instead of decoding garbage.
+// A serial pass over the run lengths finds where every scanline starts, threadCount workers (0 for one per hardware
+// thread) then decode them.
+bool DecodeRadianceHdr(const uint8_t* data, size_t size, EnvironmentImage& image, unsigned int threadCount = 0);
@@ -3,24 +3,49 @@
 #define _USE_MATH_DEFINES
 
 #include <math.h>
+#include <algorithm>
+#include <chrono>
 #include <vector>
+#include <random>
 
 #include "Renderer.h"
 #include "Utils.h"
+#include "CpuTrace.h"
+#include "MappedFile.h"
+#include "RadianceHdr.h"
 
-#include "../../stb_image.h"
 #include "../../DDSTextureLoader11.h"
 
 const float sphereRadius = 0.5f;
 const UINT cubeSize = 512;
-const UINT irradianceSize = 32;
 const UINT prefilteredColorSize = 128;
+const UINT prefilteredColorLevels = 5;
 const UINT preintegratedBRDFSize = 128;
-const UINT simpleShadowMapSize = 1024;
-const UINT PSSMSize = 1024;
-const float PSSMSplit = 250.0f;
+// BC6H quarters the baked cubes again after RGB9E5 but costs a visible loss and a slow startup encode
+const bool compressBakedCubes = false;
+// The fit skips the one time integration, at a visible loss of accuracy on rough surfaces
+const bool preintegratedBRDFAnalyticFit = false;
+const UINT shadowAtlasSize = 4096;
+const UINT shadowTileMinSize = 128;
+const UINT shadowTileMaxSize = 2048;
+const float PSSMDistance = 1000.0f;
+const float projectionFovY = DirectX::XM_PIDIV2;
 const float projectionNear = 0.1f;
 const float projectionFar = 10000.0f;
+const UINT pointLightSeed = 1234;
+const char* const gpuTimingsLogPath = "gpu_timings.csv";
+const char* const cpuTracePath = "cpu_trace.json";
+const char* const iblCacheDirectory = "IBLCache";
+const Model::ShadersSlots modelSlots = { 3, 4, 5, 8, 2, 0, 2 };
+
+static IBLBakeSettings GetIBLBakeSettings()
+{
+    IBLBakeSettings settings;
+    settings.cubeSize = cubeSize;
+    settings.prefilteredSize = prefilteredColorSize;
+    settings.prefilteredLevels = prefilteredColorLevels;
+    return settings;
+}
 
 Renderer::Renderer(const std::shared_ptr<DeviceResources>& deviceResources, const std::shared_ptr<Camera>& camera, const std::shared_ptr<Settings>& settings) :
     m_pDeviceResources(deviceResources),
@@ -33,23 +58,46 @@ Renderer::Renderer(const std::shared_ptr<DeviceResources>& deviceResources, cons
     m_lightBufferData(),
     m_materialBufferData(),
     m_shadowBufferData(),
+    m_environmentBufferData(),
     m_sceneCenter(),
-    m_sceneRadius(0)
-{};
+    m_sceneRadius(0),
+    m_PSSMCache(NUM_LIGHTS * 4),
+    m_simpleShadowValid(false),
+    m_shadowAtlas(shadowAtlasSize),
+    m_cascadeSchedulers(NUM_LIGHTS, CascadeUpdateScheduler(4)),
+    m_shadowCascadesData(),
+    m_cascadesInstanced(false),
+    m_perCascadeShadowDrawCount(0),
+    m_environmentBakeKey(0)
+{
+    m_shadowAtlas.SetTileSizeLimits(shadowTileMinSize, shadowTileMaxSize);
+};
 
 HRESULT Renderer::CreateShaders()
 {
+    CPU_TRACE_SCOPE("Renderer::CreateShaders");
+
     HRESULT hr = S_OK;
 
     std::vector<BYTE> bytes;
     ID3D11Device* device = m_pDeviceResources->GetDevice();
 
-    // Create the vertex shader for environment
+    // Create the vertex shader for environment, it takes no vertices
     hr = CreateVertexShader(device, L"EnvironmentVertexShader.cso", bytes, &m_pEnvironmentVertexShader);
     if (FAILED(hr))
         return hr;
 
-    // Define the input layout
+    // Create the pixel shader for environment
+    hr = CreatePixelShader(device, L"EnvironmentPixelShader.cso", bytes, &m_pEnvironmentPixelShader);
+    if (FAILED(hr))
+        return hr;
+
+    // Create the vertex shader
+    hr = CreateVertexShader(device, L"PBRVertexShader.cso", bytes, &m_pPBRVertexShader);
+    if (FAILED(hr))
+        return hr;
+
+    // Define the input layout of the sphere and the plane, checked against the PBR vertex shader
     D3D11_INPUT_ELEMENT_DESC layout[] =
     {
         { "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
@@ -63,16 +111,6 @@ HRESULT Renderer::CreateShaders()
     if (FAILED(hr))
         return hr;
 
-    // Create the pixel shader for environment
-    hr = CreatePixelShader(device, L"EnvironmentPixelShader.cso", bytes, &m_pEnvironmentPixelShader);
-    if (FAILED(hr))
-        return hr;
-
-    // Create the vertex shader
-    hr = CreateVertexShader(device, L"PBRVertexShader.cso", bytes, &m_pPBRVertexShader);
-    if (FAILED(hr))
-        return hr;
-
     // Create the pixel shader
     hr = CreatePixelShader(device, L"PBRPixelShader.cso", bytes, &m_pPixelShader);
     if (FAILED(hr))
@@ -93,45 +131,8 @@ HRESULT Renderer::CreateShaders()
     if (FAILED(hr))
         return hr;
 
-    // Create the vertex shader for irradiance
-    hr = CreateVertexShader(device, L"IBLVertexShader.cso", bytes, &m_pIBLVertexShader);
-    if (FAILED(hr))
-        return hr;
-
-    // Define the input layout for IBL
-    D3D11_INPUT_ELEMENT_DESC irradianceLayout[] =
-    {
-        { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 }
-    };
-    numElements = ARRAYSIZE(irradianceLayout);
-
-    // Create the input layout
-    hr = m_pDeviceResources->GetDevice()->CreateInputLayout(irradianceLayout, numElements, bytes.data(), bytes.size(), &m_pIBLInputLayout);
-    if (FAILED(hr))
-        return hr;
-
-    // Create the pixel shader for irradiance
-    hr = CreatePixelShader(device, L"IrradiancePixelShader.cso", bytes, &m_pIrradiancePixelShader);
-    if (FAILED(hr))
-        return hr;
-
-    // Create the vertex shader for environment cube
-    hr = CreateVertexShader(device, L"EnvironmentCubeVertexShader.cso", bytes, &m_pEnvironmentCubeVertexShader);
-    if (FAILED(hr))
-        return hr;
-
-    // Create the pixel shader for environment cube
-    hr = CreatePixelShader(device, L"EnvironmentCubePixelShader.cso", bytes, &m_pEnvironmentCubePixelShader);
-    if (FAILED(hr))
-        return hr;
-
-    // Create the pixel shader for prefiltered color
-    hr = CreatePixelShader(device, L"PrefilteredColorPixelShader.cso", bytes, &m_pPrefilteredColorPixelShader);
-    if (FAILED(hr))
-        return hr;
-
-    // Create the pixel shader for preintegrated BRDF
-    hr = CreatePixelShader(device, L"PreintegratedBRDFPixelShader.cso", bytes, &m_pPreintegratedBRDFPixelShader);
+    // Create the vertex shader for shadow atlas tiles clearing
+    hr = CreateVertexShader(device, L"ShadowClearVertexShader.cso", bytes, &m_pShadowClearVertexShader);
     if (FAILED(hr))
         return hr;
 
@@ -164,12 +165,26 @@ HRESULT Renderer::CreateShaders()
     // Create the constant buffer for shadows variables
     CD3D11_BUFFER_DESC cbsd(sizeof(ShadowConstantBuffer), D3D11_BIND_CONSTANT_BUFFER);
     hr = device->CreateBuffer(&cbsd, nullptr, &m_pShadowBuffer);
+    if (FAILED(hr))
+        return hr;
+
+    // Create the constant buffer for single pass shadow cascades
+    CD3D11_BUFFER_DESC cbscd(sizeof(ShadowCascadesConstantBuffer), D3D11_BIND_CONSTANT_BUFFER);
+    hr = device->CreateBuffer(&cbscd, nullptr, &m_pShadowCascadesBuffer);
+    if (FAILED(hr))
+        return hr;
+
+    // Create the constant buffer for the sky rays
+    CD3D11_BUFFER_DESC cbed(sizeof(EnvironmentConstantBuffer), D3D11_BIND_CONSTANT_BUFFER);
+    hr = device->CreateBuffer(&cbed, nullptr, &m_pEnvironmentBuffer);
 
     return hr;
 }
 
 HRESULT Renderer::CreateSphere()
 {
+    CPU_TRACE_SCOPE("Renderer::CreateSphere");
+
     HRESULT hr = S_OK;
 
     const int numLines = 32;
@@ -228,23 +243,14 @@ HRESULT Renderer::CreateSphere()
     CD3D11_BUFFER_DESC ibd(sizeof(WORD) * m_indexCount, D3D11_BIND_INDEX_BUFFER);
     initData.pSysMem = indices.data();
     hr = m_pDeviceResources->GetDevice()->CreateBuffer(&ibd, &initData, &m_pIndexBuffer);
-    if (FAILED(hr))
-        return hr;
-
-    // Create vertex buffer for environment sphere
-    for (VertexData& v : vertices)
-    {
-        DirectX::XMStoreFloat3(&v.Pos, DirectX::XMVectorNegate(DirectX::XMLoadFloat3(&v.Pos)));
-        DirectX::XMStoreFloat3(&v.Normal, DirectX::XMVectorNegate(DirectX::XMLoadFloat3(&v.Normal)));
-    }
-    initData.pSysMem = vertices.data();
-    hr = m_pDeviceResources->GetDevice()->CreateBuffer(&vbd, &initData, &m_pEnvironmentVertexBuffer);
 
     return hr;
 }
 
 HRESULT Renderer::CreatePlane()
 {
+    CPU_TRACE_SCOPE("Renderer::CreatePlane");
+
     HRESULT hr = S_OK;
 
     VertexData vertices[] =
@@ -284,28 +290,20 @@ HRESULT Renderer::CreatePlane()
 
 HRESULT Renderer::CreateTexture()
 {
+    CPU_TRACE_SCOPE("Renderer::CreateTexture");
+
     HRESULT hr = S_OK;
 
-    int w, h, n;
-    float* data = stbi_loadf("env.hdr", &w, &h, &n, STBI_rgb_alpha);
-    if (data == nullptr)
+    // The file contents are hashed for the IBL cache, both the hash and the decoder read them from one mapping
+    MappedFile file;
+    if (!file.Open("env.hdr"))
         return E_FAIL;
+    m_environmentBakeKey = ComputeIBLBakeKey(file.GetData(), file.GetSize(), GetIBLBakeSettings());
 
-    ID3D11Device* device = m_pDeviceResources->GetDevice();
-
-    CD3D11_TEXTURE2D_DESC td(DXGI_FORMAT_R32G32B32A32_FLOAT, w, h, 1, 1, D3D11_BIND_SHADER_RESOURCE);
-    D3D11_SUBRESOURCE_DATA initData;
-    initData.pSysMem = data;
-    initData.SysMemPitch = 4 * w * sizeof(float);
-    hr = device->CreateTexture2D(&td, &initData, &m_pEnvironmentTexture);
-    stbi_image_free(data);
-    if (FAILED(hr))
-        return hr;
+    if (!DecodeRadianceHdr(file.GetData(), file.GetSize(), m_environmentImage))
+        return E_FAIL;
 
-    CD3D11_SHADER_RESOURCE_VIEW_DESC srvd(D3D11_SRV_DIMENSION_TEXTURE2D, td.Format);
-    hr = device->CreateShaderResourceView(m_pEnvironmentTexture.Get(), &srvd, &m_pEnvironmentShaderResourceView);
-    if (FAILED(hr))
-        return hr;
+    ID3D11Device* device = m_pDeviceResources->GetDevice();
 
     m_pSamplerStates.resize(4);
     D3D11_SAMPLER_DESC sd;
@@ -317,14 +315,14 @@ HRESULT Renderer::CreateTexture()
     sd.ComparisonFunc = D3D11_COMPARISON_NEVER;
     sd.MinLOD = 0;
     sd.MaxLOD = D3D11_FLOAT32_MAX;
-    hr = device->CreateSamplerState(&sd, &m_pSamplerStates[0]);
+    hr = m_pStateCache->GetSamplerState(device, sd, &m_pSamplerStates[0]);
     if (FAILED(hr))
         return hr;
 
     sd.Filter = D3D11_FILTER_MIN_MAG_LINEAR_MIP_POINT;
     sd.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
     sd.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
-    hr = device->CreateSamplerState(&sd, &m_pSamplerStates[1]);
+    hr = m_pStateCache->GetSamplerState(device, sd, &m_pSamplerStates[1]);
     if (FAILED(hr))
         return hr;
 
@@ -332,307 +330,201 @@ HRESULT Renderer::CreateTexture()
     sd.AddressU = D3D11_TEXTURE_ADDRESS_BORDER;
     sd.AddressV = D3D11_TEXTURE_ADDRESS_BORDER;
     sd.BorderColor[0] = 1.0f;
-    hr = device->CreateSamplerState(&sd, &m_pSamplerStates[2]);
+    hr = m_pStateCache->GetSamplerState(device, sd, &m_pSamplerStates[2]);
     if (FAILED(hr))
         return hr;
 
     sd.Filter = D3D11_FILTER_COMPARISON_MIN_MAG_MIP_LINEAR;
     sd.ComparisonFunc = D3D11_COMPARISON_LESS;
-    hr = device->CreateSamplerState(&sd, &m_pSamplerStates[3]);
+    hr = m_pStateCache->GetSamplerState(device, sd, &m_pSamplerStates[3]);
 
     return hr;
 }
 
-HRESULT Renderer::CreateCubeTextureFromResource(UINT size, ID3D11Texture2D* dst, ID3D11ShaderResourceView* src, ID3D11VertexShader* vs, ID3D11PixelShader* ps, UINT mipSlice)
+HRESULT Renderer::CreateCubeTexture()
 {
-    HRESULT hr = S_OK;
-
-    Microsoft::WRL::ComPtr<ID3D11Buffer> vertexBuffer;
-    Microsoft::WRL::ComPtr<ID3D11Buffer> indexBuffer;
-
-    VertexPosData vertices[4];
-    WORD indices[6] =
-    {
-        0, 1, 2,
-        2, 3, 0
-    };
-    UINT indexCount = 6;
-
-    ID3D11Device* device = m_pDeviceResources->GetDevice();
-
-    D3D11_SUBRESOURCE_DATA initData;
-    ZeroMemory(&initData, sizeof(D3D11_SUBRESOURCE_DATA));
-    CD3D11_BUFFER_DESC vbd(sizeof(VertexPosData) * 4, D3D11_BIND_VERTEX_BUFFER);
-    CD3D11_BUFFER_DESC ibd(sizeof(WORD) * indexCount, D3D11_BIND_INDEX_BUFFER);
-    initData.pSysMem = indices;
-    hr = device->CreateBuffer(&ibd, &initData, &indexBuffer);
-    if (FAILED(hr))
-        return hr;
- 
-    Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
-    D3D11_TEXTURE2D_DESC dtd;
-    dst->GetDesc(&dtd);
-    D3D11_TEXTURE2D_DESC td = CD3D11_TEXTURE2D_DESC(dtd.Format, size, size, 1, 1, D3D11_BIND_RENDER_TARGET);
-    hr = device->CreateTexture2D(&td, nullptr, &texture);
-    if (FAILED(hr))
-        return hr;
-
-    // Create render target view
-    CD3D11_RENDER_TARGET_VIEW_DESC rtvd(D3D11_RTV_DIMENSION_TEXTURE2D, td.Format);
-    Microsoft::WRL::ComPtr<ID3D11RenderTargetView> pRenderTarget;
-    hr = device->CreateRenderTargetView(texture.Get(), &rtvd, &pRenderTarget);
-    if (FAILED(hr))
-        return hr;
-
-    D3D11_VIEWPORT viewport;
-    viewport.Width = static_cast<FLOAT>(size);
-    viewport.Height = static_cast<FLOAT>(size);
-    viewport.MinDepth = 0.0f;
-    viewport.MaxDepth = 1.0f;
-    viewport.TopLeftX = 0;
-    viewport.TopLeftY = 0;
-
-    WorldViewProjectionConstantBuffer cb;
-    cb.World = DirectX::XMMatrixTranspose(DirectX::XMMatrixIdentity());
-    cb.Projection = DirectX::XMMatrixTranspose(DirectX::XMMatrixPerspectiveFovLH(DirectX::XM_PIDIV2, 1, 0.2f, 0.8f));
+    CPU_TRACE_SCOPE("Renderer::CreateCubeTexture");
 
-    ID3D11DeviceContext* context = m_pDeviceResources->GetDeviceContext();
-    ID3D11RenderTargetView* renderTarget = pRenderTarget.Get();
-    context->RSSetViewports(1, &viewport);
-    context->OMSetRenderTargets(1, &renderTarget, nullptr);
+    EquirectToCube(m_environmentImage, cubeSize, m_environmentCube);
+    m_environmentImage = EnvironmentImage();
 
-    UINT stride = sizeof(VertexPosData);
-    UINT offset = 0;
-
-    // Set index buffer
-    context->IASetIndexBuffer(indexBuffer.Get(), DXGI_FORMAT_R16_UINT, 0);
+    return CreateCubeTextureFromData(m_environmentCube, HDR_TEXTURE_USAGE::ENVIRONMENT, &m_pEnvironmentCubeTexture, &m_pEnvironmentCubeShaderResourceView);
+}
 
-    // Set primitive topology
-    context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-    context->IASetInputLayout(m_pIBLInputLayout.Get());
+HRESULT Renderer::BakeEnvironmentLighting(IBLBakeResult& bake)
+{
+    CPU_TRACE_SCOPE("Renderer::BakeEnvironmentLighting");
 
-    // Render irradiance 
-    context->VSSetShader(vs, nullptr, 0);
-    context->PSSetShader(ps, nullptr, 0);
-    context->PSSetShaderResources(0, 1, &src);
-    context->PSSetSamplers(0, 1, m_pSamplerStates[0].GetAddressOf());
-    context->VSSetConstantBuffers(0, 1, m_pConstantBuffer.GetAddressOf());
+    IBLBakeSettings settings = GetIBLBakeSettings();
+    IBLBakeCache cache(iblCacheDirectory);
 
-    float color[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
-    D3D11_BOX box = CD3D11_BOX(0, 0, 0, size, size, 1);
-    for (UINT i = 0; i < 6; ++i)
+    auto start = std::chrono::steady_clock::now();
+    bool cached = cache.Load(m_environmentBakeKey, settings, bake);
+    if (!cached)
     {
-        UINT constCoord = i / 2;
-        UINT widthCoord = i >= 2 ? 0 : 2;
-        UINT heightCoord = (i == 2 || i == 3) ? 2 : 1;
-        FLOAT leftBottomAngel[3] = { m_squareLeftBottomAngles[i].x, m_squareLeftBottomAngles[i].y, m_squareLeftBottomAngles[i].z };
-        FLOAT rightTopAngel[3] = { m_squareRightTopAngles[i].x, m_squareRightTopAngles[i].y, m_squareRightTopAngles[i].z };
-        FLOAT pos[3];
-        pos[constCoord] = leftBottomAngel[constCoord];
-        pos[widthCoord] = leftBottomAngel[widthCoord];
-        pos[heightCoord] = leftBottomAngel[heightCoord];
-        vertices[0].Pos = DirectX::XMFLOAT3(pos);
-        pos[heightCoord] = rightTopAngel[heightCoord];
-        vertices[1].Pos = DirectX::XMFLOAT3(pos);
-        pos[widthCoord] = rightTopAngel[widthCoord];
-        vertices[2].Pos = DirectX::XMFLOAT3(pos);
-        pos[heightCoord] = leftBottomAngel[heightCoord];
-        vertices[3].Pos = DirectX::XMFLOAT3(pos);
-
-        initData.pSysMem = vertices;
-        hr = device->CreateBuffer(&vbd, &initData, vertexBuffer.ReleaseAndGetAddressOf());
-        if (FAILED(hr))
-            return hr;
+        if (m_environmentCube.GetMipLevels() == 0)
+            return E_FAIL;
 
-        context->IASetVertexBuffers(0, 1, vertexBuffer.GetAddressOf(), &stride, &offset);
-        cb.View = DirectX::XMMatrixTranspose(DirectX::XMMatrixLookAtLH(DirectX::XMVectorSet(0, 0, 0, 0), m_targers[i], m_ups[i]));
-        context->UpdateSubresource(m_pConstantBuffer.Get(), 0, nullptr, &cb, 0, 0);
-        context->ClearRenderTargetView(renderTarget, color);
-        context->DrawIndexed(indexCount, 0, 0);
-        context->CopySubresourceRegion(dst, D3D11CalcSubresource(mipSlice, i, dtd.MipLevels), 0, 0, 0, texture.Get(), 0, &box);
+        BakeIBL(m_environmentCube, settings, bake);
+        // A failed store only costs another bake on the next start
+        cache.Store(m_environmentBakeKey, settings, bake);
     }
+    float time = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    m_pSettings->SetIBLBakeTime(time, cached);
 
-    ID3D11ShaderResourceView* nullsrv[] = { nullptr };
-    context->PSSetShaderResources(0, 1, nullsrv);
+    m_environmentCube = CubeMap();
 
-    return hr;
+    return S_OK;
 }
 
-HRESULT Renderer::CreateCubeTexture()
+HRESULT Renderer::CreateCubeTextureFromData(const CubeMap& cube, HDR_TEXTURE_USAGE usage, ID3D11Texture2D** texture,
+    ID3D11ShaderResourceView** shaderResourceView)
 {
     HRESULT hr = S_OK;
 
-    D3D11_TEXTURE2D_DESC td = CD3D11_TEXTURE2D_DESC(DXGI_FORMAT_R32G32B32A32_FLOAT, cubeSize, cubeSize, 6, 0, D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_RENDER_TARGET,
-        D3D11_USAGE_DEFAULT, 0, 1, 0, D3D11_RESOURCE_MISC_TEXTURECUBE | D3D11_RESOURCE_MISC_GENERATE_MIPS);
-    hr = m_pDeviceResources->GetDevice()->CreateTexture2D(&td, nullptr, &m_pEnvironmentCubeTexture);
-    if (FAILED(hr))
-        return hr;
+    HDR_TEXEL_FORMAT format = SelectHdrFormat(m_pDeviceResources->GetDevice(), usage, compressBakedCubes);
 
-    hr = CreateCubeTextureFromResource(cubeSize, m_pEnvironmentCubeTexture.Get(), m_pEnvironmentShaderResourceView.Get(),
-        m_pEnvironmentCubeVertexShader.Get(), m_pEnvironmentCubePixelShader.Get());
-    if (FAILED(hr))
-        return hr;
-
-    D3D11_SHADER_RESOURCE_VIEW_DESC srvd = CD3D11_SHADER_RESOURCE_VIEW_DESC(D3D11_SRV_DIMENSION_TEXTURECUBE, td.Format);
-    hr = m_pDeviceResources->GetDevice()->CreateShaderResourceView(m_pEnvironmentCubeTexture.Get(), &srvd, &m_pEnvironmentCubeShaderResourceView);
-    if (FAILED(hr))
-        return hr;
-
-    m_pDeviceResources->GetDeviceContext()->GenerateMips(m_pEnvironmentCubeShaderResourceView.Get());
-    return hr;
-}
-
-HRESULT Renderer::CreateIrradianceTexture()
-{
-    HRESULT hr = S_OK;
+    UINT mipLevels = cube.GetMipLevels();
+    std::vector<std::vector<uint8_t>> packedData(6 * mipLevels);
+    std::vector<D3D11_SUBRESOURCE_DATA> initData(6 * mipLevels);
+    for (UINT face = 0; face < 6; ++face)
+    {
+        for (UINT mip = 0; mip < mipLevels; ++mip)
+        {
+            UINT subresource = D3D11CalcSubresource(mip, face, mipLevels);
+            PackHdrImage(format, cube.GetFace(face, mip), cube.GetSize(mip), cube.GetSize(mip), packedData[subresource]);
 
-    D3D11_TEXTURE2D_DESC td = CD3D11_TEXTURE2D_DESC(DXGI_FORMAT_R32G32B32A32_FLOAT, irradianceSize, irradianceSize, 6, 1, D3D11_BIND_SHADER_RESOURCE,
-        D3D11_USAGE_DEFAULT, 0, 1, 0, D3D11_RESOURCE_MISC_TEXTURECUBE);
-    hr = m_pDeviceResources->GetDevice()->CreateTexture2D(&td, nullptr, &m_pIrradianceTexture);
-    if (FAILED(hr))
-        return hr;
+            D3D11_SUBRESOURCE_DATA& data = initData[subresource];
+            data.pSysMem = packedData[subresource].data();
+            data.SysMemPitch = GetHdrRowPitch(format, cube.GetSize(mip));
+            data.SysMemSlicePitch = 0;
+        }
+    }
 
-    hr = CreateCubeTextureFromResource(irradianceSize, m_pIrradianceTexture.Get(), m_pEnvironmentCubeShaderResourceView.Get(),
-        m_pIBLVertexShader.Get(), m_pIrradiancePixelShader.Get());
+    D3D11_TEXTURE2D_DESC td = CD3D11_TEXTURE2D_DESC(GetDXGIFormat(format), cube.GetSize(), cube.GetSize(), 6, mipLevels, D3D11_BIND_SHADER_RESOURCE,
+        D3D11_USAGE_IMMUTABLE, 0, 1, 0, D3D11_RESOURCE_MISC_TEXTURECUBE);
+    hr = m_pDeviceResources->GetDevice()->CreateTexture2D(&td, initData.data(), texture);
     if (FAILED(hr))
         return hr;
 
-    D3D11_SHADER_RESOURCE_VIEW_DESC srvd = CD3D11_SHADER_RESOURCE_VIEW_DESC(D3D11_SRV_DIMENSION_TEXTURECUBE, td.Format, 0, 1);
-    hr = m_pDeviceResources->GetDevice()->CreateShaderResourceView(m_pIrradianceTexture.Get(), &srvd, &m_pIrradianceShaderResourceView);
+    D3D11_SHADER_RESOURCE_VIEW_DESC srvd = CD3D11_SHADER_RESOURCE_VIEW_DESC(D3D11_SRV_DIMENSION_TEXTURECUBE, td.Format, 0, mipLevels);
+    hr = m_pDeviceResources->GetDevice()->CreateShaderResourceView(*texture, &srvd, shaderResourceView);
 
     return hr;
 }
 
-HRESULT Renderer::CreatePrefilteredColorTexture()
+HRESULT Renderer::CreateIrradianceBuffer(const IrradianceSH& irradiance, ID3D11Buffer** buffer)
 {
-    HRESULT hr = S_OK;
-
-    float roughness[5] = { 0.0f, 0.25f, 0.5f, 0.75f, 1.0f };
+    CPU_TRACE_SCOPE("Renderer::CreateIrradianceBuffer");
 
-    D3D11_TEXTURE2D_DESC td = CD3D11_TEXTURE2D_DESC(DXGI_FORMAT_R32G32B32A32_FLOAT, prefilteredColorSize, prefilteredColorSize, 6, ARRAYSIZE(roughness),
-        D3D11_BIND_SHADER_RESOURCE, D3D11_USAGE_DEFAULT, 0, 1, 0, D3D11_RESOURCE_MISC_TEXTURECUBE);
-    hr = m_pDeviceResources->GetDevice()->CreateTexture2D(&td, nullptr, &m_pPrefilteredColorTexture);
-    if (FAILED(hr))
-        return hr;
+    static_assert(sizeof(IrradianceConstantBuffer) == sizeof(IrradianceSH), "the coefficients are uploaded as the constant buffer");
 
-    ID3D11DeviceContext* context = m_pDeviceResources->GetDeviceContext();
-    context->PSSetConstantBuffers(1, 1, m_pMaterialBuffer.GetAddressOf());
-    for (UINT i = 0; i < td.MipLevels; ++i)
-    {
-        m_materialBufferData.Roughness = roughness[i];
-        context->UpdateSubresource(m_pMaterialBuffer.Get(), 0, nullptr, &m_materialBufferData, 0, 0);
+    D3D11_SUBRESOURCE_DATA initData;
+    initData.pSysMem = irradiance.coefficients;
+    initData.SysMemPitch = 0;
+    initData.SysMemSlicePitch = 0;
 
-        hr = CreateCubeTextureFromResource(prefilteredColorSize / (UINT)pow(2, i), m_pPrefilteredColorTexture.Get(), m_pEnvironmentCubeShaderResourceView.Get(),
-            m_pIBLVertexShader.Get(), m_pPrefilteredColorPixelShader.Get(), i);
-        if (FAILED(hr))
-            return hr;
-    }
+    CD3D11_BUFFER_DESC bd(sizeof(IrradianceConstantBuffer), D3D11_BIND_CONSTANT_BUFFER, D3D11_USAGE_IMMUTABLE);
+    return m_pDeviceResources->GetDevice()->CreateBuffer(&bd, &initData, buffer);
+}
 
-    D3D11_SHADER_RESOURCE_VIEW_DESC srvd = CD3D11_SHADER_RESOURCE_VIEW_DESC(D3D11_SRV_DIMENSION_TEXTURECUBE, td.Format, 0, td.MipLevels);
-    hr = m_pDeviceResources->GetDevice()->CreateShaderResourceView(m_pPrefilteredColorTexture.Get(), &srvd, &m_pPrefilteredColorShaderResourceView);
+HRESULT Renderer::CreatePrefilteredColorTexture(const CubeMap& prefilteredColor)
+{
+    CPU_TRACE_SCOPE("Renderer::CreatePrefilteredColorTexture");
 
-    return hr;
+    return CreateCubeTextureFromData(prefilteredColor, HDR_TEXTURE_USAGE::PREFILTERED_COLOR, &m_pPrefilteredColorTexture, &m_pPrefilteredColorShaderResourceView);
 }
 
 HRESULT Renderer::CreatePreintegratedBRDFTexture()
 {
-    HRESULT hr = S_OK;
+    CPU_TRACE_SCOPE("Renderer::CreatePreintegratedBRDFTexture");
 
-    Microsoft::WRL::ComPtr<ID3D11Buffer> vertexBuffer;
-    Microsoft::WRL::ComPtr<ID3D11Buffer> indexBuffer;
+    HRESULT hr = S_OK;
 
-    VertexPosData vertices[4] =
-    {
-        {DirectX::XMFLOAT3(0.0f, 0.0f, 0.5f)},
-        {DirectX::XMFLOAT3(0.0f, 1.0f, 0.5f)},
-        {DirectX::XMFLOAT3(1.0f, 1.0f, 0.5f)},
-        {DirectX::XMFLOAT3(1.0f, 0.0f, 0.5f)}
-    };
+    PreintegratedBRDFSettings settings;
+    settings.size = preintegratedBRDFSize;
+    settings.analyticFit = preintegratedBRDFAnalyticFit ? 1 : 0;
 
-    WORD indices[6] =
+    // Shared by every environment, so it is integrated once and loaded on later starts
+    std::vector<uint16_t> lut;
+    IBLBakeCache cache(iblCacheDirectory);
+    if (!cache.Load(settings, lut))
     {
-        0, 1, 2,
-        2, 3, 0
-    };
-    UINT indexCount = 6;
+        BakePreintegratedBRDF(settings, lut);
+        cache.Store(settings, lut);
+    }
 
     ID3D11Device* device = m_pDeviceResources->GetDevice();
 
     D3D11_SUBRESOURCE_DATA initData;
-    ZeroMemory(&initData, sizeof(D3D11_SUBRESOURCE_DATA));
-    CD3D11_BUFFER_DESC vbd(sizeof(VertexPosData) * 4, D3D11_BIND_VERTEX_BUFFER);
-    initData.pSysMem = vertices;
-    hr = device->CreateBuffer(&vbd, &initData, &vertexBuffer);
-    if (FAILED(hr))
-        return hr;
-
-    CD3D11_BUFFER_DESC ibd(sizeof(WORD) * indexCount, D3D11_BIND_INDEX_BUFFER);
-    initData.pSysMem = indices;
-    hr = device->CreateBuffer(&ibd, &initData, &indexBuffer);
-    if (FAILED(hr))
-        return hr;
+    initData.pSysMem = lut.data();
+    initData.SysMemPitch = 2 * preintegratedBRDFSize * sizeof(uint16_t);
+    initData.SysMemSlicePitch = 0;
 
-    D3D11_TEXTURE2D_DESC td = CD3D11_TEXTURE2D_DESC(DXGI_FORMAT_R32G32B32A32_FLOAT, preintegratedBRDFSize, preintegratedBRDFSize, 1, 1, D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_RENDER_TARGET);
-    hr = device->CreateTexture2D(&td, nullptr, &m_pPreintegratedBRDFTexture);
+    D3D11_TEXTURE2D_DESC td = CD3D11_TEXTURE2D_DESC(DXGI_FORMAT_R16G16_UNORM, preintegratedBRDFSize, preintegratedBRDFSize, 1, 1, D3D11_BIND_SHADER_RESOURCE,
+        D3D11_USAGE_IMMUTABLE);
+    hr = device->CreateTexture2D(&td, &initData, &m_pPreintegratedBRDFTexture);
     if (FAILED(hr))
         return hr;
 
-    ID3D11DeviceContext* context = m_pDeviceResources->GetDeviceContext();
-    CD3D11_RENDER_TARGET_VIEW_DESC rtvd(D3D11_RTV_DIMENSION_TEXTURE2D, td.Format);
-    Microsoft::WRL::ComPtr<ID3D11RenderTargetView> pRenderTarget;
-    hr = device->CreateRenderTargetView(m_pPreintegratedBRDFTexture.Get(), &rtvd, &pRenderTarget);
-    if (FAILED(hr))
-        return hr;
-
-    D3D11_VIEWPORT viewport;
-    viewport.Width = static_cast<FLOAT>(preintegratedBRDFSize);
-    viewport.Height = static_cast<FLOAT>(preintegratedBRDFSize);
-    viewport.MinDepth = 0.0f;
-    viewport.MaxDepth = 1.0f;
-    viewport.TopLeftX = 0;
-    viewport.TopLeftY = 0;
+    D3D11_SHADER_RESOURCE_VIEW_DESC srvd = CD3D11_SHADER_RESOURCE_VIEW_DESC(D3D11_SRV_DIMENSION_TEXTURE2D, td.Format);
+    hr = device->CreateShaderResourceView(m_pPreintegratedBRDFTexture.Get(), &srvd, &m_pPreintegratedBRDFShaderResourceView);
 
-    WorldViewProjectionConstantBuffer cb;
-    cb.World = DirectX::XMMatrixTranspose(DirectX::XMMatrixIdentity());
-    cb.Projection = DirectX::XMMatrixTranspose(DirectX::XMMatrixPerspectiveFovLH(DirectX::XM_PIDIV2, 1, 0.2f, 0.8f));
+    return hr;
+}
+DirectX::XMMATRIX Renderer::GetProjectionMatrix() const
+{
+    return DirectX::XMMatrixPerspectiveFovRH(projectionFovY, m_pDeviceResources->GetAspectRatio(), projectionNear, projectionFar);
+}
 
-    ID3D11RenderTargetView* renderTarget = pRenderTarget.Get();
-    context->RSSetViewports(1, &viewport);
-    context->OMSetRenderTargets(1, &renderTarget, nullptr);
+void Renderer::UpdatePerspective()
+{
+    m_constantBufferData.Projection = DirectX::XMMatrixTranspose(GetProjectionMatrix());
+}
 
-    UINT stride = sizeof(VertexPosData);
-    UINT offset = 0;
-    context->IASetVertexBuffers(0, 1, vertexBuffer.GetAddressOf(), &stride, &offset);
-    context->IASetIndexBuffer(indexBuffer.Get(), DXGI_FORMAT_R16_UINT, 0);
+void Renderer::UpdateSkyRayTransform()
+{
+    DirectX::XMFLOAT4X4 view;
+    DirectX::XMFLOAT4X4 projection;
+    DirectX::XMStoreFloat4x4(&view, m_pCamera->GetViewMatrix());
+    DirectX::XMStoreFloat4x4(&projection, GetProjectionMatrix());
+
+    // A singular view keeps the previous rays
+    DirectX::XMFLOAT4X4 transform;
+    if (ComputeSkyRayTransform(view.m, projection.m, transform.m))
+        m_environmentBufferData.SkyRayTransform = DirectX::XMMatrixTranspose(DirectX::XMLoadFloat4x4(&transform));
+}
 
-    context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-    context->IASetInputLayout(m_pIBLInputLayout.Get());
+void Renderer::CullModels()
+{
+    CPU_TRACE_SCOPE("Renderer::CullModels");
 
-    context->VSSetShader(m_pIBLVertexShader.Get(), nullptr, 0);
-    context->VSSetConstantBuffers(0, 1, m_pConstantBuffer.GetAddressOf());
-    context->PSSetShader(m_pPreintegratedBRDFPixelShader.Get(), nullptr, 0);
+    if (m_sceneBVH.IsEmpty())
+        return;
 
-    float color[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
-    cb.View = DirectX::XMMatrixTranspose(DirectX::XMMatrixLookAtLH(DirectX::XMVectorSet(0.5f, 0.5f, 0, 0), DirectX::XMVectorSet(0.5f, 0.5f, 1.0f, 0), DirectX::XMVectorSet(0, 1.0f, 0, 0)));
-    context->UpdateSubresource(m_pConstantBuffer.Get(), 0, nullptr, &cb, 0, 0);
-    context->ClearRenderTargetView(renderTarget, color);
-    context->DrawIndexed(indexCount, 0, 0);
+    DirectX::XMFLOAT4X4 viewProjection;
+    DirectX::XMStoreFloat4x4(&viewProjection, DirectX::XMMatrixMultiply(m_pCamera->GetViewMatrix(), GetProjectionMatrix()));
 
-    D3D11_SHADER_RESOURCE_VIEW_DESC srvd = CD3D11_SHADER_RESOURCE_VIEW_DESC(D3D11_SRV_DIMENSION_TEXTURE2D, td.Format);
-    hr = device->CreateShaderResourceView(m_pPreintegratedBRDFTexture.Get(), &srvd, &m_pPreintegratedBRDFShaderResourceView);
+    m_visiblePrimitives.clear();
+    m_sceneBVH.QueryFrustum(FrustumFromMatrix(viewProjection.m), m_visiblePrimitives);
 
-    return hr;
-}
+    for (std::unique_ptr<Model>& model : m_pModels)
+        model->SetPrimitivesVisible(false);
 
-void Renderer::UpdatePerspective()
-{
-    m_constantBufferData.Projection = DirectX::XMMatrixTranspose(
-        DirectX::XMMatrixPerspectiveFovRH(DirectX::XM_PIDIV2, m_pDeviceResources->GetAspectRatio(), projectionNear, projectionFar)
-    );
+    size_t model = 0;
+    std::sort(m_visiblePrimitives.begin(), m_visiblePrimitives.end());
+    for (uint32_t index : m_visiblePrimitives)
+    {
+        while (model + 1 < m_modelPrimitiveOffsets.size() && index >= m_modelPrimitiveOffsets[model + 1])
+            ++model;
+        m_pModels[model]->SetPrimitiveVisible(index - m_modelPrimitiveOffsets[model], true);
+    }
 }
 
 HRESULT Renderer::CreateModels()
 {
+    CPU_TRACE_SCOPE("Renderer::CreateModels");
+
     HRESULT hr = S_OK;
 
     ID3D11Device* device = m_pDeviceResources->GetDevice();
@@ -650,7 +542,7 @@ HRESULT Renderer::CreateModels()
     translation = DirectX::XMMatrixTranslation(0, 20.0f, 0);
 	rotation = DirectX::XMMatrixRotationY(static_cast<float>(M_PI_2));
 	scale = DirectX::XMMatrixScaling(0.012f, 0.012f, 0.012f);
-	m_pModels.push_back(std::unique_ptr<Model>(new Model("artorias/scene.gltf", m_pModelShaders,
+	m_pModels.push_back(std::unique_ptr<Model>(new Model("artorias/scene.gltf", m_pModelShaders, m_pStateCache,
 		DirectX::XMMatrixMultiply(DirectX::XMMatrixMultiply(rotation, translation), scale))));
 	hr = m_pModels[0]->CreateDeviceDependentResources(device);
 	if (FAILED(hr))
@@ -660,7 +552,7 @@ HRESULT Renderer::CreateModels()
     /*translation = DirectX::XMMatrixTranslation(0, 0.5f, 1000);
     rotation = DirectX::XMMatrixRotationY(static_cast<float>(M_PI_2));
     scale = DirectX::XMMatrixScaling(0.12f, 0.12f, 0.12f);
-    m_pModels.push_back(std::unique_ptr<Model>(new Model("car_scene/scene.gltf", m_pModelShaders,
+    m_pModels.push_back(std::unique_ptr<Model>(new Model("car_scene/scene.gltf", m_pModelShaders, m_pStateCache,
         DirectX::XMMatrixMultiply(DirectX::XMMatrixMultiply(rotation, translation), scale))));
     hr = m_pModels[0]->CreateDeviceDependentResources(device);
     if (FAILED(hr))
@@ -669,7 +561,7 @@ HRESULT Renderer::CreateModels()
     translation = DirectX::XMMatrixTranslation(25, -5.43f, 10);
     rotation = DirectX::XMMatrixRotationY(static_cast<float>(-M_PI_2));
     scale = DirectX::XMMatrixScaling(10, 10, 10);
-    m_pModels.push_back(std::unique_ptr<Model>(new Model("msz-006/scene.gltf", m_pModelShaders,
+    m_pModels.push_back(std::unique_ptr<Model>(new Model("msz-006/scene.gltf", m_pModelShaders, m_pStateCache,
         DirectX::XMMatrixMultiply(DirectX::XMMatrixMultiply(rotation, translation), scale))));
     hr = m_pModels[1]->CreateDeviceDependentResources(device);
     if (FAILED(hr))
@@ -677,30 +569,36 @@ HRESULT Renderer::CreateModels()
 
     translation = DirectX::XMMatrixTranslation(-200, 300, 500);
     scale = DirectX::XMMatrixScaling(0.3f, 0.3f, 0.3f);
-    m_pModels.push_back(std::unique_ptr<Model>(new Model("spitfire/scene.gltf", m_pModelShaders, DirectX::XMMatrixMultiply(translation, scale))));
+    m_pModels.push_back(std::unique_ptr<Model>(new Model("spitfire/scene.gltf", m_pModelShaders, m_pStateCache, DirectX::XMMatrixMultiply(translation, scale))));
     hr = m_pModels[2]->CreateDeviceDependentResources(device);
     if (FAILED(hr))
         return hr;
 
     translation = DirectX::XMMatrixTranslation(0, 0.566f, 0);
     scale = DirectX::XMMatrixScaling(100, 100, 100);
-    m_pModels.push_back(std::unique_ptr<Model>(new Model("red_barn/scene.gltf", m_pModelShaders, DirectX::XMMatrixMultiply(translation, scale))));
+    m_pModels.push_back(std::unique_ptr<Model>(new Model("red_barn/scene.gltf", m_pModelShaders, m_pStateCache, DirectX::XMMatrixMultiply(translation, scale))));
     hr = m_pModels[3]->CreateDeviceDependentResources(device);
     if (FAILED(hr))
         return hr;*/
 
-    DirectX::XMVECTOR maxPosition = DirectX::XMVectorSet(-INFINITY, -INFINITY, -INFINITY, 0);
-    DirectX::XMVECTOR minPosition = DirectX::XMVectorSet(INFINITY, INFINITY, INFINITY, 0);
+    std::vector<AABB> primitiveBounds;
+    m_modelPrimitiveOffsets.clear();
     for (std::unique_ptr<Model>& model : m_pModels)
     {
-        DirectX::XMVECTOR maxModel = model->GetMaximumPosition();
-        DirectX::XMVECTOR minModel = model->GetMinimumPosition();
-        for (size_t i = 0; i < 3; ++i)
-        {
-            maxPosition.m128_f32[i] = max(maxPosition.m128_f32[i], maxModel.m128_f32[i]);
-            minPosition.m128_f32[i] = min(minPosition.m128_f32[i], minModel.m128_f32[i]);
-        }
+        m_modelPrimitiveOffsets.push_back(static_cast<UINT>(primitiveBounds.size()));
+        const std::vector<AABB>& bounds = model->GetPrimitiveBounds();
+        primitiveBounds.insert(primitiveBounds.end(), bounds.begin(), bounds.end());
     }
+    m_sceneBVH.Build(primitiveBounds);
+
+    m_transparentDraws.clear();
+    for (UINT i = 0; i < m_pModels.size(); ++i)
+        for (UINT j = 0; j < m_pModels[i]->GetTransparentPrimitiveCount(); ++j)
+            m_transparentDraws.push_back({ i, j });
+
+    AABB sceneBounds = m_sceneBVH.GetBounds();
+    DirectX::XMVECTOR maxPosition = DirectX::XMVectorSet(sceneBounds.max.x, sceneBounds.max.y, sceneBounds.max.z, 0);
+    DirectX::XMVECTOR minPosition = DirectX::XMVectorSet(sceneBounds.min.x, sceneBounds.min.y, sceneBounds.min.z, 0);
 
     m_sceneCenter = DirectX::XMVectorDivide(DirectX::XMVectorAdd(maxPosition, minPosition), DirectX::XMVectorReplicate(2));
     m_sceneRadius = DirectX::XMVector3Length(DirectX::XMVectorDivide(DirectX::XMVectorSubtract(maxPosition, minPosition), DirectX::XMVectorReplicate(2))).m128_f32[0];
@@ -710,22 +608,24 @@ HRESULT Renderer::CreateModels()
 
 HRESULT Renderer::CreateShadows()
 {
+    CPU_TRACE_SCOPE("Renderer::CreateShadows");
+
     HRESULT hr = S_OK;
 
     ID3D11Device* device = m_pDeviceResources->GetDevice();
 
-    D3D11_TEXTURE2D_DESC dd = CD3D11_TEXTURE2D_DESC(DXGI_FORMAT_R32_TYPELESS, simpleShadowMapSize, simpleShadowMapSize, 1, 1, D3D11_BIND_DEPTH_STENCIL | D3D11_BIND_SHADER_RESOURCE);
-    hr = device->CreateTexture2D(&dd, nullptr, &m_pSimpleShadowMapTexture);
+    D3D11_TEXTURE2D_DESC dd = CD3D11_TEXTURE2D_DESC(DXGI_FORMAT_R32_TYPELESS, shadowAtlasSize, shadowAtlasSize, 1, 1, D3D11_BIND_DEPTH_STENCIL | D3D11_BIND_SHADER_RESOURCE);
+    hr = device->CreateTexture2D(&dd, nullptr, &m_pShadowAtlasTexture);
     if (FAILED(hr))
         return hr;
 
     D3D11_DEPTH_STENCIL_VIEW_DESC dsvd = CD3D11_DEPTH_STENCIL_VIEW_DESC(D3D11_DSV_DIMENSION_TEXTURE2D, DXGI_FORMAT_D32_FLOAT);
-    hr = device->CreateDepthStencilView(m_pSimpleShadowMapTexture.Get(), &dsvd, &m_pSimpleShadowMapDepthStencilView);
+    hr = device->CreateDepthStencilView(m_pShadowAtlasTexture.Get(), &dsvd, &m_pShadowAtlasDepthStencilView);
     if (FAILED(hr))
         return hr;
 
     D3D11_SHADER_RESOURCE_VIEW_DESC srvd = CD3D11_SHADER_RESOURCE_VIEW_DESC(D3D11_SRV_DIMENSION_TEXTURE2D, DXGI_FORMAT_R32_FLOAT);
-    hr = device->CreateShaderResourceView(m_pSimpleShadowMapTexture.Get(), &srvd, &m_pSimpleShadowMapShaderResourceView);
+    hr = device->CreateShaderResourceView(m_pShadowAtlasTexture.Get(), &srvd, &m_pShadowAtlasShaderResourceView);
     if (FAILED(hr))
         return hr;
 
@@ -736,34 +636,38 @@ HRESULT Renderer::CreateShadows()
     rd.DepthBiasClamp = 0;
     rd.SlopeScaledDepthBias = 0;
     rd.DepthClipEnable = true;
-    hr = device->CreateRasterizerState(&rd, &m_pSimpleShadowMapRasterizerState);
+    hr = m_pStateCache->GetRasterizerState(device, rd, &m_pSimpleShadowMapRasterizerState);
     if (FAILED(hr))
         return hr;
 
-    dd = CD3D11_TEXTURE2D_DESC(DXGI_FORMAT_R32_TYPELESS, PSSMSize, PSSMSize, 4, 1, D3D11_BIND_DEPTH_STENCIL | D3D11_BIND_SHADER_RESOURCE);
-    hr = device->CreateTexture2D(&dd, nullptr, &m_pPSSMTexture);
+    // Depth of a single tile is reset by drawing the far plane over it
+    D3D11_DEPTH_STENCIL_DESC dsd = CD3D11_DEPTH_STENCIL_DESC(CD3D11_DEFAULT());
+    dsd.DepthFunc = D3D11_COMPARISON_ALWAYS;
+    hr = m_pStateCache->GetDepthStencilState(device, dsd, &m_pShadowClearDepthStencilState);
     if (FAILED(hr))
         return hr;
 
-    m_pPSSMDepthStencilViews.resize(4);
-    for (UINT i = 0; i < 4; ++i)
-    {
-        dsvd = CD3D11_DEPTH_STENCIL_VIEW_DESC(D3D11_DSV_DIMENSION_TEXTURE2DARRAY, DXGI_FORMAT_D32_FLOAT, 0, i, 1);
-        hr = device->CreateDepthStencilView(m_pPSSMTexture.Get(), &dsvd, &m_pPSSMDepthStencilViews[i]);
-        if (FAILED(hr))
-            return hr;
-    }
-
-    srvd = CD3D11_SHADER_RESOURCE_VIEW_DESC(D3D11_SRV_DIMENSION_TEXTURE2DARRAY, DXGI_FORMAT_R32_FLOAT);
-    hr = device->CreateShaderResourceView(m_pPSSMTexture.Get(), &srvd, &m_pPSSMShaderResourceView);
+    // New textures don't hold any cached shadows yet
+    m_shadowAtlas.SetSize(shadowAtlasSize);
+    m_simpleShadowValid = false;
+    m_PSSMCache.Invalidate();
 
     return hr;
 }
 
 HRESULT Renderer::CreateDeviceDependentResources()
 {
+    CPU_TRACE_SCOPE("Renderer::CreateDeviceDependentResources");
+
     HRESULT hr = S_OK;
 
+    m_pStateCache = std::shared_ptr<StateObjectCache>(new StateObjectCache());
+
+    m_pProfiler = std::unique_ptr<GpuProfiler>(new GpuProfiler());
+    hr = m_pProfiler->CreateDeviceDependentResources(m_pDeviceResources->GetDevice());
+    if (FAILED(hr))
+        return hr;
+
     hr = CreateShaders();
     if (FAILED(hr))
         return hr;
@@ -788,13 +692,20 @@ HRESULT Renderer::CreateDeviceDependentResources()
     if (FAILED(hr))
         return hr;
 
-    hr = CreateIrradianceTexture();
-    if (FAILED(hr))
-       return hr;
+    {
+        IBLBakeResult bake;
+        hr = BakeEnvironmentLighting(bake);
+        if (FAILED(hr))
+            return hr;
 
-    hr = CreatePrefilteredColorTexture();
-    if (FAILED(hr))
-        return hr;
+        hr = CreateIrradianceBuffer(bake.irradiance, &m_pIrradianceBuffer);
+        if (FAILED(hr))
+            return hr;
+
+        hr = CreatePrefilteredColorTexture(bake.prefilteredColor);
+        if (FAILED(hr))
+            return hr;
+    }
 
     hr = CreatePreintegratedBRDFTexture();
     if (FAILED(hr))
@@ -809,6 +720,21 @@ HRESULT Renderer::CreateDeviceDependentResources()
     if (FAILED(hr))
         return hr;
 
+    m_pOIT = std::unique_ptr<OITProcess>(new OITProcess());
+    hr = m_pOIT->CreateDeviceDependentResources(m_pDeviceResources->GetDevice());
+    if (FAILED(hr))
+        return hr;
+
+    m_pDepthReduction = std::unique_ptr<DepthReductionProcess>(new DepthReductionProcess());
+    hr = m_pDepthReduction->CreateDeviceDependentResources(m_pDeviceResources->GetDevice());
+    if (FAILED(hr))
+        return hr;
+
+    m_pClusteredLights = std::unique_ptr<ClusteredLights>(new ClusteredLights());
+    hr = m_pClusteredLights->CreateDeviceDependentResources(m_pDeviceResources->GetDevice());
+    if (FAILED(hr))
+        return hr;
+
     m_pToneMap = std::unique_ptr<ToneMapPostProcess>(new ToneMapPostProcess());
     hr = m_pToneMap->CreateDeviceDependentResources(m_pDeviceResources->GetDevice());
     if (FAILED(hr))
@@ -837,7 +763,8 @@ HRESULT Renderer::CreateWindowSizeDependentResources()
 
     UpdatePerspective();
 
-    m_pRenderTexture = std::unique_ptr<RenderTexture>(new RenderTexture(DXGI_FORMAT_R32G32B32A32_FLOAT));
+    DXGI_FORMAT sceneColorFormat = GetDXGIFormat(SelectHdrFormat(m_pDeviceResources->GetDevice(), HDR_TEXTURE_USAGE::SCENE_COLOR));
+    m_pRenderTexture = std::unique_ptr<RenderTexture>(new RenderTexture(sceneColorFormat));
     hr = m_pRenderTexture->CreateResources(m_pDeviceResources->GetDevice(), m_pDeviceResources->GetWidth(), m_pDeviceResources->GetHeight());
     if (FAILED(hr))
         return hr;
@@ -846,7 +773,15 @@ HRESULT Renderer::CreateWindowSizeDependentResources()
     if (FAILED(hr))
         return hr;
 
+    hr = m_pOIT->CreateWindowSizeDependentResources(m_pDeviceResources->GetDevice(), m_pDeviceResources->GetWidth(), m_pDeviceResources->GetHeight());
+    if (FAILED(hr))
+        return hr;
+
     hr = m_pToneMap->CreateWindowSizeDependentResources(m_pDeviceResources->GetDevice(), m_pDeviceResources->GetWidth(), m_pDeviceResources->GetHeight());
+    if (FAILED(hr))
+        return hr;
+
+    UpdateVideoMemory();
 
     return hr;
 }
@@ -865,13 +800,96 @@ HRESULT Renderer::OnResize()
     if (FAILED(hr))
         return hr;
 
+    hr = m_pOIT->CreateWindowSizeDependentResources(m_pDeviceResources->GetDevice(), m_pDeviceResources->GetWidth(), m_pDeviceResources->GetHeight());
+    if (FAILED(hr))
+        return hr;
+
     hr = m_pToneMap->CreateWindowSizeDependentResources(m_pDeviceResources->GetDevice(), m_pDeviceResources->GetWidth(), m_pDeviceResources->GetHeight());
+    if (FAILED(hr))
+        return hr;
+
+    UpdateVideoMemory();
+
+    return hr;
+}
+
+void Renderer::UpdateVideoMemory()
+{
+    std::vector<VideoMemoryEntry> entries;
+    AddTextureMemory(entries, "Environment cube", m_pEnvironmentCubeTexture.Get());
+    AddTextureMemory(entries, "Prefiltered color", m_pPrefilteredColorTexture.Get());
+    AddTextureMemory(entries, "Preintegrated BRDF", m_pPreintegratedBRDFTexture.Get());
+    AddTextureMemory(entries, "Shadow atlas", m_pShadowAtlasTexture.Get());
+    AddTextureMemory(entries, "Scene color", m_pRenderTexture->GetRenderTarget());
+    m_pBloom->AddVideoMemory(entries);
+    m_pOIT->AddVideoMemory(entries);
+    m_pToneMap->AddVideoMemory(entries);
+    m_pSettings->SetVideoMemory(entries);
+}
+
+void Renderer::StartEnvironmentBake(const std::string& path)
+{
+    CPU_TRACE_SCOPE("Renderer::StartEnvironmentBake");
+
+    // The file is decoded in this frame, only the bake is spread over the following ones. The cache isn't used, it holds
+    // the startup environment.
+    MappedFile file;
+    EnvironmentImage image;
+    if (!file.Open(path.c_str()) || !DecodeRadianceHdr(file.GetData(), file.GetSize(), image))
+    {
+        m_pSettings->SetEnvironmentStatus("Can't load " + path);
+        return;
+    }
+
+    m_iblBakeScheduler.Start(std::move(image), GetIBLBakeSettings());
+    m_bakingEnvironmentPath = path;
+    m_pSettings->SetEnvironmentStatus("Baking " + path);
+}
+
+HRESULT Renderer::SwapEnvironmentLighting()
+{
+    CPU_TRACE_SCOPE("Renderer::SwapEnvironmentLighting");
+
+    HRESULT hr = S_OK;
+
+    CubeMap environmentCube;
+    IBLBakeResult bake;
+    if (!m_iblBakeScheduler.TakeResult(environmentCube, bake))
+        return E_FAIL;
+
+    // Everything is created before anything is replaced, the shaders never see lighting of two environments
+    Microsoft::WRL::ComPtr<ID3D11Texture2D> environmentCubeTexture;
+    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> environmentCubeShaderResourceView;
+    hr = CreateCubeTextureFromData(environmentCube, HDR_TEXTURE_USAGE::ENVIRONMENT, &environmentCubeTexture, &environmentCubeShaderResourceView);
+    if (FAILED(hr))
+        return hr;
+
+    Microsoft::WRL::ComPtr<ID3D11Texture2D> prefilteredColorTexture;
+    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> prefilteredColorShaderResourceView;
+    hr = CreateCubeTextureFromData(bake.prefilteredColor, HDR_TEXTURE_USAGE::PREFILTERED_COLOR, &prefilteredColorTexture, &prefilteredColorShaderResourceView);
+    if (FAILED(hr))
+        return hr;
+
+    Microsoft::WRL::ComPtr<ID3D11Buffer> irradianceBuffer;
+    hr = CreateIrradianceBuffer(bake.irradiance, &irradianceBuffer);
+    if (FAILED(hr))
+        return hr;
+
+    m_pEnvironmentCubeTexture = environmentCubeTexture;
+    m_pEnvironmentCubeShaderResourceView = environmentCubeShaderResourceView;
+    m_pPrefilteredColorTexture = prefilteredColorTexture;
+    m_pPrefilteredColorShaderResourceView = prefilteredColorShaderResourceView;
+    m_pIrradianceBuffer = irradianceBuffer;
+
+    UpdateVideoMemory();
 
     return hr;
 }
 
 HRESULT Renderer::Update()
 {
+    CPU_TRACE_SCOPE("Renderer::Update");
+
     HRESULT hr = S_OK;
 
     m_frameCount++;
@@ -883,6 +901,9 @@ HRESULT Renderer::Update()
     DirectX::XMStoreFloat4(&m_constantBufferData.CameraPos, m_pCamera->GetPosition());
     DirectX::XMStoreFloat4(&m_constantBufferData.CameraDir, m_pCamera->GetDirection());
 
+    UpdateSkyRayTransform();
+    CullModels();
+
     for (UINT i = 0; i < NUM_LIGHTS; ++i)
     {
         m_lightBufferData.LightColor[i] = m_pSettings->GetLightColor(i);
@@ -906,12 +927,140 @@ HRESULT Renderer::Update()
     {
         rd.DepthBias = depthBias;
         rd.SlopeScaledDepthBias = slopeScaledDepthBias;
-        hr = m_pDeviceResources->GetDevice()->CreateRasterizerState(&rd, m_pSimpleShadowMapRasterizerState.ReleaseAndGetAddressOf());
+        // The sliders only give a bounded set of biases (see Settings), so every pair can stay in the cache.
+        // The previous state stays if this one fails.
+        Microsoft::WRL::ComPtr<ID3D11RasterizerState> rasterizerState;
+        hr = m_pStateCache->GetRasterizerState(m_pDeviceResources->GetDevice(), rd, &rasterizerState);
+        if (FAILED(hr))
+            return hr;
+        m_pSimpleShadowMapRasterizerState = rasterizerState;
+    }
+
+    // Cached shadow maps are rendered again only when something they depend on has changed
+    if (UpdateShadowCasters())
+    {
+        m_simpleShadowValid = false;
+        m_PSSMCache.Invalidate();
+    }
+
+    hr = UpdatePointLights();
+
+    std::string environmentPath;
+    if (m_pSettings->TakeEnvironmentRequest(environmentPath))
+        StartEnvironmentBake(environmentPath);
+
+    if (m_iblBakeScheduler.IsBaking())
+    {
+        CPU_TRACE_SCOPE("IBLBakeScheduler::Update");
+
+        // A failed swap keeps the current lighting
+        if (m_iblBakeScheduler.Update(m_pSettings->GetIBLBakeBudget()))
+            m_pSettings->SetEnvironmentStatus((FAILED(SwapEnvironmentLighting()) ? "Can't create the lighting of " : "Showing ") + m_bakingEnvironmentPath);
+        m_pSettings->SetIBLBakeProgress(m_iblBakeScheduler.IsBaking(), m_iblBakeScheduler.GetProgress(), m_iblBakeScheduler.GetUpdateCount());
+    }
+
+    if (m_pSettings->GetGpuTimingsLogging() != m_pProfiler->IsLogging())
+    {
+        if (m_pProfiler->IsLogging())
+            m_pProfiler->CloseLog();
+        else
+            m_pProfiler->OpenLog(gpuTimingsLogPath);
+    }
+
+#if CPU_TRACE_ENABLED
+    // Recording starts with the application, the trace is written once it is switched off
+    CpuTracer& tracer = CpuTracer::Get();
+    if (m_pSettings->GetCpuTraceRecording() != tracer.IsCapturing())
+    {
+        if (tracer.IsCapturing())
+        {
+            tracer.StopCapture();
+            tracer.WriteChromeTrace(cpuTracePath);
+        }
+        else
+            tracer.StartCapture();
+    }
+#endif
+
+    return hr;
+}
+
+HRESULT Renderer::UpdatePointLights()
+{
+    CPU_TRACE_SCOPE("Renderer::UpdatePointLights");
+
+    m_pointLightSettings.BeginFrame();
+    m_pointLightSettings.AddValue(m_pSettings->GetSceneMode());
+    m_pointLightSettings.AddValue(m_pSettings->GetPointLightCount());
+    m_pointLightSettings.AddValue(m_pSettings->GetPointLightRange());
+    m_pointLightSettings.AddValue(m_pSettings->GetPointLightIntensity());
+
+    if (m_pointLightSettings.EndFrame())
+    {
+        // Lights are scattered around the scene with a fixed seed, so the same settings give the same lights
+        Float3 center = { 0.0f, 100.0f, 0.0f };
+        Float3 extent = { 750.0f, 100.0f, 750.0f };
+        if (m_pSettings->GetSceneMode() == Settings::SETTINGS_SCENE_MODE::MODEL)
+        {
+            DirectX::XMFLOAT3 sceneCenter;
+            DirectX::XMStoreFloat3(&sceneCenter, m_sceneCenter);
+            center = { sceneCenter.x, sceneCenter.y, sceneCenter.z };
+            extent = { m_sceneRadius, m_sceneRadius, m_sceneRadius };
+        }
+
+        std::mt19937 generator(pointLightSeed);
+        std::uniform_real_distribution<float> offset(-1.0f, 1.0f);
+        std::uniform_real_distribution<float> hue(0.0f, 1.0f);
+
+        m_pointLights.resize(m_pSettings->GetPointLightCount());
+        for (PointLight& light : m_pointLights)
+        {
+            light.position.x = center.x + offset(generator) * extent.x;
+            light.position.y = center.y + offset(generator) * extent.y;
+            light.position.z = center.z + offset(generator) * extent.z;
+            light.range = m_pSettings->GetPointLightRange();
+            light.color = { hue(generator), hue(generator), hue(generator) };
+            light.intensity = m_pSettings->GetPointLightIntensity();
+        }
     }
 
+    // Clusters cover the frustum of the camera projection
+    float tanHalfFovY = tanf(0.5f * projectionFovY);
+    HRESULT hr = m_pClusteredLights->Update(m_pDeviceResources->GetDevice(), m_pDeviceResources->GetDeviceContext(), m_pointLights,
+        m_pCamera->GetViewMatrix(), tanHalfFovY * m_pDeviceResources->GetAspectRatio(), tanHalfFovY, projectionFar,
+        m_pDeviceResources->GetWidth(), m_pDeviceResources->GetHeight());
+
+    m_pSettings->SetClusteredLightIndices(m_pClusteredLights->GetIndexCount());
+    CPU_TRACE_COUNTER("Clustered light indices", m_pClusteredLights->GetIndexCount());
     return hr;
 }
 
+bool Renderer::UpdateShadowCasters()
+{
+    m_shadowCasters.BeginFrame();
+
+    m_shadowCasters.AddValue(m_pSettings->GetSceneMode());
+    for (UINT i = 0; i < NUM_LIGHTS; ++i)
+        m_shadowCasters.AddValue(m_lightBufferData.LightPosition[i]);
+    m_shadowCasters.AddValue(m_pSettings->GetDepthBias());
+    m_shadowCasters.AddValue(m_pSettings->GetSlopeScaledDepthBias());
+
+    m_shadowCasters.AddValue(m_pModels.size());
+    for (std::unique_ptr<Model>& model : m_pModels)
+    {
+        DirectX::XMFLOAT4X4 world;
+        DirectX::XMStoreFloat4x4(&world, model->GetGlobalWorldMatrix());
+        m_shadowCasters.AddValue(world);
+    }
+
+    DirectX::XMFLOAT3 center;
+    DirectX::XMStoreFloat3(&center, m_sceneCenter);
+    m_shadowCasters.AddValue(center);
+    m_shadowCasters.AddValue(m_sceneRadius);
+
+    return m_shadowCasters.EndFrame();
+}
+
 void Renderer::Clear()
 {
     ID3D11DeviceContext* context = m_pDeviceResources->GetDeviceContext();
@@ -956,11 +1105,11 @@ void Renderer::RenderSphere(WorldViewProjectionConstantBuffer& transformationDat
         context->PSSetConstantBuffers(1, 1, m_pLightBuffer.GetAddressOf());
         context->PSSetConstantBuffers(2, 1, m_pMaterialBuffer.GetAddressOf());
         context->PSSetConstantBuffers(3, 1, m_pShadowBuffer.GetAddressOf());
-        context->PSSetShaderResources(0, 1, m_pIrradianceShaderResourceView.GetAddressOf());
+        context->PSSetConstantBuffers(6, 1, m_pIrradianceBuffer.GetAddressOf());
         context->PSSetShaderResources(1, 1, m_pPrefilteredColorShaderResourceView.GetAddressOf());
         context->PSSetShaderResources(2, 1, m_pPreintegratedBRDFShaderResourceView.GetAddressOf());
-        context->PSSetShaderResources(6, 1, m_pSimpleShadowMapShaderResourceView.GetAddressOf());
-        context->PSSetShaderResources(7, 1, m_pPSSMShaderResourceView.GetAddressOf());
+        context->PSSetShaderResources(6, 1, m_pShadowAtlasShaderResourceView.GetAddressOf());
+        m_pClusteredLights->Bind(context, 9, 5);
         context->PSSetSamplers(0, 1, m_pSamplerStates[0].GetAddressOf());
         context->PSSetSamplers(1, 1, m_pSamplerStates[1].GetAddressOf());
         context->PSSetSamplers(3, 1, m_pSamplerStates[2].GetAddressOf());
@@ -969,7 +1118,7 @@ void Renderer::RenderSphere(WorldViewProjectionConstantBuffer& transformationDat
         switch (m_pSettings->GetShaderMode())
         {
         case Settings::SETTINGS_PBR_SHADER_MODE::REGULAR:
-            context->PSSetShaderResources(6, 1, m_pSimpleShadowMapShaderResourceView.GetAddressOf());
+            context->PSSetShaderResources(6, 1, m_pShadowAtlasShaderResourceView.GetAddressOf());
             context->PSSetShader(m_pPixelShader.Get(), nullptr, 0);
             break;
         case Settings::SETTINGS_PBR_SHADER_MODE::NORMAL_DISTRIBUTION:
@@ -997,34 +1146,24 @@ void Renderer::RenderEnvironment()
 {
     ID3D11DeviceContext* context = m_pDeviceResources->GetDeviceContext();
 
-    // Set vertex buffer
-    UINT stride = sizeof(VertexData);
-    UINT offset = 0;
-    context->IASetVertexBuffers(0, 1, m_pEnvironmentVertexBuffer.GetAddressOf(), &stride, &offset);
-
-    // Set index buffer
-    context->IASetIndexBuffer(m_pIndexBuffer.Get(), DXGI_FORMAT_R16_UINT, 0);
-
-    // Set primitive topology
+    // The triangle comes from the vertex ids
+    context->IASetInputLayout(nullptr);
     context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-    context->IASetInputLayout(m_pInputLayout.Get());
 
-    m_constantBufferData.World = DirectX::XMMatrixMultiplyTranspose(
-        DirectX::XMMatrixScaling(projectionFar, projectionFar, projectionFar),
-        DirectX::XMMatrixTranslationFromVector(m_pCamera->GetPosition())
-    );
-    context->UpdateSubresource(m_pConstantBuffer.Get(), 0, NULL, &m_constantBufferData, 0, 0);
+    context->UpdateSubresource(m_pEnvironmentBuffer.Get(), 0, nullptr, &m_environmentBufferData, 0, 0);
 
-    // Render sphere
+    // Drawn at the far plane after the opaque geometry, the depth test (equal passes, no writes) keeps it behind
+    context->OMSetDepthStencilState(m_pDeviceResources->GetTransDepthStencil(), 0);
     context->VSSetShader(m_pEnvironmentVertexShader.Get(), nullptr, 0);
-    context->VSSetConstantBuffers(0, 1, m_pConstantBuffer.GetAddressOf());
+    context->VSSetConstantBuffers(0, 1, m_pEnvironmentBuffer.GetAddressOf());
     context->PSSetShader(m_pEnvironmentPixelShader.Get(), nullptr, 0);
     context->PSSetShaderResources(0, 1, m_pEnvironmentCubeShaderResourceView.GetAddressOf());
     context->PSSetSamplers(0, 1, m_pSamplerStates[0].GetAddressOf());
-    context->DrawIndexed(m_indexCount, 0, 0);
+    context->Draw(3, 0);
 
     ID3D11ShaderResourceView* nullsrv[] = { nullptr };
     context->PSSetShaderResources(0, 1, nullsrv);
+    context->OMSetDepthStencilState(nullptr, 0);
 }
 
 void Renderer::RenderPlane()
@@ -1058,12 +1197,12 @@ void Renderer::RenderPlane()
     context->PSSetConstantBuffers(1, 1, m_pLightBuffer.GetAddressOf());
     context->PSSetConstantBuffers(2, 1, m_pMaterialBuffer.GetAddressOf());
     context->PSSetConstantBuffers(3, 1, m_pShadowBuffer.GetAddressOf());
-    context->PSSetShaderResources(0, 1, m_pIrradianceShaderResourceView.GetAddressOf());
+    context->PSSetConstantBuffers(6, 1, m_pIrradianceBuffer.GetAddressOf());
     context->PSSetShaderResources(1, 1, m_pPrefilteredColorShaderResourceView.GetAddressOf());
     context->PSSetShaderResources(2, 1, m_pPreintegratedBRDFShaderResourceView.GetAddressOf());
     context->PSSetShaderResources(3, 1, m_pPlaneShaderResourceView.GetAddressOf());
-    context->PSSetShaderResources(6, 1, m_pSimpleShadowMapShaderResourceView.GetAddressOf());
-    context->PSSetShaderResources(7, 1, m_pPSSMShaderResourceView.GetAddressOf());
+    context->PSSetShaderResources(6, 1, m_pShadowAtlasShaderResourceView.GetAddressOf());
+    m_pClusteredLights->Bind(context, 9, 5);
     context->PSSetSamplers(0, 1, m_pSamplerStates[0].GetAddressOf());
     context->PSSetSamplers(1, 1, m_pSamplerStates[1].GetAddressOf());
     context->PSSetSamplers(2, 1, m_pSamplerStates[0].GetAddressOf());
@@ -1080,83 +1219,196 @@ void Renderer::PostProcessTexture()
 {
     ID3D11DeviceContext* context = m_pDeviceResources->GetDeviceContext();
 
-    m_pToneMap->Process(context, m_pRenderTexture->GetShaderResourceView(), m_pDeviceResources->GetRenderTarget(), m_pDeviceResources->GetViewPort());
+    m_pToneMap->Process(context, m_pRenderTexture->GetShaderResourceView(), m_pDeviceResources->GetRenderTarget(), m_pDeviceResources->GetViewPort(),
+        m_pSettings->GetHistogramExposureUsing(), m_pProfiler.get());
 }
 
 void Renderer::RenderModels()
 {
+    CPU_TRACE_SCOPE("Renderer::RenderModels");
+
     ID3D11DeviceContext* context = m_pDeviceResources->GetDeviceContext();
     ID3D11RenderTargetView* renderTarget = m_pRenderTexture->GetRenderTargetView();
-    ID3D11RenderTargetView* bloomRenderTarget = m_pBloom->GetBloomRenderTargetView();
 
     context->UpdateSubresource(m_pLightBuffer.Get(), 0, nullptr, &m_lightBufferData, 0, 0);
     context->PSSetConstantBuffers(1, 1, m_pLightBuffer.GetAddressOf());
     context->PSSetConstantBuffers(3, 1, m_pShadowBuffer.GetAddressOf());
-    context->PSSetShaderResources(0, 1, m_pIrradianceShaderResourceView.GetAddressOf());
+    context->PSSetConstantBuffers(6, 1, m_pIrradianceBuffer.GetAddressOf());
     context->PSSetShaderResources(1, 1, m_pPrefilteredColorShaderResourceView.GetAddressOf());
     context->PSSetShaderResources(2, 1, m_pPreintegratedBRDFShaderResourceView.GetAddressOf());
-    context->PSSetShaderResources(6, 1, m_pSimpleShadowMapShaderResourceView.GetAddressOf());
-    context->PSSetShaderResources(7, 1, m_pPSSMShaderResourceView.GetAddressOf());
+    context->PSSetShaderResources(6, 1, m_pShadowAtlasShaderResourceView.GetAddressOf());
+    m_pClusteredLights->Bind(context, 9, 5);
     context->PSSetSamplers(0, 1, m_pSamplerStates[0].GetAddressOf());
     context->PSSetSamplers(1, 1, m_pSamplerStates[1].GetAddressOf());
     context->PSSetSamplers(3, 1, m_pSamplerStates[2].GetAddressOf());
     context->PSSetSamplers(4, 1, m_pSamplerStates[3].GetAddressOf());
 
-    Model::ShadersSlots slots = { 3, 4, 5, 2, 0, 2 };
-    context->OMSetRenderTargets(1, &renderTarget, m_pDeviceResources->GetDepthStencil());
-    for (size_t i = 0; i < m_pModels.size(); ++i)
-        m_pModels[i]->Render(context, m_constantBufferData, m_pConstantBuffer.Get(), m_pMaterialBuffer.Get(), slots);
-    
-    context->OMSetRenderTargets(1, &bloomRenderTarget, m_pDeviceResources->GetDepthStencil());
-    for (size_t i = 0; i < m_pModels.size(); ++i)
-        m_pModels[i]->Render(context, m_constantBufferData, m_pConstantBuffer.Get(), m_pMaterialBuffer.Get(), slots, true);
-    
-    context->OMSetRenderTargets(1, &renderTarget, m_pDeviceResources->GetDepthStencil());
-    for (size_t i = 0; i < m_pModels.size(); ++i)
-        m_pModels[i]->RenderTransparent(context, m_constantBufferData, m_pConstantBuffer.Get(), m_pMaterialBuffer.Get(), slots, m_pCamera->GetDirection());
-
-    context->OMSetRenderTargets(1, &bloomRenderTarget, m_pDeviceResources->GetDepthStencil());
-    context->OMSetDepthStencilState(m_pDeviceResources->GetTransDepthStencil(), 0);
-    for (size_t i = 0; i < m_pModels.size(); ++i)
-        m_pModels[i]->RenderTransparent(context, m_constantBufferData, m_pConstantBuffer.Get(), m_pMaterialBuffer.Get(), slots, m_pCamera->GetDirection(), true);
+    PlanModelPasses(m_pSettings->GetOITUsing(), m_modelPasses);
+    ModelPassExecutor executor(this);
+    ExecuteModelPasses(m_modelPasses, executor);
 
     ID3D11ShaderResourceView* nullsrv[] = { nullptr };
     context->PSSetShaderResources(0, 1, nullsrv);
     context->OMSetRenderTargets(1, &renderTarget, m_pDeviceResources->GetDepthStencil());
 }
 
+void Renderer::BeginModelPass(const ModelPass& pass)
+{
+    ID3D11DeviceContext* context = m_pDeviceResources->GetDeviceContext();
+
+    if (pass.targets & MODEL_PASS_TARGET_OIT)
+    {
+        m_pOIT->Begin(context, m_pBloom->GetBloomRenderTargetView(), m_pDeviceResources->GetDepthStencil(), m_pDeviceResources->GetTransDepthStencil());
+        return;
+    }
+
+    // Resolve binds its own target
+    if (pass.type == MODEL_PASS_TYPE::OIT_RESOLVE)
+        return;
+
+    ID3D11RenderTargetView* renderTargets[2] = { m_pRenderTexture->GetRenderTargetView(), m_pBloom->GetBloomRenderTargetView() };
+    UINT renderTargetsCount = (pass.targets & MODEL_PASS_TARGET_BLOOM) ? 2 : 1;
+    context->OMSetRenderTargets(renderTargetsCount, renderTargets, m_pDeviceResources->GetDepthStencil());
+    context->OMSetDepthStencilState(pass.depthWrite ? nullptr : m_pDeviceResources->GetTransDepthStencil(), 0);
+}
+
+void Renderer::DrawModelPass(const ModelPass& pass)
+{
+    ID3D11DeviceContext* context = m_pDeviceResources->GetDeviceContext();
+
+    GPU_PROFILER_PASS profilerPass = GPU_PROFILER_PASS::MODELS_OPAQUE;
+    if (pass.type == MODEL_PASS_TYPE::ENVIRONMENT)
+        profilerPass = GPU_PROFILER_PASS::ENVIRONMENT;
+    else if (pass.type == MODEL_PASS_TYPE::SORTED_TRANSPARENT_PRIMITIVES || pass.type == MODEL_PASS_TYPE::OIT_TRANSPARENT_PRIMITIVES)
+        profilerPass = GPU_PROFILER_PASS::MODELS_TRANSPARENT;
+    else if (pass.type == MODEL_PASS_TYPE::OIT_RESOLVE)
+        profilerPass = GPU_PROFILER_PASS::OIT_RESOLVE;
+    m_pProfiler->BeginPass(context, profilerPass);
+
+    switch (pass.type)
+    {
+    case MODEL_PASS_TYPE::OPAQUE_PRIMITIVES:
+        for (size_t i = 0; i < m_pModels.size(); ++i)
+            m_pModels[i]->Render(context, m_constantBufferData, m_pConstantBuffer.Get(), m_pMaterialBuffer.Get(), modelSlots);
+        break;
+    case MODEL_PASS_TYPE::ENVIRONMENT:
+        RenderEnvironment();
+        break;
+    case MODEL_PASS_TYPE::SORTED_TRANSPARENT_PRIMITIVES:
+        RenderTransparentModels();
+        break;
+    case MODEL_PASS_TYPE::OIT_TRANSPARENT_PRIMITIVES:
+        for (size_t i = 0; i < m_pModels.size(); ++i)
+            m_pModels[i]->RenderTransparent(context, m_constantBufferData, m_pConstantBuffer.Get(), m_pMaterialBuffer.Get(), modelSlots, true, true);
+        break;
+    case MODEL_PASS_TYPE::OIT_RESOLVE:
+        m_pOIT->Resolve(context, m_pRenderTexture->GetRenderTargetView(), m_pRenderTexture->GetViewPort());
+        break;
+    }
+
+    m_pProfiler->EndPass(context, profilerPass);
+}
+
+void Renderer::RenderTransparentModels()
+{
+    CPU_TRACE_SCOPE("Renderer::RenderTransparentModels");
+
+    ID3D11DeviceContext* context = m_pDeviceResources->GetDeviceContext();
+
+    DirectX::XMVECTOR cameraPos = m_pCamera->GetPosition();
+    DirectX::XMVECTOR cameraDir = m_pCamera->GetDirection();
+
+    m_transparentSorter.Clear();
+    for (UINT i = 0; i < m_transparentDraws.size(); ++i)
+    {
+        const Model* model = m_pModels[m_transparentDraws[i].model].get();
+        if (!model->IsTransparentPrimitiveVisible(m_transparentDraws[i].primitive))
+            continue;
+        DirectX::XMVECTOR center = model->GetTransparentPrimitiveCenter(m_transparentDraws[i].primitive);
+        m_transparentSorter.Add(i, DirectX::XMVector3Dot(DirectX::XMVectorSubtract(center, cameraPos), cameraDir).m128_f32[0]);
+    }
+
+    WorldViewProjectionConstantBuffer transformationData = m_constantBufferData;
+    UINT boundModel = UINT_MAX;
+    for (uint32_t i : m_transparentSorter.Sort())
+    {
+        const TransparentDraw& draw = m_transparentDraws[i];
+        Model* model = m_pModels[draw.model].get();
+        if (draw.model != boundModel)
+        {
+            model->BindResources(context, m_pConstantBuffer.Get(), m_pMaterialBuffer.Get(), modelSlots);
+            boundModel = draw.model;
+        }
+        model->RenderTransparentPrimitive(context, transformationData, m_pConstantBuffer.Get(), m_pMaterialBuffer.Get(), modelSlots, draw.primitive);
+    }
+}
+
 void Renderer::Render()
 {
-    Clear();
+    CPU_TRACE_SCOPE("Renderer::Render");
 
     ID3D11DeviceContext* context = m_pDeviceResources->GetDeviceContext();
     ID3D11RenderTargetView* renderTarget;
 
+    m_pProfiler->BeginFrame(context);
+
+    Clear();
+
     D3D11_VIEWPORT viewport = m_pRenderTexture->GetViewPort();
 
     if (m_pSettings->GetShaderMode() == Settings::SETTINGS_PBR_SHADER_MODE::REGULAR)
     {
+        m_cascadesInstanced = false;
+        m_perCascadeShadowDrawCount = 0;
+        m_pProfiler->BeginPass(context, GPU_PROFILER_PASS::SHADOWS);
         if (m_pSettings->GetShadowPSSMUsing())
             RenderPSSM();
         else
             RenderSimpleShadow();
+        m_pProfiler->EndPass(context, GPU_PROFILER_PASS::SHADOWS);
+
+        UINT shadowDrawCount = GetModelDrawCount();
+        m_pSettings->SetShadowDrawCounts(shadowDrawCount, m_cascadesInstanced ? m_perCascadeShadowDrawCount : shadowDrawCount);
+        m_pSettings->SetShadowAtlasUsage(m_shadowAtlas.GetUsedTexels(), m_shadowAtlas.GetTileCount());
 
         context->RSSetViewports(1, &viewport);
 
         renderTarget = m_pRenderTexture->GetRenderTargetView();
         context->OMSetRenderTargets(1, &renderTarget, m_pDeviceResources->GetDepthStencil());
-        
-        RenderEnvironment();
+
+        // The environment is drawn by the model passes after the opaque models, or after the sphere
+        m_pProfiler->BeginPass(context, GPU_PROFILER_PASS::PLANE);
         RenderPlane();
+        m_pProfiler->EndPass(context, GPU_PROFILER_PASS::PLANE);
+
         if (m_pSettings->GetSceneMode() == Settings::SETTINGS_SCENE_MODE::MODEL)
         {
             RenderModels();
 
             context->OMSetRenderTargets(0, nullptr, nullptr);
+            m_pProfiler->BeginPass(context, GPU_PROFILER_PASS::BLOOM);
             m_pBloom->Process(context, m_pRenderTexture.get(), m_pDeviceResources->GetViewPort());
+            m_pProfiler->EndPass(context, GPU_PROFILER_PASS::BLOOM);
         }
         else
+        {
+            m_pProfiler->BeginPass(context, GPU_PROFILER_PASS::SPHERE);
             RenderSphere(m_constantBufferData);
+            m_pProfiler->EndPass(context, GPU_PROFILER_PASS::SPHERE);
+
+            m_pProfiler->BeginPass(context, GPU_PROFILER_PASS::ENVIRONMENT);
+            RenderEnvironment();
+            m_pProfiler->EndPass(context, GPU_PROFILER_PASS::ENVIRONMENT);
+        }
+
+        // Visible depth range for the next frames cascades
+        if (m_pSettings->GetShadowPSSMUsing() && m_pSettings->GetShadowSDSMUsing())
+        {
+            context->OMSetRenderTargets(0, nullptr, nullptr);
+            m_pProfiler->BeginPass(context, GPU_PROFILER_PASS::DEPTH_REDUCTION);
+            m_pDepthReduction->Process(context, m_pDeviceResources->GetDepthShaderResourceView(), m_pDeviceResources->GetWidth(), m_pDeviceResources->GetHeight());
+            m_pProfiler->EndPass(context, GPU_PROFILER_PASS::DEPTH_REDUCTION);
+        }
         
         PostProcessTexture();
     }
@@ -1167,31 +1419,103 @@ void Renderer::Render()
         renderTarget = m_pDeviceResources->GetRenderTarget();
         context->OMSetRenderTargets(1, &renderTarget, m_pDeviceResources->GetDepthStencil());
         
+        m_pProfiler->BeginPass(context, GPU_PROFILER_PASS::SPHERE);
         RenderSphere(m_constantBufferData);
+        m_pProfiler->EndPass(context, GPU_PROFILER_PASS::SPHERE);
     }
+
+    UINT modelDrawCount = GetModelDrawCount();
+    m_pSettings->SetModelDrawCount(modelDrawCount);
+    CPU_TRACE_COUNTER("Model draws", modelDrawCount);
+    const PassTimingStats& timings = m_pProfiler->GetStats();
+    for (UINT i = 0; i < timings.GetPassCount(); ++i)
+        m_pSettings->SetGpuPassTiming(i, GpuProfiler::GetPassName(static_cast<GPU_PROFILER_PASS>(i)), timings.GetAverage(i), timings.GetMax(i),
+            m_pProfiler->GetPixelShaderInvocations(static_cast<GPU_PROFILER_PASS>(i)));
+#if CPU_TRACE_ENABLED
+    m_pSettings->SetCpuTimings(CpuTracer::Get().GetZoneSummary(), CpuTracer::Get().GetCounterSummary());
+#endif
+    for (std::unique_ptr<Model>& model : m_pModels)
+        model->ResetDrawCount();
 }
 
-void Renderer::RenderSimpleShadow()
+UINT Renderer::GetModelDrawCount() const
 {
-    ID3D11DeviceContext* context = m_pDeviceResources->GetDeviceContext();
+    UINT drawCount = 0;
+    for (const std::unique_ptr<Model>& model : m_pModels)
+        drawCount += model->GetDrawCount();
+    return drawCount;
+}
+
+Float3 ToFloat3(DirectX::FXMVECTOR vector)
+{
+    DirectX::XMFLOAT3 result;
+    DirectX::XMStoreFloat3(&result, vector);
+    return { result.x, result.y, result.z };
+}
+
+// Maps the light clip space to the tile, in uv of the whole atlas
+DirectX::XMMATRIX ShadowTileTransform(const ShadowAtlasTile& tile)
+{
+    float scale = 0.5f * tile.size / shadowAtlasSize;
+    float x = (tile.x + 0.5f * tile.size) / shadowAtlasSize;
+    float y = (tile.y + 0.5f * tile.size) / shadowAtlasSize;
+    return DirectX::XMMatrixSet(scale, 0, 0, 0, 0, -scale, 0, 0, 0, 0, 1, 0, x, y, 0, 1);
+}
+
+// Tile bounds in atlas uv shrunk by half a texel, a tile that didn't fit into the atlas gets an empty rect
+DirectX::XMFLOAT4 ShadowTileRect(const ShadowAtlasTile& tile)
+{
+    if (tile.size == 0)
+        return DirectX::XMFLOAT4(1.0f, 1.0f, 0.0f, 0.0f);
+
+    float texel = 1.0f / shadowAtlasSize;
+    return DirectX::XMFLOAT4((tile.x + 0.5f) * texel, (tile.y + 0.5f) * texel, (tile.x + tile.size - 0.5f) * texel, (tile.y + tile.size - 0.5f) * texel);
+}
 
-    context->OMSetRenderTargets(0, nullptr, m_pSimpleShadowMapDepthStencilView.Get());
+D3D11_VIEWPORT ShadowTileViewport(const ShadowAtlasTile& tile)
+{
+    return CD3D11_VIEWPORT(static_cast<FLOAT>(tile.x), static_cast<FLOAT>(tile.y), static_cast<FLOAT>(tile.size), static_cast<FLOAT>(tile.size));
+}
+
+// Lights without strength cast no shadows, their tiles are left to the others
+bool Renderer::IsLightOn(UINT light) const
+{
+    return m_lightBufferData.LightColor[light].w > 0.0f;
+}
 
-    D3D11_VIEWPORT viewport = CD3D11_VIEWPORT(0.0f, 0.0f, static_cast<FLOAT>(simpleShadowMapSize), static_cast<FLOAT>(simpleShadowMapSize));
+CascadeCamera Renderer::GetShadowCamera() const
+{
+    CascadeCamera camera;
+    camera.position = ToFloat3(m_pCamera->GetPosition());
+    camera.direction = ToFloat3(m_pCamera->GetDirection());
+    camera.tanHalfFovY = tanf(0.5f * projectionFovY);
+    camera.tanHalfFovX = camera.tanHalfFovY * m_pDeviceResources->GetAspectRatio();
+    return camera;
+}
 
+void Renderer::ClearShadowTile(const ShadowAtlasTile& tile)
+{
+    ID3D11DeviceContext* context = m_pDeviceResources->GetDeviceContext();
+
+    D3D11_VIEWPORT viewport = ShadowTileViewport(tile);
     context->RSSetViewports(1, &viewport);
 
-    Model::ShadersSlots slots = { 3, 4, 5, 2, 0, 2 };
+    context->IASetInputLayout(nullptr);
+    context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+    context->VSSetShader(m_pShadowClearVertexShader.Get(), nullptr, 0);
+    context->PSSetShader(nullptr, nullptr, 0);
+    context->OMSetDepthStencilState(m_pShadowClearDepthStencilState.Get(), 0);
 
-    DirectX::XMVECTOR lightPos = DirectX::XMLoadFloat4(&m_lightBufferData.LightPosition[0]);
+    context->Draw(4, 0);
 
-    context->RSSetState(m_pSimpleShadowMapRasterizerState.Get());
+    context->OMSetDepthStencilState(nullptr, 0);
+}
 
-    DirectX::XMVECTOR x = DirectX::XMVectorSet(1, 0, 0, 0);
-    if (DirectX::XMVector3AngleBetweenVectors(lightPos, x).m128_f32[0] < 1e-7)
-        x = DirectX::XMVectorSet(0, 0, 1, 0);
+void Renderer::RenderSimpleShadow()
+{
+    CPU_TRACE_SCOPE("Renderer::RenderSimpleShadow");
 
-    DirectX::XMVECTOR y = DirectX::XMVector3Cross(lightPos, x);
+    ID3D11DeviceContext* context = m_pDeviceResources->GetDeviceContext();
 
     DirectX::XMVECTOR center;
     float radius;
@@ -1207,201 +1531,249 @@ void Renderer::RenderSimpleShadow()
         radius = 100;
     }
 
+    // Every light gets a tile as large as the scene needs from where the camera is, lights that are off get none
+    BoundingSphere scene = { ToFloat3(center), radius };
+    float resolution = EstimateShadowResolution(GetShadowCamera(), static_cast<float>(m_pDeviceResources->GetHeight()), scene, projectionNear);
+    m_shadowTileResolutions.resize(NUM_LIGHTS);
+    for (UINT light = 0; light < NUM_LIGHTS; ++light)
+        m_shadowTileResolutions[light] = IsLightOn(light) ? resolution : 0.0f;
+    if (m_shadowAtlas.Allocate(m_shadowTileResolutions.data(), NUM_LIGHTS, m_pSettings->GetShadowAtlasBudget()))
+        m_simpleShadowValid = false;
+
+    // Shadow maps and their transforms are still valid, only the flags might have changed
+    if (m_simpleShadowValid)
+    {
+        context->UpdateSubresource(m_pShadowBuffer.Get(), 0, nullptr, &m_shadowBufferData, 0, 0);
+        return;
+    }
+
+    context->OMSetRenderTargets(0, nullptr, m_pShadowAtlasDepthStencilView.Get());
+    context->ClearDepthStencilView(m_pShadowAtlasDepthStencilView.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
+
+    context->RSSetState(m_pSimpleShadowMapRasterizerState.Get());
+
     WorldViewProjectionConstantBuffer cb;
     cb.World = DirectX::XMMatrixIdentity();
-    DirectX::XMMATRIX view = DirectX::XMMatrixLookAtLH(DirectX::XMVectorAdd(center, DirectX::XMVectorScale(DirectX::XMVector3Normalize(lightPos), radius * 2)),
-        center, DirectX::XMVector3Normalize(y));
-    cb.View = DirectX::XMMatrixTranspose(view);
 
-    DirectX::XMVECTOR centerLightSpace = DirectX::XMVector3Transform(center, view);
-    float left = centerLightSpace.m128_f32[0] - radius;
-    float bottom = centerLightSpace.m128_f32[1] - radius;
-    float nearZ = centerLightSpace.m128_f32[2] - radius;
-    float right = centerLightSpace.m128_f32[0] + radius;
-    float top = centerLightSpace.m128_f32[1] + radius;
-    float farZ = centerLightSpace.m128_f32[2] + 750 * sqrt(2.0f);
+    for (UINT light = 0; light < NUM_LIGHTS; ++light)
+    {
+        const ShadowAtlasTile& tile = m_shadowAtlas.GetTile(light);
+        m_shadowBufferData.SimpleShadowRects[light] = ShadowTileRect(tile);
+        if (tile.size == 0)
+            continue;
 
-    DirectX::XMMATRIX projection = DirectX::XMMatrixOrthographicOffCenterLH(left, right, bottom, top, nearZ, farZ);
-    cb.Projection = DirectX::XMMatrixTranspose(projection);
+        D3D11_VIEWPORT viewport = ShadowTileViewport(tile);
+        context->RSSetViewports(1, &viewport);
 
-    context->ClearDepthStencilView(m_pSimpleShadowMapDepthStencilView.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
+        DirectX::XMVECTOR lightPos = DirectX::XMLoadFloat4(&m_lightBufferData.LightPosition[light]);
 
-    if (m_pSettings->GetSceneMode() == Settings::SETTINGS_SCENE_MODE::MODEL)
-    {
-        for (size_t i = 0; i < m_pModels.size(); ++i)
-            m_pModels[i]->Render(context, cb, m_pConstantBuffer.Get(), m_pMaterialBuffer.Get(), slots, false, false);
+        DirectX::XMVECTOR x = DirectX::XMVectorSet(1, 0, 0, 0);
+        if (DirectX::XMVector3AngleBetweenVectors(lightPos, x).m128_f32[0] < 1e-7)
+            x = DirectX::XMVectorSet(0, 0, 1, 0);
 
-        for (size_t i = 0; i < m_pModels.size(); ++i)
-            m_pModels[i]->RenderTransparent(context, cb, m_pConstantBuffer.Get(), m_pMaterialBuffer.Get(), slots, m_pCamera->GetDirection(), false, false);
-    }
-    else
-        RenderSphere(cb, false);
+        DirectX::XMVECTOR y = DirectX::XMVector3Cross(lightPos, x);
 
-    DirectX::XMMATRIX uv = DirectX::XMMatrixSet(0.5f, 0, 0, 0, 0, -0.5f, 0, 0, 0, 0, 1, 0, 0.5f, 0.5f, 0, 1);
-    m_shadowBufferData.SimpleShadowTransform = DirectX::XMMatrixMultiplyTranspose(DirectX::XMMatrixMultiply(view, projection), uv);
-    context->UpdateSubresource(m_pShadowBuffer.Get(), 0, nullptr, &m_shadowBufferData, 0, 0);
+        DirectX::XMMATRIX view = DirectX::XMMatrixLookAtLH(DirectX::XMVectorAdd(center, DirectX::XMVectorScale(DirectX::XMVector3Normalize(lightPos), radius * 2)),
+            center, DirectX::XMVector3Normalize(y));
+        cb.View = DirectX::XMMatrixTranspose(view);
 
-    context->RSSetState(nullptr);
-}
+        DirectX::XMVECTOR centerLightSpace = DirectX::XMVector3Transform(center, view);
+        float left = centerLightSpace.m128_f32[0] - radius;
+        float bottom = centerLightSpace.m128_f32[1] - radius;
+        float nearZ = centerLightSpace.m128_f32[2] - radius;
+        float right = centerLightSpace.m128_f32[0] + radius;
+        float top = centerLightSpace.m128_f32[1] + radius;
+        float farZ = centerLightSpace.m128_f32[2] + 750 * sqrt(2.0f);
 
-void GetMaximumMinimum(std::vector<DirectX::XMVECTOR>& points, DirectX::XMVECTOR& maxPoint, DirectX::XMVECTOR& minPoint)
-{
-    maxPoint = DirectX::XMVectorSet(-INFINITY, -INFINITY, -INFINITY, 0);
-    minPoint = DirectX::XMVectorSet(INFINITY, INFINITY, INFINITY, 0);
-    for (DirectX::XMVECTOR& point : points)
-    {
-        for (size_t i = 0; i < 3; ++i)
+        DirectX::XMMATRIX projection = DirectX::XMMatrixOrthographicOffCenterLH(left, right, bottom, top, nearZ, farZ);
+        cb.Projection = DirectX::XMMatrixTranspose(projection);
+
+        if (m_pSettings->GetSceneMode() == Settings::SETTINGS_SCENE_MODE::MODEL)
         {
-            maxPoint.m128_f32[i] = max(maxPoint.m128_f32[i], point.m128_f32[i]);
-            minPoint.m128_f32[i] = min(minPoint.m128_f32[i], point.m128_f32[i]);
+            for (size_t i = 0; i < m_pModels.size(); ++i)
+                m_pModels[i]->Render(context, cb, m_pConstantBuffer.Get(), m_pMaterialBuffer.Get(), modelSlots, false);
+
+            for (size_t i = 0; i < m_pModels.size(); ++i)
+                m_pModels[i]->RenderTransparent(context, cb, m_pConstantBuffer.Get(), m_pMaterialBuffer.Get(), modelSlots, false);
         }
+        else
+            RenderSphere(cb, false);
+
+        m_shadowBufferData.SimpleShadowTransforms[light] = DirectX::XMMatrixMultiplyTranspose(DirectX::XMMatrixMultiply(view, projection), ShadowTileTransform(tile));
     }
+
+    context->UpdateSubresource(m_pShadowBuffer.Get(), 0, nullptr, &m_shadowBufferData, 0, 0);
+
+    context->RSSetState(nullptr);
+
+    m_simpleShadowValid = true;
 }
 
 void Renderer::RenderPSSM()
 {
-    ID3D11DeviceContext* context = m_pDeviceResources->GetDeviceContext();
-
-    D3D11_VIEWPORT viewport = CD3D11_VIEWPORT(0.0f, 0.0f, static_cast<FLOAT>(PSSMSize), static_cast<FLOAT>(PSSMSize));
+    CPU_TRACE_SCOPE("Renderer::RenderPSSM");
 
-    context->RSSetViewports(1, &viewport);
-
-    Model::ShadersSlots slots = { 3, 4, 5, 2, 0, 2 };
+    ID3D11DeviceContext* context = m_pDeviceResources->GetDeviceContext();
 
-    DirectX::XMVECTOR lightPos = DirectX::XMLoadFloat4(&m_lightBufferData.LightPosition[0]);
-    DirectX::XMVECTOR lightDir = DirectX::XMVector3Normalize(lightPos);
+    context->OMSetRenderTargets(0, nullptr, m_pShadowAtlasDepthStencilView.Get());
 
     context->RSSetState(m_pSimpleShadowMapRasterizerState.Get());
 
-    DirectX::XMVECTOR x = DirectX::XMVectorSet(1, 0, 0, 0);
-    if (DirectX::XMVector3AngleBetweenVectors(lightPos, x).m128_f32[0] < 1e-7)
-        x = DirectX::XMVectorSet(0, 0, 1, 0);
-
-    DirectX::XMVECTOR y = DirectX::XMVector3Normalize(DirectX::XMVector3Cross(lightPos, x));
-
-    DirectX::XMVECTOR center;
-    float radius;
-
     WorldViewProjectionConstantBuffer cb;
     cb.World = DirectX::XMMatrixIdentity();
 
-    DirectX::XMMATRIX view, projection;
-    float nearBorder = projectionNear;
-    float farBorder = nearBorder + PSSMSplit;
-    float borders[4];
-
-    DirectX::XMVECTOR cameraPos = m_pCamera->GetPosition();
-    DirectX::XMVECTOR cameraDir = m_pCamera->GetDirection();
-    DirectX::XMVECTOR cameraUp = m_pCamera->GetUp();
-    DirectX::XMVECTOR cameraRight = m_pCamera->GetPerpendicular();
-
-    DirectX::XMVECTOR dirNear, dirFar, rightNear, rightFar, upNear, upFar;
+    // Sphere scene isn't a model, it's always rendered with a pass per cascade
+    bool singlePass = m_pSettings->GetShadowCascadesInstancing() && m_pSettings->GetSceneMode() == Settings::SETTINGS_SCENE_MODE::MODEL;
 
-    DirectX::XMVECTOR maxPoint, minPoint, maxModelPoint, minModelPoint;
+    // Sample distribution mode fits the cascades to the depth range that was visible a few frames ago
+    float splits[5];
+    DepthRange visibleRange;
+    if (m_pSettings->GetShadowSDSMUsing() && m_pDepthReduction->GetDepthRange(projectionNear, projectionFar, visibleRange))
+        FitSampleDistributionSplits(visibleRange, m_pSettings->GetPSSMSplitScheme(), m_pSettings->GetPSSMSplitLambda(), projectionNear, PSSMDistance, 4, splits);
+    else
+        ComputeCascadeSplits(m_pSettings->GetPSSMSplitScheme(), m_pSettings->GetPSSMSplitLambda(), projectionNear, PSSMDistance, 4, splits);
 
-    std::vector<DirectX::XMVECTOR> points(8);
-    float aspectRatio = m_pDeviceResources->GetAspectRatio();
+    CascadeCamera camera = GetShadowCamera();
 
-    for (UINT split = 0; split < 4; ++split)
+    // Models (or the sphere) and the plane cast shadows
+    m_cascadeCasters.clear();
+    if (m_pSettings->GetSceneMode() == Settings::SETTINGS_SCENE_MODE::MODEL)
     {
-        dirNear = DirectX::XMVectorScale(cameraDir, nearBorder);
-        dirFar = DirectX::XMVectorScale(cameraDir, farBorder);
-        rightNear = DirectX::XMVectorScale(cameraRight, nearBorder);
-        rightFar = DirectX::XMVectorScale(cameraRight, farBorder);
-        upNear = DirectX::XMVectorScale(cameraUp, nearBorder / aspectRatio);
-        upFar = DirectX::XMVectorScale(cameraUp, farBorder / aspectRatio);
-        
-        points[0] = DirectX::XMVectorAdd(cameraPos, DirectX::XMVectorAdd(dirNear, DirectX::XMVectorAdd(rightNear, upNear)));
-        points[1] = DirectX::XMVectorAdd(cameraPos, DirectX::XMVectorAdd(dirNear, DirectX::XMVectorSubtract(rightNear, upNear)));
-        points[2] = DirectX::XMVectorAdd(cameraPos, DirectX::XMVectorSubtract(dirNear, DirectX::XMVectorSubtract(rightNear, upNear)));
-        points[3] = DirectX::XMVectorAdd(cameraPos, DirectX::XMVectorSubtract(dirNear, DirectX::XMVectorAdd(rightNear, upNear)));
+        for (std::unique_ptr<Model>& model : m_pModels)
+            m_cascadeCasters.push_back({ ToFloat3(model->GetMinimumPosition()), ToFloat3(model->GetMaximumPosition()) });
+    }
+    else
+        m_cascadeCasters.push_back({ { -100.0f, -100.0f, -100.0f }, { 100.0f, 100.0f, 100.0f } });
+    m_cascadeCasters.push_back({ { -750.0f, 0.0f, -750.0f }, { 750.0f, 0.0f, 750.0f } });
 
-        points[4] = DirectX::XMVectorAdd(cameraPos, DirectX::XMVectorAdd(dirFar, DirectX::XMVectorAdd(rightFar, upFar)));
-        points[5] = DirectX::XMVectorAdd(cameraPos, DirectX::XMVectorAdd(dirFar, DirectX::XMVectorSubtract(rightFar, upFar)));
-        points[6] = DirectX::XMVectorAdd(cameraPos, DirectX::XMVectorSubtract(dirFar, DirectX::XMVectorSubtract(rightFar, upFar)));
-        points[7] = DirectX::XMVectorAdd(cameraPos, DirectX::XMVectorSubtract(dirFar, DirectX::XMVectorAdd(rightFar, upFar)));
+    // Cascade spheres only depend on the camera, nearer cascades cover less of the world and get more texels per unit
+    BoundingSphere spheres[4];
+    for (UINT split = 0; split < 4; ++split)
+        spheres[split] = FitCascadeSphere(camera, splits[split], splits[split + 1]);
 
-        GetMaximumMinimum(points, maxPoint, minPoint);
+    float screenHeight = static_cast<float>(m_pDeviceResources->GetHeight());
+    m_shadowTileResolutions.resize(NUM_LIGHTS * 4);
+    for (UINT light = 0; light < NUM_LIGHTS; ++light)
+    {
+        for (UINT split = 0; split < 4; ++split)
+            m_shadowTileResolutions[light * 4 + split] = IsLightOn(light) ? EstimateShadowResolution(camera, screenHeight, spheres[split], splits[split]) : 0.0f;
+    }
 
-        center = DirectX::XMVectorDivide(DirectX::XMVectorAdd(maxPoint, minPoint), DirectX::XMVectorReplicate(2));
-        radius = DirectX::XMVector3Length(DirectX::XMVectorDivide(DirectX::XMVectorSubtract(maxPoint, minPoint), DirectX::XMVectorReplicate(2))).m128_f32[0];
+    // A new layout moves the tiles, every cascade is rendered again into the cleared atlas
+    bool atlasChanged = m_shadowAtlas.Allocate(m_shadowTileResolutions.data(), NUM_LIGHTS * 4, m_pSettings->GetShadowAtlasBudget());
+    if (atlasChanged)
+    {
+        m_PSSMCache.Invalidate();
+        context->ClearDepthStencilView(m_pShadowAtlasDepthStencilView.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
+    }
 
-        view = DirectX::XMMatrixLookAtLH(DirectX::XMVectorAdd(center, lightDir), center, y);
+    for (UINT light = 0; light < NUM_LIGHTS; ++light)
+    {
+        // Light view doesn't depend on the camera, so cascade bounds can be compared between frames
+        DirectX::XMFLOAT4X4 lightView;
+        DirectX::XMFLOAT4 lightPos = m_lightBufferData.LightPosition[light];
+        ComputeLightView({ lightPos.x, lightPos.y, lightPos.z }, lightView.m);
+        DirectX::XMMATRIX view = DirectX::XMLoadFloat4x4(&lightView);
         cb.View = DirectX::XMMatrixTranspose(view);
 
-        for (size_t i = 0; i < 8; ++i)
-            points[i] = DirectX::XMVector3Transform(points[i], view);
-        GetMaximumMinimum(points, maxPoint, minPoint);
-
-        for (std::unique_ptr<Model>& model : m_pModels)
+        // Cascade is kept with its old transform while the fitted bounds move less than a texel
+        ShadowCascadeBounds cascadeBounds[4];
+        D3D11_VIEWPORT viewports[4];
+        UINT dirtyMask = 0;
+        UINT tiledMask = 0;
+        for (UINT split = 0; split < 4; ++split)
         {
-            DirectX::XMVECTOR maxModel = model->GetMaximumPosition();
-            DirectX::XMVECTOR minModel = model->GetMinimumPosition();
-
-            points[0] = DirectX::XMVector3Transform(DirectX::XMVectorSet(maxModel.m128_f32[0], maxModel.m128_f32[1], minModel.m128_f32[2], 1.0f), view);
-            points[1] = DirectX::XMVector3Transform(DirectX::XMVectorSet(maxModel.m128_f32[0], minModel.m128_f32[1], minModel.m128_f32[2], 1.0f), view);
-            points[2] = DirectX::XMVector3Transform(DirectX::XMVectorSet(minModel.m128_f32[0], minModel.m128_f32[1], minModel.m128_f32[2], 1.0f), view);
-            points[3] = DirectX::XMVector3Transform(DirectX::XMVectorSet(minModel.m128_f32[0], maxModel.m128_f32[1], minModel.m128_f32[2], 1.0f), view);
-
-            points[4] = DirectX::XMVector3Transform(DirectX::XMVectorSet(maxModel.m128_f32[0], maxModel.m128_f32[1], maxModel.m128_f32[2], 1.0f), view);
-            points[5] = DirectX::XMVector3Transform(DirectX::XMVectorSet(maxModel.m128_f32[0], minModel.m128_f32[1], maxModel.m128_f32[2], 1.0f), view);
-            points[6] = DirectX::XMVector3Transform(DirectX::XMVectorSet(minModel.m128_f32[0], minModel.m128_f32[1], maxModel.m128_f32[2], 1.0f), view);
-            points[7] = DirectX::XMVector3Transform(DirectX::XMVectorSet(minModel.m128_f32[0], maxModel.m128_f32[1], maxModel.m128_f32[2], 1.0f), view);
-            
-            GetMaximumMinimum(points, maxModelPoint, minModelPoint);
-
-            if (minModelPoint.m128_f32[0] < maxPoint.m128_f32[0] && maxModelPoint.m128_f32[0] > minPoint.m128_f32[0] &&
-                maxModelPoint.m128_f32[1] > minPoint.m128_f32[1] && minModelPoint.m128_f32[1] < maxPoint.m128_f32[1])
+            UINT cascade = light * 4 + split;
+            const ShadowAtlasTile& tile = m_shadowAtlas.GetTile(cascade);
+            viewports[split] = ShadowTileViewport(tile);
+            if (tile.size == 0)
             {
-                maxPoint.m128_f32[2] = max(maxPoint.m128_f32[2], maxModelPoint.m128_f32[2]);
-                minPoint.m128_f32[2] = min(minPoint.m128_f32[2], minModelPoint.m128_f32[2]);
-                maxPoint.m128_f32[0] = max(maxPoint.m128_f32[0], maxModelPoint.m128_f32[0]);
-                minPoint.m128_f32[0] = min(minPoint.m128_f32[0], minModelPoint.m128_f32[0]);
-                maxPoint.m128_f32[1] = max(maxPoint.m128_f32[1], maxModelPoint.m128_f32[1]);
-                minPoint.m128_f32[1] = min(minPoint.m128_f32[1], minModelPoint.m128_f32[1]);
+                m_shadowBufferData.PSSMRects[cascade] = ShadowTileRect(tile);
+                continue;
             }
+
+            tiledMask |= 1u << split;
+            cascadeBounds[split] = FitCascadeBounds(spheres[split], lightView.m, tile.size, m_cascadeCasters.data(), m_cascadeCasters.size());
+            if (m_PSSMCache.HasMoved(cascade, cascadeBounds[split], tile.size))
+                dirtyMask |= 1u << split;
         }
-        
-        points[0] = points[4] = DirectX::XMVector3Transform(DirectX::XMVectorSet(-750.0f, 0.0f, 750.0f, 1.0f), view);
-        points[1] = points[5] = DirectX::XMVector3Transform(DirectX::XMVectorSet(750.0f, 0.0f, 750.0f, 1.0f), view);
-        points[2] = points[6] = DirectX::XMVector3Transform(DirectX::XMVectorSet(750.0f, 0.0f, -750.0f, 1.0f), view);
-        points[3] = points[7] = DirectX::XMVector3Transform(DirectX::XMVectorSet(-750.0f, 0.0f, -750.0f, 1.0f), view);
 
-        GetMaximumMinimum(points, maxModelPoint, minModelPoint);
+        // Moved cascades that don't fit into this frame stay dirty and keep their old maps,
+        // except after a new layout, which has cleared them. Cascades that didn't move keep their valid maps.
+        CascadeUpdateScheduler& scheduler = m_cascadeSchedulers[light];
+        scheduler.SetBudget(m_pSettings->GetPSSMUpdateBudget());
+        scheduler.SetInterval(m_pSettings->GetPSSMUpdateInterval());
+        UINT scheduledMask = scheduler.Schedule(dirtyMask) & tiledMask;
+        if (atlasChanged)
+            scheduledMask = dirtyMask;
+
+        Frustum cascades[4];
+        UINT updateMask = 0;
 
-        if (minModelPoint.m128_f32[0] < maxPoint.m128_f32[0] && maxModelPoint.m128_f32[0] > minPoint.m128_f32[0] &&
-            maxModelPoint.m128_f32[1] > minPoint.m128_f32[1] && minModelPoint.m128_f32[1] < maxPoint.m128_f32[1])
+        for (UINT split = 0; split < 4; ++split)
         {
-            maxPoint.m128_f32[2] = max(maxPoint.m128_f32[2], maxModelPoint.m128_f32[2]);
-            minPoint.m128_f32[2] = min(minPoint.m128_f32[2], minModelPoint.m128_f32[2]);
-        }
+            if (!(scheduledMask & (1u << split)))
+                continue;
 
-        projection = DirectX::XMMatrixOrthographicOffCenterLH(minPoint.m128_f32[0], maxPoint.m128_f32[0], minPoint.m128_f32[1], maxPoint.m128_f32[1], minPoint.m128_f32[2], maxPoint.m128_f32[2]);
-        cb.Projection = DirectX::XMMatrixTranspose(projection);
+            UINT cascade = light * 4 + split;
+            const ShadowAtlasTile& tile = m_shadowAtlas.GetTile(cascade);
+            const ShadowCascadeBounds& bounds = cascadeBounds[split];
+            m_PSSMCache.Store(cascade, bounds);
 
-        context->ClearDepthStencilView(m_pPSSMDepthStencilViews[split].Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
-        context->OMSetRenderTargets(0, nullptr, m_pPSSMDepthStencilViews[split].Get());
+            DirectX::XMMATRIX projection = DirectX::XMMatrixOrthographicOffCenterLH(bounds.minPoint[0], bounds.maxPoint[0], bounds.minPoint[1], bounds.maxPoint[1], bounds.minPoint[2], bounds.maxPoint[2]);
+            cb.Projection = DirectX::XMMatrixTranspose(projection);
 
-        if (m_pSettings->GetSceneMode() == Settings::SETTINGS_SCENE_MODE::MODEL)
-        {
-            for (size_t i = 0; i < m_pModels.size(); ++i)
-                m_pModels[i]->Render(context, cb, m_pConstantBuffer.Get(), m_pMaterialBuffer.Get(), slots, false, false);
+            m_shadowBufferData.PSSMTransforms[cascade] = DirectX::XMMatrixMultiplyTranspose(DirectX::XMMatrixMultiply(view, projection), ShadowTileTransform(tile));
+            m_shadowBufferData.PSSMRects[cascade] = ShadowTileRect(tile);
 
-            for (size_t i = 0; i < m_pModels.size(); ++i)
-                m_pModels[i]->RenderTransparent(context, cb, m_pConstantBuffer.Get(), m_pMaterialBuffer.Get(), slots, m_pCamera->GetDirection(), false, false);
+            if (!atlasChanged)
+                ClearShadowTile(tile);
+
+            if (singlePass)
+            {
+                DirectX::XMMATRIX viewProjection = DirectX::XMMatrixMultiply(view, projection);
+                m_shadowCascadesData.CascadeViewProjection[split] = DirectX::XMMatrixTranspose(viewProjection);
+
+                DirectX::XMFLOAT4X4 cascadeViewProjection;
+                DirectX::XMStoreFloat4x4(&cascadeViewProjection, viewProjection);
+                cascades[split] = FrustumFromMatrix(cascadeViewProjection.m);
+                updateMask |= 1u << split;
+            }
+            else
+            {
+                context->RSSetViewports(1, &viewports[split]);
+
+                if (m_pSettings->GetSceneMode() == Settings::SETTINGS_SCENE_MODE::MODEL)
+                {
+                    for (size_t i = 0; i < m_pModels.size(); ++i)
+                        m_pModels[i]->Render(context, cb, m_pConstantBuffer.Get(), m_pMaterialBuffer.Get(), modelSlots, false);
+
+                    for (size_t i = 0; i < m_pModels.size(); ++i)
+                        m_pModels[i]->RenderTransparent(context, cb, m_pConstantBuffer.Get(), m_pMaterialBuffer.Get(), modelSlots, false);
+                }
+                else
+                    RenderSphere(cb, false);
+            }
         }
-        else
-            RenderSphere(cb, false);
 
-        DirectX::XMMATRIX uv = DirectX::XMMatrixSet(0.5f, 0, 0, 0, 0, -0.5f, 0, 0, 0, 0, 1, 0, 0.5f, 0.5f, 0, 1);
-        m_shadowBufferData.PSSMTransform[split] = DirectX::XMMatrixMultiplyTranspose(DirectX::XMMatrixMultiply(view, projection), uv);
+        // All updated cascades of the light at once, every primitive is instanced into the tiles of the cascades it overlaps
+        if (singlePass && updateMask != 0)
+        {
+            m_cascadePlanner.Plan(m_sceneBVH, cascades, 4, updateMask);
+            const std::vector<uint8_t>& masks = m_cascadePlanner.GetMasks();
 
-        borders[split] = farBorder;
-        
-        nearBorder = farBorder;
-        farBorder += PSSMSplit;
+            context->RSSetViewports(4, viewports);
+            context->VSSetConstantBuffers(4, 1, m_pShadowCascadesBuffer.GetAddressOf());
+
+            for (size_t i = 0; i < m_pModels.size(); ++i)
+                m_pModels[i]->RenderCascades(context, cb, m_pConstantBuffer.Get(), m_shadowCascadesData, m_pShadowCascadesBuffer.Get(), modelSlots, masks.data() + m_modelPrimitiveOffsets[i]);
+
+            m_perCascadeShadowDrawCount += m_cascadePlanner.GetPerCascadeDrawCount();
+            m_cascadesInstanced = true;
+        }
     }
-    m_shadowBufferData.PSSMBorders = DirectX::XMFLOAT4(borders);
+
+    m_shadowBufferData.PSSMBorders = DirectX::XMFLOAT4(splits + 1);
     context->UpdateSubresource(m_pShadowBuffer.Get(), 0, nullptr, &m_shadowBufferData, 0, 0);
 
     context->RSSetState(nullptr);
@@ -6,8 +6,25 @@
 #include "ToneMapPostProcess.h"
 #include "Camera.h"
 #include "BloomProcess.h"
+#include "OITProcess.h"
+#include "DepthReductionProcess.h"
 #include "Settings.h"
 #include "Model.h"
+#include "BoundingVolumeHierarchy.h"
+#include "TransparentSorter.h"
+#include "ModelPassPlanner.h"
+#include "ShadowCache.h"
+#include "ShadowCascadePlanner.h"
+#include "ShadowCascades.h"
+#include "CascadeUpdateScheduler.h"
+#include "ShadowAtlas.h"
+#include "ClusteredLights.h"
+#include "StateObjectCache.h"
+#include "GpuProfiler.h"
+#include "IBLBaker.h"
+#include "IBLBakeScheduler.h"
+#include "SkyRay.h"
+#include "TextureFormats.h"
 
 class Renderer
 {
@@ -24,6 +41,9 @@ public:
 
     void Render();
 
+    // Frame measurement is begun by Render, the caller ends it after the remaining passes (ImGui)
+    GpuProfiler* GetProfiler() const { return m_pProfiler.get(); };
+
 private:
     HRESULT CreateShaders();
     HRESULT CreateSphere();
@@ -31,84 +51,126 @@ private:
     HRESULT CreateLights();
     HRESULT CreateTexture();
     HRESULT CreateCubeTexture();
-    HRESULT CreateIrradianceTexture();
-    HRESULT CreatePrefilteredColorTexture();
+    HRESULT BakeEnvironmentLighting(IBLBakeResult& bake);
+    HRESULT CreateIrradianceBuffer(const IrradianceSH& irradiance, ID3D11Buffer** buffer);
+    HRESULT CreatePrefilteredColorTexture(const CubeMap& prefilteredColor);
     HRESULT CreatePreintegratedBRDFTexture();
-    HRESULT CreateCubeTextureFromResource(UINT size, ID3D11Texture2D* dst, ID3D11ShaderResourceView* src, ID3D11VertexShader* vs, ID3D11PixelShader* ps, UINT mipSlice = 0);
+    HRESULT CreateCubeTextureFromData(const CubeMap& cube, HDR_TEXTURE_USAGE usage, ID3D11Texture2D** texture, ID3D11ShaderResourceView** shaderResourceView);
     HRESULT CreateModels();
     HRESULT CreateShadows();
 
+    DirectX::XMMATRIX GetProjectionMatrix() const;
     void UpdatePerspective();
+    void UpdateSkyRayTransform();
+    void UpdateVideoMemory();
+    void StartEnvironmentBake(const std::string& path);
+    HRESULT SwapEnvironmentLighting();
+    void CullModels();
+    bool UpdateShadowCasters();
+    HRESULT UpdatePointLights();
 
     void Clear();
     void RenderSphere(WorldViewProjectionConstantBuffer& transformationData, bool usePS = true);
     void RenderModels();
+    void RenderTransparentModels();
+    void BeginModelPass(const ModelPass& pass);
+    void DrawModelPass(const ModelPass& pass);
     void RenderEnvironment();
     void RenderPlane();
     void RenderSimpleShadow();
     void RenderPSSM();
+    void ClearShadowTile(const ShadowAtlasTile& tile);
     void PostProcessTexture();
 
+    UINT GetModelDrawCount() const;
+    bool IsLightOn(UINT light) const;
+    CascadeCamera GetShadowCamera() const;
+
     std::unique_ptr<RenderTexture>      m_pRenderTexture;
     std::unique_ptr<ToneMapPostProcess> m_pToneMap;
     std::unique_ptr<BloomProcess>       m_pBloom;
+    std::unique_ptr<OITProcess>         m_pOIT;
+    std::unique_ptr<DepthReductionProcess> m_pDepthReduction;
+    std::unique_ptr<ClusteredLights>    m_pClusteredLights;
+    std::unique_ptr<GpuProfiler>        m_pProfiler;
     std::shared_ptr<Camera>             m_pCamera;
     std::shared_ptr<DeviceResources>    m_pDeviceResources;
     std::shared_ptr<Settings>           m_pSettings;
     std::shared_ptr<ModelShaders>       m_pModelShaders;
+    std::shared_ptr<StateObjectCache>   m_pStateCache;
 
     Microsoft::WRL::ComPtr<ID3D11InputLayout>        m_pInputLayout;
-    Microsoft::WRL::ComPtr<ID3D11InputLayout>        m_pIBLInputLayout;
     Microsoft::WRL::ComPtr<ID3D11Buffer>             m_pVertexBuffer;
-    Microsoft::WRL::ComPtr<ID3D11Buffer>             m_pEnvironmentVertexBuffer;
     Microsoft::WRL::ComPtr<ID3D11Buffer>             m_pPlaneVertexBuffer;
     Microsoft::WRL::ComPtr<ID3D11Buffer>             m_pIndexBuffer;
     Microsoft::WRL::ComPtr<ID3D11Buffer>             m_pPlaneIndexBuffer;
-    Microsoft::WRL::ComPtr<ID3D11Texture2D>          m_pEnvironmentTexture;
-    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_pEnvironmentShaderResourceView;
     Microsoft::WRL::ComPtr<ID3D11Texture2D>          m_pEnvironmentCubeTexture;
     Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_pEnvironmentCubeShaderResourceView;
-    Microsoft::WRL::ComPtr<ID3D11Texture2D>          m_pIrradianceTexture;
-    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_pIrradianceShaderResourceView;
     Microsoft::WRL::ComPtr<ID3D11Texture2D>          m_pPrefilteredColorTexture;
     Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_pPrefilteredColorShaderResourceView;
     Microsoft::WRL::ComPtr<ID3D11Texture2D>          m_pPreintegratedBRDFTexture;
     Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_pPreintegratedBRDFShaderResourceView;
     Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_pPlaneShaderResourceView;
-    Microsoft::WRL::ComPtr<ID3D11Texture2D>          m_pSimpleShadowMapTexture;
-    Microsoft::WRL::ComPtr<ID3D11DepthStencilView>   m_pSimpleShadowMapDepthStencilView;
-    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_pSimpleShadowMapShaderResourceView;
-    Microsoft::WRL::ComPtr<ID3D11Texture2D>          m_pPSSMTexture;
-    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_pPSSMShaderResourceView;
+    Microsoft::WRL::ComPtr<ID3D11Texture2D>          m_pShadowAtlasTexture;
+    Microsoft::WRL::ComPtr<ID3D11DepthStencilView>   m_pShadowAtlasDepthStencilView;
+    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_pShadowAtlasShaderResourceView;
     Microsoft::WRL::ComPtr<ID3D11RasterizerState>    m_pSimpleShadowMapRasterizerState;
+    Microsoft::WRL::ComPtr<ID3D11DepthStencilState>  m_pShadowClearDepthStencilState;
     Microsoft::WRL::ComPtr<ID3D11VertexShader>       m_pPBRVertexShader;
     Microsoft::WRL::ComPtr<ID3D11VertexShader>       m_pEnvironmentVertexShader;
-    Microsoft::WRL::ComPtr<ID3D11VertexShader>       m_pIBLVertexShader;
-    Microsoft::WRL::ComPtr<ID3D11VertexShader>       m_pEnvironmentCubeVertexShader;
+    Microsoft::WRL::ComPtr<ID3D11VertexShader>       m_pShadowClearVertexShader;
     Microsoft::WRL::ComPtr<ID3D11PixelShader>        m_pPixelShader;
     Microsoft::WRL::ComPtr<ID3D11PixelShader>        m_pPlanePixelShader;
     Microsoft::WRL::ComPtr<ID3D11PixelShader>        m_pNDPixelShader;
     Microsoft::WRL::ComPtr<ID3D11PixelShader>        m_pGPixelShader;
     Microsoft::WRL::ComPtr<ID3D11PixelShader>        m_pFPixelShader;
     Microsoft::WRL::ComPtr<ID3D11PixelShader>        m_pEnvironmentPixelShader;
-    Microsoft::WRL::ComPtr<ID3D11PixelShader>        m_pIrradiancePixelShader;
-    Microsoft::WRL::ComPtr<ID3D11PixelShader>        m_pPrefilteredColorPixelShader;
-    Microsoft::WRL::ComPtr<ID3D11PixelShader>        m_pPreintegratedBRDFPixelShader;
-    Microsoft::WRL::ComPtr<ID3D11PixelShader>        m_pEnvironmentCubePixelShader;
     Microsoft::WRL::ComPtr<ID3D11Buffer>             m_pConstantBuffer;
     Microsoft::WRL::ComPtr<ID3D11Buffer>             m_pLightBuffer;
     Microsoft::WRL::ComPtr<ID3D11Buffer>             m_pMaterialBuffer;
     Microsoft::WRL::ComPtr<ID3D11Buffer>             m_pShadowBuffer;
+    Microsoft::WRL::ComPtr<ID3D11Buffer>             m_pShadowCascadesBuffer;
+    Microsoft::WRL::ComPtr<ID3D11Buffer>             m_pEnvironmentBuffer;
+    Microsoft::WRL::ComPtr<ID3D11Buffer>             m_pIrradianceBuffer;
 
     std::vector<Microsoft::WRL::ComPtr<ID3D11SamplerState>>       m_pSamplerStates;
-    std::vector<Microsoft::WRL::ComPtr<ID3D11DepthStencilView>>   m_pPSSMDepthStencilViews;
 
     std::vector<std::unique_ptr<Model>> m_pModels;
 
+    // Primitives of all models, model i owns ids starting from m_modelPrimitiveOffsets[i]
+    BoundingVolumeHierarchy m_sceneBVH;
+    std::vector<UINT>       m_modelPrimitiveOffsets;
+    std::vector<uint32_t>   m_visiblePrimitives;
+
+    struct TransparentDraw
+    {
+        UINT model;
+        UINT primitive;
+    };
+
+    // Transparent primitives of all models, sorted together every frame
+    std::vector<TransparentDraw> m_transparentDraws;
+    TransparentSorter            m_transparentSorter;
+
+    class ModelPassExecutor : public ModelPassContext
+    {
+    public:
+        ModelPassExecutor(Renderer* renderer) : m_pRenderer(renderer) {};
+
+        void BeginPass(const ModelPass& pass) override { m_pRenderer->BeginModelPass(pass); };
+        void DrawPass(const ModelPass& pass) override { m_pRenderer->DrawModelPass(pass); };
+
+    private:
+        Renderer* m_pRenderer;
+    };
+
+    std::vector<ModelPass> m_modelPasses;
+
     WorldViewProjectionConstantBuffer m_constantBufferData;
     LightConstantBuffer               m_lightBufferData;
     MaterialConstantBuffer            m_materialBufferData;
     ShadowConstantBuffer              m_shadowBufferData;
+    EnvironmentConstantBuffer         m_environmentBufferData;
     
     UINT32 m_indexCount;
     UINT32 m_planeIndexCount;
@@ -117,39 +179,31 @@ private:
     DirectX::XMVECTOR m_sceneCenter;
     FLOAT m_sceneRadius;
 
-    DirectX::XMVECTOR m_targers[6] = {
-        DirectX::XMVectorSet(1, 0, 0, 0),
-        DirectX::XMVectorSet(-1, 0, 0, 0),
-        DirectX::XMVectorSet(0, 1, 0, 0),
-        DirectX::XMVectorSet(0, -1, 0, 0),
-        DirectX::XMVectorSet(0, 0, 1, 0),
-        DirectX::XMVectorSet(0, 0, -1, 0)
-    };
-
-    DirectX::XMVECTOR m_ups[6] = {
-        DirectX::XMVectorSet(0, 1, 0, 0),
-        DirectX::XMVectorSet(0, 1, 0, 0),
-        DirectX::XMVectorSet(0, 0, -1, 0),
-        DirectX::XMVectorSet(0, 0, 1, 0),
-        DirectX::XMVectorSet(0, 1, 0, 0),
-        DirectX::XMVectorSet(0, 1, 0, 0)
-    };
-
-    DirectX::XMFLOAT3 m_squareLeftBottomAngles[6] = {
-        DirectX::XMFLOAT3(0.5f, -0.5f, 0.5f),
-        DirectX::XMFLOAT3(-0.5f, -0.5f, -0.5f),
-        DirectX::XMFLOAT3(-0.5f, 0.5f, 0.5f),
-        DirectX::XMFLOAT3(-0.5f, -0.5f, -0.5f),
-        DirectX::XMFLOAT3(-0.5f, -0.5f, 0.5f),
-        DirectX::XMFLOAT3(0.5f, -0.5f, -0.5f)
-    };
-
-    DirectX::XMFLOAT3 m_squareRightTopAngles[6] = {
-        DirectX::XMFLOAT3(0.5f, 0.5f, -0.5f),
-        DirectX::XMFLOAT3(-0.5f, 0.5f, 0.5f),
-        DirectX::XMFLOAT3(0.5f, 0.5f, -0.5f),
-        DirectX::XMFLOAT3(0.5f, -0.5f, 0.5f),
-        DirectX::XMFLOAT3(0.5f, 0.5f, 0.5f),
-        DirectX::XMFLOAT3(-0.5f, 0.5f, -0.5f)
-    };
+    ShadowCacheTracker m_shadowCasters;
+    ShadowCascadeCache m_PSSMCache;
+    bool               m_simpleShadowValid;
+
+    // Tiles of the simple maps (one per light) or of the cascades (light * 4 + cascade)
+    ShadowAtlas        m_shadowAtlas;
+    std::vector<float> m_shadowTileResolutions;
+
+    std::vector<CascadeUpdateScheduler> m_cascadeSchedulers;
+    std::vector<AABB>            m_cascadeCasters;
+    ShadowCascadePlanner         m_cascadePlanner;
+    ShadowCascadesConstantBuffer m_shadowCascadesData;
+    bool                         m_cascadesInstanced;
+    UINT                         m_perCascadeShadowDrawCount;
+
+    // Decoded env.hdr and its cube, kept on the CPU until the lighting is baked
+    EnvironmentImage m_environmentImage;
+    CubeMap          m_environmentCube;
+    uint64_t         m_environmentBakeKey;
+
+    // Lighting of an environment loaded at runtime, baked over frames while the current one is still shown
+    IBLBakeScheduler m_iblBakeScheduler;
+    std::string      m_bakingEnvironmentPath;
+
+    // Unshadowed point lights shaded through the light clusters, generated again when their settings change
+    std::vector<PointLight> m_pointLights;
+    ShadowCacheTracker      m_pointLightSettings;
 };
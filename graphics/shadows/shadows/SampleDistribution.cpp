@@ -0,0 +1,62 @@
+#include "SampleDistribution.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    const float RANGE_STEPS_PER_OCTAVE = 8.0f;
+
+    // Visible range has to be at least this many times its near distance
+    const float MIN_RANGE_RATIO = 1.25f;
+}
+
+float LinearizeDepth(float depth, float nearZ, float farZ)
+{
+    return nearZ * farZ / ((nearZ - farZ) * depth + farZ);
+}
+
+DepthRange ReduceDepthRange(const float* depth, uint32_t width, uint32_t height, size_t rowPitch, float nearZ, float farZ)
+{
+    // Same as the compute shader: raw depth is reduced and only the extremes are linearized,
+    // which is fine since linearization is monotonic
+    float minDepth = 1.0f;
+    float maxDepth = 0.0f;
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        const float* row = depth + y * rowPitch;
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            float value = row[x];
+            if (value >= 1.0f)
+                continue;
+            minDepth = std::min(minDepth, value);
+            maxDepth = std::max(maxDepth, value);
+        }
+    }
+
+    DepthRange range = { farZ, nearZ, false };
+    if (minDepth > maxDepth)
+        return range;
+
+    range.minDistance = LinearizeDepth(minDepth, nearZ, farZ);
+    range.maxDistance = LinearizeDepth(maxDepth, nearZ, farZ);
+    range.valid = true;
+    return range;
+}
+
+void FitSampleDistributionSplits(const DepthRange& range, CASCADE_SPLIT_SCHEME scheme, float lambda, float nearLimit, float farLimit, uint32_t cascadeCount, float* splits)
+{
+    float nearDistance = nearLimit;
+    float farDistance = farLimit;
+    if (range.valid && range.minDistance <= range.maxDistance)
+    {
+        nearDistance = exp2f(floorf(log2f(std::max(range.minDistance, nearLimit)) * RANGE_STEPS_PER_OCTAVE) / RANGE_STEPS_PER_OCTAVE);
+        farDistance = exp2f(ceilf(log2f(std::max(range.maxDistance, nearLimit)) * RANGE_STEPS_PER_OCTAVE) / RANGE_STEPS_PER_OCTAVE);
+
+        nearDistance = std::min(std::max(nearDistance, nearLimit), farLimit / MIN_RANGE_RATIO);
+        farDistance = std::min(std::max(farDistance, nearDistance * MIN_RANGE_RATIO), farLimit);
+    }
+
+    ComputeCascadeSplits(scheme, lambda, nearDistance, farDistance, cascadeCount, splits);
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "ShadowCascades.h"
+
+// Sample distribution shadow maps: cascades are fitted to the depth range that is actually visible.
+// The GPU reduction in DepthReductionProcess matches ReduceDepthRange, which is the CPU reference.
+
+struct DepthRange
+{
+    float minDistance;
+    float maxDistance;
+    bool  valid;
+};
+
+// View distance of a [0, 1] depth from a perspective projection with the given near and far planes
+float LinearizeDepth(float depth, float nearZ, float farZ);
+
+// Min and max view distance over the pixels that aren't at the far plane (cleared depth)
+DepthRange ReduceDepthRange(const float* depth, uint32_t width, uint32_t height, size_t rowPitch, float nearZ, float farZ);
+
+// Cascade splits over the visible range clamped to [nearLimit, farLimit], or over the whole limits if the
+// range isn't valid. The range is widened to 1/8 octave steps, so small depth changes keep the cascades (and
+// their cached shadow maps) in place.
+void FitSampleDistributionSplits(const DepthRange& range, CASCADE_SPLIT_SCHEME scheme, float lambda, float nearLimit, float farLimit, uint32_t cascadeCount, float* splits);
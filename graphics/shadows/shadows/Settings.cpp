@@ -7,10 +7,19 @@
 #include "../../ImGui/imgui_impl_dx11.h"
 #include "../../ImGui/imgui_impl_win32.h"
 
+// The renderer keeps a rasterizer state for every pair of biases in its state cache, which never releases them.
+// Clamped and quantized biases keep the pairs below the 4096 unique rasterizer states a D3D11 device allows: 33 * 81 of them.
+const int maxDepthBias = 32;
+const float maxSlopeScaledDepthBias = 10.0f;
+const float slopeScaledDepthBiasStep = 0.125f;
+
 Settings::Settings(const std::shared_ptr<DeviceResources>& deviceResources) :
     m_pDeviceResources(deviceResources),
     m_shaderMode(SETTINGS_PBR_SHADER_MODE::REGULAR),
     m_sceneMode(SETTINGS_SCENE_MODE::MODEL),
+    m_useOIT(false),
+    m_useHistogramExposure(true),
+    m_modelDrawCount(0),
     m_lightsStrengths(),
     m_lightsThetaAngles(),
     m_lightsPhiAngles(),
@@ -19,23 +28,59 @@ Settings::Settings(const std::shared_ptr<DeviceResources>& deviceResources) :
     m_lightsAttenuations(),
     m_metalRough(),
     m_depthBias(10),
-    m_slopeScaledDepthBias(2 * static_cast<float>(sqrt(2))),
+    m_slopeScaledDepthBias(2.875f), // 2 * sqrt(2) on the slider steps
     m_useShadowPCF(true),
     m_useShadowPSSM(false),
-    m_showPSSMSplits(false)
+    m_showPSSMSplits(false),
+    m_useShadowCascadesInstancing(true),
+    m_useShadowSDSM(false),
+    m_PSSMSplitScheme(CASCADE_SPLIT_SCHEME::PRACTICAL),
+    m_PSSMSplitLambda(0.5f),
+    m_PSSMUpdateBudget(2),
+    m_PSSMUpdateInterval(1),
+    m_shadowAtlasBudget(8),
+    m_shadowDrawCount(0),
+    m_perCascadeShadowDrawCount(0),
+    m_shadowAtlasTexels(0),
+    m_shadowAtlasTiles(0),
+    m_pointLightCount(256),
+    m_pointLightRange(50.0f),
+    m_pointLightIntensity(500.0f),
+    m_clusteredLightIndices(0),
+    m_logGpuTimings(false),
+    m_recordCpuTrace(true),
+    m_iblBakeTime(0.0f),
+    m_iblBakeCached(false),
+    m_environmentPath("env.hdr"),
+    m_environmentRequested(false),
+    m_iblBakeBudget(2.0f),
+    m_iblBaking(false),
+    m_iblBakeProgress(0.0f),
+    m_iblBakeUpdates(0)
 {
     for (UINT i = 0; i < NUM_LIGHTS; ++i)
     {
         m_lightsColors[i][0] = m_lightsColors[i][1] = m_lightsColors[i][2] = 1.0f;
         m_lightsAttenuations[i][0] = 1.0f;
-        m_lightsAttenuations[i][1] = 0.01f;
+        m_lightsAttenuations[i][1] = 0.001f;
+        m_lightsStrengths[i] = 0.0f;
+        m_lightsThetaAngles[i] = 1.1f;
+        m_lightsPhiAngles[i] = 2.1f + 2.0f * i;
+        m_lightsDistances[i] = 200.0f;
     }
 
-    m_lightsAttenuations[0][1] = 0.001f;
+    // A white key light and two dimmer colored ones from the other sides, each with its own shadow tiles
     m_lightsStrengths[0] = 500.0f;
-    m_lightsThetaAngles[0] = 1.1f;
-    m_lightsPhiAngles[0] = 2.1f;
-    m_lightsDistances[0] = 200.0f;
+#if NUM_LIGHTS > 2
+    m_lightsStrengths[1] = 150.0f;
+    m_lightsThetaAngles[1] = 0.7f;
+    m_lightsColors[1][1] = 0.85f;
+    m_lightsColors[1][2] = 0.7f;
+    m_lightsStrengths[2] = 100.0f;
+    m_lightsThetaAngles[2] = 1.3f;
+    m_lightsColors[2][0] = 0.7f;
+    m_lightsColors[2][1] = 0.8f;
+#endif
 };
 
 void Settings::CreateResources(HWND hWnd)
@@ -48,14 +93,26 @@ void Settings::CreateResources(HWND hWnd)
     ImGui::StyleColorsDark();
 }
 
+bool Settings::TakeEnvironmentRequest(std::string& path)
+{
+    if (!m_environmentRequested)
+        return false;
+
+    m_environmentRequested = false;
+    path = m_environmentPath;
+    return true;
+}
+
 void Settings::Render()
 {
+    CPU_TRACE_SCOPE("Settings::Render");
+
     ImGui_ImplDX11_NewFrame();
     ImGui_ImplWin32_NewFrame();
     ImGui::NewFrame();
 
     ImGui::SetNextWindowPos(ImVec2(0, 0), ImGuiCond_Once);
-    ImGui::SetNextWindowSize(ImVec2(410, 90), ImGuiCond_Once);
+    ImGui::SetNextWindowSize(ImVec2(410, 140), ImGuiCond_Once);
 
     ImGui::Begin("Settings");
 
@@ -65,11 +122,18 @@ void Settings::Render()
     static const char* sceneModes[] = { "Model", "Sphere" };
     ImGui::Combo("Scene content", reinterpret_cast<int*>(&m_sceneMode), sceneModes, IM_ARRAYSIZE(sceneModes));
 
+    ImGui::Checkbox("Order independent transparency", &m_useOIT);
+
+    // Off reads the average luminance back to the CPU every frame
+    ImGui::Checkbox("Histogram exposure", &m_useHistogramExposure);
+
+    ImGui::Text("Model draw calls: %u", m_modelDrawCount);
+
     ImGui::End();
 
     for (UINT i = 0; i < NUM_LIGHTS; ++i)
     {
-        ImGui::SetNextWindowPos(ImVec2(0, 90 + 175 * static_cast<float>(i)), ImGuiCond_Once);
+        ImGui::SetNextWindowPos(ImVec2(0, 140 + 175 * static_cast<float>(i)), ImGuiCond_Once);
         ImGui::SetNextWindowSize(ImVec2(410, 175), ImGuiCond_Once);
 
         ImGui::Begin((std::string("Light ") + std::to_string(i)).c_str());
@@ -89,29 +153,51 @@ void Settings::Render()
         ImGui::End();
     }
 
-    ImGui::SetNextWindowPos(ImVec2(0, 90 + 175 * NUM_LIGHTS), ImGuiCond_Once);
-    ImGui::SetNextWindowSize(ImVec2(410, 150), ImGuiCond_Once);
+    ImGui::SetNextWindowPos(ImVec2(0, 140 + 175 * NUM_LIGHTS), ImGuiCond_Once);
+    ImGui::SetNextWindowSize(ImVec2(410, 360), ImGuiCond_Once);
 
     ImGui::Begin("Shadows");
 
-    ImGui::SliderInt("Depth bias", &m_depthBias, 0, 32);
+    // Values typed in with ctrl+click aren't clamped by the sliders
+    ImGui::SliderInt("Depth bias", &m_depthBias, 0, maxDepthBias);
+    m_depthBias = m_depthBias < 0 ? 0 : (m_depthBias > maxDepthBias ? maxDepthBias : m_depthBias);
 
-    ImGui::SliderFloat("Slope scaled depth bias", &m_slopeScaledDepthBias, 0.0f, 10.0f);
+    ImGui::SliderFloat("Slope scaled depth bias", &m_slopeScaledDepthBias, 0.0f, maxSlopeScaledDepthBias, "%.3f");
+    float slope = m_slopeScaledDepthBias < 0.0f ? 0.0f : (m_slopeScaledDepthBias > maxSlopeScaledDepthBias ? maxSlopeScaledDepthBias : m_slopeScaledDepthBias);
+    m_slopeScaledDepthBias = roundf(slope / slopeScaledDepthBiasStep) * slopeScaledDepthBiasStep;
 
     ImGui::Checkbox("Use PCF", &m_useShadowPCF);
 
     ImGui::Checkbox("Use PSSM", &m_useShadowPSSM);
 
     if (m_useShadowPSSM)
+    {
         ImGui::Checkbox("Show splits", &m_showPSSMSplits);
+        ImGui::Checkbox("Single pass cascades", &m_useShadowCascadesInstancing);
+        ImGui::Checkbox("Fit cascades to visible depth", &m_useShadowSDSM);
+
+        static const char* splitSchemes[] = { "Uniform", "Logarithmic", "Practical" };
+        ImGui::Combo("Split scheme", reinterpret_cast<int*>(&m_PSSMSplitScheme), splitSchemes, IM_ARRAYSIZE(splitSchemes));
+
+        if (m_PSSMSplitScheme == CASCADE_SPLIT_SCHEME::PRACTICAL)
+            ImGui::SliderFloat("Split lambda", &m_PSSMSplitLambda, 0.0f, 1.0f);
+
+        ImGui::SliderInt("Far cascades per frame", &m_PSSMUpdateBudget, 1, 3);
+        ImGui::SliderInt("Far cascades interval", &m_PSSMUpdateInterval, 1, 8);
+    }
     else
         m_showPSSMSplits = false;
 
+    ImGui::SliderInt("Atlas budget (Mtexels)", &m_shadowAtlasBudget, 1, 16);
+
+    ImGui::Text("Shadow draw calls: %u (%u with a pass per cascade)", m_shadowDrawCount, m_perCascadeShadowDrawCount);
+    ImGui::Text("Shadow atlas: %u tiles, %.2f Mtexels", m_shadowAtlasTiles, m_shadowAtlasTexels / static_cast<double>(1 << 20));
+
     ImGui::End();
 
     if (m_sceneMode == SETTINGS_SCENE_MODE::SPHERE)
     {
-        ImGui::SetNextWindowPos(ImVec2(0, 240 + 175 * NUM_LIGHTS), ImGuiCond_Once);
+        ImGui::SetNextWindowPos(ImVec2(0, 500 + 175 * NUM_LIGHTS), ImGuiCond_Once);
         ImGui::SetNextWindowSize(ImVec2(410, 100), ImGuiCond_Once);
 
         ImGui::Begin("Material");
@@ -125,6 +211,98 @@ void Settings::Render()
         ImGui::End();
     }
 
+    ImGui::SetNextWindowPos(ImVec2(410, 0), ImGuiCond_Once);
+    ImGui::SetNextWindowSize(ImVec2(410, 140), ImGuiCond_Once);
+
+    ImGui::Begin("Point lights");
+
+    ImGui::SliderInt("Count", &m_pointLightCount, 0, 10000);
+
+    ImGui::SliderFloat("Range", &m_pointLightRange, 1.0f, 500.0f);
+
+    ImGui::SliderFloat("Intensity", &m_pointLightIntensity, 0.0f, 5000.0f);
+
+    ImGui::Text("Clustered light indices: %u", m_clusteredLightIndices);
+
+    ImGui::End();
+
+    ImGui::SetNextWindowPos(ImVec2(410, 140), ImGuiCond_Once);
+    ImGui::SetNextWindowSize(ImVec2(410, 150), ImGuiCond_Once);
+
+    ImGui::Begin("Environment");
+
+    ImGui::InputText("Path", m_environmentPath, sizeof(m_environmentPath));
+    if (ImGui::Button("Load"))
+        m_environmentRequested = true;
+
+    // The current lighting stays until the new one is baked completely
+    ImGui::SliderFloat("Bake budget (ms)", &m_iblBakeBudget, 0.0f, 16.0f);
+    if (m_iblBaking)
+        ImGui::ProgressBar(m_iblBakeProgress);
+    else if (m_iblBakeUpdates > 0)
+        ImGui::Text("Baked over %u frames", m_iblBakeUpdates);
+    ImGui::TextUnformatted(m_environmentStatus.c_str());
+
+    ImGui::End();
+
+    ImGui::SetNextWindowPos(ImVec2(820, 0), ImGuiCond_Once);
+    ImGui::SetNextWindowSize(ImVec2(460, 300), ImGuiCond_Once);
+
+    ImGui::Begin("GPU timings");
+
+    // Averages over the recent frames, the peak is the longest time within the last couple of seconds.
+    // Pixel shader invocations are those of the latest measured frame.
+    float totalTime = 0.0f;
+    UINT64 totalInvocations = 0;
+    for (const GpuPassTiming& timing : m_gpuPassTimings)
+    {
+        ImGui::Text("%-20s %6.3f ms (peak %6.3f) %10llu PS", timing.name, timing.average, timing.maximum, timing.pixelShaderInvocations);
+        totalTime += timing.average;
+        totalInvocations += timing.pixelShaderInvocations;
+    }
+    ImGui::Text("%-20s %6.3f ms %14s %10llu PS", "Total", totalTime, "", totalInvocations);
+
+    ImGui::Checkbox("Log to gpu_timings.csv", &m_logGpuTimings);
+
+    ImGui::End();
+
+    ImGui::SetNextWindowPos(ImVec2(820, 300), ImGuiCond_Once);
+    ImGui::SetNextWindowSize(ImVec2(330, 300), ImGuiCond_Once);
+
+    ImGui::Begin("CPU timings");
+
+    // Previous frame's zones, nested ones are indented under their parents, calls on all threads are summed
+    for (const CpuZoneSummary& zone : m_cpuZones)
+    {
+        int indent = static_cast<int>(zone.depth) * 2;
+        ImGui::Text("%*s%-*s %7.3f ms (%u)", indent, "", 24 - indent, zone.name, zone.average, zone.calls);
+    }
+    for (const CpuCounterSummary& counter : m_cpuCounters)
+        ImGui::Text("%-24s %lld", counter.name, static_cast<long long>(counter.value));
+
+    // Startup cost of the image based lighting, a load when the cache had it
+    ImGui::Text("%-24s %7.1f ms (%s)", "IBL bake", m_iblBakeTime, m_iblBakeCached ? "cached" : "baked");
+
+    ImGui::Checkbox("Record cpu_trace.json", &m_recordCpuTrace);
+
+    ImGui::End();
+
+    ImGui::SetNextWindowPos(ImVec2(820, 600), ImGuiCond_Once);
+    ImGui::SetNextWindowSize(ImVec2(460, 300), ImGuiCond_Once);
+
+    ImGui::Begin("Video memory");
+
+    // Textures the renderer creates, with the formats the device took for them
+    UINT64 totalBytes = 0;
+    for (const VideoMemoryEntry& entry : m_videoMemory)
+    {
+        ImGui::Text("%-24s %-20s %8.2f MB", entry.name.c_str(), entry.format, static_cast<double>(entry.bytes) / (1 << 20));
+        totalBytes += entry.bytes;
+    }
+    ImGui::Text("%-24s %-20s %8.2f MB", "Total", "", static_cast<double>(totalBytes) / (1 << 20));
+
+    ImGui::End();
+
     ImGui::Render();
     
     ID3D11RenderTargetView* renderTarget = m_pDeviceResources->GetRenderTarget();
@@ -133,6 +311,13 @@ void Settings::Render()
     ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
 }
 
+void Settings::SetGpuPassTiming(UINT pass, const char* name, float average, float maximum, UINT64 pixelShaderInvocations)
+{
+    if (pass >= m_gpuPassTimings.size())
+        m_gpuPassTimings.resize(pass + 1, { "", 0.0f, 0.0f, 0 });
+    m_gpuPassTimings[pass] = { name, average, maximum, pixelShaderInvocations };
+}
+
 DirectX::XMFLOAT4 Settings::GetLightColor(UINT index) const
 {
     if (index >= NUM_LIGHTS)
@@ -1,7 +1,13 @@
 #pragma once
 
+#include <string>
+#include <vector>
+
+#include "CpuTrace.h"
 #include "DeviceResources.h"
 #include "ShaderStructures.h"
+#include "ShadowCascades.h"
+#include "TextureFormats.h"
 #include "../../ImGui/imgui.h"
 
 class Settings
@@ -28,6 +34,19 @@ public:
 
     SETTINGS_PBR_SHADER_MODE GetShaderMode() const { return m_shaderMode; };
     SETTINGS_SCENE_MODE GetSceneMode() const { return m_sceneMode; };
+    bool GetOITUsing() const { return m_useOIT; };
+    bool GetHistogramExposureUsing() const { return m_useHistogramExposure; };
+
+    void SetModelDrawCount(UINT count) { m_modelDrawCount = count; };
+    void SetShadowDrawCounts(UINT count, UINT perCascadeCount) { m_shadowDrawCount = count; m_perCascadeShadowDrawCount = perCascadeCount; };
+    void SetShadowAtlasUsage(UINT64 texels, UINT tiles) { m_shadowAtlasTexels = texels; m_shadowAtlasTiles = tiles; };
+    void SetClusteredLightIndices(UINT count) { m_clusteredLightIndices = count; };
+    void SetGpuPassTiming(UINT pass, const char* name, float average, float maximum, UINT64 pixelShaderInvocations);
+    void SetCpuTimings(const std::vector<CpuZoneSummary>& zones, const std::vector<CpuCounterSummary>& counters) { m_cpuZones = zones; m_cpuCounters = counters; };
+    void SetIBLBakeTime(float time, bool cached) { m_iblBakeTime = time; m_iblBakeCached = cached; };
+    void SetVideoMemory(const std::vector<VideoMemoryEntry>& entries) { m_videoMemory = entries; };
+    void SetEnvironmentStatus(const std::string& status) { m_environmentStatus = status; };
+    void SetIBLBakeProgress(bool baking, float progress, UINT updates) { m_iblBaking = baking; m_iblBakeProgress = progress; m_iblBakeUpdates = updates; };
 
     DirectX::XMFLOAT4 GetLightColor(UINT index) const;
     DirectX::XMFLOAT4 GetLightPosition(UINT index) const;
@@ -42,6 +61,25 @@ public:
     bool GetShadowPCFUsing() const { return m_useShadowPCF; };
     bool GetShadowPSSMUsing() const { return m_useShadowPSSM; };
     bool GetPSSMSplitsShowing() const { return m_showPSSMSplits; };
+    bool GetShadowCascadesInstancing() const { return m_useShadowCascadesInstancing; };
+    bool GetShadowSDSMUsing() const { return m_useShadowSDSM; };
+    CASCADE_SPLIT_SCHEME GetPSSMSplitScheme() const { return m_PSSMSplitScheme; };
+    FLOAT GetPSSMSplitLambda() const { return m_PSSMSplitLambda; };
+    UINT GetPSSMUpdateBudget() const { return static_cast<UINT>(m_PSSMUpdateBudget); };
+    UINT GetPSSMUpdateInterval() const { return static_cast<UINT>(m_PSSMUpdateInterval); };
+    UINT64 GetShadowAtlasBudget() const { return static_cast<UINT64>(m_shadowAtlasBudget) << 20; };
+
+    UINT GetPointLightCount() const { return static_cast<UINT>(m_pointLightCount); };
+    FLOAT GetPointLightRange() const { return m_pointLightRange; };
+    FLOAT GetPointLightIntensity() const { return m_pointLightIntensity; };
+
+    bool GetGpuTimingsLogging() const { return m_logGpuTimings; };
+    bool GetCpuTraceRecording() const { return m_recordCpuTrace; };
+
+    // Path of an environment to switch to, once per press of the load button
+    bool TakeEnvironmentRequest(std::string& path);
+    // Milliseconds per frame a new environment's lighting is baked for
+    FLOAT GetIBLBakeBudget() const { return m_iblBakeBudget; };
 
     void Render();
 
@@ -50,6 +88,9 @@ private:
 
     SETTINGS_PBR_SHADER_MODE m_shaderMode;
     SETTINGS_SCENE_MODE      m_sceneMode;
+    bool                     m_useOIT;
+    bool                     m_useHistogramExposure;
+    UINT                     m_modelDrawCount;
 
     float m_lightsStrengths[NUM_LIGHTS];
     float m_lightsThetaAngles[NUM_LIGHTS];
@@ -66,4 +107,48 @@ private:
     bool  m_useShadowPCF;
     bool  m_useShadowPSSM;
     bool  m_showPSSMSplits;
+    bool  m_useShadowCascadesInstancing;
+    bool  m_useShadowSDSM;
+    CASCADE_SPLIT_SCHEME m_PSSMSplitScheme;
+    float m_PSSMSplitLambda;
+    int   m_PSSMUpdateBudget;
+    int   m_PSSMUpdateInterval;
+    int   m_shadowAtlasBudget;
+    UINT  m_shadowDrawCount;
+    UINT  m_perCascadeShadowDrawCount;
+    UINT64 m_shadowAtlasTexels;
+    UINT  m_shadowAtlasTiles;
+
+    int   m_pointLightCount;
+    float m_pointLightRange;
+    float m_pointLightIntensity;
+    UINT  m_clusteredLightIndices;
+
+    struct GpuPassTiming
+    {
+        const char* name;
+        float average;
+        float maximum;
+        UINT64 pixelShaderInvocations;
+    };
+
+    std::vector<GpuPassTiming> m_gpuPassTimings;
+    bool                       m_logGpuTimings;
+
+    std::vector<CpuZoneSummary>    m_cpuZones;
+    std::vector<CpuCounterSummary> m_cpuCounters;
+    bool                           m_recordCpuTrace;
+
+    float m_iblBakeTime;
+    bool  m_iblBakeCached;
+
+    char        m_environmentPath[260];
+    bool        m_environmentRequested;
+    std::string m_environmentStatus;
+    float       m_iblBakeBudget;
+    bool        m_iblBaking;
+    float       m_iblBakeProgress;
+    UINT        m_iblBakeUpdates;
+
+    std::vector<VideoMemoryEntry> m_videoMemory;
 };
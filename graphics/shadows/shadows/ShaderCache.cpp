@@ -0,0 +1,221 @@
+#include "ShaderCache.h"
+
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <set>
+#include <sstream>
+
+#include "CacheFile.h"
+
+// Bumped whenever the file layout or the key changes, old entries become misses then
+const uint32_t shaderCacheVersion = 1;
+const uint32_t shaderCacheMagic = 0x48534344; // "DCSH"
+
+struct ShaderCacheHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint64_t size;
+};
+
+uint64_t HashShaderBytes(const void* data, size_t size, uint64_t hash)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static uint64_t HashString(const std::string& value, uint64_t hash)
+{
+    // Length first, so consecutive strings can't run into each other
+    uint64_t length = value.size();
+    hash = HashShaderBytes(&length, sizeof(length), hash);
+    return HashShaderBytes(value.data(), value.size(), hash);
+}
+
+static std::string GetDirectory(const std::string& path)
+{
+    size_t separator = path.find_last_of("/\\");
+    return separator == std::string::npos ? std::string() : path.substr(0, separator + 1);
+}
+
+// Names of the #include directives of one file, both "file" and <file> forms
+static std::vector<std::string> ParseIncludes(const std::string& source)
+{
+    std::vector<std::string> includes;
+
+    std::istringstream lines(source);
+    std::string line;
+    while (std::getline(lines, line))
+    {
+        size_t position = line.find_first_not_of(" \t");
+        if (position == std::string::npos || line[position] != '#')
+            continue;
+
+        position = line.find_first_not_of(" \t", position + 1);
+        if (position == std::string::npos || line.compare(position, 7, "include") != 0)
+            continue;
+
+        position = line.find_first_not_of(" \t", position + 7);
+        if (position == std::string::npos || (line[position] != '"' && line[position] != '<'))
+            continue;
+
+        char closing = line[position] == '"' ? '"' : '>';
+        size_t end = line.find(closing, position + 1);
+        if (end != std::string::npos)
+            includes.push_back(line.substr(position + 1, end - position - 1));
+    }
+
+    return includes;
+}
+
+ShaderSourceHasher::ShaderSourceHasher()
+{};
+
+const ShaderSourceHasher::SourceFile& ShaderSourceHasher::GetFile(const std::string& path)
+{
+    std::map<std::string, SourceFile>::const_iterator it = m_files.find(path);
+    if (it != m_files.end())
+        return it->second;
+
+    SourceFile file = { false, 0, {} };
+
+    std::ifstream stream(path, std::ios::in | std::ios::binary);
+    if (stream.is_open())
+    {
+        std::string source((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+        file.found = true;
+        file.contentHash = HashShaderBytes(source.data(), source.size());
+
+        std::string directory = GetDirectory(path);
+        for (const std::string& include : ParseIncludes(source))
+            file.includes.push_back(directory + include);
+    }
+
+    return m_files[path] = file;
+}
+
+void ShaderSourceHasher::CollectDependencies(const std::string& path, std::vector<std::string>& files)
+{
+    // Depth first, every file once even if it is included from several places or recursively
+    std::set<std::string> visited;
+    std::function<void(const std::string&)> visit = [&](const std::string& current)
+    {
+        if (!visited.insert(current).second)
+            return;
+
+        files.push_back(current);
+        const SourceFile& file = GetFile(current);
+        for (const std::string& include : file.includes)
+            visit(include);
+    };
+    visit(path);
+}
+
+bool ShaderSourceHasher::HashSource(const std::string& path, uint64_t& hash)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::vector<std::string> files;
+    CollectDependencies(path, files);
+    if (!GetFile(path).found)
+        return false;
+
+    hash = HashShaderBytes(nullptr, 0);
+    for (const std::string& name : files)
+    {
+        const SourceFile& file = GetFile(name);
+        hash = HashString(name, hash);
+        hash = HashShaderBytes(&file.found, sizeof(file.found), hash);
+        hash = HashShaderBytes(&file.contentHash, sizeof(file.contentHash), hash);
+    }
+    return true;
+}
+
+std::vector<std::string> ShaderSourceHasher::GetDependencies(const std::string& path)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::vector<std::string> files;
+    CollectDependencies(path, files);
+    return files;
+}
+
+void ShaderSourceHasher::Clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_files.clear();
+}
+
+ShaderSourceHasher::~ShaderSourceHasher()
+{};
+
+uint64_t ComputeShaderKey(const ShaderCompileRequest& request, uint64_t sourceHash)
+{
+    uint64_t hash = HashShaderBytes(&shaderCacheVersion, sizeof(shaderCacheVersion));
+    hash = HashShaderBytes(&sourceHash, sizeof(sourceHash), hash);
+    hash = HashString(request.sourcePath, hash);
+    hash = HashString(request.entryPoint, hash);
+    hash = HashString(request.target, hash);
+
+    // Defines are hashed in their order, the same set in another order is another key
+    uint64_t defineCount = request.defines.size();
+    hash = HashShaderBytes(&defineCount, sizeof(defineCount), hash);
+    for (const ShaderDefine& define : request.defines)
+    {
+        hash = HashString(define.name, hash);
+        hash = HashString(define.value, hash);
+    }
+
+    hash = HashShaderBytes(&request.flags, sizeof(request.flags), hash);
+    hash = HashShaderBytes(&request.compilerVersion, sizeof(request.compilerVersion), hash);
+    return hash;
+}
+
+ShaderCache::ShaderCache(const std::string& directory) :
+    m_directory(CreateCacheDirectory(directory))
+{};
+
+std::string ShaderCache::GetPath(uint64_t key) const
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.cso", static_cast<unsigned long long>(key));
+    return m_directory + name;
+}
+
+bool ShaderCache::Load(uint64_t key, std::vector<uint8_t>& bytecode) const
+{
+    std::ifstream file(GetPath(key), std::ios::in | std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    ShaderCacheHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+        return false;
+
+    if (header.magic != shaderCacheMagic || header.version != shaderCacheVersion || header.key != key || header.size == 0)
+        return false;
+
+    bytecode.resize(static_cast<size_t>(header.size));
+    if (!file.read(reinterpret_cast<char*>(bytecode.data()), bytecode.size()))
+        return false;
+
+    // Trailing bytes mean the file isn't what was written
+    return file.peek() == std::ifstream::traits_type::eof();
+}
+
+bool ShaderCache::Store(uint64_t key, const void* bytecode, size_t size) const
+{
+    ShaderCacheHeader header = { shaderCacheMagic, shaderCacheVersion, key, size };
+    CacheFileChunk chunks[] = { { &header, sizeof(header) }, { bytecode, size } };
+    return WriteCacheFile(GetPath(key), chunks, 2);
+}
+
+ShaderCache::~ShaderCache()
+{};
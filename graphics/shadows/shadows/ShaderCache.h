@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct ShaderDefine
+{
+    std::string name;
+    std::string value;
+};
+
+// Everything the compiled bytecode depends on besides the source text
+struct ShaderCompileRequest
+{
+    std::string               sourcePath;
+    std::string               entryPoint;
+    std::string               target;
+    std::vector<ShaderDefine> defines;
+    uint32_t                  flags;
+    uint32_t                  compilerVersion;
+};
+
+// 64-bit FNV-1a, hash continues from the given one
+uint64_t HashShaderBytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ull);
+
+// Hashes shader sources together with everything they #include. Includes are resolved relative to the including file
+// (as the standard D3D include handler does) and followed regardless of preprocessor conditions, so a change in any
+// file that might be included changes the hash. Files are read once and remembered, the hasher is thread safe.
+class ShaderSourceHasher
+{
+public:
+    ShaderSourceHasher();
+    ~ShaderSourceHasher();
+
+    // Returns false if the source file itself can't be read, includes that can't be found are hashed by name only
+    bool HashSource(const std::string& path, uint64_t& hash);
+
+    // Source file and all files it includes, in the order they were hashed
+    std::vector<std::string> GetDependencies(const std::string& path);
+
+    // Forgets the remembered files, for when the sources change while running
+    void Clear();
+
+private:
+    struct SourceFile
+    {
+        bool                     found;
+        uint64_t                 contentHash;
+        std::vector<std::string> includes;
+    };
+
+    const SourceFile& GetFile(const std::string& path);
+    void CollectDependencies(const std::string& path, std::vector<std::string>& files);
+
+    std::mutex                        m_mutex;
+    std::map<std::string, SourceFile> m_files;
+};
+
+// Key of the compiled bytecode: the sources hash combined with the entry point, target, defines, flags and compiler version
+uint64_t ComputeShaderKey(const ShaderCompileRequest& request, uint64_t sourceHash);
+
+// Compiled bytecode stored on disk, one file per key. Every file starts with a header holding the key and the size,
+// files that don't match are treated as misses. New files are written under a temporary name and renamed,
+// so a crash while writing never leaves a truncated entry behind.
+class ShaderCache
+{
+public:
+    explicit ShaderCache(const std::string& directory);
+    ~ShaderCache();
+
+    bool Load(uint64_t key, std::vector<uint8_t>& bytecode) const;
+    bool Store(uint64_t key, const void* bytecode, size_t size) const;
+
+    std::string GetPath(uint64_t key) const;
+
+private:
+    std::string m_directory;
+};
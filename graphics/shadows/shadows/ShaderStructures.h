@@ -1,6 +1,6 @@
 #pragma once
 
-#define NUM_LIGHTS 1
+#define NUM_LIGHTS 3
 
 struct WorldViewProjectionConstantBuffer
 {
@@ -11,6 +11,11 @@ struct WorldViewProjectionConstantBuffer
 	DirectX::XMFLOAT4 CameraDir;
 };
 
+struct EnvironmentConstantBuffer
+{
+	DirectX::XMMATRIX SkyRayTransform;
+};
+
 struct VertexData
 {
 	DirectX::XMFLOAT3 Normal;
@@ -31,9 +36,10 @@ struct LightConstantBuffer
 };
 
 __declspec(align(16))
-struct LuminanceConstantBuffer
+struct LuminanceHistogramConstantBuffer
 {
-	float AverageLuminance;
+	DirectX::XMUINT2 ImageSize;
+	float DeltaTime;
 };
 
 __declspec(align(16))
@@ -52,10 +58,36 @@ struct BlurConstantBuffer
 
 struct ShadowConstantBuffer
 {
-	DirectX::XMMATRIX SimpleShadowTransform;
-	DirectX::XMMATRIX PSSMTransform[4];
+	DirectX::XMMATRIX SimpleShadowTransforms[NUM_LIGHTS];
+	DirectX::XMFLOAT4 SimpleShadowRects[NUM_LIGHTS];
+	DirectX::XMMATRIX PSSMTransforms[NUM_LIGHTS * 4];
+	DirectX::XMFLOAT4 PSSMRects[NUM_LIGHTS * 4];
 	DirectX::XMFLOAT4 PSSMBorders;
 	BOOL UseShadowPCF;
 	BOOL UseShadowPSSM;
 	BOOL ShowPSSMSplits;
 };
+
+struct ShadowCascadesConstantBuffer
+{
+	DirectX::XMMATRIX CascadeViewProjection[4];
+	DirectX::XMUINT4 CascadeSlices;
+};
+
+__declspec(align(16))
+struct DepthReductionConstantBuffer
+{
+	DirectX::XMUINT2 ImageSize;
+};
+
+__declspec(align(16))
+struct LightClustersConstantBuffer
+{
+	DirectX::XMUINT4 ClusterGrid;
+	DirectX::XMFLOAT4 ClusterParams;
+};
+
+struct IrradianceConstantBuffer
+{
+	DirectX::XMFLOAT4 IrradianceSH[9];
+};
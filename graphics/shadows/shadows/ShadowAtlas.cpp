@@ -0,0 +1,191 @@
+#include "ShadowAtlas.h"
+
+#include <cfloat>
+#include <cmath>
+
+#define STBRP_STATIC
+#define STB_RECT_PACK_IMPLEMENTATION
+#include "../../ImGui/imstb_rectpack.h"
+
+// Tiles keep their size while the wanted one stays within this many octaves of it
+const float tileSizeHysteresis = 0.75f;
+
+ShadowAtlas::ShadowAtlas(uint32_t atlasSize) :
+    m_size(atlasSize),
+    m_minTileSize(128),
+    m_maxTileSize(2048)
+{};
+
+void ShadowAtlas::SetSize(uint32_t atlasSize)
+{
+    m_size = atlasSize;
+    m_tiles.clear();
+    m_sizes.clear();
+}
+
+void ShadowAtlas::SetTileSizeLimits(uint32_t minTileSize, uint32_t maxTileSize)
+{
+    m_minTileSize = minTileSize;
+    m_maxTileSize = maxTileSize < m_size ? maxTileSize : m_size;
+}
+
+static uint32_t RoundToPowerOfTwo(float size, uint32_t minSize, uint32_t maxSize)
+{
+    uint32_t rounded = minSize;
+    while (rounded < maxSize && static_cast<float>(rounded) * 1.41421356f < size)
+        rounded <<= 1;
+    return rounded;
+}
+
+static uint64_t CountTexels(const uint32_t* sizes, uint32_t tileCount)
+{
+    uint64_t texels = 0;
+    for (uint32_t i = 0; i < tileCount; ++i)
+        texels += static_cast<uint64_t>(sizes[i]) * sizes[i];
+    return texels;
+}
+
+// Halves the largest tile that is still above the minimum, returns false if there is none
+static bool ShrinkLargestTile(uint32_t* sizes, uint32_t tileCount, uint32_t minTileSize)
+{
+    uint32_t largest = tileCount;
+    for (uint32_t i = 0; i < tileCount; ++i)
+    {
+        if (sizes[i] > minTileSize && (largest == tileCount || sizes[i] > sizes[largest]))
+            largest = i;
+    }
+    if (largest == tileCount)
+        return false;
+
+    sizes[largest] >>= 1;
+    return true;
+}
+
+void ChooseShadowTileSizes(const float* resolutions, uint32_t tileCount, uint64_t texelBudget, uint32_t minTileSize, uint32_t maxTileSize,
+    const uint32_t* previousSizes, uint32_t* sizes)
+{
+    float minSize = static_cast<float>(minTileSize);
+    float maxSize = static_cast<float>(maxTileSize);
+
+    double wantedTexels = 0.0;
+    for (uint32_t i = 0; i < tileCount; ++i)
+    {
+        if (resolutions[i] <= 0.0f)
+            continue;
+        float resolution = resolutions[i] < minSize ? minSize : (resolutions[i] > maxSize ? maxSize : resolutions[i]);
+        wantedTexels += static_cast<double>(resolution) * resolution;
+    }
+
+    // Every tile loses the same share, so their relative importance is kept
+    float scale = 1.0f;
+    if (wantedTexels > static_cast<double>(texelBudget))
+        scale = static_cast<float>(std::sqrt(static_cast<double>(texelBudget) / wantedTexels));
+
+    for (uint32_t i = 0; i < tileCount; ++i)
+    {
+        if (resolutions[i] <= 0.0f)
+        {
+            sizes[i] = 0;
+            continue;
+        }
+
+        float resolution = resolutions[i] > maxSize ? maxSize : resolutions[i];
+        float size = resolution * scale;
+
+        uint32_t previous = previousSizes ? previousSizes[i] : 0;
+        if (previous >= minTileSize && previous <= maxTileSize && size > 0.0f &&
+            std::fabs(std::log2(size / static_cast<float>(previous))) < tileSizeHysteresis)
+            sizes[i] = previous;
+        else
+            sizes[i] = RoundToPowerOfTwo(size, minTileSize, maxTileSize);
+    }
+
+    // Rounding up and kept sizes may still overshoot the budget
+    while (CountTexels(sizes, tileCount) > texelBudget && ShrinkLargestTile(sizes, tileCount, minTileSize))
+        ;
+}
+
+bool ShadowAtlas::Allocate(const float* resolutions, uint32_t tileCount, uint64_t texelBudget)
+{
+    uint64_t atlasTexels = static_cast<uint64_t>(m_size) * m_size;
+    if (texelBudget > atlasTexels)
+        texelBudget = atlasTexels;
+
+    std::vector<uint32_t> sizes(tileCount);
+    const uint32_t* previousSizes = m_sizes.size() == tileCount ? m_sizes.data() : nullptr;
+    ChooseShadowTileSizes(resolutions, tileCount, texelBudget, m_minTileSize, m_maxTileSize, previousSizes, sizes.data());
+
+    if (sizes == m_sizes && m_tiles.size() == tileCount)
+        return false;
+
+    // The chosen sizes are remembered even if packing had to shrink some tiles,
+    // so the same wanted resolutions don't repack the atlas every frame
+    m_sizes = sizes;
+
+    // Power of two squares within the atlas area nearly always fit, this only handles what the packer couldn't place
+    while (!Pack(sizes.data(), tileCount))
+    {
+        if (!ShrinkLargestTile(sizes.data(), tileCount, m_minTileSize))
+            break;
+    }
+
+    return true;
+}
+
+bool ShadowAtlas::Pack(const uint32_t* sizes, uint32_t tileCount)
+{
+    std::vector<stbrp_node> nodes(m_size);
+    std::vector<stbrp_rect> rects(tileCount);
+
+    stbrp_context context;
+    stbrp_init_target(&context, static_cast<int>(m_size), static_cast<int>(m_size), nodes.data(), static_cast<int>(nodes.size()));
+
+    for (uint32_t i = 0; i < tileCount; ++i)
+    {
+        rects[i].id = static_cast<int>(i);
+        rects[i].w = static_cast<stbrp_coord>(sizes[i]);
+        rects[i].h = static_cast<stbrp_coord>(sizes[i]);
+    }
+
+    int packed = stbrp_pack_rects(&context, rects.data(), static_cast<int>(tileCount));
+
+    // Tiles that didn't fit get a zero size, nothing is rendered into them
+    m_tiles.resize(tileCount);
+    for (const stbrp_rect& rect : rects)
+    {
+        ShadowAtlasTile& tile = m_tiles[rect.id];
+        if (rect.was_packed)
+            tile = { rect.x, rect.y, rect.w };
+        else
+            tile = { 0, 0, 0 };
+    }
+
+    return packed != 0;
+}
+
+uint64_t ShadowAtlas::GetUsedTexels() const
+{
+    uint64_t texels = 0;
+    for (const ShadowAtlasTile& tile : m_tiles)
+        texels += static_cast<uint64_t>(tile.size) * tile.size;
+    return texels;
+}
+
+ShadowAtlas::~ShadowAtlas()
+{};
+
+float EstimateShadowResolution(const CascadeCamera& camera, float screenHeight, const BoundingSphere& region, float minDistance)
+{
+    float dx = region.center.x - camera.position.x;
+    float dy = region.center.y - camera.position.y;
+    float dz = region.center.z - camera.position.z;
+
+    float distance = std::sqrt(dx * dx + dy * dy + dz * dz) - region.radius;
+    if (distance < minDistance)
+        distance = minDistance;
+    if (distance <= 0.0f)
+        return FLT_MAX;
+
+    // A pixel at that distance is 2 * distance * tanHalfFovY / screenHeight wide, the region is 2 * radius wide
+    return region.radius * screenHeight / (distance * camera.tanHalfFovY);
+}
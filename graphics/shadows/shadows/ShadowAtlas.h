@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Bounds.h"
+#include "ShadowCascades.h"
+
+struct ShadowAtlasTile
+{
+    uint32_t x;
+    uint32_t y;
+    uint32_t size;
+};
+
+// Hands out square tiles of one shadow map texture, one per light (or light cascade).
+// Tile sizes are powers of two chosen from the wanted resolutions under a total texel budget,
+// the tiles are packed with stb_rect_pack. The layout only changes when some tile size changes.
+class ShadowAtlas
+{
+public:
+    explicit ShadowAtlas(uint32_t atlasSize = 0);
+    ~ShadowAtlas();
+
+    void SetSize(uint32_t atlasSize);
+    // Tile sizes are clamped to [minTileSize, maxTileSize], both powers of two
+    void SetTileSizeLimits(uint32_t minTileSize, uint32_t maxTileSize);
+
+    // Picks tile sizes for the wanted resolutions (in texels per side) and packs them. A resolution of zero
+    // (a light without shadows) gets an empty tile.
+    // Returns true when the layout differs from the previous one, the tiles have to be rendered again then.
+    bool Allocate(const float* resolutions, uint32_t tileCount, uint64_t texelBudget);
+
+    // Packs tiles of the given sizes, returns false if they don't fit into the atlas
+    bool Pack(const uint32_t* sizes, uint32_t tileCount);
+
+    uint32_t GetSize() const { return m_size; };
+    uint32_t GetTileCount() const { return static_cast<uint32_t>(m_tiles.size()); };
+    const ShadowAtlasTile& GetTile(uint32_t tile) const { return m_tiles[tile]; };
+    uint64_t GetUsedTexels() const;
+
+private:
+    std::vector<ShadowAtlasTile> m_tiles;
+    std::vector<uint32_t>        m_sizes;
+
+    uint32_t m_size;
+    uint32_t m_minTileSize;
+    uint32_t m_maxTileSize;
+};
+
+// Power of two tile sizes for the wanted resolutions. All of them are scaled down together until their texels fit the budget,
+// sizes close to the previous ones (if there are any) are kept so the tiles don't flicker between two sizes.
+// Resolutions of zero get a size of zero and no share of the budget.
+void ChooseShadowTileSizes(const float* resolutions, uint32_t tileCount, uint64_t texelBudget, uint32_t minTileSize, uint32_t maxTileSize,
+    const uint32_t* previousSizes, uint32_t* sizes);
+
+// Screen-space importance of a shadowed region: the number of shadow map texels per side that gives about one texel per pixel
+// where the region is closest to the camera. Regions closer than minDistance are treated as if they were at minDistance.
+float EstimateShadowResolution(const CascadeCamera& camera, float screenHeight, const BoundingSphere& region, float minDistance);
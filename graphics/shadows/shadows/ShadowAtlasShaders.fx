@@ -0,0 +1,6 @@
+// Quad on the far plane, drawn with the viewport of an atlas tile it resets the depth of that tile only
+float4 vs_shadow_clear_main(uint input : SV_VERTEXID) : SV_POSITION
+{
+    float2 uv = float2(input & 1, input >> 1);
+    return float4((uv.x - 0.5f) * 2, -(uv.y - 0.5f) * 2, 1, 1);
+}
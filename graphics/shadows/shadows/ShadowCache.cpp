@@ -0,0 +1,82 @@
+#include "ShadowCache.h"
+
+#include <cmath>
+#include <cstring>
+
+ShadowCacheTracker::ShadowCacheTracker() :
+    m_valid(false)
+{};
+
+ShadowCacheTracker::~ShadowCacheTracker()
+{};
+
+void ShadowCacheTracker::BeginFrame()
+{
+    m_current.clear();
+}
+
+void ShadowCacheTracker::AddState(const void* data, size_t size)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    m_current.insert(m_current.end(), bytes, bytes + size);
+}
+
+bool ShadowCacheTracker::EndFrame()
+{
+    bool changed = !m_valid || m_current.size() != m_previous.size() ||
+        memcmp(m_current.data(), m_previous.data(), m_current.size()) != 0;
+
+    // Buffers are swapped so neither of them reallocates once the state size settles
+    m_current.swap(m_previous);
+    m_valid = true;
+    return changed;
+}
+
+ShadowCascadeCache::ShadowCascadeCache(size_t cascadeCount)
+{
+    Resize(cascadeCount);
+}
+
+ShadowCascadeCache::~ShadowCascadeCache()
+{};
+
+void ShadowCascadeCache::Resize(size_t cascadeCount)
+{
+    m_bounds.resize(cascadeCount);
+    m_valid.assign(cascadeCount, false);
+}
+
+void ShadowCascadeCache::Invalidate()
+{
+    m_valid.assign(m_valid.size(), false);
+}
+
+bool ShadowCascadeCache::Update(size_t cascade, const ShadowCascadeBounds& bounds, uint32_t mapSize)
+{
+    bool moved = HasMoved(cascade, bounds, mapSize);
+    if (moved)
+        Store(cascade, bounds);
+    return moved;
+}
+
+bool ShadowCascadeCache::HasMoved(size_t cascade, const ShadowCascadeBounds& bounds, uint32_t mapSize) const
+{
+    if (!m_valid[cascade])
+        return true;
+
+    const ShadowCascadeBounds& cached = m_bounds[cascade];
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        float texel = (cached.maxPoint[axis] - cached.minPoint[axis]) / static_cast<float>(mapSize);
+        if (!(fabsf(bounds.minPoint[axis] - cached.minPoint[axis]) <= texel &&
+            fabsf(bounds.maxPoint[axis] - cached.maxPoint[axis]) <= texel))
+            return true;
+    }
+    return false;
+}
+
+void ShadowCascadeCache::Store(size_t cascade, const ShadowCascadeBounds& bounds)
+{
+    m_bounds[cascade] = bounds;
+    m_valid[cascade] = true;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Tracks everything a cached shadow map depends on (light, bias, casters and their transforms).
+// The state is written into a byte signature every frame and compared with the one the maps were rendered with.
+class ShadowCacheTracker
+{
+public:
+    ShadowCacheTracker();
+    ~ShadowCacheTracker();
+
+    void BeginFrame();
+    void AddState(const void* data, size_t size);
+
+    template <typename T>
+    void AddValue(const T& value) { AddState(&value, sizeof(T)); };
+
+    // Returns true when the state differs from the previous frame (or Invalidate was called)
+    bool EndFrame();
+
+    void Invalidate() { m_valid = false; };
+
+private:
+    std::vector<uint8_t> m_current;
+    std::vector<uint8_t> m_previous;
+
+    bool m_valid;
+};
+
+struct ShadowCascadeBounds
+{
+    float minPoint[3];
+    float maxPoint[3];
+};
+
+// Light space bounds the cascades were last rendered with.
+// A cascade keeps its shadow map while the freshly fitted bounds stay within a texel of the cached ones.
+class ShadowCascadeCache
+{
+public:
+    explicit ShadowCascadeCache(size_t cascadeCount = 0);
+    ~ShadowCascadeCache();
+
+    void Resize(size_t cascadeCount);
+    void Invalidate();
+
+    // Returns true when the cascade has to be rendered again, the cached bounds are replaced then
+    bool Update(size_t cascade, const ShadowCascadeBounds& bounds, uint32_t mapSize);
+
+    // Same test and replacement separately, for when a moved cascade isn't necessarily rendered this frame
+    bool HasMoved(size_t cascade, const ShadowCascadeBounds& bounds, uint32_t mapSize) const;
+    void Store(size_t cascade, const ShadowCascadeBounds& bounds);
+
+    const ShadowCascadeBounds& GetBounds(size_t cascade) const { return m_bounds[cascade]; };
+    size_t GetCascadeCount() const { return m_bounds.size(); };
+
+private:
+    std::vector<ShadowCascadeBounds> m_bounds;
+    std::vector<bool>                m_valid;
+};
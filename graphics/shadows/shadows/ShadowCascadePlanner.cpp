@@ -0,0 +1,54 @@
+#include "ShadowCascadePlanner.h"
+
+#include <algorithm>
+
+CascadeInstances GetCascadeInstances(uint32_t cascadeMask)
+{
+    CascadeInstances instances = {};
+    for (uint32_t cascade = 0; cascade < MAX_SHADOW_CASCADES; ++cascade)
+        if (cascadeMask & (1u << cascade))
+            instances.slices[instances.count++] = cascade;
+    return instances;
+}
+
+ShadowCascadePlanner::ShadowCascadePlanner() :
+    m_instancedDrawCount(0),
+    m_instanceCount(0),
+    m_perCascadeDrawCount(0)
+{};
+
+ShadowCascadePlanner::~ShadowCascadePlanner()
+{};
+
+void ShadowCascadePlanner::Plan(const BoundingVolumeHierarchy& bvh, const Frustum* cascades, uint32_t cascadeCount, uint32_t updateMask)
+{
+    m_masks.assign(bvh.GetPrimitiveCount(), 0);
+    m_instancedDrawCount = 0;
+    m_instanceCount = 0;
+    m_perCascadeDrawCount = 0;
+
+    if (bvh.IsEmpty())
+        return;
+
+    cascadeCount = std::min(cascadeCount, MAX_SHADOW_CASCADES);
+    for (uint32_t cascade = 0; cascade < cascadeCount; ++cascade)
+    {
+        if (!(updateMask & (1u << cascade)))
+            continue;
+
+        m_query.clear();
+        bvh.QueryFrustum(cascades[cascade], m_query);
+        for (uint32_t index : m_query)
+            m_masks[index] |= static_cast<uint8_t>(1u << cascade);
+
+        m_perCascadeDrawCount += static_cast<uint32_t>(m_masks.size());
+    }
+
+    for (uint8_t mask : m_masks)
+    {
+        if (mask == 0)
+            continue;
+        ++m_instancedDrawCount;
+        m_instanceCount += GetCascadeInstances(mask).count;
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "BoundingVolumeHierarchy.h"
+
+const uint32_t MAX_SHADOW_CASCADES = 4;
+
+// Instance to cascade table of one instanced cascade draw, the cascade selects the viewport of its atlas tile
+struct CascadeInstances
+{
+    uint32_t count;
+    uint32_t slices[MAX_SHADOW_CASCADES];
+};
+
+CascadeInstances GetCascadeInstances(uint32_t cascadeMask);
+
+// Decides which cascades every primitive has to be drawn into when all cascades are rendered in one pass.
+// Every primitive is drawn once with one instance per set bit of its mask.
+class ShadowCascadePlanner
+{
+public:
+    ShadowCascadePlanner();
+    ~ShadowCascadePlanner();
+
+    // Only cascades in updateMask are planned, the others keep their cached maps
+    void Plan(const BoundingVolumeHierarchy& bvh, const Frustum* cascades, uint32_t cascadeCount, uint32_t updateMask);
+
+    // Indexed by the primitive index the hierarchy was built with
+    const std::vector<uint8_t>& GetMasks() const { return m_masks; };
+
+    // Draws issued by the single pass and by rendering every primitive into every updated cascade separately
+    uint32_t GetInstancedDrawCount() const { return m_instancedDrawCount; };
+    uint32_t GetInstanceCount() const { return m_instanceCount; };
+    uint32_t GetPerCascadeDrawCount() const { return m_perCascadeDrawCount; };
+
+private:
+    std::vector<uint8_t>  m_masks;
+    std::vector<uint32_t> m_query;
+
+    uint32_t m_instancedDrawCount;
+    uint32_t m_instanceCount;
+    uint32_t m_perCascadeDrawCount;
+};
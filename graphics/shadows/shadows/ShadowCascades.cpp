@@ -0,0 +1,184 @@
+#include "ShadowCascades.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include <xmmintrin.h>
+
+namespace
+{
+    Float3 Cross(const Float3& a, const Float3& b)
+    {
+        return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+    }
+
+    float Dot(const Float3& a, const Float3& b)
+    {
+        return a.x * b.x + a.y * b.y + a.z * b.z;
+    }
+
+    Float3 Normalize(const Float3& v)
+    {
+        float length = sqrtf(Dot(v, v));
+        return { v.x / length, v.y / length, v.z / length };
+    }
+
+    Float3 TransformPoint(const Float3& p, const float m[4][4])
+    {
+        return {
+            p.x * m[0][0] + p.y * m[1][0] + p.z * m[2][0] + m[3][0],
+            p.x * m[0][1] + p.y * m[1][1] + p.z * m[2][1] + m[3][1],
+            p.x * m[0][2] + p.y * m[1][2] + p.z * m[2][2] + m[3][2]
+        };
+    }
+
+    float HorizontalMin(__m128 v)
+    {
+        v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+        v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+        return _mm_cvtss_f32(v);
+    }
+
+    float HorizontalMax(__m128 v)
+    {
+        v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+        v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+        return _mm_cvtss_f32(v);
+    }
+}
+
+void ComputeCascadeSplits(CASCADE_SPLIT_SCHEME scheme, float lambda, float nearDistance, float farDistance, uint32_t cascadeCount, float* splits)
+{
+    if (scheme == CASCADE_SPLIT_SCHEME::UNIFORM)
+        lambda = 0.0f;
+    else if (scheme == CASCADE_SPLIT_SCHEME::LOGARITHMIC)
+        lambda = 1.0f;
+    lambda = std::min(std::max(lambda, 0.0f), 1.0f);
+
+    splits[0] = nearDistance;
+    for (uint32_t i = 1; i < cascadeCount; ++i)
+    {
+        float fraction = static_cast<float>(i) / static_cast<float>(cascadeCount);
+        float logarithmic = nearDistance * powf(farDistance / nearDistance, fraction);
+        float uniform = nearDistance + (farDistance - nearDistance) * fraction;
+        splits[i] = lambda * logarithmic + (1.0f - lambda) * uniform;
+    }
+    splits[cascadeCount] = farDistance;
+}
+
+void ComputeLightView(const Float3& towardsLight, float view[4][4])
+{
+    Float3 eye = Normalize(towardsLight);
+
+    // Same up vector as the simple shadow map
+    Float3 axis = { 1.0f, 0.0f, 0.0f };
+    if (fabsf(Dot(eye, axis)) > 1.0f - 1e-6f)
+        axis = { 0.0f, 0.0f, 1.0f };
+    Float3 up = Normalize(Cross(eye, axis));
+
+    Float3 zAxis = { -eye.x, -eye.y, -eye.z };
+    Float3 xAxis = Normalize(Cross(up, zAxis));
+    Float3 yAxis = Cross(zAxis, xAxis);
+
+    const Float3 axes[3] = { xAxis, yAxis, zAxis };
+    for (int i = 0; i < 3; ++i)
+    {
+        view[0][i] = axes[i].x;
+        view[1][i] = axes[i].y;
+        view[2][i] = axes[i].z;
+        view[3][i] = -Dot(axes[i], eye);
+        view[i][3] = 0.0f;
+    }
+    view[3][3] = 1.0f;
+}
+
+BoundingSphere FitCascadeSphere(const CascadeCamera& camera, float nearSplit, float farSplit)
+{
+    // Slice corners lie on two circles around the view axis with radii nearSplit * t and farSplit * t.
+    // The center is on the axis where the distances to both circles are equal, or at the far cap if that is outside.
+    float t2 = camera.tanHalfFovX * camera.tanHalfFovX + camera.tanHalfFovY * camera.tanHalfFovY;
+    float distance = 0.5f * (nearSplit + farSplit) * (1.0f + t2);
+    float radius;
+    if (distance < farSplit)
+    {
+        float d = distance - nearSplit;
+        radius = sqrtf(d * d + nearSplit * nearSplit * t2);
+    }
+    else
+    {
+        distance = farSplit;
+        radius = farSplit * sqrtf(t2);
+    }
+
+    BoundingSphere sphere;
+    sphere.center = {
+        camera.position.x + camera.direction.x * distance,
+        camera.position.y + camera.direction.y * distance,
+        camera.position.z + camera.direction.z * distance
+    };
+    sphere.radius = radius;
+    return sphere;
+}
+
+AABB TransformAABBCorners(const AABB& box, const float matrix[4][4])
+{
+    // Corners 0-3 are on the min z face, 4-7 on the max z one, both share x and y
+    __m128 x = _mm_setr_ps(box.min.x, box.max.x, box.min.x, box.max.x);
+    __m128 y = _mm_setr_ps(box.min.y, box.min.y, box.max.y, box.max.y);
+    __m128 zMin = _mm_set1_ps(box.min.z);
+    __m128 zMax = _mm_set1_ps(box.max.z);
+
+    float minimum[3];
+    float maximum[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        __m128 xy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(matrix[0][i])), _mm_mul_ps(y, _mm_set1_ps(matrix[1][i]))), _mm_set1_ps(matrix[3][i]));
+        __m128 a = _mm_add_ps(xy, _mm_mul_ps(zMin, _mm_set1_ps(matrix[2][i])));
+        __m128 b = _mm_add_ps(xy, _mm_mul_ps(zMax, _mm_set1_ps(matrix[2][i])));
+        minimum[i] = HorizontalMin(_mm_min_ps(a, b));
+        maximum[i] = HorizontalMax(_mm_max_ps(a, b));
+    }
+
+    return { { minimum[0], minimum[1], minimum[2] }, { maximum[0], maximum[1], maximum[2] } };
+}
+
+ShadowCascadeBounds FitCascadeBounds(const BoundingSphere& sphere, const float lightView[4][4], uint32_t mapSize, const AABB* casters, size_t casterCount)
+{
+    Float3 center = TransformPoint(sphere.center, lightView);
+
+    // The snapped window is one texel wider than the sphere, so it still covers it after rounding down
+    float texel = 2.0f * sphere.radius / static_cast<float>(mapSize - 1);
+    float extent = texel * static_cast<float>(mapSize);
+
+    ShadowCascadeBounds bounds;
+    bounds.minPoint[0] = floorf((center.x - sphere.radius) / texel) * texel;
+    bounds.minPoint[1] = floorf((center.y - sphere.radius) / texel) * texel;
+    bounds.maxPoint[0] = bounds.minPoint[0] + extent;
+    bounds.maxPoint[1] = bounds.minPoint[1] + extent;
+
+    // Casters in front of the sphere have to be in the map, receivers behind the last caster don't
+    float nearZ = FLT_MAX;
+    float farZ = -FLT_MAX;
+    for (size_t i = 0; i < casterCount; ++i)
+    {
+        AABB box = TransformAABBCorners(casters[i], lightView);
+        if (box.max.x < bounds.minPoint[0] || box.min.x > bounds.maxPoint[0] ||
+            box.max.y < bounds.minPoint[1] || box.min.y > bounds.maxPoint[1])
+            continue;
+        nearZ = std::min(nearZ, box.min.z);
+        farZ = std::max(farZ, box.max.z);
+    }
+
+    if (nearZ > farZ)
+    {
+        nearZ = center.z - sphere.radius;
+        farZ = center.z + sphere.radius;
+    }
+    else
+        farZ = std::min(farZ, center.z + sphere.radius);
+
+    bounds.minPoint[2] = nearZ;
+    bounds.maxPoint[2] = std::max(farZ, nearZ + texel);
+    return bounds;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Bounds.h"
+#include "ShadowCache.h"
+
+// Cascaded shadow map fitting shared by the PSSM passes. Matrices are row-major with the
+// row vector convention (as DirectXMath), light space is left-handed like XMMatrixLookAtLH.
+
+enum class CASCADE_SPLIT_SCHEME
+{
+    UNIFORM = 0,
+    LOGARITHMIC,
+    PRACTICAL
+};
+
+struct CascadeCamera
+{
+    Float3 position;
+    Float3 direction;
+    float  tanHalfFovX;
+    float  tanHalfFovY;
+};
+
+// Writes cascadeCount + 1 view distances, splits[0] is nearDistance and splits[cascadeCount] is farDistance.
+// Practical scheme blends the logarithmic (lambda = 1) and uniform (lambda = 0) ones.
+void ComputeCascadeSplits(CASCADE_SPLIT_SCHEME scheme, float lambda, float nearDistance, float farDistance, uint32_t cascadeCount, float* splits);
+
+// Light looks along -towardsLight, the view doesn't depend on the camera
+void ComputeLightView(const Float3& towardsLight, float view[4][4]);
+
+// Smallest sphere around the camera frustum slice, its radius only depends on the split distances and fov
+BoundingSphere FitCascadeSphere(const CascadeCamera& camera, float nearSplit, float farSplit);
+
+// Same as TransformAABB, the 8 corners are transformed 4 at a time with SSE
+AABB TransformAABBCorners(const AABB& box, const float matrix[4][4]);
+
+// Light space ortho bounds of the cascade. X and y cover the sphere and are snapped to whole shadow map texels,
+// so the projection only moves in texel steps and doesn't shimmer. Z is tightened to the casters overlapping them.
+ShadowCascadeBounds FitCascadeBounds(const BoundingSphere& sphere, const float lightView[4][4], uint32_t mapSize, const AABB* casters, size_t casterCount);
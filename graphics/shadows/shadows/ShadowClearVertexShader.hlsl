@@ -0,0 +1 @@
+#include "ShadowAtlasShaders.fx"
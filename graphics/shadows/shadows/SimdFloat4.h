@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define SIMD_FLOAT4_SSE 1
+#include <emmintrin.h>
+#else
+#define SIMD_FLOAT4_SSE 0
+#endif
+
+// Four floats processed together: an RGBA texel, or one component of four directions.
+// SSE is used where the compiler guarantees it, plain loops elsewhere.
+struct SimdFloat4
+{
+#if SIMD_FLOAT4_SSE
+    __m128 v;
+
+    static SimdFloat4 Zero() { return { _mm_setzero_ps() }; };
+    static SimdFloat4 Replicate(float value) { return { _mm_set1_ps(value) }; };
+    static SimdFloat4 Load(const float* values) { return { _mm_loadu_ps(values) }; };
+    void Store(float* values) const { _mm_storeu_ps(values, v); };
+    // Four unsigned bytes converted to floats
+    static SimdFloat4 LoadBytes(const uint8_t* values)
+    {
+        int32_t bytes;
+        memcpy(&bytes, values, sizeof(bytes));
+        __m128i zero = _mm_setzero_si128();
+        return { _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero), zero)) };
+    };
+
+    friend SimdFloat4 operator+(SimdFloat4 a, SimdFloat4 b) { return { _mm_add_ps(a.v, b.v) }; };
+    friend SimdFloat4 operator-(SimdFloat4 a, SimdFloat4 b) { return { _mm_sub_ps(a.v, b.v) }; };
+    friend SimdFloat4 operator*(SimdFloat4 a, SimdFloat4 b) { return { _mm_mul_ps(a.v, b.v) }; };
+    friend SimdFloat4 operator/(SimdFloat4 a, SimdFloat4 b) { return { _mm_div_ps(a.v, b.v) }; };
+    friend SimdFloat4 Min(SimdFloat4 a, SimdFloat4 b) { return { _mm_min_ps(a.v, b.v) }; };
+    friend SimdFloat4 Max(SimdFloat4 a, SimdFloat4 b) { return { _mm_max_ps(a.v, b.v) }; };
+    // Swaps rows and columns of the matrix with rows a, b, c and d, four components of four texels become four texels
+    friend void Transpose(SimdFloat4& a, SimdFloat4& b, SimdFloat4& c, SimdFloat4& d) { _MM_TRANSPOSE4_PS(a.v, b.v, c.v, d.v); };
+#else
+    float v[4];
+
+    static SimdFloat4 Zero() { return { { 0.0f, 0.0f, 0.0f, 0.0f } }; };
+    static SimdFloat4 Replicate(float value) { return { { value, value, value, value } }; };
+    static SimdFloat4 Load(const float* values) { return { { values[0], values[1], values[2], values[3] } }; };
+    void Store(float* values) const { for (int i = 0; i < 4; ++i) values[i] = v[i]; };
+    static SimdFloat4 LoadBytes(const uint8_t* values)
+    {
+        return { { static_cast<float>(values[0]), static_cast<float>(values[1]), static_cast<float>(values[2]), static_cast<float>(values[3]) } };
+    };
+
+    friend SimdFloat4 operator+(SimdFloat4 a, SimdFloat4 b) { return { { a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3] } }; };
+    friend SimdFloat4 operator-(SimdFloat4 a, SimdFloat4 b) { return { { a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], a.v[3] - b.v[3] } }; };
+    friend SimdFloat4 operator*(SimdFloat4 a, SimdFloat4 b) { return { { a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3] } }; };
+    friend SimdFloat4 operator/(SimdFloat4 a, SimdFloat4 b) { return { { a.v[0] / b.v[0], a.v[1] / b.v[1], a.v[2] / b.v[2], a.v[3] / b.v[3] } }; };
+    friend SimdFloat4 Min(SimdFloat4 a, SimdFloat4 b) { return { { a.v[0] < b.v[0] ? a.v[0] : b.v[0], a.v[1] < b.v[1] ? a.v[1] : b.v[1], a.v[2] < b.v[2] ? a.v[2] : b.v[2], a.v[3] < b.v[3] ? a.v[3] : b.v[3] } }; };
+    friend SimdFloat4 Max(SimdFloat4 a, SimdFloat4 b) { return { { a.v[0] > b.v[0] ? a.v[0] : b.v[0], a.v[1] > b.v[1] ? a.v[1] : b.v[1], a.v[2] > b.v[2] ? a.v[2] : b.v[2], a.v[3] > b.v[3] ? a.v[3] : b.v[3] } }; };
+    friend void Transpose(SimdFloat4& a, SimdFloat4& b, SimdFloat4& c, SimdFloat4& d)
+    {
+        SimdFloat4 rows[4] = { a, b, c, d };
+        for (int i = 0; i < 4; ++i)
+        {
+            a.v[i] = rows[i].v[0];
+            b.v[i] = rows[i].v[1];
+            c.v[i] = rows[i].v[2];
+            d.v[i] = rows[i].v[3];
+        }
+    };
+#endif
+
+    // a + (b - a) * t
+    friend SimdFloat4 Lerp(SimdFloat4 a, SimdFloat4 b, float t) { return a + (b - a) * Replicate(t); };
+};
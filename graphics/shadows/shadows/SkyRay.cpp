@@ -0,0 +1,98 @@
+#include "SkyRay.h"
+
+#include <cmath>
+
+void GetSkyTriangleVertex(uint32_t vertex, float position[4])
+{
+    float u = static_cast<float>((vertex << 1) & 2);
+    float v = static_cast<float>(vertex & 2);
+    position[0] = u * 2.0f - 1.0f;
+    position[1] = 1.0f - v * 2.0f;
+    position[2] = 1.0f;
+    position[3] = 1.0f;
+}
+
+bool ComputeSkyRayTransform(const float view[4][4], const float projection[4][4], float transform[4][4])
+{
+    // Doubles keep the inverse accurate with a far plane thousands of times farther than the near one
+    double m[4][4];
+    for (int row = 0; row < 4; ++row)
+    {
+        for (int column = 0; column < 4; ++column)
+        {
+            // The last row of the view holds the translation, it is replaced by (0, 0, 0, 1)
+            double sum = projection[3][column];
+            if (row < 3)
+            {
+                sum = 0.0;
+                for (int k = 0; k < 4; ++k)
+                    sum += static_cast<double>(view[row][k]) * projection[k][column];
+            }
+            m[row][column] = sum;
+        }
+    }
+
+    // Gauss-Jordan elimination with partial pivoting
+    double inverse[4][4] = {};
+    for (int i = 0; i < 4; ++i)
+        inverse[i][i] = 1.0;
+
+    for (int column = 0; column < 4; ++column)
+    {
+        int pivot = column;
+        for (int row = column + 1; row < 4; ++row)
+        {
+            if (std::fabs(m[row][column]) > std::fabs(m[pivot][column]))
+                pivot = row;
+        }
+        if (m[pivot][column] == 0.0)
+            return false;
+
+        for (int k = 0; k < 4; ++k)
+        {
+            double t = m[column][k];
+            m[column][k] = m[pivot][k];
+            m[pivot][k] = t;
+            t = inverse[column][k];
+            inverse[column][k] = inverse[pivot][k];
+            inverse[pivot][k] = t;
+        }
+
+        double scale = 1.0 / m[column][column];
+        for (int k = 0; k < 4; ++k)
+        {
+            m[column][k] *= scale;
+            inverse[column][k] *= scale;
+        }
+
+        for (int row = 0; row < 4; ++row)
+        {
+            if (row == column)
+                continue;
+
+            double factor = m[row][column];
+            for (int k = 0; k < 4; ++k)
+            {
+                m[row][k] -= factor * m[column][k];
+                inverse[row][k] -= factor * inverse[column][k];
+            }
+        }
+    }
+
+    for (int row = 0; row < 4; ++row)
+    {
+        for (int column = 0; column < 4; ++column)
+            transform[row][column] = static_cast<float>(inverse[row][column]);
+    }
+    return true;
+}
+
+void ReconstructSkyRay(const float transform[4][4], float x, float y, float direction[3])
+{
+    float ray[4];
+    for (int column = 0; column < 4; ++column)
+        ray[column] = x * transform[0][column] + y * transform[1][column] + transform[2][column] + transform[3][column];
+
+    for (int k = 0; k < 3; ++k)
+        direction[k] = ray[k] / ray[3];
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+
+// The sky is one triangle that covers the screen at the far plane. Its pixels look up the environment along view rays
+// reconstructed from their clip positions, EnvironmentShaders.fx does the same math. Matrices are row-major with the
+// row vector convention (as DirectXMath).
+
+// Clip position of vertex 0, 1 or 2 of the triangle: (-1, 1), (3, 1) and (-1, -3) with depth 1, clockwise on screen
+void GetSkyTriangleVertex(uint32_t vertex, float position[4]);
+
+// Inverse of the view without its translation times the projection, the sky doesn't move with the camera.
+// False if the matrices can't be inverted.
+bool ComputeSkyRayTransform(const float view[4][4], const float projection[4][4], float transform[4][4]);
+
+// World direction (not normalized) through a clip position at the far plane. The vertex shader transforms the
+// position, the pixel shader divides the interpolated result by its w.
+void ReconstructSkyRay(const float transform[4][4], float x, float y, float direction[3]);
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "ShaderCache.h"
+
+// Small dense ids of distinct state descriptors. Descriptors are plain structs compared by their bytes,
+// so structs with padding have to be zeroed before their fields are set (equal fields then mean equal bytes).
+// Ids are handed out in insertion order and never change, they fit into draw sort keys.
+template <typename Desc>
+class StateDescTable
+{
+    static_assert(std::is_trivially_copyable<Desc>::value, "state descriptors are compared by their bytes");
+
+public:
+    static const uint32_t INVALID_ID = 0xFFFFFFFF;
+
+    // Returns the id of an equal descriptor, the descriptor is added first if there is none
+    uint32_t Insert(const Desc& desc, bool* added = nullptr)
+    {
+        uint64_t hash = HashShaderBytes(&desc, sizeof(Desc));
+        uint32_t id = Find(desc, hash);
+        if (added)
+            *added = id == INVALID_ID;
+        if (id != INVALID_ID)
+            return id;
+
+        id = static_cast<uint32_t>(m_descs.size());
+        m_descs.push_back(desc);
+        m_ids.insert({ hash, id });
+        return id;
+    };
+
+    uint32_t Find(const Desc& desc) const { return Find(desc, HashShaderBytes(&desc, sizeof(Desc))); };
+
+    const Desc& Get(uint32_t id) const { return m_descs[id]; };
+    uint32_t GetCount() const { return static_cast<uint32_t>(m_descs.size()); };
+
+    void Clear()
+    {
+        m_descs.clear();
+        m_ids.clear();
+    };
+
+private:
+    uint32_t Find(const Desc& desc, uint64_t hash) const
+    {
+        auto range = m_ids.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            if (memcmp(&m_descs[it->second], &desc, sizeof(Desc)) == 0)
+                return it->second;
+        }
+        return INVALID_ID;
+    };
+
+    std::vector<Desc>                          m_descs;
+    std::unordered_multimap<uint64_t, uint32_t> m_ids;
+};
+
+template <typename Desc>
+const uint32_t StateDescTable<Desc>::INVALID_ID;
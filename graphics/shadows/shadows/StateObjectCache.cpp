@@ -0,0 +1,101 @@
+#include "pch.h"
+
+#include "StateObjectCache.h"
+
+// Blend and depth stencil descriptors have padding, they are copied field by field into zeroed ones before hashing
+static D3D11_BLEND_DESC GetCanonicalDesc(const D3D11_BLEND_DESC& desc)
+{
+    D3D11_BLEND_DESC canonical;
+    ZeroMemory(&canonical, sizeof(canonical));
+    canonical.AlphaToCoverageEnable = desc.AlphaToCoverageEnable;
+    canonical.IndependentBlendEnable = desc.IndependentBlendEnable;
+
+    // Without independent blending only the first target counts
+    UINT targetCount = desc.IndependentBlendEnable ? D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT : 1;
+    for (UINT i = 0; i < targetCount; ++i)
+    {
+        const D3D11_RENDER_TARGET_BLEND_DESC& target = desc.RenderTarget[i];
+        canonical.RenderTarget[i].BlendEnable = target.BlendEnable;
+        canonical.RenderTarget[i].SrcBlend = target.SrcBlend;
+        canonical.RenderTarget[i].DestBlend = target.DestBlend;
+        canonical.RenderTarget[i].BlendOp = target.BlendOp;
+        canonical.RenderTarget[i].SrcBlendAlpha = target.SrcBlendAlpha;
+        canonical.RenderTarget[i].DestBlendAlpha = target.DestBlendAlpha;
+        canonical.RenderTarget[i].BlendOpAlpha = target.BlendOpAlpha;
+        canonical.RenderTarget[i].RenderTargetWriteMask = target.RenderTargetWriteMask;
+    }
+    return canonical;
+}
+
+static D3D11_DEPTH_STENCIL_DESC GetCanonicalDesc(const D3D11_DEPTH_STENCIL_DESC& desc)
+{
+    D3D11_DEPTH_STENCIL_DESC canonical;
+    ZeroMemory(&canonical, sizeof(canonical));
+    canonical.DepthEnable = desc.DepthEnable;
+    canonical.DepthWriteMask = desc.DepthWriteMask;
+    canonical.DepthFunc = desc.DepthFunc;
+    canonical.StencilEnable = desc.StencilEnable;
+    canonical.StencilReadMask = desc.StencilReadMask;
+    canonical.StencilWriteMask = desc.StencilWriteMask;
+    canonical.FrontFace = desc.FrontFace;
+    canonical.BackFace = desc.BackFace;
+    return canonical;
+}
+
+// Looks the descriptor up and creates the object the first time it is seen
+template <typename Desc, typename State, typename Create>
+static HRESULT GetState(StateDescTable<Desc>& descs, std::vector<Microsoft::WRL::ComPtr<State>>& states, const Desc& desc,
+    State** state, UINT* id, Create create)
+{
+    HRESULT hr = S_OK;
+
+    UINT stateId = descs.Find(desc);
+    if (stateId == StateDescTable<Desc>::INVALID_ID)
+    {
+        // Descriptors are only added once their object exists, so ids always index created states
+        Microsoft::WRL::ComPtr<State> newState;
+        hr = create(&desc, &newState);
+        if (FAILED(hr))
+            return hr;
+
+        stateId = descs.Insert(desc);
+        states.push_back(newState);
+    }
+
+    *state = states[stateId].Get();
+    (*state)->AddRef();
+    if (id)
+        *id = stateId;
+
+    return hr;
+}
+
+StateObjectCache::StateObjectCache()
+{};
+
+HRESULT StateObjectCache::GetBlendState(ID3D11Device* device, const D3D11_BLEND_DESC& desc, ID3D11BlendState** state, UINT* id)
+{
+    return GetState(m_blendDescs, m_pBlendStates, GetCanonicalDesc(desc), state, id,
+        [device](const D3D11_BLEND_DESC* d, ID3D11BlendState** s) { return device->CreateBlendState(d, s); });
+}
+
+HRESULT StateObjectCache::GetRasterizerState(ID3D11Device* device, const D3D11_RASTERIZER_DESC& desc, ID3D11RasterizerState** state, UINT* id)
+{
+    return GetState(m_rasterizerDescs, m_pRasterizerStates, desc, state, id,
+        [device](const D3D11_RASTERIZER_DESC* d, ID3D11RasterizerState** s) { return device->CreateRasterizerState(d, s); });
+}
+
+HRESULT StateObjectCache::GetSamplerState(ID3D11Device* device, const D3D11_SAMPLER_DESC& desc, ID3D11SamplerState** state, UINT* id)
+{
+    return GetState(m_samplerDescs, m_pSamplerStates, desc, state, id,
+        [device](const D3D11_SAMPLER_DESC* d, ID3D11SamplerState** s) { return device->CreateSamplerState(d, s); });
+}
+
+HRESULT StateObjectCache::GetDepthStencilState(ID3D11Device* device, const D3D11_DEPTH_STENCIL_DESC& desc, ID3D11DepthStencilState** state, UINT* id)
+{
+    return GetState(m_depthStencilDescs, m_pDepthStencilStates, GetCanonicalDesc(desc), state, id,
+        [device](const D3D11_DEPTH_STENCIL_DESC* d, ID3D11DepthStencilState** s) { return device->CreateDepthStencilState(d, s); });
+}
+
+StateObjectCache::~StateObjectCache()
+{};
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "DeviceResources.h"
+#include "StateDescTable.h"
+
+// Shared blend, rasterizer, sampler and depth stencil states. Equal descriptors give the same object and the same id,
+// ids are small and dense per state type, so draws can be sorted and compared by them.
+class StateObjectCache
+{
+public:
+    StateObjectCache();
+    ~StateObjectCache();
+
+    HRESULT GetBlendState(ID3D11Device* device, const D3D11_BLEND_DESC& desc, ID3D11BlendState** state, UINT* id = nullptr);
+    HRESULT GetRasterizerState(ID3D11Device* device, const D3D11_RASTERIZER_DESC& desc, ID3D11RasterizerState** state, UINT* id = nullptr);
+    HRESULT GetSamplerState(ID3D11Device* device, const D3D11_SAMPLER_DESC& desc, ID3D11SamplerState** state, UINT* id = nullptr);
+    HRESULT GetDepthStencilState(ID3D11Device* device, const D3D11_DEPTH_STENCIL_DESC& desc, ID3D11DepthStencilState** state, UINT* id = nullptr);
+
+private:
+    StateDescTable<D3D11_BLEND_DESC>         m_blendDescs;
+    StateDescTable<D3D11_RASTERIZER_DESC>    m_rasterizerDescs;
+    StateDescTable<D3D11_SAMPLER_DESC>       m_samplerDescs;
+    StateDescTable<D3D11_DEPTH_STENCIL_DESC> m_depthStencilDescs;
+
+    std::vector<Microsoft::WRL::ComPtr<ID3D11BlendState>>        m_pBlendStates;
+    std::vector<Microsoft::WRL::ComPtr<ID3D11RasterizerState>>   m_pRasterizerStates;
+    std::vector<Microsoft::WRL::ComPtr<ID3D11SamplerState>>      m_pSamplerStates;
+    std::vector<Microsoft::WRL::ComPtr<ID3D11DepthStencilState>> m_pDepthStencilStates;
+};
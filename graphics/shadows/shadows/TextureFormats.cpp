@@ -0,0 +1,128 @@
+#include "pch.h"
+
+#include "TextureFormats.h"
+
+struct HdrUsageFormats
+{
+    UINT             support;
+    HDR_TEXEL_FORMAT candidates[4];
+    UINT             candidateCount;
+};
+
+// Render textures are always created with render target, shader resource and unordered access views
+const UINT renderTextureSupport = D3D11_FORMAT_SUPPORT_TEXTURE2D | D3D11_FORMAT_SUPPORT_RENDER_TARGET | D3D11_FORMAT_SUPPORT_SHADER_SAMPLE |
+    D3D11_FORMAT_SUPPORT_TYPED_UNORDERED_ACCESS_VIEW;
+const UINT bakedCubeSupport = D3D11_FORMAT_SUPPORT_TEXTURECUBE | D3D11_FORMAT_SUPPORT_SHADER_SAMPLE | D3D11_FORMAT_SUPPORT_MIP;
+
+const HdrUsageFormats usageFormats[] =
+{
+    // Scene color and bloom don't use alpha, transparent models and emissive OIT output are blended into them
+    { renderTextureSupport | D3D11_FORMAT_SUPPORT_BLENDABLE,
+        { HDR_TEXEL_FORMAT::R11G11B10_FLOAT, HDR_TEXEL_FORMAT::R16G16B16A16_FLOAT, HDR_TEXEL_FORMAT::R32G32B32A32_FLOAT }, 3 },
+    // The log luminance is a single channel
+    { renderTextureSupport,
+        { HDR_TEXEL_FORMAT::R16_FLOAT, HDR_TEXEL_FORMAT::R32_FLOAT }, 2 },
+    // Alpha holds the sum of the weights
+    { renderTextureSupport | D3D11_FORMAT_SUPPORT_BLENDABLE,
+        { HDR_TEXEL_FORMAT::R16G16B16A16_FLOAT, HDR_TEXEL_FORMAT::R32G32B32A32_FLOAT }, 2 },
+    { bakedCubeSupport,
+        { HDR_TEXEL_FORMAT::BC6H_UF16, HDR_TEXEL_FORMAT::R9G9B9E5_SHAREDEXP, HDR_TEXEL_FORMAT::R16G16B16A16_FLOAT, HDR_TEXEL_FORMAT::R32G32B32A32_FLOAT }, 4 },
+    { bakedCubeSupport,
+        { HDR_TEXEL_FORMAT::BC6H_UF16, HDR_TEXEL_FORMAT::R9G9B9E5_SHAREDEXP, HDR_TEXEL_FORMAT::R16G16B16A16_FLOAT, HDR_TEXEL_FORMAT::R32G32B32A32_FLOAT }, 4 }
+};
+static_assert(ARRAYSIZE(usageFormats) == static_cast<size_t>(HDR_TEXTURE_USAGE::COUNT), "every usage needs its formats");
+
+struct FormatInfo
+{
+    DXGI_FORMAT format;
+    const char* name;
+    // Bytes per texel, or per 4x4 block of the compressed formats
+    UINT        bytes;
+    bool        blockCompressed;
+};
+
+const FormatInfo formatInfos[] =
+{
+    { DXGI_FORMAT_R32G32B32A32_FLOAT,  "R32G32B32A32_FLOAT",  16, false },
+    { DXGI_FORMAT_R16G16B16A16_FLOAT,  "R16G16B16A16_FLOAT",  8,  false },
+    { DXGI_FORMAT_R11G11B10_FLOAT,     "R11G11B10_FLOAT",     4,  false },
+    { DXGI_FORMAT_R9G9B9E5_SHAREDEXP,  "R9G9B9E5_SHAREDEXP",  4,  false },
+    { DXGI_FORMAT_R32_FLOAT,           "R32_FLOAT",           4,  false },
+    { DXGI_FORMAT_R16_FLOAT,           "R16_FLOAT",           2,  false },
+    { DXGI_FORMAT_BC6H_UF16,           "BC6H_UF16",           16, true },
+    { DXGI_FORMAT_R16G16_UNORM,        "R16G16_UNORM",        4,  false },
+    { DXGI_FORMAT_R32_TYPELESS,        "R32_TYPELESS",        4,  false },
+    { DXGI_FORMAT_R24G8_TYPELESS,      "R24G8_TYPELESS",      4,  false },
+    { DXGI_FORMAT_R8G8B8A8_UNORM,      "R8G8B8A8_UNORM",      4,  false },
+    { DXGI_FORMAT_R8G8B8A8_UNORM_SRGB, "R8G8B8A8_UNORM_SRGB", 4,  false }
+};
+
+HDR_TEXEL_FORMAT SelectHdrFormat(ID3D11Device* device, HDR_TEXTURE_USAGE usage, bool allowBlockCompression)
+{
+    const HdrUsageFormats& formats = usageFormats[static_cast<size_t>(usage)];
+    for (UINT i = 0; i < formats.candidateCount; ++i)
+    {
+        HDR_TEXEL_FORMAT candidate = formats.candidates[i];
+        if (candidate == HDR_TEXEL_FORMAT::BC6H_UF16 && !allowBlockCompression)
+            continue;
+
+        UINT support = 0;
+        if (SUCCEEDED(device->CheckFormatSupport(GetDXGIFormat(candidate), &support)) && (support & formats.support) == formats.support)
+            return candidate;
+    }
+    // Every device takes the last candidates for these binds
+    return formats.candidates[formats.candidateCount - 1];
+}
+
+DXGI_FORMAT GetDXGIFormat(HDR_TEXEL_FORMAT format)
+{
+    switch (format)
+    {
+    case HDR_TEXEL_FORMAT::R32G32B32A32_FLOAT:
+        return DXGI_FORMAT_R32G32B32A32_FLOAT;
+    case HDR_TEXEL_FORMAT::R16G16B16A16_FLOAT:
+        return DXGI_FORMAT_R16G16B16A16_FLOAT;
+    case HDR_TEXEL_FORMAT::R11G11B10_FLOAT:
+        return DXGI_FORMAT_R11G11B10_FLOAT;
+    case HDR_TEXEL_FORMAT::R9G9B9E5_SHAREDEXP:
+        return DXGI_FORMAT_R9G9B9E5_SHAREDEXP;
+    case HDR_TEXEL_FORMAT::R32_FLOAT:
+        return DXGI_FORMAT_R32_FLOAT;
+    case HDR_TEXEL_FORMAT::R16_FLOAT:
+        return DXGI_FORMAT_R16_FLOAT;
+    case HDR_TEXEL_FORMAT::BC6H_UF16:
+        return DXGI_FORMAT_BC6H_UF16;
+    default:
+        return DXGI_FORMAT_UNKNOWN;
+    }
+}
+
+void AddTextureMemory(std::vector<VideoMemoryEntry>& entries, const std::string& name, ID3D11Texture2D* texture)
+{
+    if (!texture)
+        return;
+
+    D3D11_TEXTURE2D_DESC td;
+    texture->GetDesc(&td);
+
+    VideoMemoryEntry entry = { name, "UNKNOWN", 0 };
+    for (const FormatInfo& info : formatInfos)
+    {
+        if (info.format != td.Format)
+            continue;
+
+        entry.format = info.name;
+        for (UINT mip = 0; mip < td.MipLevels; ++mip)
+        {
+            UINT64 width = td.Width >> mip ? td.Width >> mip : 1;
+            UINT64 height = td.Height >> mip ? td.Height >> mip : 1;
+            if (info.blockCompressed)
+                entry.bytes += (width + 3) / 4 * ((height + 3) / 4) * info.bytes;
+            else
+                entry.bytes += width * height * info.bytes;
+        }
+        entry.bytes *= static_cast<UINT64>(td.ArraySize) * td.SampleDesc.Count;
+        break;
+    }
+    entries.push_back(entry);
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "DeviceResources.h"
+#include "HdrPacking.h"
+
+// What an HDR texture is used for. Every usage has a list of formats from the most compact one, the binds it needs
+// decide which of them a device takes.
+enum class HDR_TEXTURE_USAGE
+{
+    // Also the bloom targets, the bloom result is copied into the scene
+    SCENE_COLOR = 0,
+    LUMINANCE,
+    OIT_ACCUMULATION,
+    ENVIRONMENT,
+    PREFILTERED_COLOR,
+    COUNT
+};
+
+// Block compression is only a candidate of the baked cubes, and only when it is allowed
+HDR_TEXEL_FORMAT SelectHdrFormat(ID3D11Device* device, HDR_TEXTURE_USAGE usage, bool allowBlockCompression = false);
+DXGI_FORMAT GetDXGIFormat(HDR_TEXEL_FORMAT format);
+
+struct VideoMemoryEntry
+{
+    std::string name;
+    const char* format;
+    UINT64      bytes;
+};
+
+// Appends the size of every subresource of the texture, formats the renderer doesn't create count as 0 bytes
+void AddTextureMemory(std::vector<VideoMemoryEntry>& entries, const std::string& name, ID3D11Texture2D* texture);
@@ -4,7 +4,9 @@
 #include "ShaderStructures.h"
 #include "Utils.h"
 
-ToneMapPostProcess::ToneMapPostProcess()
+ToneMapPostProcess::ToneMapPostProcess() :
+    m_width(0),
+    m_height(0)
 {};
 
 HRESULT ToneMapPostProcess::CreateDeviceDependentResources(ID3D11Device* device)
@@ -43,10 +45,27 @@ HRESULT ToneMapPostProcess::CreateDeviceDependentResources(ID3D11Device* device)
     if (FAILED(hr))
         return hr;
 
-    // Create the constant buffer for average luminance
-    CD3D11_BUFFER_DESC albd(sizeof(LuminanceConstantBuffer), D3D11_BIND_CONSTANT_BUFFER);
-    hr = device->CreateBuffer(&albd, nullptr, &m_pLuminanceBuffer);
-    
+    m_pLuminanceHistogram = std::unique_ptr<LuminanceHistogramProcess>(new LuminanceHistogramProcess());
+    hr = m_pLuminanceHistogram->CreateDeviceDependentResources(device);
+    if (FAILED(hr))
+        return hr;
+
+    // Create the adapted luminance buffer, both exposure paths write it and the tone mapping reads it
+    float adaptedLuminance = 0.0f;
+    D3D11_SUBRESOURCE_DATA ald = { &adaptedLuminance, 0, 0 };
+    CD3D11_BUFFER_DESC albd(sizeof(float), D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS);
+    hr = device->CreateBuffer(&albd, &ald, &m_pAdaptedLuminanceBuffer);
+    if (FAILED(hr))
+        return hr;
+
+    CD3D11_SHADER_RESOURCE_VIEW_DESC alsrvd(D3D11_SRV_DIMENSION_BUFFER, DXGI_FORMAT_R32_FLOAT, 0, 1);
+    hr = device->CreateShaderResourceView(m_pAdaptedLuminanceBuffer.Get(), &alsrvd, &m_pAdaptedLuminanceShaderResourceView);
+    if (FAILED(hr))
+        return hr;
+
+    CD3D11_UNORDERED_ACCESS_VIEW_DESC aluavd(D3D11_UAV_DIMENSION_BUFFER, DXGI_FORMAT_R32_FLOAT, 0, 1);
+    hr = device->CreateUnorderedAccessView(m_pAdaptedLuminanceBuffer.Get(), &aluavd, &m_pAdaptedLuminanceUnorderedAccessView);
+
     return hr;
 }
 
@@ -54,17 +73,35 @@ HRESULT ToneMapPostProcess::CreateWindowSizeDependentResources(ID3D11Device* dev
 {
     HRESULT hr = S_OK;
 
+    m_width = width;
+    m_height = height;
+
     hr = m_pAverageLuminance->CreateWindowSizeDependentResources(device, width, height);
 
     return hr;
 }
 
-void ToneMapPostProcess::Process(ID3D11DeviceContext* context, ID3D11ShaderResourceView* sourceTexture, ID3D11RenderTargetView* renderTarget, D3D11_VIEWPORT viewport)
+void ToneMapPostProcess::Process(ID3D11DeviceContext* context, ID3D11ShaderResourceView* sourceTexture, ID3D11RenderTargetView* renderTarget, D3D11_VIEWPORT viewport,
+    bool histogramExposure, GpuProfiler* profiler)
 {
-    float averageLuminance = m_pAverageLuminance->Process(context, sourceTexture);
-
-    LuminanceConstantBuffer luminanceBufferData = { averageLuminance };
-    context->UpdateSubresource(m_pLuminanceBuffer.Get(), 0, nullptr, &luminanceBufferData, 0, 0);
+    if (profiler)
+        profiler->BeginPass(context, GPU_PROFILER_PASS::LUMINANCE);
+
+    if (histogramExposure)
+    {
+        m_pLuminanceHistogram->Process(context, sourceTexture, m_width, m_height, m_pAdaptedLuminanceUnorderedAccessView.Get());
+    }
+    else
+    {
+        float adaptedLuminance = m_pAverageLuminance->Process(context, sourceTexture);
+        context->UpdateSubresource(m_pAdaptedLuminanceBuffer.Get(), 0, nullptr, &adaptedLuminance, 0, 0);
+    }
+
+    if (profiler)
+    {
+        profiler->EndPass(context, GPU_PROFILER_PASS::LUMINANCE);
+        profiler->BeginPass(context, GPU_PROFILER_PASS::TONE_MAP);
+    }
 
     context->OMSetRenderTargets(1, &renderTarget, nullptr);
     context->RSSetViewports(1, &viewport);
@@ -80,14 +117,22 @@ void ToneMapPostProcess::Process(ID3D11DeviceContext* context, ID3D11ShaderResou
 
     context->VSSetShader(m_pVertexShader.Get(), nullptr, 0);
     context->PSSetShader(m_pPixelShader.Get(), nullptr, 0);
-    context->PSSetConstantBuffers(0, 1, m_pLuminanceBuffer.GetAddressOf());
-    context->PSSetShaderResources(0, 1, &sourceTexture);
+    ID3D11ShaderResourceView* shaderResourceViews[2] = { sourceTexture, m_pAdaptedLuminanceShaderResourceView.Get() };
+    context->PSSetShaderResources(0, 2, shaderResourceViews);
     context->PSSetSamplers(0, 1, m_pSamplerState.GetAddressOf());
     
     context->Draw(4, 0);
 
-    ID3D11ShaderResourceView* nullsrv[] = { nullptr };
-    context->PSSetShaderResources(0, 1, nullsrv);
+    ID3D11ShaderResourceView* nullsrv[] = { nullptr, nullptr };
+    context->PSSetShaderResources(0, 2, nullsrv);
+
+    if (profiler)
+        profiler->EndPass(context, GPU_PROFILER_PASS::TONE_MAP);
+}
+
+void ToneMapPostProcess::AddVideoMemory(std::vector<VideoMemoryEntry>& entries) const
+{
+    m_pAverageLuminance->AddVideoMemory(entries);
 }
 
 ToneMapPostProcess::~ToneMapPostProcess()
@@ -2,6 +2,8 @@
 
 #include "DeviceResources.h"
 #include "AverageLuminanceProcess.h"
+#include "GpuProfiler.h"
+#include "LuminanceHistogramProcess.h"
 
 class ToneMapPostProcess
 {
@@ -12,13 +14,24 @@ public:
     HRESULT CreateDeviceDependentResources(ID3D11Device* device);
     HRESULT CreateWindowSizeDependentResources(ID3D11Device* device, UINT width, UINT height);
 
-    void Process(ID3D11DeviceContext* context, ID3D11ShaderResourceView* sourceTexture, ID3D11RenderTargetView* renderTarget, D3D11_VIEWPORT viewport);
+    // Luminance and tone mapping are measured as separate passes when a profiler is given. The histogram exposure keeps
+    // the adapted luminance on the GPU, otherwise the average luminance is read back and adapted on the CPU.
+    void Process(ID3D11DeviceContext* context, ID3D11ShaderResourceView* sourceTexture, ID3D11RenderTargetView* renderTarget, D3D11_VIEWPORT viewport,
+        bool histogramExposure, GpuProfiler* profiler = nullptr);
+
+    void AddVideoMemory(std::vector<VideoMemoryEntry>& entries) const;
 
 private:
-    std::unique_ptr<AverageLuminanceProcess> m_pAverageLuminance;
+    std::unique_ptr<AverageLuminanceProcess>   m_pAverageLuminance;
+    std::unique_ptr<LuminanceHistogramProcess> m_pLuminanceHistogram;
+
+    Microsoft::WRL::ComPtr<ID3D11VertexShader>        m_pVertexShader;
+    Microsoft::WRL::ComPtr<ID3D11PixelShader>         m_pPixelShader;
+    Microsoft::WRL::ComPtr<ID3D11SamplerState>        m_pSamplerState;
+    Microsoft::WRL::ComPtr<ID3D11Buffer>              m_pAdaptedLuminanceBuffer;
+    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>  m_pAdaptedLuminanceShaderResourceView;
+    Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView> m_pAdaptedLuminanceUnorderedAccessView;
 
-    Microsoft::WRL::ComPtr<ID3D11VertexShader> m_pVertexShader;
-    Microsoft::WRL::ComPtr<ID3D11PixelShader>  m_pPixelShader;
-    Microsoft::WRL::ComPtr<ID3D11SamplerState> m_pSamplerState;
-    Microsoft::WRL::ComPtr<ID3D11Buffer>       m_pLuminanceBuffer;
+    UINT m_width;
+    UINT m_height;
 };
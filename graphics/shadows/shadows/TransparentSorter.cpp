@@ -0,0 +1,175 @@
+#include "TransparentSorter.h"
+
+#include <cstring>
+
+namespace
+{
+    // Insertion refine gives up after this many moves per draw and the radix sort is used instead
+    const size_t COHERENT_MOVES_PER_DRAW = 4;
+
+    // Unsigned key whose ascending order is the descending order of the float
+    uint32_t DescendingKey(float key)
+    {
+        uint32_t bits;
+        memcpy(&bits, &key, sizeof(bits));
+        bits ^= (bits & 0x80000000) ? 0xFFFFFFFF : 0x80000000;
+        return ~bits;
+    }
+}
+
+TransparentSorter::TransparentSorter() :
+    m_stamp(0),
+    m_radixSorted(false)
+{};
+
+TransparentSorter::~TransparentSorter()
+{};
+
+void TransparentSorter::Clear()
+{
+    m_values.clear();
+    m_keys.clear();
+}
+
+void TransparentSorter::Add(uint32_t value, float key)
+{
+    m_values.push_back(value);
+    m_keys.push_back(key);
+    if (value >= m_valueKeys.size())
+    {
+        m_valueKeys.resize(value + 1, 0.0f);
+        m_valueStamps.resize(value + 1, 0);
+    }
+}
+
+const std::vector<uint32_t>& TransparentSorter::Sort()
+{
+    // Every frame uses two stamps: "added this frame" and "already in the order"
+    if (m_stamp >= 0xFFFFFFFD)
+    {
+        std::fill(m_valueStamps.begin(), m_valueStamps.end(), 0);
+        m_stamp = 0;
+    }
+    const uint32_t added = m_stamp + 1;
+    const uint32_t ordered = m_stamp + 2;
+    m_stamp += 2;
+
+    size_t count = m_values.size();
+    for (size_t i = 0; i < count; ++i)
+    {
+        m_valueKeys[m_values[i]] = m_keys[i];
+        m_valueStamps[m_values[i]] = added;
+    }
+
+    // Previous order without the draws that are gone, followed by the new ones
+    size_t kept = 0;
+    for (uint32_t value : m_order)
+    {
+        if (value < m_valueStamps.size() && m_valueStamps[value] == added)
+        {
+            m_valueStamps[value] = ordered;
+            m_order[kept++] = value;
+        }
+    }
+    m_order.resize(kept);
+    for (uint32_t value : m_values)
+    {
+        if (m_valueStamps[value] == added)
+        {
+            m_valueStamps[value] = ordered;
+            m_order.push_back(value);
+        }
+    }
+
+    // Duplicated values can't be refined in place
+    m_radixSorted = m_order.size() != count || !InsertionSort(count * COHERENT_MOVES_PER_DRAW + 16);
+    if (m_radixSorted)
+        RadixSort();
+
+    return m_order;
+}
+
+bool TransparentSorter::InsertionSort(size_t maxMoves)
+{
+    size_t moves = 0;
+    for (size_t i = 1; i < m_order.size(); ++i)
+    {
+        uint32_t value = m_order[i];
+        float key = m_valueKeys[value];
+        size_t j = i;
+        while (j > 0 && m_valueKeys[m_order[j - 1]] < key)
+        {
+            m_order[j] = m_order[j - 1];
+            --j;
+            if (++moves > maxMoves)
+            {
+                m_order[j] = value;
+                return false;
+            }
+        }
+        m_order[j] = value;
+    }
+    return true;
+}
+
+void TransparentSorter::RadixSort()
+{
+    size_t count = m_values.size();
+    m_sortKeys.resize(count);
+    m_tempKeys.resize(count);
+    m_order.resize(count);
+    m_tempOrder.resize(count);
+
+    uint32_t histograms[4][256];
+    memset(histograms, 0, sizeof(histograms));
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint32_t key = DescendingKey(m_keys[i]);
+        m_sortKeys[i] = key;
+        m_order[i] = static_cast<uint32_t>(i);
+        for (int pass = 0; pass < 4; ++pass)
+            ++histograms[pass][(key >> (pass * 8)) & 0xFF];
+    }
+
+    uint32_t* keys = m_sortKeys.data();
+    uint32_t* indices = m_order.data();
+    uint32_t* tempKeys = m_tempKeys.data();
+    uint32_t* tempIndices = m_tempOrder.data();
+    for (int pass = 0; pass < 4; ++pass)
+    {
+        uint32_t* histogram = histograms[pass];
+        int shift = pass * 8;
+
+        // All keys have the same digit, the pass wouldn't move anything
+        if (count == 0 || histogram[(keys[0] >> shift) & 0xFF] == count)
+            continue;
+
+        uint32_t offset = 0;
+        for (int i = 0; i < 256; ++i)
+        {
+            uint32_t bucket = histogram[i];
+            histogram[i] = offset;
+            offset += bucket;
+        }
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            uint32_t destination = histogram[(keys[i] >> shift) & 0xFF]++;
+            tempKeys[destination] = keys[i];
+            tempIndices[destination] = indices[i];
+        }
+
+        uint32_t* swap = keys;
+        keys = tempKeys;
+        tempKeys = swap;
+        swap = indices;
+        indices = tempIndices;
+        tempIndices = swap;
+    }
+
+    // Indices to values, the unused buffer is free for it
+    for (size_t i = 0; i < count; ++i)
+        tempIndices[i] = m_values[indices[i]];
+    if (tempIndices != m_order.data())
+        m_order.swap(m_tempOrder);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Back to front ordering of transparent draws for one view.
+// Values are small stable ids of the draws (e.g. an index into a draw list), keys are view distances.
+// All buffers persist between frames, so sorting doesn't allocate once the capacity is reached.
+// The previous frame order is refined with an insertion sort while the scene is coherent,
+// a radix sort over the float keys is used when it isn't.
+class TransparentSorter
+{
+public:
+    TransparentSorter();
+    ~TransparentSorter();
+
+    void Clear();
+    void Add(uint32_t value, float key);
+
+    // Returns values ordered by decreasing key. Equal keys keep the previous frame order when it is refined
+    // and the order of the Add calls when it is radix sorted.
+    const std::vector<uint32_t>& Sort();
+
+    bool WasRadixSorted() const { return m_radixSorted; };
+    size_t GetCount() const { return m_values.size(); };
+
+private:
+    void RadixSort();
+    bool InsertionSort(size_t maxMoves);
+
+    std::vector<uint32_t> m_values;
+    std::vector<float>    m_keys;
+
+    // Indexed by value
+    std::vector<float>    m_valueKeys;
+    std::vector<uint32_t> m_valueStamps;
+
+    std::vector<uint32_t> m_order;
+    std::vector<uint32_t> m_sortKeys;
+    std::vector<uint32_t> m_tempKeys;
+    std::vector<uint32_t> m_tempOrder;
+
+    uint32_t m_stamp;
+    bool     m_radixSorted;
+};
@@ -1,8 +1,12 @@
 #include "pch.h"
 
+#include <atomic>
 #include <fstream>
+#include <future>
+#include <thread>
 
 #include "Utils.h"
+#include "CpuTrace.h"
 
 HRESULT ReadCompiledShader(const WCHAR* szFileName, std::vector<BYTE>& bytes)
 {
@@ -67,19 +71,147 @@ HRESULT CreateComputeShader(ID3D11Device* device, const WCHAR* szFileName, std::
     return hr;
 }
 
-HRESULT CompileShaderFromFile(const WCHAR* szFileName, LPCSTR szEntryPoint, LPCSTR szShaderModel, ID3DBlob** ppBlobOut, D3D_SHADER_MACRO* pDefines)
+// Compiled shaders are kept next to the executable between runs
+const char* const shaderCacheDirectory = "ShaderCache";
+
+static ShaderSourceHasher& GetShaderSourceHasher()
 {
-    HRESULT hr = S_OK;
+    static ShaderSourceHasher hasher;
+    return hasher;
+}
+
+static const ShaderCache& GetShaderCache()
+{
+    static ShaderCache cache(shaderCacheDirectory);
+    return cache;
+}
 
+static DWORD GetShaderCompileFlags()
+{
     DWORD dwShaderFlags = D3DCOMPILE_ENABLE_STRICTNESS;
 #if defined(DEBUG) || defined(_DEBUG)
     dwShaderFlags |= D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
 #endif
+    return dwShaderFlags;
+}
+
+static std::string ToNarrowString(const std::wstring& value)
+{
+    int size = WideCharToMultiByte(CP_ACP, 0, value.c_str(), static_cast<int>(value.size()), nullptr, 0, nullptr, nullptr);
+    std::string result(size, '\0');
+    WideCharToMultiByte(CP_ACP, 0, value.c_str(), static_cast<int>(value.size()), &result[0], size, nullptr, nullptr);
+    return result;
+}
+
+static HRESULT CompileShaderTask(ShaderCompileTask& task)
+{
+    std::vector<D3D_SHADER_MACRO> defines;
+    for (const ShaderDefine& define : task.defines)
+        defines.push_back({ define.name.c_str(), define.value.c_str() });
+    defines.push_back({ nullptr, nullptr });
 
     Microsoft::WRL::ComPtr<ID3DBlob> err;
-    hr = D3DCompileFromFile(szFileName, pDefines, D3D_COMPILE_STANDARD_FILE_INCLUDE, szEntryPoint, szShaderModel, dwShaderFlags, 0, ppBlobOut, &err);
+    HRESULT hr = D3DCompileFromFile(task.fileName.c_str(), defines.data(), D3D_COMPILE_STANDARD_FILE_INCLUDE, task.entryPoint.c_str(), task.shaderModel.c_str(),
+        GetShaderCompileFlags(), 0, &task.blob, &err);
     if (FAILED(hr) && err)
         OutputDebugStringA(reinterpret_cast<const char*>(err->GetBufferPointer()));
 
     return hr;
 }
+
+HRESULT CompileShadersFromFile(std::vector<ShaderCompileTask>& tasks)
+{
+    CPU_TRACE_SCOPE("CompileShadersFromFile");
+
+    HRESULT hr = S_OK;
+
+    const ShaderCache& cache = GetShaderCache();
+
+    // Hits are loaded right away, misses remember their key for storing the result
+    std::vector<size_t> misses;
+    std::vector<uint64_t> keys(tasks.size());
+    std::vector<bool> keyValid(tasks.size(), false);
+    for (size_t i = 0; i < tasks.size(); ++i)
+    {
+        ShaderCompileTask& task = tasks[i];
+
+        ShaderCompileRequest request = { ToNarrowString(task.fileName), task.entryPoint, task.shaderModel, task.defines, GetShaderCompileFlags(), D3D_COMPILER_VERSION };
+
+        uint64_t sourceHash;
+        if (GetShaderSourceHasher().HashSource(request.sourcePath, sourceHash))
+        {
+            keys[i] = ComputeShaderKey(request, sourceHash);
+            keyValid[i] = true;
+
+            std::vector<uint8_t> bytecode;
+            if (cache.Load(keys[i], bytecode))
+            {
+                hr = D3DCreateBlob(bytecode.size(), &task.blob);
+                if (FAILED(hr))
+                    return hr;
+
+                memcpy(task.blob->GetBufferPointer(), bytecode.data(), bytecode.size());
+                continue;
+            }
+        }
+
+        misses.push_back(i);
+    }
+
+    // The compiler is thread safe, every worker takes the next miss until none are left
+    std::atomic<size_t> next(0);
+    std::vector<HRESULT> results(tasks.size(), S_OK);
+    auto compileMisses = [&]()
+    {
+        for (size_t miss = next++; miss < misses.size(); miss = next++)
+        {
+            CPU_TRACE_SCOPE("Compile shader");
+            size_t i = misses[miss];
+            results[i] = CompileShaderTask(tasks[i]);
+            if (SUCCEEDED(results[i]) && keyValid[i])
+                cache.Store(keys[i], tasks[i].blob->GetBufferPointer(), tasks[i].blob->GetBufferSize());
+        }
+    };
+
+    CPU_TRACE_COUNTER("Shader cache misses", misses.size());
+
+    size_t threadCount = std::thread::hardware_concurrency();
+    if (threadCount == 0)
+        threadCount = 1;
+    if (threadCount > misses.size())
+        threadCount = misses.size();
+    std::vector<std::future<void>> workers;
+    for (size_t t = 1; t < threadCount; ++t)
+        workers.push_back(std::async(std::launch::async, compileMisses));
+    compileMisses();
+    for (std::future<void>& worker : workers)
+        worker.get();
+
+    for (HRESULT result : results)
+    {
+        if (FAILED(result))
+            return result;
+    }
+
+    return hr;
+}
+
+HRESULT CompileShaderFromFile(const WCHAR* szFileName, LPCSTR szEntryPoint, LPCSTR szShaderModel, ID3DBlob** ppBlobOut, D3D_SHADER_MACRO* pDefines)
+{
+    HRESULT hr = S_OK;
+
+    std::vector<ShaderCompileTask> tasks(1);
+    tasks[0].fileName = szFileName;
+    tasks[0].entryPoint = szEntryPoint;
+    tasks[0].shaderModel = szShaderModel;
+    for (D3D_SHADER_MACRO* define = pDefines; define && define->Name; ++define)
+        tasks[0].defines.push_back({ define->Name, define->Definition });
+
+    hr = CompileShadersFromFile(tasks);
+    if (FAILED(hr))
+        return hr;
+
+    *ppBlobOut = tasks[0].blob.Detach();
+
+    return hr;
+}
@@ -2,6 +2,8 @@
 
 #include <vector>
 
+#include "ShaderCache.h"
+
 HRESULT CreateVertexShader(ID3D11Device* device, const WCHAR* szFileName, std::vector<BYTE>& bytes, ID3D11VertexShader** vertexShader);
 
 HRESULT CreatePixelShader(ID3D11Device* device, const WCHAR* szFileName, std::vector<BYTE>& bytes, ID3D11PixelShader** pixelShader);
@@ -9,3 +11,15 @@ HRESULT CreatePixelShader(ID3D11Device* device, const WCHAR* szFileName, std::ve
 HRESULT CreateComputeShader(ID3D11Device* device, const WCHAR* szFileName, std::vector<BYTE>& bytes, ID3D11ComputeShader** computeShader);
 
 HRESULT CompileShaderFromFile(const WCHAR* szFileName, LPCSTR szEntryPoint, LPCSTR szShaderModel, ID3DBlob** ppBlobOut, D3D_SHADER_MACRO* pDefines=nullptr);
+
+struct ShaderCompileTask
+{
+    std::wstring                      fileName;
+    std::string                       entryPoint;
+    std::string                       shaderModel;
+    std::vector<ShaderDefine>         defines;
+    Microsoft::WRL::ComPtr<ID3DBlob>  blob;
+};
+
+// Bytecode of all tasks, taken from the on-disk shader cache where possible. Misses are compiled in parallel and stored.
+HRESULT CompileShadersFromFile(std::vector<ShaderCompileTask>& tasks);
@@ -0,0 +1,47 @@
+#include "WeightedBlendedOIT.h"
+
+#include <cmath>
+
+namespace
+{
+    const float MIN_WEIGHT = 1e-2f;
+    const float MAX_WEIGHT = 3e3f;
+    const float MIN_ACCUMULATED_ALPHA = 1e-5f;
+}
+
+void ClearOITPixel(OITPixel& pixel)
+{
+    for (int i = 0; i < 4; ++i)
+        pixel.accumulation[i] = 0.0f;
+    pixel.revealage = 1.0f;
+}
+
+float OITWeight(float alpha, float viewDepth)
+{
+    // Equation 9 of the paper
+    float z = std::fabs(viewDepth);
+    float nearTerm = z / 5.0f;
+    float farTerm = z / 200.0f;
+    float weight = 10.0f / (1e-5f + nearTerm * nearTerm + farTerm * farTerm * farTerm * farTerm * farTerm * farTerm);
+    weight = weight < MIN_WEIGHT ? MIN_WEIGHT : (weight > MAX_WEIGHT ? MAX_WEIGHT : weight);
+    return alpha * weight;
+}
+
+void AccumulateOIT(OITPixel& pixel, const float color[3], float alpha, float viewDepth)
+{
+    // Accumulation target blends with ONE, ONE, revealage with ZERO, INV_SRC_COLOR
+    float weight = OITWeight(alpha, viewDepth);
+    for (int i = 0; i < 3; ++i)
+        pixel.accumulation[i] += color[i] * alpha * weight;
+    pixel.accumulation[3] += alpha * weight;
+    pixel.revealage *= 1.0f - alpha;
+}
+
+void ResolveOIT(const OITPixel& pixel, const float background[3], float result[3])
+{
+    // Resolve pass blends with SRC_ALPHA, INV_SRC_ALPHA
+    float coverage = 1.0f - pixel.revealage;
+    float accumulatedAlpha = pixel.accumulation[3] > MIN_ACCUMULATED_ALPHA ? pixel.accumulation[3] : MIN_ACCUMULATED_ALPHA;
+    for (int i = 0; i < 3; ++i)
+        result[i] = pixel.accumulation[i] / accumulatedAlpha * coverage + background[i] * pixel.revealage;
+}
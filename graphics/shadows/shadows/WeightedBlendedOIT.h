@@ -0,0 +1,23 @@
+#pragma once
+
+// CPU reference of the weighted blended order independent transparency
+// (McGuire, Bavoil, "Weighted Blended Order-Independent Transparency", 2013).
+// The same math is used by the OIT variant of ps_main in PBRShaders.fx and by OITShaders.fx,
+// keep them in sync.
+
+struct OITPixel
+{
+    float accumulation[4];
+    float revealage;
+};
+
+void ClearOITPixel(OITPixel& pixel);
+
+// Weight of a fragment by its alpha and view space depth (distance along the camera direction)
+float OITWeight(float alpha, float viewDepth);
+
+// Adds a fragment with not premultiplied color, order of the calls doesn't matter
+void AccumulateOIT(OITPixel& pixel, const float color[3], float alpha, float viewDepth);
+
+// Composites the accumulated fragments over the background
+void ResolveOIT(const OITPixel& pixel, const float background[3], float result[3]);
@@ -0,0 +1,165 @@
+#include "Test.h"
+#include "../shadows/BoundingVolumeHierarchy.h"
+
+#include <algorithm>
+#include <random>
+
+namespace
+{
+    std::vector<AABB> RandomBoxes(std::mt19937& random, size_t count)
+    {
+        std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+        std::uniform_real_distribution<float> extent(0.1f, 5.0f);
+        std::vector<AABB> boxes(count);
+        for (AABB& box : boxes)
+        {
+            Float3 center = { position(random), position(random), position(random) };
+            Float3 half = { extent(random), extent(random), extent(random) };
+            box.min = { center.x - half.x, center.y - half.y, center.z - half.z };
+            box.max = { center.x + half.x, center.y + half.y, center.z + half.z };
+        }
+        return boxes;
+    }
+
+    template <typename Volume>
+    std::vector<uint32_t> BruteForce(const std::vector<AABB>& boxes, const Volume& volume)
+    {
+        std::vector<uint32_t> result;
+        for (uint32_t i = 0; i < boxes.size(); ++i)
+            if (Intersects(boxes[i], volume))
+                result.push_back(i);
+        return result;
+    }
+
+    std::vector<uint32_t> Sorted(std::vector<uint32_t> indices)
+    {
+        std::sort(indices.begin(), indices.end());
+        return indices;
+    }
+
+    // Compares the queries with a linear scan of the boxes
+    void CheckQueries(const BoundingVolumeHierarchy& bvh, const std::vector<AABB>& boxes, std::mt19937& random)
+    {
+        std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+        std::uniform_real_distribution<float> size(0.5f, 25.0f);
+        for (int query = 0; query < 100; ++query)
+        {
+            std::vector<uint32_t> result;
+            BoundingSphere sphere = { { position(random), position(random), position(random) }, size(random) };
+            bvh.QuerySphere(sphere, result);
+            CHECK(Sorted(result) == BruteForce(boxes, sphere));
+
+            result.clear();
+            AABB box;
+            box.min = { position(random), position(random), position(random) };
+            box.max = { box.min.x + size(random), box.min.y + size(random), box.min.z + size(random) };
+            bvh.QueryAABB(box, result);
+            CHECK(Sorted(result) == BruteForce(boxes, box));
+
+            result.clear();
+            const float matrix[4][4] = {
+                { 0.02f, 0.0f, 0.0f, 0.0f },
+                { 0.0f, 0.02f, 0.0f, 0.0f },
+                { 0.0f, 0.0f, 0.005f, 0.0f },
+                { position(random) * 0.01f, position(random) * 0.01f, 0.5f, 1.0f }
+            };
+            Frustum frustum = FrustumFromMatrix(matrix);
+            bvh.QueryFrustum(frustum, result);
+            CHECK(Sorted(result) == BruteForce(boxes, frustum));
+
+            Ray ray = { { position(random), position(random), position(random) }, { position(random), position(random), position(random) } };
+            float nearest = 1e9f;
+            bool expectedHit = false;
+            for (const AABB& candidate : boxes)
+            {
+                float distance;
+                if (Intersects(ray, candidate, nearest, distance))
+                {
+                    nearest = distance < nearest ? distance : nearest;
+                    expectedHit = true;
+                }
+            }
+            uint32_t hitIndex = 0;
+            float hitDistance = 0.0f;
+            bool hit = bvh.QueryRay(ray, 1e9f, hitIndex, hitDistance);
+            CHECK(hit == expectedHit);
+            if (hit && expectedHit)
+            {
+                CHECK_NEAR(hitDistance, nearest, 1e-4f);
+                float distance;
+                CHECK(Intersects(ray, boxes[hitIndex], 1e9f, distance));
+            }
+        }
+    }
+}
+
+TEST(BoundingVolumeHierarchyQueriesMatchBruteForce)
+{
+    std::mt19937 random(1);
+    const size_t counts[] = { 1, 3, 5, 17, 100, 1000, 5000 };
+    for (size_t count : counts)
+    {
+        std::vector<AABB> boxes = RandomBoxes(random, count);
+        BoundingVolumeHierarchy bvh;
+        bvh.Build(boxes);
+        CHECK(bvh.GetPrimitiveCount() == count);
+        CheckQueries(bvh, boxes, random);
+    }
+}
+
+TEST(BoundingVolumeHierarchyBuildDoesNotDependOnThreadCount)
+{
+    std::mt19937 random(2);
+    std::vector<AABB> boxes = RandomBoxes(random, 20000);
+    BoundingVolumeHierarchy single;
+    single.Build(boxes, 1);
+    BoundingVolumeHierarchy parallel;
+    parallel.Build(boxes, 4);
+    CHECK(single.GetNodeCount() == parallel.GetNodeCount());
+
+    BoundingSphere sphere = { { 0.0f, 0.0f, 0.0f }, 40.0f };
+    std::vector<uint32_t> singleResult;
+    std::vector<uint32_t> parallelResult;
+    single.QuerySphere(sphere, singleResult);
+    parallel.QuerySphere(sphere, parallelResult);
+    CHECK(Sorted(singleResult) == Sorted(parallelResult));
+}
+
+TEST(BoundingVolumeHierarchyRefit)
+{
+    std::mt19937 random(3);
+    std::vector<AABB> boxes = RandomBoxes(random, 1000);
+    BoundingVolumeHierarchy bvh;
+    bvh.Build(boxes);
+
+    std::vector<uint32_t> moved;
+    for (uint32_t i = 0; i < boxes.size(); i += 7)
+    {
+        boxes[i].min.x += 10.0f;
+        boxes[i].max.x += 10.0f;
+        moved.push_back(i);
+    }
+    bvh.Refit(moved, boxes);
+    CheckQueries(bvh, boxes, random);
+
+    for (AABB& box : boxes)
+    {
+        box.min.y -= 3.0f;
+        box.max.y -= 3.0f;
+    }
+    bvh.Refit(boxes);
+    CheckQueries(bvh, boxes, random);
+}
+
+TEST(BoundingVolumeHierarchyEmpty)
+{
+    BoundingVolumeHierarchy bvh;
+    bvh.Build(std::vector<AABB>());
+    CHECK(bvh.IsEmpty());
+    std::vector<uint32_t> result;
+    bvh.QuerySphere({ { 0.0f, 0.0f, 0.0f }, 100.0f }, result);
+    CHECK(result.empty());
+    uint32_t hitIndex;
+    float hitDistance;
+    CHECK(!bvh.QueryRay({ { 0.0f, 0.0f, 0.0f }, { 1.0f, 0.0f, 0.0f } }, 1e9f, hitIndex, hitDistance));
+}
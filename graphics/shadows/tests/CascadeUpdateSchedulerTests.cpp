@@ -0,0 +1,152 @@
+#include "Test.h"
+#include "../shadows/CascadeUpdateScheduler.h"
+
+#include <random>
+
+namespace
+{
+    uint32_t CountBits(uint32_t mask)
+    {
+        uint32_t count = 0;
+        for (; mask != 0; mask &= mask - 1)
+            ++count;
+        return count;
+    }
+
+    std::vector<uint32_t> ScheduleFrames(CascadeUpdateScheduler& scheduler, const std::vector<uint32_t>& dirtyMasks)
+    {
+        std::vector<uint32_t> scheduled;
+        for (uint32_t dirtyMask : dirtyMasks)
+            scheduled.push_back(scheduler.Schedule(dirtyMask));
+        return scheduled;
+    }
+}
+
+TEST(CascadeUpdateSchedulerFirstCascadeOutsideOfTheBudget)
+{
+    // With a budget of one the farther cascades still take turns while the first one renders every frame
+    CascadeUpdateScheduler scheduler(4);
+    scheduler.SetBudget(1);
+    std::vector<uint32_t> expected = { 0x3, 0x5, 0x9, 0x3, 0x5, 0x9, 0x3, 0x5, 0x9 };
+    CHECK(ScheduleFrames(scheduler, std::vector<uint32_t>(9, 0xF)) == expected);
+
+    // Cascades that don't fit stay dirty until they are rendered, after that a static camera renders nothing
+    CascadeUpdateScheduler staticScheduler(4);
+    staticScheduler.SetBudget(1);
+    expected = { 0x3, 0x4, 0x8, 0x0, 0x0, 0x0, 0x0 };
+    CHECK(ScheduleFrames(staticScheduler, { 0xF, 0xC, 0x8, 0, 0, 0, 0 }) == expected);
+}
+
+TEST(CascadeUpdateSchedulerKeepsCleanCascades)
+{
+    // Only the first cascade moves, the others are never rendered again
+    CascadeUpdateScheduler scheduler(4);
+    std::vector<uint32_t> dirtyMasks = { 0xF, 0x1, 0x1, 0x1, 0x1, 0x1, 0x1, 0x1, 0x1 };
+    std::vector<uint32_t> expected = { 0xF, 0x1, 0x1, 0x1, 0x1, 0x1, 0x1, 0x1, 0x1 };
+    CHECK(ScheduleFrames(scheduler, dirtyMasks) == expected);
+}
+
+TEST(CascadeUpdateSchedulerRefreshesWhenEnabled)
+{
+    // Only the first cascade moves, the others are refreshed in turn once they are old enough
+    CascadeUpdateScheduler scheduler(4);
+    scheduler.SetRefresh(true);
+    std::vector<uint32_t> expected = { 0xF, 0x1, 0x1, 0x3, 0x5, 0x9, 0x3, 0x5, 0x9 };
+    std::vector<uint32_t> dirtyMasks = { 0xF, 0x1, 0x1, 0x1, 0x1, 0x1, 0x1, 0x1, 0x1 };
+    CHECK(ScheduleFrames(scheduler, dirtyMasks) == expected);
+
+    // A static camera refreshes the farther cascades one per frame within the budget
+    CascadeUpdateScheduler staticScheduler(4);
+    staticScheduler.SetBudget(1);
+    staticScheduler.SetRefresh(true);
+    expected = { 0x3, 0x4, 0x8, 0x2, 0x4, 0x8, 0x2 };
+    CHECK(ScheduleFrames(staticScheduler, { 0xF, 0, 0, 0, 0, 0, 0 }) == expected);
+}
+
+TEST(CascadeUpdateSchedulerInterval)
+{
+    CascadeUpdateScheduler scheduler(4);
+    scheduler.SetBudget(2);
+    scheduler.SetInterval(2);
+    std::vector<uint32_t> expected = { 0x7, 0x9, 0x7, 0x9, 0x7, 0x9 };
+    CHECK(ScheduleFrames(scheduler, std::vector<uint32_t>(6, 0xF)) == expected);
+}
+
+TEST(CascadeUpdateSchedulerAges)
+{
+    CascadeUpdateScheduler scheduler(3);
+    scheduler.SetBudget(1);
+    CHECK(scheduler.GetAge(2) == UINT32_MAX);
+    scheduler.Schedule(0x7);
+    CHECK(scheduler.GetAge(0) == 0);
+    CHECK(scheduler.GetAge(1) == 0);
+    CHECK(scheduler.GetAge(2) == UINT32_MAX);
+    scheduler.Schedule(0x4);
+    CHECK(scheduler.GetAge(0) == 1);
+    CHECK(scheduler.GetAge(1) == 1);
+    CHECK(scheduler.GetAge(2) == 0);
+}
+
+// Random motion: the budget holds, moved cascades wait for their interval and nothing waits longer than a full turn.
+// Without refreshing only moved cascades are rendered and they wait a full turn at most after moving.
+TEST(CascadeUpdateSchedulerBounds)
+{
+    std::mt19937 random(9);
+    for (int refresh = 0; refresh < 2; ++refresh)
+    {
+        for (uint32_t cascadeCount = 1; cascadeCount <= 4; ++cascadeCount)
+        {
+            for (uint32_t budget = 0; budget <= 3; ++budget)
+            {
+                for (uint32_t interval = 1; interval <= 3; ++interval)
+                {
+                    CascadeUpdateScheduler scheduler(cascadeCount);
+                    scheduler.SetBudget(budget);
+                    scheduler.SetInterval(interval);
+                    scheduler.SetRefresh(refresh != 0);
+                    uint32_t allMask = (1u << cascadeCount) - 1;
+                    // Cascades start as if they were rendered long ago
+                    std::vector<int> lastFrames(cascadeCount, -1000);
+                    std::vector<int> movedFrames(cascadeCount, 0);
+                    int maxWait = static_cast<int>(interval * (cascadeCount - 1));
+                    // Like the renderer, cascades that moved stay dirty until they are rendered
+                    uint32_t dirtyMask = 0;
+                    for (int frame = 0; frame < 200; ++frame)
+                    {
+                        uint32_t moved = frame == 0 ? allMask : random() & allMask;
+                        for (uint32_t cascade = 0; cascade < cascadeCount; ++cascade)
+                        {
+                            if ((moved & ~dirtyMask) & (1u << cascade))
+                                movedFrames[cascade] = frame;
+                        }
+                        dirtyMask = (dirtyMask & ~1u) | moved;
+
+                        uint32_t scheduled = scheduler.Schedule(dirtyMask);
+                        CHECK((scheduled & ~allMask) == 0);
+                        CHECK((scheduled & 1) == (dirtyMask & 1));
+                        if (!refresh)
+                            CHECK((scheduled & ~dirtyMask) == 0);
+                        if (budget > 0)
+                            CHECK(CountBits(scheduled >> 1) <= budget);
+                        for (uint32_t cascade = 1; cascade < cascadeCount; ++cascade)
+                        {
+                            if (!(scheduled & (1u << cascade)))
+                                continue;
+                            CHECK(frame - lastFrames[cascade] >= static_cast<int>(interval));
+                            lastFrames[cascade] = frame;
+                        }
+                        dirtyMask &= ~scheduled;
+
+                        for (uint32_t cascade = 1; cascade < cascadeCount && frame >= maxWait; ++cascade)
+                        {
+                            if (refresh)
+                                CHECK(frame - lastFrames[cascade] <= maxWait);
+                            else if (dirtyMask & (1u << cascade))
+                                CHECK(frame - movedFrames[cascade] < maxWait);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
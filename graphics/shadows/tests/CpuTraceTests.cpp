@@ -0,0 +1,135 @@
+#include "Test.h"
+#include "../shadows/CpuTrace.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <sstream>
+
+#if CPU_TRACE_ENABLED
+
+namespace
+{
+    CpuTraceEvent MakeEvent(uint64_t begin)
+    {
+        return { "Event", begin, begin + 1, 0, 0, 0, CPU_TRACE_EVENT_TYPE::ZONE };
+    }
+
+    const CpuZoneSummary* FindZone(const char* name, uint32_t depth)
+    {
+        const std::vector<CpuZoneSummary>& zones = CpuTracer::Get().GetZoneSummary();
+        auto zone = std::find_if(zones.begin(), zones.end(), [&](const CpuZoneSummary& z) { return z.depth == depth && strcmp(z.name, name) == 0; });
+        return zone != zones.end() ? &*zone : nullptr;
+    }
+
+    void TraceWork(int innerCount)
+    {
+        CPU_TRACE_SCOPE("TestWork");
+        for (int i = 0; i < innerCount; ++i)
+        {
+            CPU_TRACE_SCOPE("TestInner");
+        }
+    }
+}
+
+TEST(CpuTraceBufferReadsInOrder)
+{
+    // Capacity rounds up to 8
+    CpuTraceBuffer buffer(5);
+    std::vector<CpuTraceEvent> events;
+    uint64_t lost = 0;
+    for (uint64_t i = 0; i < 6; ++i)
+        buffer.Push(MakeEvent(i));
+    uint64_t position = buffer.Read(0, events, lost);
+    CHECK(position == 6);
+    CHECK(lost == 0);
+    CHECK(events.size() == 6);
+    for (size_t i = 0; i < events.size(); ++i)
+        CHECK(events[i].begin == i);
+
+    // Only the latest capacity worth of events survive a wrap, the others are counted as lost
+    events.clear();
+    for (uint64_t i = 6; i < 26; ++i)
+        buffer.Push(MakeEvent(i));
+    position = buffer.Read(position, events, lost);
+    CHECK(position == 26);
+    CHECK(lost == 12);
+    CHECK(events.size() == 8);
+    if (!events.empty())
+        CHECK(events.front().begin == 18);
+
+    events.clear();
+    CHECK(buffer.Read(position, events, lost) == 26);
+    CHECK(events.empty());
+}
+
+TEST(CpuTraceSummarizesThreads)
+{
+    CpuTracer& tracer = CpuTracer::Get();
+    CPU_TRACE_END_FRAME();
+    uint64_t lost = tracer.GetLostEventCount();
+
+    for (int frame = 0; frame < 3; ++frame)
+    {
+        {
+            CPU_TRACE_SCOPE("TestFrame");
+            CPU_TRACE_COUNTER("TestCounter", frame * 10);
+            std::vector<std::future<void>> tasks;
+            for (int i = 0; i < 3; ++i)
+                tasks.push_back(std::async(std::launch::async, TraceWork, 100));
+            TraceWork(100);
+            for (std::future<void>& task : tasks)
+                task.get();
+        }
+        CPU_TRACE_END_FRAME();
+
+        // Calls of all threads are summed per name and nesting level
+        const CpuZoneSummary* frameZone = FindZone("TestFrame", 0);
+        const CpuZoneSummary* work = FindZone("TestWork", 1);
+        const CpuZoneSummary* threadWork = FindZone("TestWork", 0);
+        const CpuZoneSummary* inner = FindZone("TestInner", 2);
+        CHECK(frameZone && frameZone->calls == 1);
+        CHECK(work && work->calls == 1);
+        CHECK(threadWork && threadWork->calls == 3);
+        CHECK(FindZone("TestInner", 1) && FindZone("TestInner", 1)->calls == 300);
+        CHECK(inner && inner->calls == 100);
+        if (frameZone && work)
+            CHECK(frameZone->last >= work->last);
+    }
+
+    const std::vector<CpuCounterSummary>& counters = tracer.GetCounterSummary();
+    auto counter = std::find_if(counters.begin(), counters.end(), [](const CpuCounterSummary& c) { return strcmp(c.name, "TestCounter") == 0; });
+    CHECK(counter != counters.end() && counter->value == 20);
+    CHECK(tracer.GetLostEventCount() == lost);
+
+    // A frame without the zones keeps them with no calls
+    CPU_TRACE_END_FRAME();
+    const CpuZoneSummary* frameZone = FindZone("TestFrame", 0);
+    CHECK(frameZone && frameZone->calls == 0 && frameZone->idleFrames == 1);
+}
+
+TEST(CpuTraceChromeTrace)
+{
+    CpuTracer& tracer = CpuTracer::Get();
+    tracer.StartCapture();
+    CPU_TRACE_THREAD_NAME("Test \"main\"");
+    {
+        CPU_TRACE_SCOPE("TestCaptured");
+    }
+    CPU_TRACE_END_FRAME();
+    tracer.StopCapture();
+
+    std::string path = GetTemporaryDirectory() + "shadows_tests_trace.json";
+    CHECK(tracer.WriteChromeTrace(path));
+    std::ifstream file(path);
+    std::stringstream stream;
+    stream << file.rdbuf();
+    std::string trace = stream.str();
+    CHECK(trace.find("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[") == 0);
+    CHECK(trace.find("\"name\":\"TestCaptured\"") != std::string::npos);
+    CHECK(trace.find("Test \\\"main\\\"") != std::string::npos);
+    CHECK(trace.find_last_not_of(" \n") != std::string::npos && trace[trace.find_last_not_of(" \n")] == '}');
+}
+
+#endif
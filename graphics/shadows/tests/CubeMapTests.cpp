@@ -0,0 +1,173 @@
+#include "Test.h"
+#include "TestEnvironment.h"
+
+#include <cmath>
+
+namespace
+{
+    double CornerSolidAngle(double x, double y)
+    {
+        return std::atan2(x * y, std::sqrt(x * x + y * y + 1.0));
+    }
+
+    double TexelSolidAngle(uint32_t x, uint32_t y, uint32_t size)
+    {
+        double x0 = 2.0 * x / size - 1.0;
+        double x1 = 2.0 * (x + 1) / size - 1.0;
+        double y0 = 2.0 * y / size - 1.0;
+        double y1 = 2.0 * (y + 1) / size - 1.0;
+        return CornerSolidAngle(x0, y0) - CornerSolidAngle(x0, y1) - CornerSolidAngle(x1, y0) + CornerSolidAngle(x1, y1);
+    }
+
+    // Every texel of every mip holds its own direction
+    void FillDirections(CubeMap& cube)
+    {
+        for (uint32_t mip = 0; mip < cube.GetMipLevels(); ++mip)
+        {
+            uint32_t size = cube.GetSize(mip);
+            for (uint32_t face = 0; face < 6; ++face)
+            {
+                for (uint32_t y = 0; y < size; ++y)
+                {
+                    for (uint32_t x = 0; x < size; ++x)
+                    {
+                        float* texel = cube.GetFace(face, mip) + (y * size + x) * 4;
+                        CubeTexelDirection(face, x, y, size, texel);
+                        texel[3] = 1.0f;
+                    }
+                }
+            }
+        }
+    }
+}
+
+TEST(CubeMapSampleTexelCenters)
+{
+    CubeMap cube;
+    cube.Resize(16, 5);
+    FillDirections(cube);
+    for (uint32_t mip = 0; mip < 5; ++mip)
+    {
+        uint32_t size = cube.GetSize(mip);
+        for (uint32_t face = 0; face < 6; ++face)
+        {
+            for (uint32_t y = 0; y < size; ++y)
+            {
+                for (uint32_t x = 0; x < size; ++x)
+                {
+                    float direction[3];
+                    CubeTexelDirection(face, x, y, size, direction);
+                    float color[4];
+                    SampleCube(cube, direction, mip, color);
+                    const float* texel = cube.GetFace(face, mip) + (y * size + x) * 4;
+                    for (int i = 0; i < 3; ++i)
+                        CHECK_NEAR(color[i], texel[i], 1e-5f);
+                }
+            }
+        }
+    }
+}
+
+TEST(CubeMapSampleAcrossSeams)
+{
+    // Bilinear filtering continues across the edges into the neighbouring faces, so the two sides of an edge agree
+    CubeMap cube;
+    cube.Resize(16, 5);
+    FillDirections(cube);
+    const float offset = 1e-3f;
+    for (uint32_t mip = 0; mip < 5; ++mip)
+    {
+        float maxJump = 0.0f;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            int axis1 = (axis + 1) % 3;
+            int axis2 = (axis + 2) % 3;
+            for (int sign1 = -1; sign1 <= 1; sign1 += 2)
+            {
+                for (int sign2 = -1; sign2 <= 1; sign2 += 2)
+                {
+                    // Points along the edge between the faces of axis1 and axis2, the corners included
+                    for (int i = 0; i <= 64; ++i)
+                    {
+                        float edge[3];
+                        edge[axis] = -1.0f + i / 32.0f;
+                        edge[axis1] = static_cast<float>(sign1);
+                        edge[axis2] = static_cast<float>(sign2);
+                        float inside1[3] = { edge[0], edge[1], edge[2] };
+                        float inside2[3] = { edge[0], edge[1], edge[2] };
+                        inside1[axis1] *= 1.0f - offset;
+                        inside2[axis2] *= 1.0f - offset;
+                        float color1[4];
+                        float color2[4];
+                        SampleCube(cube, inside1, mip, color1);
+                        SampleCube(cube, inside2, mip, color2);
+                        for (int k = 0; k < 3; ++k)
+                            maxJump = std::fmax(maxJump, std::fabs(color1[k] - color2[k]));
+                    }
+                }
+            }
+        }
+        // What is left is the gradient over the offset, a clamped edge jumps by about a texel
+        CHECK(maxJump < 0.005f);
+    }
+}
+
+TEST(CubeMapEquirectToCube)
+{
+    CubeMap cube;
+    EquirectToCube(MakeTestEnvironment(256, 128), 32, cube);
+    CHECK(cube.GetSize() == 32);
+    CHECK(cube.GetMipLevels() == 6);
+
+    // The top level follows the environment
+    double sumError = 0.0;
+    for (uint32_t face = 0; face < 6; ++face)
+    {
+        for (uint32_t y = 0; y < 32; ++y)
+        {
+            for (uint32_t x = 0; x < 32; ++x)
+            {
+                float direction[3];
+                CubeTexelDirection(face, x, y, 32, direction);
+                float color[3];
+                EvaluateTestEnvironment(direction, color);
+                const float* texel = cube.GetFace(face, 0) + (y * 32 + x) * 4;
+                for (int i = 0; i < 3; ++i)
+                    sumError += std::fabs(texel[i] - color[i]);
+            }
+        }
+    }
+    CHECK(sumError / (6 * 32 * 32 * 3) < 0.02);
+
+    // Every level keeps the radiance integrated over the sphere
+    double total[6][3] = {};
+    for (uint32_t mip = 0; mip < 6; ++mip)
+    {
+        uint32_t size = cube.GetSize(mip);
+        for (uint32_t face = 0; face < 6; ++face)
+        {
+            for (uint32_t y = 0; y < size; ++y)
+            {
+                for (uint32_t x = 0; x < size; ++x)
+                {
+                    double solidAngle = TexelSolidAngle(x, y, size);
+                    const float* texel = cube.GetFace(face, mip) + (y * size + x) * 4;
+                    for (int i = 0; i < 3; ++i)
+                        total[mip][i] += texel[i] * solidAngle;
+                }
+            }
+        }
+        for (int i = 0; i < 3; ++i)
+            CHECK_NEAR(total[mip][i], total[0][i], 1e-4 * total[0][i]);
+    }
+}
+
+TEST(CubeMapEquirectToCubeDoesNotDependOnThreadCount)
+{
+    EnvironmentImage image = MakeTestEnvironment(256, 128);
+    CubeMap single;
+    CubeMap parallel;
+    EquirectToCube(image, 32, single, 1);
+    EquirectToCube(image, 32, parallel, 4);
+    CHECK(single.GetData() == parallel.GetData());
+}
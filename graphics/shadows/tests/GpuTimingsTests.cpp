@@ -0,0 +1,92 @@
+#include "Test.h"
+#include "../shadows/GpuTimings.h"
+
+#include <sstream>
+
+TEST(GpuTimingsQueryRing)
+{
+    QueryRing ring(3);
+    CHECK(ring.CanBegin());
+    CHECK(!ring.HasPending());
+    CHECK(ring.Begin() == 0);
+    CHECK(ring.Begin() == 1);
+    CHECK(ring.Begin() == 2);
+    CHECK(!ring.CanBegin());
+    CHECK(ring.GetPendingCount() == 3);
+
+    // Results come back oldest first, freed slots are reused in turn
+    CHECK(ring.GetOldest() == 0);
+    ring.Complete();
+    CHECK(ring.GetOldest() == 1);
+    CHECK(ring.CanBegin());
+    CHECK(ring.Begin() == 0);
+    ring.Complete();
+    CHECK(ring.GetOldest() == 2);
+    ring.Complete();
+    CHECK(ring.GetOldest() == 0);
+    ring.Complete();
+    CHECK(!ring.HasPending());
+}
+
+TEST(GpuTimingsTimestamps)
+{
+    CHECK_NEAR(TimestampsToMilliseconds(1000, 3000, 1000000), 2.0f, 1e-6f);
+    CHECK(TimestampsToMilliseconds(5, 4, 100) < 0.0f);
+    // Large counter values don't lose the difference
+    CHECK_NEAR(TimestampsToMilliseconds(0xFFFFFFFF00000000ull, 0xFFFFFFFF00000000ull + 3000000, 1000000000), 3.0f, 1e-5f);
+}
+
+TEST(GpuTimingsStats)
+{
+    PassTimingStats stats(2, 0.5f, 4);
+    const float first[2] = { 2.0f, -1.0f };
+    stats.AddFrame(first);
+    CHECK(stats.GetAverage(0) == 2.0f);
+    CHECK(stats.GetAverage(1) == 0.0f);
+
+    // The first time of a pass starts its average, the next ones are blended in
+    const float second[2] = { 4.0f, 1.0f };
+    stats.AddFrame(second);
+    CHECK(stats.GetAverage(0) == 3.0f);
+    CHECK(stats.GetAverage(1) == 1.0f);
+    CHECK(stats.GetLast(0) == 4.0f);
+    CHECK(stats.GetMin(0) == 2.0f);
+    CHECK(stats.GetMax(0) == 4.0f);
+    CHECK(stats.GetMin(1) == 1.0f);
+    CHECK(stats.GetMax(1) == 1.0f);
+    CHECK(stats.GetTotal() == 4.0f);
+
+    // The window drops the older frames, a pass that didn't run in it has no range
+    const float later[2] = { 1.0f, -1.0f };
+    for (int i = 0; i < 4; ++i)
+        stats.AddFrame(later);
+    CHECK(stats.GetMin(0) == 1.0f);
+    CHECK(stats.GetMax(0) == 1.0f);
+    CHECK(stats.GetMin(1) == 0.0f);
+    CHECK(stats.GetMax(1) == 0.0f);
+    CHECK(stats.GetFrameCount() == 6);
+
+    stats.Reset(3);
+    CHECK(stats.GetPassCount() == 3);
+    CHECK(stats.GetAverage(2) == 0.0f);
+}
+
+TEST(GpuTimingsLog)
+{
+    std::string path = GetTemporaryDirectory() + "shadows_tests_timings.csv";
+    PassTimingLog log;
+    const char* names[2] = { "shadows", "scene" };
+    CHECK(log.Open(path, names, 2));
+    CHECK(log.IsOpen());
+    const float first[2] = { 2.0f, -1.0f };
+    const float second[2] = { 4.0f, 1.5f };
+    log.Write(7, first);
+    log.Write(8, second);
+    log.Close();
+    CHECK(!log.IsOpen());
+
+    std::ifstream file(path);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    CHECK(contents.str() == "frame,shadows,scene\n7,2,\n8,4,1.5\n");
+}
@@ -0,0 +1,259 @@
+#include "Test.h"
+#include "../shadows/HdrPacking.h"
+
+#include <cmath>
+#include <random>
+
+namespace
+{
+    bool IsHalfFinite(uint32_t bits)
+    {
+        return ((bits >> 10) & 31u) != 31u;
+    }
+
+    // The code of one channel of a R11G11B10 value, 11 bits for red and green and 10 for blue
+    uint32_t GetSmallFloatCode(uint32_t bits, int channel)
+    {
+        return channel == 2 ? bits >> 22 : (bits >> (channel * 11)) & 0x7FFu;
+    }
+
+    uint32_t SetSmallFloatCode(uint32_t code, int channel)
+    {
+        return code << (channel * 11);
+    }
+}
+
+TEST(HdrPackingHalfRoundTrip)
+{
+    for (uint32_t bits = 0; bits < 0x10000; ++bits)
+    {
+        if (!IsHalfFinite(bits) || bits == 0x8000)
+            continue;
+        CHECK(PackHalf(UnpackHalf(bits)) == bits);
+    }
+    CHECK(UnpackHalf(0x3C00) == 1.0f);
+    CHECK(UnpackHalf(0x7BFF) == 65504.0f);
+    CHECK(UnpackHalf(0x0001) == std::ldexp(1.0f, -24));
+}
+
+TEST(HdrPackingHalfRounding)
+{
+    // Random floats over the whole range go to the nearest half
+    std::mt19937 random(3);
+    std::uniform_real_distribution<float> mantissa(1.0f, 2.0f);
+    std::uniform_int_distribution<int> exponent(-26, 15);
+    for (int i = 0; i < 100000; ++i)
+    {
+        float value = std::ldexp(mantissa(random), exponent(random));
+        uint16_t bits = PackHalf(value);
+        float error = std::fabs(UnpackHalf(bits) - value);
+        if (bits > 0)
+            CHECK(std::fabs(UnpackHalf(bits - 1) - value) >= error);
+        if (bits < 0x7BFF)
+            CHECK(std::fabs(UnpackHalf(bits + 1) - value) >= error);
+    }
+
+    // Halfway between two halves goes to the even one
+    for (uint32_t bits = 0; bits < 0x7BFF; bits += 37)
+    {
+        float middle = 0.5f * (UnpackHalf(bits) + UnpackHalf(bits + 1));
+        CHECK(PackHalf(middle) == ((bits & 1) ? bits + 1 : bits));
+        CHECK(PackHalf(-middle) == (((bits & 1) ? bits + 1 : bits) | 0x8000));
+    }
+
+    // Saturation and NaN
+    CHECK(PackHalf(1e6f) == 0x7BFF);
+    CHECK(PackHalf(-1e6f) == 0xFBFF);
+    CHECK(PackHalf(INFINITY) == 0x7BFF);
+    CHECK(PackHalf(NAN) == 0);
+}
+
+TEST(HdrPackingR11G11B10)
+{
+    // Every finite code of every channel round trips
+    for (int channel = 0; channel < 3; ++channel)
+    {
+        uint32_t codeCount = channel == 2 ? 31u << 5 : 31u << 6;
+        for (uint32_t code = 0; code < codeCount; ++code)
+        {
+            float rgb[3];
+            UnpackR11G11B10(SetSmallFloatCode(code, channel), rgb);
+            CHECK(GetSmallFloatCode(PackR11G11B10(rgb), channel) == code);
+        }
+    }
+
+    // Random values go to the nearest code
+    std::mt19937 random(5);
+    std::uniform_real_distribution<float> mantissa(1.0f, 2.0f);
+    std::uniform_int_distribution<int> exponent(-16, 15);
+    for (int i = 0; i < 100000; ++i)
+    {
+        float rgb[3] = { std::ldexp(mantissa(random), exponent(random)), std::ldexp(mantissa(random), exponent(random)),
+            std::ldexp(mantissa(random), exponent(random)) };
+        uint32_t bits = PackR11G11B10(rgb);
+        float packed[3];
+        UnpackR11G11B10(bits, packed);
+        for (int channel = 0; channel < 3; ++channel)
+        {
+            uint32_t code = GetSmallFloatCode(bits, channel);
+            float error = std::fabs(packed[channel] - rgb[channel]);
+            uint32_t neighbours[2] = { code - 1, code + 1 };
+            for (uint32_t neighbour : neighbours)
+            {
+                uint32_t maxCode = channel == 2 ? (31u << 5) - 1 : (31u << 6) - 1;
+                if (neighbour > maxCode)
+                    continue;
+                float other[3];
+                UnpackR11G11B10(SetSmallFloatCode(neighbour, channel), other);
+                CHECK(std::fabs(other[channel] - rgb[channel]) >= error);
+            }
+        }
+    }
+
+    // Negatives and NaNs are 0, large values saturate
+    float negative[3] = { -1.0f, -2.0f, -3.0f };
+    float nan[3] = { NAN, NAN, NAN };
+    float large[3] = { 1e9f, 1e9f, 1e9f };
+    CHECK(PackR11G11B10(negative) == 0);
+    CHECK(PackR11G11B10(nan) == 0);
+    float saturated[3];
+    UnpackR11G11B10(PackR11G11B10(large), saturated);
+    CHECK(saturated[0] == 65024.0f);
+    CHECK(saturated[1] == 65024.0f);
+    CHECK(saturated[2] == 64512.0f);
+}
+
+TEST(HdrPackingRGB9E5)
+{
+    // Values with a normalized largest channel round trip
+    for (uint32_t exponent = 1; exponent < 32; ++exponent)
+    {
+        for (uint32_t mantissa = 256; mantissa < 512; mantissa += 7)
+        {
+            uint32_t bits = (exponent << 27) | ((mantissa / 3) << 18) | ((mantissa / 2) << 9) | mantissa;
+            float rgb[3];
+            UnpackRGB9E5(bits, rgb);
+            CHECK(PackRGB9E5(rgb) == bits);
+        }
+    }
+
+    // Each channel is within half a step of the shared exponent, the largest one within 2^-9 of its value
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> mantissa(0.0f, 2.0f);
+    std::uniform_int_distribution<int> exponent(-12, 14);
+    std::uniform_int_distribution<int> spread(0, 3);
+    for (int i = 0; i < 100000; ++i)
+    {
+        int sharedExponent = exponent(random);
+        float rgb[3];
+        for (float& value : rgb)
+            value = std::ldexp(mantissa(random), sharedExponent - spread(random));
+        uint32_t bits = PackRGB9E5(rgb);
+        float packed[3];
+        UnpackRGB9E5(bits, packed);
+        float step = std::ldexp(1.0f, static_cast<int>(bits >> 27) - 24);
+        float largest = 0.0f;
+        float largestPacked = 0.0f;
+        for (int channel = 0; channel < 3; ++channel)
+        {
+            CHECK(std::fabs(packed[channel] - rgb[channel]) <= 0.5f * step);
+            largest = rgb[channel] > largest ? rgb[channel] : largest;
+            largestPacked = packed[channel] > largestPacked ? packed[channel] : largestPacked;
+        }
+        // Below 2^-15 the largest channel is denormal and has fewer bits
+        if (largest >= std::ldexp(1.0f, -15))
+            CHECK(std::fabs(largestPacked - largest) <= std::ldexp(largest, -9));
+    }
+
+    float negative[3] = { -1.0f, 0.0f, 0.0f };
+    CHECK(PackRGB9E5(negative) == 0);
+}
+
+TEST(HdrPackingBC6H)
+{
+    // A constant block keeps its color to the precision of the 10-bit endpoints
+    float texels[16 * 4];
+    for (int i = 0; i < 16; ++i)
+    {
+        texels[i * 4] = 1.0f;
+        texels[i * 4 + 1] = 0.5f;
+        texels[i * 4 + 2] = 0.25f;
+        texels[i * 4 + 3] = 1.0f;
+    }
+    uint8_t block[16];
+    CompressBC6HBlock(texels, block);
+    float decoded[16 * 4];
+    DecompressBC6HBlock(block, decoded);
+    for (int i = 0; i < 16; ++i)
+    {
+        CHECK_NEAR(decoded[i * 4], 1.0f, 1e-2f);
+        CHECK_NEAR(decoded[i * 4 + 1], 0.5f, 5e-3f);
+        CHECK_NEAR(decoded[i * 4 + 2], 0.25f, 3e-3f);
+        CHECK(decoded[i * 4 + 3] == 1.0f);
+    }
+
+    // Two colors are the endpoints of the line
+    for (int i = 0; i < 16; ++i)
+    {
+        float value = (i % 2) ? 4.0f : 0.5f;
+        texels[i * 4] = value;
+        texels[i * 4 + 1] = value;
+        texels[i * 4 + 2] = value;
+    }
+    CompressBC6HBlock(texels, block);
+    DecompressBC6HBlock(block, decoded);
+    for (int i = 0; i < 16; ++i)
+    {
+        for (int channel = 0; channel < 3; ++channel)
+            CHECK(std::fabs(decoded[i * 4 + channel] - texels[i * 4 + channel]) < 0.02f * texels[i * 4 + channel]);
+    }
+
+    // Blocks of other modes decode to black
+    uint8_t otherMode[16] = { 0x00 };
+    DecompressBC6HBlock(otherMode, decoded);
+    CHECK(decoded[0] == 0.0f && decoded[1] == 0.0f && decoded[2] == 0.0f);
+}
+
+TEST(HdrPackingImages)
+{
+    // A 6x5 image doesn't fill the last BC6H blocks
+    const uint32_t width = 6;
+    const uint32_t height = 5;
+    std::vector<float> rgba(width * height * 4);
+    for (uint32_t i = 0; i < width * height; ++i)
+    {
+        rgba[i * 4] = 0.25f + i * 0.125f;
+        rgba[i * 4 + 1] = 1.0f;
+        rgba[i * 4 + 2] = 0.5f;
+        rgba[i * 4 + 3] = 1.0f;
+    }
+
+    const uint32_t pitches[] = { 96, 48, 24, 24, 24, 12, 32 };
+    for (uint32_t format = 0; format < static_cast<uint32_t>(HDR_TEXEL_FORMAT::COUNT); ++format)
+    {
+        HDR_TEXEL_FORMAT texelFormat = static_cast<HDR_TEXEL_FORMAT>(format);
+        CHECK(GetHdrTexelFormatName(texelFormat) != nullptr);
+        CHECK(GetHdrRowPitch(texelFormat, width) == pitches[format]);
+        CHECK(GetHdrRowCount(texelFormat, height) == (texelFormat == HDR_TEXEL_FORMAT::BC6H_UF16 ? 2u : height));
+
+        std::vector<uint8_t> data;
+        PackHdrImage(texelFormat, rgba.data(), width, height, data);
+        CHECK(data.size() == GetHdrRowPitch(texelFormat, width) * GetHdrRowCount(texelFormat, height));
+        std::vector<float> unpacked;
+        UnpackHdrImage(texelFormat, data.data(), width, height, unpacked);
+        CHECK(unpacked.size() == rgba.size());
+        if (unpacked.size() != rgba.size())
+            continue;
+
+        bool singleChannel = texelFormat == HDR_TEXEL_FORMAT::R32_FLOAT || texelFormat == HDR_TEXEL_FORMAT::R16_FLOAT;
+        float tolerance = texelFormat == HDR_TEXEL_FORMAT::R32G32B32A32_FLOAT || texelFormat == HDR_TEXEL_FORMAT::R32_FLOAT ? 0.0f
+            : (texelFormat == HDR_TEXEL_FORMAT::BC6H_UF16 ? 0.25f : 0.02f);
+        for (uint32_t i = 0; i < width * height; ++i)
+        {
+            CHECK_NEAR(unpacked[i * 4], rgba[i * 4], tolerance * rgba[i * 4]);
+            CHECK_NEAR(unpacked[i * 4 + 1], singleChannel ? 0.0f : 1.0f, tolerance);
+            CHECK_NEAR(unpacked[i * 4 + 2], singleChannel ? 0.0f : 0.5f, tolerance);
+            CHECK(unpacked[i * 4 + 3] == 1.0f);
+        }
+    }
+}
@@ -0,0 +1,121 @@
+#include "Test.h"
+#include "TestEnvironment.h"
+#include "../shadows/CacheFile.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+namespace
+{
+    IBLBakeSettings SmallSettings()
+    {
+        IBLBakeSettings settings;
+        settings.cubeSize = 32;
+        settings.prefilteredSize = 16;
+        settings.prefilteredLevels = 3;
+        settings.prefilteredMinSamples = 32;
+        settings.prefilteredMaxSamples = 64;
+        return settings;
+    }
+
+    std::string ReadFile(const std::string& path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    }
+}
+
+TEST(CacheFileWritesChunks)
+{
+    std::string directory = CreateCacheDirectory(GetTemporaryDirectory() + "shadows_tests_cache_files");
+    CHECK(directory.back() == '/' || directory.back() == '\\');
+    // An existing directory is fine
+    CHECK(CreateCacheDirectory(directory) == directory);
+
+    std::string path = directory + "chunks.bin";
+    const char header[] = "HEAD";
+    const char body[] = "body";
+    const CacheFileChunk chunks[] = { { header, 4 }, { body, 4 }, { nullptr, 0 } };
+    CHECK(WriteCacheFile(path, chunks, 3));
+    CHECK(ReadFile(path) == "HEADbody");
+
+    // A shorter file replaces the longer one completely
+    CHECK(WriteCacheFile(path, chunks + 1, 1));
+    CHECK(ReadFile(path) == "body");
+
+    CHECK(!WriteCacheFile(directory + "missing/chunks.bin", chunks, 1));
+}
+
+TEST(IBLBakeCacheRoundTrip)
+{
+    IBLBakeSettings settings = SmallSettings();
+    CubeMap environment;
+    EquirectToCube(MakeTestEnvironment(128, 64), settings.cubeSize, environment);
+    IBLBakeResult result;
+    BakeIBL(environment, settings, result);
+
+    const char contents[] = "environment file";
+    uint64_t key = ComputeIBLBakeKey(contents, sizeof(contents), settings);
+    IBLBakeCache cache(GetTemporaryDirectory() + "shadows_tests_ibl_cache");
+    remove(cache.GetPath(key).c_str());
+
+    IBLBakeResult loaded;
+    CHECK(!cache.Load(key, settings, loaded));
+    CHECK(cache.Store(key, settings, result));
+    CHECK(cache.Load(key, settings, loaded));
+    CHECK(memcmp(&loaded.irradiance, &result.irradiance, sizeof(result.irradiance)) == 0);
+    CHECK(loaded.prefilteredColor.GetMipLevels() == result.prefilteredColor.GetMipLevels());
+    CHECK(loaded.prefilteredColor.GetSize() == result.prefilteredColor.GetSize());
+    CHECK(loaded.prefilteredColor.GetData() == result.prefilteredColor.GetData());
+
+    // Other settings with the same key are a miss, as is a truncated file
+    IBLBakeSettings otherSettings = settings;
+    otherSettings.prefilteredMinSamples = 16;
+    CHECK(!cache.Load(key, otherSettings, loaded));
+    std::string file = ReadFile(cache.GetPath(key));
+    std::ofstream(cache.GetPath(key), std::ios::binary | std::ios::trunc) << file.substr(0, file.size() / 2);
+    CHECK(!cache.Load(key, settings, loaded));
+}
+
+TEST(IBLBakeCacheKeys)
+{
+    IBLBakeSettings settings = SmallSettings();
+    const char contents[] = "environment file";
+    uint64_t key = ComputeIBLBakeKey(contents, sizeof(contents), settings);
+    CHECK(ComputeIBLBakeKey(contents, sizeof(contents), settings) == key);
+    CHECK(ComputeIBLBakeKey(contents, sizeof(contents) - 1, settings) != key);
+    const char otherContents[] = "environment filf";
+    CHECK(ComputeIBLBakeKey(otherContents, sizeof(otherContents), settings) != key);
+    IBLBakeSettings otherSettings = settings;
+    ++otherSettings.prefilteredMaxSamples;
+    CHECK(ComputeIBLBakeKey(contents, sizeof(contents), otherSettings) != key);
+}
+
+TEST(IBLBakeCacheBRDF)
+{
+    PreintegratedBRDFSettings settings;
+    settings.size = 16;
+    settings.sampleCount = 64;
+    std::vector<uint16_t> lut;
+    BakePreintegratedBRDF(settings, lut);
+    CHECK(lut.size() == 16 * 16 * 2);
+
+    IBLBakeCache cache(GetTemporaryDirectory() + "shadows_tests_ibl_cache");
+    CHECK(cache.Store(settings, lut));
+    std::vector<uint16_t> loaded;
+    CHECK(cache.Load(settings, loaded));
+    CHECK(loaded == lut);
+
+    // Tables of other settings are kept next to it
+    PreintegratedBRDFSettings otherSettings = settings;
+    otherSettings.sampleCount = 128;
+    std::vector<uint16_t> otherLut;
+    BakePreintegratedBRDF(otherSettings, otherLut);
+    CHECK(cache.Store(otherSettings, otherLut));
+    CHECK(cache.Load(settings, loaded));
+    CHECK(loaded == lut);
+    CHECK(cache.Load(otherSettings, loaded));
+    CHECK(loaded == otherLut);
+}
@@ -0,0 +1,131 @@
+#include "Test.h"
+#include "TestEnvironment.h"
+#include "../shadows/IBLBakeScheduler.h"
+
+#include <cstring>
+
+namespace
+{
+    IBLBakeSettings SmallSettings()
+    {
+        IBLBakeSettings settings;
+        settings.cubeSize = 32;
+        settings.prefilteredSize = 16;
+        settings.prefilteredLevels = 3;
+        settings.prefilteredMinSamples = 32;
+        settings.prefilteredMaxSamples = 64;
+        return settings;
+    }
+
+    // The bake the job splits into rows
+    void BakeAtOnce(const IBLBakeSettings& settings, CubeMap& environment, IBLBakeResult& result)
+    {
+        EquirectToCube(MakeTestEnvironment(128, 64), settings.cubeSize, environment);
+        BakeIBL(environment, settings, result);
+    }
+
+    bool IsSameBake(const CubeMap& environment, const IBLBakeResult& result, const CubeMap& otherEnvironment, const IBLBakeResult& otherResult)
+    {
+        return environment.GetData() == otherEnvironment.GetData() && result.prefilteredColor.GetData() == otherResult.prefilteredColor.GetData() &&
+            memcmp(&result.irradiance, &otherResult.irradiance, sizeof(result.irradiance)) == 0;
+    }
+}
+
+TEST(IBLBakeJobRowByRow)
+{
+    IBLBakeSettings settings = SmallSettings();
+    CubeMap environment;
+    IBLBakeResult result;
+    BakeAtOnce(settings, environment, result);
+
+    IBLBakeJob job;
+    CHECK(!job.IsRunning());
+    job.Start(MakeTestEnvironment(128, 64), settings);
+    float progress = 0.0f;
+    uint32_t rows = 0;
+    while (job.IsRunning())
+    {
+        CHECK(job.GetRowCost() > 0.0f);
+        CHECK(job.Run(1, 1) == 1);
+        CHECK(job.GetProgress() > progress);
+        progress = job.GetProgress();
+        ++rows;
+    }
+    CHECK(job.IsFinished());
+    CHECK(progress == 1.0f);
+    CHECK(rows > 6 * 32);
+
+    CubeMap jobEnvironment;
+    IBLBakeResult jobResult;
+    CHECK(job.TakeResult(jobEnvironment, jobResult));
+    CHECK(IsSameBake(environment, result, jobEnvironment, jobResult));
+    CHECK(!job.TakeResult(jobEnvironment, jobResult));
+}
+
+TEST(IBLBakeSchedulerBudget)
+{
+    // Simulated time that passes in proportion to the work done, 1000 milliseconds for the whole bake
+    const double bakeMs = 1000.0;
+    const float budget = 10.0f;
+    IBLBakeScheduler* pScheduler = nullptr;
+    IBLBakeScheduler scheduler(0, [&]() { return bakeMs * pScheduler->GetProgress(); });
+    pScheduler = &scheduler;
+    CHECK(!scheduler.Update(budget));
+
+    IBLBakeSettings settings = SmallSettings();
+    scheduler.Start(MakeTestEnvironment(128, 64), settings);
+    CHECK(scheduler.IsBaking());
+    double previous = 0.0;
+    bool finished = false;
+    while (!finished && scheduler.GetUpdateCount() < 1000)
+    {
+        finished = scheduler.Update(budget);
+        // Once a stage has been measured its rows are predicted exactly
+        double now = bakeMs * scheduler.GetProgress();
+        CHECK(now - previous <= budget * 1.001);
+        previous = now;
+    }
+    CHECK(finished);
+    CHECK(!scheduler.IsBaking());
+    // The roughest level has rows of more than half the budget, they run one per update
+    CHECK(scheduler.GetUpdateCount() >= bakeMs / budget);
+    CHECK(scheduler.GetUpdateCount() < 2 * bakeMs / budget);
+
+    CubeMap environment;
+    IBLBakeResult result;
+    BakeAtOnce(settings, environment, result);
+    CubeMap bakedEnvironment;
+    IBLBakeResult bakedResult;
+    CHECK(scheduler.TakeResult(bakedEnvironment, bakedResult));
+    CHECK(IsSameBake(environment, result, bakedEnvironment, bakedResult));
+}
+
+TEST(IBLBakeSchedulerFinishAndCancel)
+{
+    IBLBakeScheduler scheduler;
+    IBLBakeSettings settings = SmallSettings();
+
+    // A budget of 0 finishes in one update
+    scheduler.Start(MakeTestEnvironment(128, 64), settings);
+    CHECK(scheduler.Update(0.0f));
+    CHECK(scheduler.GetUpdateCount() == 1);
+    CHECK(scheduler.GetProgress() == 1.0f);
+
+    // A canceled bake has no result
+    scheduler.Start(MakeTestEnvironment(128, 64), settings);
+    scheduler.Update(0.01f);
+    scheduler.Cancel();
+    CHECK(!scheduler.IsBaking());
+    CHECK(!scheduler.Update(0.0f));
+    CubeMap environment;
+    IBLBakeResult result;
+    CHECK(!scheduler.TakeResult(environment, result));
+
+    // Starting again replaces the bake in progress
+    scheduler.Start(MakeTestEnvironment(128, 64), settings);
+    scheduler.Update(0.01f);
+    scheduler.Start(MakeTestEnvironment(128, 64), settings);
+    CHECK(scheduler.GetUpdateCount() == 0);
+    CHECK(scheduler.Update(0.0f));
+    CHECK(scheduler.TakeResult(environment, result));
+}
@@ -0,0 +1,144 @@
+#include "Test.h"
+#include "../shadows/IBLBaker.h"
+
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <random>
+
+namespace
+{
+    const double PI = 3.14159265358979323846;
+
+    double CornerSolidAngle(double x, double y)
+    {
+        return std::atan2(x * y, std::sqrt(x * x + y * y + 1.0));
+    }
+
+    // Irradiance over pi summed over every texel of the top mip with its exact solid angle
+    void IntegrateIrradiance(const CubeMap& environment, const float normal[3], double irradiance[3])
+    {
+        uint32_t size = environment.GetSize();
+        irradiance[0] = irradiance[1] = irradiance[2] = 0.0;
+        for (uint32_t face = 0; face < 6; ++face)
+        {
+            for (uint32_t y = 0; y < size; ++y)
+            {
+                for (uint32_t x = 0; x < size; ++x)
+                {
+                    float direction[3];
+                    CubeTexelDirection(face, x, y, size, direction);
+                    double cosine = normal[0] * direction[0] + normal[1] * direction[1] + normal[2] * direction[2];
+                    if (cosine <= 0.0)
+                        continue;
+                    double x0 = 2.0 * x / size - 1.0;
+                    double x1 = 2.0 * (x + 1) / size - 1.0;
+                    double y0 = 2.0 * y / size - 1.0;
+                    double y1 = 2.0 * (y + 1) / size - 1.0;
+                    double solidAngle = CornerSolidAngle(x0, y0) - CornerSolidAngle(x0, y1) - CornerSolidAngle(x1, y0) + CornerSolidAngle(x1, y1);
+                    const float* texel = environment.GetFace(face, 0) + (y * size + x) * 4;
+                    for (int i = 0; i < 3; ++i)
+                        irradiance[i] += texel[i] * cosine * solidAngle;
+                }
+            }
+        }
+        for (int i = 0; i < 3; ++i)
+            irradiance[i] /= PI;
+    }
+
+    void FillCube(uint32_t size, const std::function<float(const float*)>& radiance, CubeMap& cube)
+    {
+        cube.Resize(size, 1);
+        for (uint32_t face = 0; face < 6; ++face)
+        {
+            for (uint32_t y = 0; y < size; ++y)
+            {
+                for (uint32_t x = 0; x < size; ++x)
+                {
+                    float direction[3];
+                    CubeTexelDirection(face, x, y, size, direction);
+                    float value = radiance(direction);
+                    float* texel = cube.GetFace(face, 0) + (y * size + x) * 4;
+                    texel[0] = value;
+                    texel[1] = value * 0.5f;
+                    texel[2] = value * 0.25f;
+                    texel[3] = 1.0f;
+                }
+            }
+        }
+    }
+
+    // Largest error over random normals relative to the largest irradiance
+    double CompareWithIntegral(const CubeMap& environment, const IrradianceSH& irradiance)
+    {
+        std::mt19937 random(13);
+        std::normal_distribution<float> gaussian;
+        double maxError = 0.0;
+        double maxIrradiance = 0.0;
+        for (int i = 0; i < 40; ++i)
+        {
+            float normal[3] = { gaussian(random), gaussian(random), gaussian(random) };
+            float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+            for (float& value : normal)
+                value /= length;
+            double reference[3];
+            IntegrateIrradiance(environment, normal, reference);
+            float color[3];
+            EvaluateIrradianceSH(irradiance, normal, color);
+            for (int k = 0; k < 3; ++k)
+            {
+                maxError = std::fmax(maxError, std::fabs(color[k] - reference[k]));
+                maxIrradiance = std::fmax(maxIrradiance, reference[k]);
+            }
+        }
+        return maxError / maxIrradiance;
+    }
+}
+
+TEST(IrradianceSHConstantEnvironment)
+{
+    // A uniform radiance of 1 gives an irradiance of pi, 1 after the division
+    CubeMap environment;
+    FillCube(32, [](const float*) { return 1.0f; }, environment);
+    IrradianceSH irradiance;
+    ProjectIrradianceSH(environment, irradiance);
+    const float normals[3][3] = { { 1.0f, 0.0f, 0.0f }, { 0.0f, -1.0f, 0.0f }, { 0.6f, 0.0f, 0.8f } };
+    for (const float* normal : normals)
+    {
+        float color[3];
+        EvaluateIrradianceSH(irradiance, normal, color);
+        CHECK_NEAR(color[0], 1.0f, 1e-4f);
+        CHECK_NEAR(color[1], 0.5f, 1e-4f);
+        CHECK_NEAR(color[2], 0.25f, 1e-4f);
+    }
+}
+
+TEST(IrradianceSHMatchesIntegration)
+{
+    // Up to quadratic radiance lies in the first three bands and is projected exactly
+    CubeMap environment;
+    FillCube(32, [](const float* d) { return 2.0f + d[0] - 0.5f * d[1] + 0.3f * d[2]; }, environment);
+    IrradianceSH irradiance;
+    ProjectIrradianceSH(environment, irradiance);
+    CHECK(CompareWithIntegral(environment, irradiance) < 1e-3);
+
+    FillCube(32, [](const float* d) { return 3.0f + d[0] * d[1] + 0.5f * d[2] * d[2] - 0.4f * d[1] * d[2] + 0.2f * (d[0] * d[0] - d[1] * d[1]); }, environment);
+    ProjectIrradianceSH(environment, irradiance);
+    CHECK(CompareWithIntegral(environment, irradiance) < 1e-3);
+
+    // A sharp lobe has higher bands, the cosine lobe damps them to a few percent
+    FillCube(32, [](const float* d) { float c = d[0] * 0.6f + d[1] * 0.8f; return 0.5f + 10.0f * std::pow(c > 0.0f ? c : 0.0f, 16.0f); }, environment);
+    ProjectIrradianceSH(environment, irradiance);
+    CHECK(CompareWithIntegral(environment, irradiance) < 0.05);
+}
+
+TEST(IrradianceSHDoesNotDependOnThreadCount)
+{
+    CubeMap environment;
+    FillCube(48, [](const float* d) { return 1.0f + std::sin(5.0f * d[0]) * std::cos(3.0f * d[2]) + d[1]; }, environment);
+    IrradianceSH single;
+    IrradianceSH parallel;
+    ProjectIrradianceSH(environment, single, 1);
+    ProjectIrradianceSH(environment, parallel, 4);
+    CHECK(memcmp(&single, &parallel, sizeof(single)) == 0);
+}
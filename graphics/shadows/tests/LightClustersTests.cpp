@@ -0,0 +1,153 @@
+#include "Test.h"
+#include "../shadows/LightClusters.h"
+
+#include <algorithm>
+#include <random>
+
+namespace
+{
+    const LightClusterGrid grid = { 16, 9, 24, 1.0f, 10000.0f, 1.7777f, 1.0f };
+
+    std::vector<PointLight> RandomLights(std::mt19937& random, uint32_t count)
+    {
+        std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+        std::uniform_real_distribution<float> range(5.0f, 60.0f);
+        std::vector<PointLight> lights(count);
+        for (PointLight& light : lights)
+            light = { { position(random), position(random) * 0.3f, position(random) }, range(random), { 1.0f, 1.0f, 1.0f }, 1.0f };
+        return lights;
+    }
+
+    // Rotation around y and a translation
+    void MakeView(float angle, float view[4][4])
+    {
+        const float matrix[4][4] = {
+            { std::cos(angle), 0.0f, -std::sin(angle), 0.0f },
+            { 0.0f, 1.0f, 0.0f, 0.0f },
+            { std::sin(angle), 0.0f, std::cos(angle), 0.0f },
+            { 10.0f, -20.0f, 300.0f, 1.0f }
+        };
+        std::copy(&matrix[0][0], &matrix[0][0] + 16, &view[0][0]);
+    }
+
+    Float3 ToView(const Float3& p, const float view[4][4])
+    {
+        return {
+            p.x * view[0][0] + p.y * view[1][0] + p.z * view[2][0] + view[3][0],
+            p.x * view[0][1] + p.y * view[1][1] + p.z * view[2][1] + view[3][1],
+            p.x * view[0][2] + p.y * view[1][2] + p.z * view[2][2] + view[3][2]
+        };
+    }
+
+    std::vector<uint32_t> GetClusterLights(const LightClusterBuilder& builder, uint32_t cluster)
+    {
+        const LightClusterRange& range = builder.GetClusters()[cluster];
+        const std::vector<uint32_t>& indices = builder.GetIndices();
+        return std::vector<uint32_t>(indices.begin() + range.offset, indices.begin() + range.offset + range.count);
+    }
+}
+
+// Every cluster lists exactly the lights the per cluster test accepts, in their order, for any number of threads
+TEST(LightClustersMatchBruteForce)
+{
+    std::mt19937 random(11);
+    LightClusterBuilder builder;
+    builder.SetGrid(grid);
+    float view[4][4];
+    MakeView(0.3f, view);
+    const uint32_t lightCounts[] = { 0, 1, 100, 3000 };
+    const unsigned int threadCounts[] = { 1, 4, 0 };
+    for (uint32_t lightCount : lightCounts)
+    {
+        std::vector<PointLight> lights = RandomLights(random, lightCount);
+        std::vector<uint32_t> firstIndices;
+        for (unsigned int threadCount : threadCounts)
+        {
+            builder.Build(lights.data(), lightCount, view, threadCount);
+            if (threadCount == threadCounts[0])
+                firstIndices = builder.GetIndices();
+            CHECK(builder.GetIndices() == firstIndices);
+
+            for (uint32_t slice = 0; slice < grid.slices; ++slice)
+            {
+                for (uint32_t y = 0; y < grid.tilesY; ++y)
+                {
+                    for (uint32_t x = 0; x < grid.tilesX; ++x)
+                    {
+                        std::vector<uint32_t> expected;
+                        for (uint32_t i = 0; i < lightCount; ++i)
+                            if (builder.IsLightInCluster(ToView(lights[i].position, view), lights[i].range, x, y, slice))
+                                expected.push_back(i);
+                        CHECK(GetClusterLights(builder, (slice * grid.tilesY + y) * grid.tilesX + x) == expected);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Points inside of a light sphere land in clusters that list the light
+TEST(LightClustersAreConservative)
+{
+    std::mt19937 random(12);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    LightClusterBuilder builder;
+    builder.SetGrid(grid);
+    float view[4][4];
+    MakeView(-0.7f, view);
+    std::vector<PointLight> lights = RandomLights(random, 500);
+    builder.Build(lights.data(), static_cast<uint32_t>(lights.size()), view, 1);
+
+    for (uint32_t i = 0; i < lights.size(); ++i)
+    {
+        Float3 center = ToView(lights[i].position, view);
+        for (int sample = 0; sample < 200; ++sample)
+        {
+            Float3 offset = { unit(random), unit(random), unit(random) };
+            if (offset.x * offset.x + offset.y * offset.y + offset.z * offset.z > 1.0f)
+                continue;
+            float range = lights[i].range;
+            Float3 p = { center.x + offset.x * range, center.y + offset.y * range, center.z + offset.z * range };
+            if (p.z <= 0.0f || p.z >= grid.farDistance)
+                continue;
+
+            // Tile (0, 0) is the top left one
+            float u = (p.x / (p.z * grid.tanHalfFovX) + 1.0f) * 0.5f;
+            float v = (1.0f - p.y / (p.z * grid.tanHalfFovY)) * 0.5f;
+            if (u < 0.0f || u >= 1.0f || v < 0.0f || v >= 1.0f)
+                continue;
+            uint32_t x = static_cast<uint32_t>(u * grid.tilesX);
+            uint32_t y = static_cast<uint32_t>(v * grid.tilesY);
+            uint32_t slice = 0;
+            while (slice + 1 < grid.slices && p.z >= builder.GetSliceDepth(slice + 1))
+                ++slice;
+
+            std::vector<uint32_t> clusterLights = GetClusterLights(builder, (slice * grid.tilesY + y) * grid.tilesX + x);
+            CHECK(std::find(clusterLights.begin(), clusterLights.end(), i) != clusterLights.end());
+        }
+    }
+}
+
+TEST(LightClustersSlices)
+{
+    LightClusterBuilder builder;
+    builder.SetGrid(grid);
+    CHECK(builder.GetClusterCount() == 16 * 9 * 24);
+    CHECK(builder.GetSliceDepth(0) == 0.0f);
+    CHECK_NEAR(builder.GetSliceDepth(grid.slices), grid.farDistance, grid.farDistance * 1e-5f);
+    for (uint32_t slice = 1; slice < grid.slices; ++slice)
+    {
+        CHECK(builder.GetSliceDepth(slice) > builder.GetSliceDepth(slice - 1));
+        // Exponential slices have the same depth ratio
+        if (slice > 1)
+            CHECK_NEAR(builder.GetSliceDepth(slice + 1) / builder.GetSliceDepth(slice), builder.GetSliceDepth(slice) / builder.GetSliceDepth(slice - 1), 1e-3f);
+    }
+
+    // A light around the camera reaches behind it and touches tiles on both sides of the screen
+    const float identity[4][4] = { { 1.0f, 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 0.0f, 1.0f } };
+    PointLight light = { { 0.0f, 0.0f, 0.5f }, 2.0f, { 1.0f, 1.0f, 1.0f }, 1.0f };
+    builder.Build(&light, 1, identity, 1);
+    CHECK(GetClusterLights(builder, 0).size() == 1);
+    CHECK(GetClusterLights(builder, grid.tilesX * grid.tilesY - 1).size() == 1);
+    CHECK(GetClusterLights(builder, grid.tilesX * grid.tilesY * (grid.slices - 1)).empty());
+}
@@ -0,0 +1,240 @@
+#include "Test.h"
+#include "../shadows/LuminanceHistogram.h"
+#include "../shadows/MappedFile.h"
+#include "../shadows/RadianceHdr.h"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+namespace
+{
+    // LuminanceHistogramShaders.fx step by step: 16x16 groups with shared bins, 64-bit sums as pairs of uints and a
+    // tree reduction over the bins. The shader reads the weights from a buffer of GetLuminanceHistogramBinWeight.
+
+    struct Uint2
+    {
+        uint32_t x;
+        uint32_t y;
+    };
+
+    Uint2 Add64(Uint2 a, Uint2 b)
+    {
+        uint32_t low = a.x + b.x;
+        return { low, a.y + b.y + (low < a.x ? 1u : 0u) };
+    }
+
+    Uint2 Multiply64(uint32_t count, uint32_t weight)
+    {
+        uint32_t low = (count & 0xFFFF) * (weight & 0xFFFF);
+        uint32_t high = (count >> 16) * (weight >> 16);
+        uint32_t middle = (count & 0xFFFF) * (weight >> 16);
+        uint32_t otherMiddle = (count >> 16) * (weight & 0xFFFF);
+        Uint2 product = Add64({ low, high }, { middle << 16, middle >> 16 });
+        return Add64(product, { otherMiddle << 16, otherMiddle >> 16 });
+    }
+
+    void EmulateHistogramShader(const float* rgba, uint32_t width, uint32_t height, uint32_t histogram[LUMINANCE_HISTOGRAM_BINS])
+    {
+        for (uint32_t bin = 0; bin < LUMINANCE_HISTOGRAM_BINS; ++bin)
+            histogram[bin] = 0;
+        for (uint32_t groupY = 0; groupY < (height + 15) / 16; ++groupY)
+        {
+            for (uint32_t groupX = 0; groupX < (width + 15) / 16; ++groupX)
+            {
+                uint32_t groupBins[LUMINANCE_HISTOGRAM_BINS] = {};
+                for (uint32_t index = 0; index < 256; ++index)
+                {
+                    uint32_t x = groupX * 16 + index % 16;
+                    uint32_t y = groupY * 16 + index / 16;
+                    if (x < width && y < height)
+                    {
+                        const float* color = rgba + (static_cast<size_t>(y) * width + x) * 4;
+                        ++groupBins[GetLuminanceHistogramBin(ComputeLuminance(color[0], color[1], color[2]))];
+                    }
+                }
+                for (uint32_t bin = 0; bin < LUMINANCE_HISTOGRAM_BINS; ++bin)
+                    histogram[bin] += groupBins[bin];
+            }
+        }
+    }
+
+    bool EmulateAdaptationShader(const uint32_t histogram[LUMINANCE_HISTOGRAM_BINS], float& luminance)
+    {
+        Uint2 sums[LUMINANCE_HISTOGRAM_BINS];
+        uint32_t counts[LUMINANCE_HISTOGRAM_BINS];
+        for (uint32_t index = 0; index < LUMINANCE_HISTOGRAM_BINS; ++index)
+        {
+            sums[index] = Multiply64(histogram[index], GetLuminanceHistogramBinWeight(index));
+            counts[index] = histogram[index];
+        }
+        for (uint32_t stride = LUMINANCE_HISTOGRAM_BINS / 2; stride > 0; stride >>= 1)
+        {
+            for (uint32_t index = 0; index < stride; ++index)
+            {
+                sums[index] = Add64(sums[index], sums[index + stride]);
+                counts[index] += counts[index + stride];
+            }
+        }
+        if (counts[0] == 0)
+            return false;
+
+        float sum = static_cast<float>(sums[0].y) * 4294967296.0f;
+        sum += static_cast<float>(sums[0].x);
+        float meanWeight = sum / static_cast<float>(counts[0]);
+        luminance = meanWeight / 1048576.0f;
+        return true;
+    }
+
+    // Both paths give the same histogram and the same bits of the mean
+    bool MatchesShader(const float* rgba, uint32_t width, uint32_t height)
+    {
+        uint32_t bins[LUMINANCE_HISTOGRAM_BINS];
+        uint32_t shaderBins[LUMINANCE_HISTOGRAM_BINS];
+        BuildLuminanceHistogram(rgba, width, height, bins);
+        EmulateHistogramShader(rgba, width, height, shaderBins);
+        float luminance = 0.0f;
+        float shaderLuminance = 1.0f;
+        bool computed = ComputeHistogramLogLuminance(bins, luminance);
+        bool shaderComputed = EmulateAdaptationShader(shaderBins, shaderLuminance);
+        return computed && shaderComputed && memcmp(bins, shaderBins, sizeof(bins)) == 0 && memcmp(&luminance, &shaderLuminance, sizeof(float)) == 0;
+    }
+}
+
+TEST(LuminanceHistogramBins)
+{
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    const float infinity = std::numeric_limits<float>::infinity();
+    CHECK(GetLuminanceHistogramBin(0.0f) == 0);
+    CHECK(GetLuminanceHistogramBin(-1.0f) == 0);
+    CHECK(GetLuminanceHistogramBin(nan) == 0);
+    CHECK(GetLuminanceHistogramBin(infinity) == LUMINANCE_HISTOGRAM_BINS - 1);
+    CHECK(GetLuminanceHistogramBin(1e30f) == LUMINANCE_HISTOGRAM_BINS - 1);
+    CHECK(GetLuminanceHistogramBin(1e-10f) == 0);
+    // Powers of two of luminance start an octave, from 2^-16
+    CHECK(GetLuminanceHistogramBin(1.0f / 65536.0f) == 0);
+    CHECK(GetLuminanceHistogramBin(1.0f / 32768.0f) == 16);
+    CHECK(GetLuminanceHistogramBin(1.0f / 65536.0f * 1.0625f) == 1);
+    CHECK(GetLuminanceHistogramBin(1.0f) == 256);
+    CHECK(GetLuminanceHistogramBin(2.0f) == 272);
+    CHECK(GetLuminanceHistogramBin(65535.0f) == 511);
+    CHECK(GetLuminanceHistogramBin(65536.0f) == 511);
+    // 1.28 * 2^-7
+    CHECK(GetLuminanceHistogramBin(0.01f) == 148);
+
+    // The weights are log(luminance + 1) at the middle of the bins
+    for (uint32_t bin = 0; bin < LUMINANCE_HISTOGRAM_BINS; ++bin)
+    {
+        double middle = std::ldexp(1.0 + (bin % 16 + 0.5) / 16.0, static_cast<int>(bin / 16) - 16);
+        CHECK_NEAR(GetLuminanceHistogramBinWeight(bin) / 1048576.0, std::log(middle + 1.0), 1.0 / 1048576.0);
+        if (bin > 0)
+            CHECK(GetLuminanceHistogramBinWeight(bin) > GetLuminanceHistogramBinWeight(bin - 1));
+    }
+}
+
+TEST(LuminanceHistogramMatchesShader)
+{
+    // Luminance over many octaves with negative and NaN pixels, in a size that leaves the last groups partly empty
+    const uint32_t width = 123;
+    const uint32_t height = 45;
+    std::mt19937 random(17);
+    std::uniform_real_distribution<float> exponent(-12.0f, 18.0f);
+    std::vector<float> rgba(width * height * 4);
+    for (uint32_t i = 0; i < width * height; ++i)
+    {
+        for (int channel = 0; channel < 3; ++channel)
+            rgba[i * 4 + channel] = std::exp2(exponent(random));
+        rgba[i * 4 + 3] = 1.0f;
+    }
+    rgba[0] = -5.0f;
+    rgba[5] = std::numeric_limits<float>::quiet_NaN();
+    CHECK(MatchesShader(rgba.data(), width, height));
+
+    MappedFile file;
+    EnvironmentImage image;
+    CHECK(file.Open(GetDataPath("env.hdr").c_str()));
+    CHECK(DecodeRadianceHdr(file.GetData(), file.GetSize(), image));
+    CHECK(MatchesShader(image.pixels.data(), image.width, image.height));
+
+    // The histogram mean is close to the mean over the pixels
+    uint32_t bins[LUMINANCE_HISTOGRAM_BINS];
+    BuildLuminanceHistogram(image.pixels.data(), image.width, image.height, bins);
+    float luminance;
+    CHECK(ComputeHistogramLogLuminance(bins, luminance));
+    double sum = 0.0;
+    for (size_t i = 0; i < static_cast<size_t>(image.width) * image.height; ++i)
+    {
+        const float* color = &image.pixels[i * 4];
+        sum += std::log(static_cast<double>(ComputeLuminance(color[0], color[1], color[2])) + 1.0);
+    }
+    double mean = sum / (static_cast<double>(image.width) * image.height);
+    CHECK_NEAR(luminance, mean, 0.01 * mean);
+}
+
+TEST(LuminanceHistogramDarkScene)
+{
+    // Mean luminance 0.01: log-normal around it, uniform down to black and flat. Bins of luminance + 1 put almost all
+    // of these pixels into their first bin, which weighs about 0.03.
+    const uint32_t width = 256;
+    const uint32_t height = 128;
+    std::mt19937 random(23);
+    std::lognormal_distribution<float> logNormal(std::log(0.01f) - 0.5f, 1.0f);
+    std::uniform_real_distribution<float> uniform(0.0f, 0.02f);
+    for (int scene = 0; scene < 3; ++scene)
+    {
+        std::vector<float> rgba(width * height * 4);
+        double sum = 0.0;
+        for (uint32_t i = 0; i < width * height; ++i)
+        {
+            float value = scene == 0 ? logNormal(random) : (scene == 1 ? uniform(random) : 0.01f);
+            rgba[i * 4] = value;
+            rgba[i * 4 + 1] = value;
+            rgba[i * 4 + 2] = value;
+            rgba[i * 4 + 3] = 1.0f;
+            sum += std::log(static_cast<double>(ComputeLuminance(value, value, value)) + 1.0);
+        }
+        CHECK(MatchesShader(rgba.data(), width, height));
+
+        uint32_t bins[LUMINANCE_HISTOGRAM_BINS];
+        BuildLuminanceHistogram(rgba.data(), width, height, bins);
+        float luminance;
+        CHECK(ComputeHistogramLogLuminance(bins, luminance));
+        double mean = sum / (width * height);
+        CHECK_NEAR(mean, 0.01, 0.001);
+        CHECK_NEAR(luminance, mean, 0.005 * mean);
+    }
+}
+
+TEST(LuminanceHistogramLargeCounts)
+{
+    // Sums that need more than 32 bits
+    uint32_t bins[LUMINANCE_HISTOGRAM_BINS] = {};
+    bins[511] = 4000000000u;
+    bins[300] = 200000000u;
+    bins[3] = 100000u;
+    float luminance;
+    float shaderLuminance;
+    CHECK(ComputeHistogramLogLuminance(bins, luminance));
+    CHECK(EmulateAdaptationShader(bins, shaderLuminance));
+    CHECK(memcmp(&luminance, &shaderLuminance, sizeof(float)) == 0);
+
+    uint32_t empty[LUMINANCE_HISTOGRAM_BINS] = {};
+    luminance = 7.0f;
+    CHECK(!ComputeHistogramLogLuminance(empty, luminance));
+    CHECK(luminance == 7.0f);
+}
+
+TEST(LuminanceHistogramAdaptation)
+{
+    // Moves towards the measured value without passing it, and faster towards dark scenes
+    float brighter = AdaptLuminance(1.0f, 2.0f, 0.1f);
+    float darker = AdaptLuminance(2.0f, 1.0f, 0.1f);
+    CHECK(brighter > 1.0f && brighter < 2.0f);
+    CHECK(darker < 2.0f && darker > 1.0f);
+    CHECK(AdaptLuminance(0.1f, 5.0f, 0.1f) - 0.1f < 5.0f - AdaptLuminance(5.0f, 0.1f, 0.1f));
+    CHECK(AdaptLuminance(1.5f, 1.5f, 0.1f) == 1.5f);
+    CHECK(AdaptLuminance(1.0f, 2.0f, 0.0f) == 1.0f);
+    CHECK_NEAR(AdaptLuminance(1.0f, 2.0f, 1000.0f), 2.0f, 1e-4f);
+}
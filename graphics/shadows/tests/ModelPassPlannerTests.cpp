@@ -0,0 +1,108 @@
+#include "Test.h"
+#include "../shadows/ModelPassPlanner.h"
+
+namespace
+{
+    // Records the calls the renderer would get and counts the draws of a scene
+    class MockModelPassContext : public ModelPassContext
+    {
+    public:
+        MockModelPassContext(unsigned int opaqueCount, unsigned int transparentCount) :
+            m_opaqueCount(opaqueCount),
+            m_transparentCount(transparentCount),
+            m_boundTargets(0),
+            m_draws(0),
+            m_bloomDraws(0),
+            m_depthWritingTransparentPasses(0)
+        {};
+
+        void BeginPass(const ModelPass& pass) override
+        {
+            m_types.push_back(pass.type);
+            m_boundTargets = pass.targets;
+        }
+
+        void DrawPass(const ModelPass& pass) override
+        {
+            unsigned int draws = 1;
+            if (pass.type == MODEL_PASS_TYPE::OPAQUE_PRIMITIVES)
+                draws = m_opaqueCount;
+            else if (pass.type == MODEL_PASS_TYPE::SORTED_TRANSPARENT_PRIMITIVES || pass.type == MODEL_PASS_TYPE::OIT_TRANSPARENT_PRIMITIVES)
+            {
+                draws = m_transparentCount;
+                m_depthWritingTransparentPasses += pass.depthWrite ? 1 : 0;
+            }
+            m_draws += draws;
+            if (m_boundTargets & MODEL_PASS_TARGET_BLOOM)
+                m_bloomDraws += draws;
+        }
+
+        std::vector<MODEL_PASS_TYPE> m_types;
+        unsigned int m_opaqueCount;
+        unsigned int m_transparentCount;
+        unsigned int m_boundTargets;
+        unsigned int m_draws;
+        unsigned int m_bloomDraws;
+        unsigned int m_depthWritingTransparentPasses;
+    };
+}
+
+TEST(ModelPassPlannerSortedTransparency)
+{
+    std::vector<ModelPass> passes;
+    PlanModelPasses(false, passes);
+    MockModelPassContext context(40, 7);
+    ExecuteModelPasses(passes, context);
+
+    std::vector<MODEL_PASS_TYPE> expected = {
+        MODEL_PASS_TYPE::OPAQUE_PRIMITIVES,
+        MODEL_PASS_TYPE::ENVIRONMENT,
+        MODEL_PASS_TYPE::SORTED_TRANSPARENT_PRIMITIVES
+    };
+    CHECK(context.m_types == expected);
+
+    // Every primitive is drawn once, bloom comes from the same draws
+    CHECK(context.m_draws == 40 + 7 + 1);
+    CHECK(context.m_bloomDraws == 40 + 7);
+    CHECK(context.m_depthWritingTransparentPasses == 0);
+    CHECK(CountModelPassDraws(passes, 40, 7) == context.m_draws);
+}
+
+TEST(ModelPassPlannerWeightedOIT)
+{
+    std::vector<ModelPass> passes;
+    PlanModelPasses(true, passes);
+    MockModelPassContext context(40, 7);
+    ExecuteModelPasses(passes, context);
+
+    std::vector<MODEL_PASS_TYPE> expected = {
+        MODEL_PASS_TYPE::OPAQUE_PRIMITIVES,
+        MODEL_PASS_TYPE::ENVIRONMENT,
+        MODEL_PASS_TYPE::OIT_TRANSPARENT_PRIMITIVES,
+        MODEL_PASS_TYPE::OIT_RESOLVE
+    };
+    CHECK(context.m_types == expected);
+    CHECK(context.m_draws == 40 + 7 + 2);
+    CHECK(context.m_bloomDraws == 40 + 7);
+    CHECK(context.m_depthWritingTransparentPasses == 0);
+    CHECK(CountModelPassDraws(passes, 40, 7) == context.m_draws);
+
+    // Only the opaque pass writes depth, the resolve goes to the scene color
+    for (const ModelPass& pass : passes)
+    {
+        CHECK(pass.depthWrite == (pass.type == MODEL_PASS_TYPE::OPAQUE_PRIMITIVES));
+        if (pass.type == MODEL_PASS_TYPE::OIT_RESOLVE)
+            CHECK(pass.targets == MODEL_PASS_TARGET_SCENE);
+        if (pass.type == MODEL_PASS_TYPE::OIT_TRANSPARENT_PRIMITIVES)
+            CHECK((pass.targets & MODEL_PASS_TARGET_SCENE) == 0);
+    }
+}
+
+TEST(ModelPassPlannerReplansFromScratch)
+{
+    std::vector<ModelPass> passes;
+    PlanModelPasses(true, passes);
+    PlanModelPasses(false, passes);
+    CHECK(passes.size() == 3);
+    CHECK(CountModelPassDraws(passes, 0, 0) == 1);
+}
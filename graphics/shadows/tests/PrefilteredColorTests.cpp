@@ -0,0 +1,176 @@
+#include "Test.h"
+#include "TestEnvironment.h"
+
+#include <cmath>
+
+namespace
+{
+    IBLBakeSettings SmallSettings()
+    {
+        IBLBakeSettings settings;
+        settings.cubeSize = 64;
+        settings.prefilteredSize = 16;
+        settings.prefilteredLevels = 5;
+        settings.prefilteredMinSamples = 64;
+        settings.prefilteredMaxSamples = 128;
+        return settings;
+    }
+
+    // Root mean square difference of one level relative to the mean of the reference
+    double CompareLevel(const CubeMap& prefiltered, const CubeMap& reference, uint32_t level)
+    {
+        uint32_t size = prefiltered.GetSize(level);
+        double sumSqr = 0.0;
+        double sum = 0.0;
+        for (uint32_t face = 0; face < 6; ++face)
+        {
+            const float* texels = prefiltered.GetFace(face, level);
+            const float* referenceTexels = reference.GetFace(face, level);
+            for (uint32_t i = 0; i < size * size; ++i)
+            {
+                for (int k = 0; k < 3; ++k)
+                {
+                    double difference = texels[i * 4 + k] - referenceTexels[i * 4 + k];
+                    sumSqr += difference * difference;
+                    sum += referenceTexels[i * 4 + k];
+                }
+            }
+        }
+        double count = 6.0 * size * size * 3;
+        return std::sqrt(sumSqr / count) / (sum / count);
+    }
+}
+
+TEST(PrefilteredColorSampleCount)
+{
+    IBLBakeSettings settings;
+    CHECK(GetPrefilteredSampleCount(settings, 0) == 1);
+    CHECK(GetPrefilteredSampleCount(settings, 1) == settings.prefilteredMinSamples);
+    CHECK(GetPrefilteredSampleCount(settings, settings.prefilteredLevels - 1) == settings.prefilteredMaxSamples);
+
+    settings.prefilteredMinSamples = 50;
+    settings.prefilteredMaxSamples = 900;
+    settings.prefilteredLevels = 6;
+    uint32_t previous = 0;
+    for (uint32_t level = 1; level < 6; ++level)
+    {
+        uint32_t count = GetPrefilteredSampleCount(settings, level);
+        CHECK(count % 4 == 0);
+        CHECK(count > previous);
+        previous = count;
+    }
+    CHECK(GetPrefilteredSampleCount(settings, 1) == 52);
+    CHECK(GetPrefilteredSampleCount(settings, 5) == 900);
+}
+
+TEST(PrefilteredColorMirrorLevel)
+{
+    // The smooth level is the environment itself
+    IBLBakeSettings settings = SmallSettings();
+    CubeMap environment;
+    EquirectToCube(MakeTestEnvironment(256, 128), settings.cubeSize, environment);
+    CubeMap prefiltered;
+    BakePrefilteredColor(environment, settings, prefiltered);
+    CHECK(prefiltered.GetSize() == 16);
+    CHECK(prefiltered.GetMipLevels() == 5);
+    for (uint32_t face = 0; face < 6; ++face)
+    {
+        for (uint32_t y = 0; y < 16; ++y)
+        {
+            for (uint32_t x = 0; x < 16; ++x)
+            {
+                float direction[3];
+                CubeTexelDirection(face, x, y, 16, direction);
+                float color[4];
+                SampleCubeLevel(environment, direction, 0.0f, color);
+                const float* texel = prefiltered.GetFace(face, 0) + (y * 16 + x) * 4;
+                for (int i = 0; i < 3; ++i)
+                    CHECK_NEAR(texel[i], color[i], 1e-5f);
+            }
+        }
+    }
+}
+
+TEST(PrefilteredColorConstantEnvironment)
+{
+    // Normalized weights keep a uniform environment uniform at every roughness
+    IBLBakeSettings settings = SmallSettings();
+    EnvironmentImage image;
+    image.width = 8;
+    image.height = 4;
+    for (uint32_t i = 0; i < 8 * 4; ++i)
+    {
+        image.pixels.push_back(0.5f);
+        image.pixels.push_back(1.0f);
+        image.pixels.push_back(2.0f);
+        image.pixels.push_back(1.0f);
+    }
+    CubeMap environment;
+    EquirectToCube(image, settings.cubeSize, environment);
+    CubeMap prefiltered;
+    BakePrefilteredColor(environment, settings, prefiltered);
+    for (uint32_t level = 0; level < 5; ++level)
+    {
+        uint32_t size = prefiltered.GetSize(level);
+        for (uint32_t face = 0; face < 6; ++face)
+        {
+            const float* texels = prefiltered.GetFace(face, level);
+            for (uint32_t i = 0; i < size * size; ++i)
+            {
+                CHECK_NEAR(texels[i * 4], 0.5f, 1e-4f);
+                CHECK_NEAR(texels[i * 4 + 1], 1.0f, 1e-4f);
+                CHECK_NEAR(texels[i * 4 + 2], 2.0f, 1e-4f);
+            }
+        }
+    }
+}
+
+TEST(PrefilteredColorMatchesManySamples)
+{
+    // Reading the mip that covers the solid angle of a sample keeps the default counts close to a dense integration
+    IBLBakeSettings settings = SmallSettings();
+    CubeMap environment;
+    EquirectToCube(MakeTestEnvironment(256, 128), settings.cubeSize, environment);
+
+    IBLBakeSettings referenceSettings = settings;
+    referenceSettings.prefilteredMinSamples = 16384;
+    referenceSettings.prefilteredMaxSamples = 16384;
+    CubeMap reference;
+    BakePrefilteredColor(environment, referenceSettings, reference);
+
+    IBLBakeSettings defaultSettings = settings;
+    defaultSettings.prefilteredMinSamples = IBLBakeSettings().prefilteredMinSamples;
+    defaultSettings.prefilteredMaxSamples = IBLBakeSettings().prefilteredMaxSamples;
+    CubeMap prefiltered;
+    BakePrefilteredColor(environment, defaultSettings, prefiltered);
+    for (uint32_t level = 1; level < 5; ++level)
+        CHECK(CompareLevel(prefiltered, reference, level) < 0.02);
+
+    // And the error shrinks as samples are added
+    double previous[5] = { 1.0, 1.0, 1.0, 1.0, 1.0 };
+    for (uint32_t sampleCount = 64; sampleCount <= 4096; sampleCount *= 4)
+    {
+        IBLBakeSettings sampledSettings = settings;
+        sampledSettings.prefilteredMinSamples = sampleCount;
+        sampledSettings.prefilteredMaxSamples = sampleCount;
+        BakePrefilteredColor(environment, sampledSettings, prefiltered);
+        for (uint32_t level = 1; level < 5; ++level)
+        {
+            double error = CompareLevel(prefiltered, reference, level);
+            CHECK(error < previous[level]);
+            previous[level] = error;
+        }
+    }
+}
+
+TEST(PrefilteredColorDoesNotDependOnThreadCount)
+{
+    IBLBakeSettings settings = SmallSettings();
+    CubeMap environment;
+    EquirectToCube(MakeTestEnvironment(256, 128), settings.cubeSize, environment);
+    CubeMap single;
+    CubeMap parallel;
+    BakePrefilteredColor(environment, settings, single, 1);
+    BakePrefilteredColor(environment, settings, parallel, 4);
+    CHECK(single.GetData() == parallel.GetData());
+}
@@ -0,0 +1,120 @@
+#include "Test.h"
+#include "../shadows/IBLBaker.h"
+
+#include <cmath>
+#include <random>
+
+namespace
+{
+    const double PI = 3.14159265358979323846;
+
+    double SchlickGGX(double ndotv, double k)
+    {
+        return ndotv / (ndotv * (1.0 - k) + k);
+    }
+
+    // Split sum scale and bias from GGX half vectors drawn at random, in the frame of n = +y
+    void IntegrateBRDF(double ndotv, double roughness, uint32_t sampleCount, double& scale, double& bias)
+    {
+        std::mt19937 random(7);
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        double a = roughness * roughness;
+        double k = a / 2.0;
+        double v[3] = { std::sqrt(1.0 - ndotv * ndotv), ndotv, 0.0 };
+        scale = bias = 0.0;
+        for (uint32_t i = 0; i < sampleCount; ++i)
+        {
+            double phi = 2.0 * PI * uniform(random);
+            double xi = uniform(random);
+            double cosTheta = std::sqrt((1.0 - xi) / (1.0 + (a * a - 1.0) * xi));
+            double sinTheta = std::sqrt(1.0 - cosTheta * cosTheta);
+            double h[3] = { std::cos(phi) * sinTheta, cosTheta, std::sin(phi) * sinTheta };
+            double vdoth = v[0] * h[0] + v[1] * h[1];
+            double ndotl = 2.0 * vdoth * h[1] - v[1];
+            if (ndotl <= 0.0 || vdoth <= 0.0)
+                continue;
+            double visibility = SchlickGGX(ndotv, k) * SchlickGGX(ndotl, k) * vdoth / (h[1] * ndotv);
+            double fresnel = std::pow(1.0 - vdoth, 5.0);
+            scale += (1.0 - fresnel) * visibility;
+            bias += fresnel * visibility;
+        }
+        scale /= sampleCount;
+        bias /= sampleCount;
+    }
+}
+
+TEST(PreintegratedBRDFMatchesIntegration)
+{
+    PreintegratedBRDFSettings settings;
+    settings.size = 16;
+    std::vector<uint16_t> lut;
+    BakePreintegratedBRDF(settings, lut);
+    CHECK(lut.size() == 16 * 16 * 2);
+
+    double maxError = 0.0;
+    for (uint32_t y = 0; y < 16; y += 3)
+    {
+        for (uint32_t x = 0; x < 16; x += 3)
+        {
+            double scale, bias;
+            IntegrateBRDF((x + 0.5) / 16, (y + 0.5) / 16, 1 << 16, scale, bias);
+            maxError = std::fmax(maxError, std::fabs(lut[(y * 16 + x) * 2] / 65535.0 - scale));
+            maxError = std::fmax(maxError, std::fabs(lut[(y * 16 + x) * 2 + 1] / 65535.0 - bias));
+        }
+    }
+    // 1024 samples leave about 0.015 at grazing angles of smooth surfaces
+    CHECK(maxError < 0.02);
+}
+
+TEST(PreintegratedBRDFBounds)
+{
+    PreintegratedBRDFSettings settings;
+    settings.size = 32;
+    std::vector<uint16_t> lut;
+    BakePreintegratedBRDF(settings, lut);
+    for (uint32_t y = 0; y < 32; ++y)
+    {
+        // Energy is lost to masking and at grazing angles, never gained
+        for (uint32_t x = 0; x < 32; ++x)
+            CHECK(lut[(y * 32 + x) * 2] + lut[(y * 32 + x) * 2 + 1] <= 65536);
+    }
+    // A smooth surface seen head on reflects almost everything, a rough one loses most of it to masking
+    CHECK(lut[31 * 2] + lut[31 * 2 + 1] > 0.95 * 65535);
+    CHECK(lut[(31 * 32 + 31) * 2] + lut[(31 * 32 + 31) * 2 + 1] < 0.5 * 65535);
+}
+
+TEST(PreintegratedBRDFAnalyticFit)
+{
+    PreintegratedBRDFSettings settings;
+    settings.size = 32;
+    std::vector<uint16_t> integrated;
+    BakePreintegratedBRDF(settings, integrated);
+    settings.analyticFit = 1;
+    std::vector<uint16_t> fitted;
+    BakePreintegratedBRDF(settings, fitted);
+    CHECK(fitted.size() == integrated.size());
+
+    // The fit is as coarse as its comment says and no coarser
+    double maxError = 0.0;
+    double sumError = 0.0;
+    for (size_t i = 0; i < fitted.size(); ++i)
+    {
+        double error = std::fabs(static_cast<int>(fitted[i]) - static_cast<int>(integrated[i])) / 65535.0;
+        maxError = std::fmax(maxError, error);
+        sumError += error;
+    }
+    CHECK(sumError / fitted.size() < 0.05);
+    CHECK(maxError < 0.3);
+}
+
+TEST(PreintegratedBRDFDoesNotDependOnThreadCount)
+{
+    PreintegratedBRDFSettings settings;
+    settings.size = 32;
+    settings.sampleCount = 256;
+    std::vector<uint16_t> single;
+    std::vector<uint16_t> parallel;
+    BakePreintegratedBRDF(settings, single, 1);
+    BakePreintegratedBRDF(settings, parallel, 4);
+    CHECK(single == parallel);
+}
@@ -0,0 +1,220 @@
+#include "Test.h"
+#include "../shadows/MappedFile.h"
+#include "../shadows/RadianceHdr.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "../../stb_image.h"
+#undef STB_IMAGE_IMPLEMENTATION
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+    void AppendHeader(std::vector<uint8_t>& file, uint32_t width, uint32_t height, const char* signature = "#?RADIANCE")
+    {
+        std::string header = std::string(signature) + "\n# test\nFORMAT=32-bit_rle_rgbe\nEXPOSURE=1\n\n-Y " + std::to_string(height) + " +X " +
+            std::to_string(width) + "\n";
+        file.insert(file.end(), header.begin(), header.end());
+    }
+
+    // Runs of three or more equal bytes are encoded as runs, the rest as literal copies
+    void EncodeChannel(const uint8_t* values, uint32_t width, std::vector<uint8_t>& file)
+    {
+        uint32_t x = 0;
+        while (x < width)
+        {
+            uint32_t run = 1;
+            while (x + run < width && run < 127 && values[x + run] == values[x])
+                ++run;
+            if (run >= 3)
+            {
+                file.push_back(static_cast<uint8_t>(128 + run));
+                file.push_back(values[x]);
+                x += run;
+                continue;
+            }
+
+            uint32_t start = x;
+            uint32_t count = 0;
+            while (x < width && count < 128)
+            {
+                uint32_t equal = 1;
+                while (x + equal < width && equal < 3 && values[x + equal] == values[x])
+                    ++equal;
+                if (equal >= 3)
+                    break;
+                ++x;
+                ++count;
+            }
+            file.push_back(static_cast<uint8_t>(count));
+            file.insert(file.end(), values + start, values + start + count);
+        }
+    }
+
+    std::vector<uint8_t> MakeFile(const std::vector<uint8_t>& rgbe, uint32_t width, uint32_t height, bool runLengthEncoded)
+    {
+        std::vector<uint8_t> file;
+        AppendHeader(file, width, height);
+        if (!runLengthEncoded)
+        {
+            file.insert(file.end(), rgbe.begin(), rgbe.end());
+            return file;
+        }
+
+        std::vector<uint8_t> channel(width);
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            file.push_back(2);
+            file.push_back(2);
+            file.push_back(static_cast<uint8_t>(width >> 8));
+            file.push_back(static_cast<uint8_t>(width & 255));
+            for (uint32_t c = 0; c < 4; ++c)
+            {
+                for (uint32_t x = 0; x < width; ++x)
+                    channel[x] = rgbe[(static_cast<size_t>(y) * width + x) * 4 + c];
+                EncodeChannel(channel.data(), width, file);
+            }
+        }
+        return file;
+    }
+
+    // Zero, tiny, huge and ordinary exponents with repeated pixels so that both kinds of runs occur
+    std::vector<uint8_t> MakeRandomImage(std::mt19937& random, uint32_t width, uint32_t height)
+    {
+        std::vector<uint8_t> rgbe(static_cast<size_t>(width) * height * 4);
+        for (size_t i = 0; i < rgbe.size() / 4; ++i)
+        {
+            if (i > 0 && random() % 3 == 0)
+            {
+                memcpy(&rgbe[i * 4], &rgbe[(i - 1) * 4], 4);
+                continue;
+            }
+            uint32_t kind = random() % 8;
+            uint8_t exponent = kind == 0 ? 0 : (kind == 1 ? static_cast<uint8_t>(1 + random() % 12) : (kind == 2 ? 255 : static_cast<uint8_t>(100 + random() % 60)));
+            uint8_t r = static_cast<uint8_t>(random());
+            uint8_t g = static_cast<uint8_t>(random());
+            uint8_t b = static_cast<uint8_t>(random());
+            // A pixel that starts with 2 2 and a small width would read as a run length encoded scanline
+            if (r < 128 && g < 128 && b < 128)
+                r |= 128;
+            rgbe[i * 4] = r;
+            rgbe[i * 4 + 1] = g;
+            rgbe[i * 4 + 2] = b;
+            rgbe[i * 4 + 3] = exponent;
+        }
+        return rgbe;
+    }
+
+    // Both decoders accept the file and give the same bits
+    bool DecodesLikeStbImage(const std::vector<uint8_t>& file, unsigned int threadCount)
+    {
+        int width, height, channels;
+        float* reference = stbi_loadf_from_memory(file.data(), static_cast<int>(file.size()), &width, &height, &channels, 4);
+        EnvironmentImage image;
+        bool decoded = DecodeRadianceHdr(file.data(), file.size(), image, threadCount);
+        bool same = reference && decoded && static_cast<int>(image.width) == width && static_cast<int>(image.height) == height &&
+            memcmp(reference, image.pixels.data(), static_cast<size_t>(width) * height * 4 * sizeof(float)) == 0;
+        if (reference)
+            stbi_image_free(reference);
+        return same;
+    }
+}
+
+TEST(RadianceHdrEnvironmentFile)
+{
+    MappedFile file;
+    CHECK(file.Open(GetDataPath("env.hdr").c_str()));
+    CHECK(file.GetSize() > 0);
+    std::vector<uint8_t> bytes(file.GetData(), file.GetData() + file.GetSize());
+    CHECK(DecodesLikeStbImage(bytes, 0));
+    CHECK(DecodesLikeStbImage(bytes, 1));
+}
+
+TEST(RadianceHdrMatchesStbImage)
+{
+    std::mt19937 random(7);
+    // Run length encoding needs widths from 8 to 32767, other widths are always flat
+    const uint32_t widths[] = { 8, 9, 13, 100, 1024, 4099, 32767 };
+    for (uint32_t width : widths)
+    {
+        std::vector<uint8_t> rgbe = MakeRandomImage(random, width, 5);
+        CHECK(DecodesLikeStbImage(MakeFile(rgbe, width, 5, true), 3));
+        CHECK(DecodesLikeStbImage(MakeFile(rgbe, width, 5, false), 3));
+    }
+    const uint32_t flatWidths[] = { 1, 3, 7, 32768, 40000 };
+    for (uint32_t width : flatWidths)
+        CHECK(DecodesLikeStbImage(MakeFile(MakeRandomImage(random, width, 3), width, 3, false), 3));
+
+    std::vector<uint8_t> file;
+    AppendHeader(file, 64, 64, "#?RGBE");
+    std::vector<uint8_t> encoded = MakeFile(MakeRandomImage(random, 64, 64), 64, 64, true);
+    std::vector<uint8_t> header;
+    AppendHeader(header, 64, 64);
+    file.insert(file.end(), encoded.begin() + header.size(), encoded.end());
+    CHECK(DecodesLikeStbImage(file, 3));
+}
+
+TEST(RadianceHdrRejectsBrokenFiles)
+{
+    std::mt19937 random(11);
+    std::vector<uint8_t> file = MakeFile(MakeRandomImage(random, 200, 40), 200, 40, true);
+
+    // Every truncation fails
+    for (size_t size = 0; size < file.size(); size += 7)
+    {
+        EnvironmentImage image;
+        CHECK(!DecodeRadianceHdr(file.data(), size, image, 2));
+    }
+
+    // A flipped byte either fails or still decodes what stb_image decodes
+    for (int i = 0; i < 1000; ++i)
+    {
+        std::vector<uint8_t> corrupt = file;
+        corrupt[60 + random() % (corrupt.size() - 60)] = static_cast<uint8_t>(random());
+        EnvironmentImage image;
+        if (DecodeRadianceHdr(corrupt.data(), corrupt.size(), image, 2))
+            CHECK(DecodesLikeStbImage(corrupt, 2));
+    }
+
+    // Other formats and orientations
+    const char* headers[] = { "#?RADIANCE\nFORMAT=32-bit_rle_xyze\n\n-Y 2 +X 16\n", "#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n+Y 2 +X 16\n",
+        "#?PNG\nFORMAT=32-bit_rle_rgbe\n\n-Y 2 +X 16\n" };
+    for (const char* header : headers)
+    {
+        std::vector<uint8_t> other(header, header + strlen(header));
+        other.resize(other.size() + 128, 130);
+        EnvironmentImage image;
+        CHECK(!DecodeRadianceHdr(other.data(), other.size(), image));
+    }
+}
+
+TEST(RadianceHdrMappedFile)
+{
+    std::string path = GetTemporaryDirectory() + "shadows_tests_mapped.bin";
+    MappedFile file;
+    CHECK(!file.Open((path + ".missing").c_str()));
+    CHECK(file.GetData() == nullptr);
+
+    // Empty files can't be mapped
+    FILE* output = fopen(path.c_str(), "wb");
+    CHECK(output != nullptr);
+    if (!output)
+        return;
+    fclose(output);
+    CHECK(!file.Open(path.c_str()));
+
+    const char text[] = "mapped file contents";
+    output = fopen(path.c_str(), "wb");
+    fwrite(text, 1, sizeof(text), output);
+    fclose(output);
+    CHECK(file.Open(path.c_str()));
+    CHECK(file.GetSize() == sizeof(text));
+    CHECK(file.GetData() && memcmp(file.GetData(), text, sizeof(text)) == 0);
+    file.Close();
+    CHECK(file.GetData() == nullptr && file.GetSize() == 0);
+    remove(path.c_str());
+}
@@ -0,0 +1,107 @@
+#include "Test.h"
+#include "../shadows/SampleDistribution.h"
+
+#include <random>
+#include <vector>
+
+namespace
+{
+    const float nearZ = 0.1f;
+    const float farZ = 10000.0f;
+
+    // [0, 1] depth of a view distance, as written by the perspective projection
+    float ProjectDistance(float distance)
+    {
+        return (farZ / (nearZ - farZ) * -distance + nearZ * farZ / (nearZ - farZ)) / distance;
+    }
+}
+
+TEST(SampleDistributionLinearizeDepth)
+{
+    for (float distance = 0.1f; distance < 1000.0f; distance *= 1.3f)
+    {
+        float depth = ProjectDistance(distance);
+        CHECK(depth >= -1e-6f && depth <= 1.0001f);
+        CHECK_NEAR(LinearizeDepth(depth, nearZ, farZ), distance, distance * 2e-2f);
+    }
+}
+
+TEST(SampleDistributionReduceDepthRange)
+{
+    // Only a part of every row is reduced, the padding holds depths that must be skipped
+    const uint32_t width = 60;
+    const uint32_t height = 48;
+    const size_t rowPitch = 64;
+    std::vector<float> depth(rowPitch * height, 1.0f);
+    DepthRange range = ReduceDepthRange(depth.data(), width, height, rowPitch, nearZ, farZ);
+    CHECK(!range.valid);
+
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (int image = 0; image < 100; ++image)
+    {
+        float low = 1.0f + unit(random) * 200.0f;
+        float high = low + 1.0f + unit(random) * 600.0f;
+        float minDepth = 1.0f;
+        float maxDepth = 0.0f;
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            for (uint32_t x = 0; x < rowPitch; ++x)
+            {
+                float value = unit(random) < 0.3f ? 1.0f : ProjectDistance(low + (high - low) * unit(random));
+                if (x >= width)
+                    value = ProjectDistance(0.5f);
+                else if (value < 1.0f)
+                {
+                    minDepth = value < minDepth ? value : minDepth;
+                    maxDepth = value > maxDepth ? value : maxDepth;
+                }
+                depth[y * rowPitch + x] = value;
+            }
+        }
+        range = ReduceDepthRange(depth.data(), width, height, rowPitch, nearZ, farZ);
+        CHECK(range.valid);
+        CHECK(range.minDistance == LinearizeDepth(minDepth, nearZ, farZ));
+        CHECK(range.maxDistance == LinearizeDepth(maxDepth, nearZ, farZ));
+    }
+}
+
+TEST(SampleDistributionSplitsCoverTheRange)
+{
+    float splits[5];
+    DepthRange invalid = { farZ, nearZ, false };
+    FitSampleDistributionSplits(invalid, CASCADE_SPLIT_SCHEME::UNIFORM, 0.0f, nearZ, 1000.0f, 4, splits);
+    CHECK(splits[0] == nearZ);
+    CHECK(splits[4] == 1000.0f);
+
+    std::mt19937 random(8);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (int i = 0; i < 500; ++i)
+    {
+        float minDistance = 1.0f + unit(random) * 200.0f;
+        DepthRange range = { minDistance, minDistance + 1.0f + unit(random) * 1200.0f, true };
+        FitSampleDistributionSplits(range, CASCADE_SPLIT_SCHEME::PRACTICAL, 0.5f, nearZ, 1000.0f, 4, splits);
+
+        // Covers the visible range, widened by less than an eighth of an octave and clamped to the limits
+        float maxDistance = range.maxDistance < 1000.0f ? range.maxDistance : 1000.0f;
+        CHECK(splits[0] <= range.minDistance * 1.0001f);
+        CHECK(splits[4] >= maxDistance * 0.9999f);
+        CHECK(splits[0] >= range.minDistance / 1.1f);
+        CHECK(splits[4] <= 1000.0f);
+        CHECK(splits[4] <= maxDistance * 1.1f || splits[4] <= splits[0] * 1.2501f);
+        for (int cascade = 0; cascade < 4; ++cascade)
+            CHECK(splits[cascade] < splits[cascade + 1]);
+    }
+}
+
+TEST(SampleDistributionSplitsStayForSmallChanges)
+{
+    DepthRange range = { 50.0f, 300.0f, true };
+    DepthRange moved = { 50.5f, 301.0f, true };
+    float splits[5];
+    float movedSplits[5];
+    FitSampleDistributionSplits(range, CASCADE_SPLIT_SCHEME::LOGARITHMIC, 0.0f, nearZ, 1000.0f, 4, splits);
+    FitSampleDistributionSplits(moved, CASCADE_SPLIT_SCHEME::LOGARITHMIC, 0.0f, nearZ, 1000.0f, 4, movedSplits);
+    for (int i = 0; i < 5; ++i)
+        CHECK(splits[i] == movedSplits[i]);
+}
@@ -0,0 +1,158 @@
+#include "Test.h"
+#include "../shadows/CacheFile.h"
+#include "../shadows/ShaderCache.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <thread>
+
+namespace
+{
+    void WriteTextFile(const std::string& path, const std::string& text)
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file << text;
+    }
+
+    std::string CreateSourceDirectory()
+    {
+        std::string directory = CreateCacheDirectory(GetTemporaryDirectory() + "shadows_tests_sources");
+        CreateCacheDirectory(directory + "sub");
+        return directory;
+    }
+}
+
+TEST(ShaderSourceHasherFollowsIncludes)
+{
+    std::string directory = CreateSourceDirectory();
+    std::string main = directory + "main.fx";
+    // Includes in comments are followed as well, an include cycle is hashed once
+    WriteTextFile(main, "#include \"common.fx\"\n  #  include <sub/lighting.fx>\n// #include \"missing.fx\"\nfloat4 main() { return 0; }\n");
+    WriteTextFile(directory + "common.fx", "#include \"main.fx\"\nstatic float x;\n");
+    WriteTextFile(directory + "sub/lighting.fx", "static float y;\n");
+
+    ShaderSourceHasher hasher;
+    uint64_t hash;
+    CHECK(hasher.HashSource(main, hash));
+    std::vector<std::string> dependencies = hasher.GetDependencies(main);
+    CHECK(dependencies.size() == 3);
+    if (dependencies.size() == 3)
+    {
+        CHECK(dependencies[0] == main);
+        CHECK(dependencies[1].find("common.fx") != std::string::npos);
+        CHECK(dependencies[2].find("lighting.fx") != std::string::npos);
+    }
+
+    // Files are remembered until Clear, a change of an included file changes the hash then
+    uint64_t rememberedHash;
+    WriteTextFile(directory + "sub/lighting.fx", "static float z;\n");
+    CHECK(hasher.HashSource(main, rememberedHash));
+    CHECK(rememberedHash == hash);
+    hasher.Clear();
+    uint64_t changedHash;
+    CHECK(hasher.HashSource(main, changedHash));
+    CHECK(changedHash != hash);
+
+    CHECK(!hasher.HashSource(directory + "nonexistent.fx", hash));
+}
+
+TEST(ShaderCacheKeys)
+{
+    ShaderCompileRequest request = { "main.fx", "ps_main", "ps_5_0", { { "A", "1" } }, 1, 47 };
+    uint64_t key = ComputeShaderKey(request, 1);
+    CHECK(ComputeShaderKey(request, 1) == key);
+    CHECK(ComputeShaderKey(request, 2) != key);
+
+    ShaderCompileRequest changed = request;
+    changed.defines.push_back({ "B", "1" });
+    CHECK(ComputeShaderKey(changed, 1) != key);
+    changed = request;
+    changed.defines[0].value = "2";
+    CHECK(ComputeShaderKey(changed, 1) != key);
+    changed = request;
+    changed.flags = 2;
+    CHECK(ComputeShaderKey(changed, 1) != key);
+    changed = request;
+    changed.entryPoint = "vs_main";
+    CHECK(ComputeShaderKey(changed, 1) != key);
+    changed = request;
+    changed.compilerVersion = 48;
+    CHECK(ComputeShaderKey(changed, 1) != key);
+
+    // Name and value boundaries are part of the key
+    changed = request;
+    changed.defines[0] = { "A1", "" };
+    CHECK(ComputeShaderKey(changed, 1) != key);
+
+    // FNV-1a of "a"
+    CHECK(HashShaderBytes("a", 1) == 0xAF63DC4C8601EC8Cull);
+}
+
+TEST(ShaderCacheStoreAndLoad)
+{
+    ShaderCache cache(GetTemporaryDirectory() + "shadows_tests_shader_cache");
+    const uint64_t key = 0x1234567890ABCDEFull;
+    const uint64_t otherKey = key + 1;
+    remove(cache.GetPath(key).c_str());
+    remove(cache.GetPath(otherKey).c_str());
+
+    std::vector<uint8_t> loaded;
+    CHECK(!cache.Load(key, loaded));
+    std::vector<uint8_t> bytecode(1000);
+    for (size_t i = 0; i < bytecode.size(); ++i)
+        bytecode[i] = static_cast<uint8_t>(i * 7);
+    CHECK(cache.Store(key, bytecode.data(), bytecode.size()));
+    CHECK(cache.Load(key, loaded));
+    CHECK(loaded == bytecode);
+
+    // A new entry replaces the old one
+    CHECK(cache.Store(key, bytecode.data(), 10));
+    CHECK(cache.Load(key, loaded));
+    CHECK(loaded.size() == 10);
+
+    // Truncated files and files of another key are misses
+    WriteTextFile(cache.GetPath(otherKey), "DCSHxxxx");
+    CHECK(!cache.Load(otherKey, loaded));
+    std::ifstream source(cache.GetPath(key), std::ios::binary);
+    std::string contents((std::istreambuf_iterator<char>(source)), std::istreambuf_iterator<char>());
+    source.close();
+    WriteTextFile(cache.GetPath(otherKey), contents);
+    CHECK(!cache.Load(otherKey, loaded));
+    WriteTextFile(cache.GetPath(key), contents.substr(0, contents.size() - 1));
+    CHECK(!cache.Load(key, loaded));
+}
+
+TEST(ShaderCacheConcurrentWrites)
+{
+    // Threads storing the same key never let a reader see a partial file
+    ShaderCache cache(GetTemporaryDirectory() + "shadows_tests_shader_cache");
+    const uint64_t key = 0xFEDCBA0987654321ull;
+    std::vector<uint8_t> bytecode(4096);
+    for (size_t i = 0; i < bytecode.size(); ++i)
+        bytecode[i] = static_cast<uint8_t>(i * 13);
+
+    std::vector<int> mismatches(8, 0);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < mismatches.size(); ++t)
+    {
+        threads.emplace_back([&, t]()
+        {
+            for (int i = 0; i < 50; ++i)
+            {
+                cache.Store(key, bytecode.data(), bytecode.size());
+                std::vector<uint8_t> loaded;
+                if (cache.Load(key, loaded) && loaded != bytecode)
+                    ++mismatches[t];
+            }
+        });
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+    for (int count : mismatches)
+        CHECK(count == 0);
+
+    std::vector<uint8_t> loaded;
+    CHECK(cache.Load(key, loaded));
+    CHECK(loaded == bytecode);
+}
@@ -0,0 +1,187 @@
+#include "Test.h"
+#include "../shadows/ShadowAtlas.h"
+
+#include <random>
+
+namespace
+{
+    const uint32_t atlasSize = 4096;
+    const uint32_t minTileSize = 128;
+    const uint32_t maxTileSize = 2048;
+
+    bool IsPowerOfTwo(uint32_t value)
+    {
+        return value != 0 && (value & (value - 1)) == 0;
+    }
+
+    // Tiles are inside of the atlas, don't overlap and respect the budget and the size limits.
+    // Returns the number of tiles that didn't fit.
+    uint32_t CheckLayout(const ShadowAtlas& atlas, uint64_t texelBudget)
+    {
+        uint32_t unplaced = 0;
+        for (uint32_t i = 0; i < atlas.GetTileCount(); ++i)
+        {
+            const ShadowAtlasTile& tile = atlas.GetTile(i);
+            if (tile.size == 0)
+            {
+                ++unplaced;
+                continue;
+            }
+            CHECK(IsPowerOfTwo(tile.size));
+            CHECK(tile.size >= minTileSize && tile.size <= maxTileSize);
+            CHECK(tile.x + tile.size <= atlas.GetSize() && tile.y + tile.size <= atlas.GetSize());
+            for (uint32_t j = i + 1; j < atlas.GetTileCount(); ++j)
+            {
+                const ShadowAtlasTile& other = atlas.GetTile(j);
+                if (other.size == 0)
+                    continue;
+                bool overlap = tile.x < other.x + other.size && other.x < tile.x + tile.size &&
+                    tile.y < other.y + other.size && other.y < tile.y + tile.size;
+                CHECK(!overlap);
+            }
+        }
+        uint64_t atlasTexels = static_cast<uint64_t>(atlas.GetSize()) * atlas.GetSize();
+        uint64_t minTexels = static_cast<uint64_t>(minTileSize) * minTileSize * atlas.GetTileCount();
+        if (minTexels <= texelBudget && minTexels <= atlasTexels)
+            CHECK(atlas.GetUsedTexels() <= (texelBudget < atlasTexels ? texelBudget : atlasTexels));
+        return unplaced;
+    }
+}
+
+TEST(ShadowAtlasSingleLight)
+{
+    ShadowAtlas atlas(atlasSize);
+    atlas.SetTileSizeLimits(minTileSize, maxTileSize);
+    const uint64_t budget = 8u << 20;
+    float resolutions[4] = { 1e9f, 3000.0f, 700.0f, 90.0f };
+    CHECK(atlas.Allocate(resolutions, 4, budget));
+    CHECK(CheckLayout(atlas, budget) == 0);
+    CHECK(atlas.GetTile(3).size == minTileSize);
+    CHECK(atlas.GetTile(1).size >= atlas.GetTile(2).size);
+
+    // Same or slightly different resolutions keep the layout, a large change doesn't
+    CHECK(!atlas.Allocate(resolutions, 4, budget));
+    float close[4] = { 1e9f, 3100.0f, 760.0f, 95.0f };
+    CHECK(!atlas.Allocate(close, 4, budget));
+    float far[4] = { 1e9f, 3000.0f, 2000.0f, 90.0f };
+    CHECK(atlas.Allocate(far, 4, budget));
+    CHECK(CheckLayout(atlas, budget) == 0);
+}
+
+TEST(ShadowAtlasManyLightsUnderBudget)
+{
+    // Lights times cascades tiles, the app packs NUM_LIGHTS * 4 of them
+    std::mt19937 random(10);
+    std::uniform_real_distribution<float> resolution(32.0f, 5000.0f);
+    const uint32_t lightCounts[] = { 1, 2, 4, 8, 16 };
+    const uint64_t budgets[] = { 1u << 20, 4u << 20, 8u << 20, 16u << 20, 64u << 20 };
+    for (uint32_t lightCount : lightCounts)
+    {
+        for (uint64_t budget : budgets)
+        {
+            ShadowAtlas atlas(atlasSize);
+            atlas.SetTileSizeLimits(minTileSize, maxTileSize);
+            uint32_t tileCount = lightCount * 4;
+            std::vector<float> resolutions(tileCount);
+            for (int frame = 0; frame < 10; ++frame)
+            {
+                for (float& value : resolutions)
+                    value = resolution(random);
+                atlas.Allocate(resolutions.data(), tileCount, budget);
+                CHECK(atlas.GetTileCount() == tileCount);
+                // Even the smallest budget holds 64 minimum size tiles, so every tile is placed
+                CHECK(CheckLayout(atlas, budget) == 0);
+            }
+        }
+    }
+}
+
+TEST(ShadowAtlasMoreTilesThanFit)
+{
+    // 32 minimum size tiles into an atlas that holds 16 of them: the placed ones are valid, the rest get no texels
+    ShadowAtlas atlas(512);
+    atlas.SetTileSizeLimits(minTileSize, maxTileSize);
+    std::vector<float> resolutions(32, 4096.0f);
+    CHECK(atlas.Allocate(resolutions.data(), 32, 64u << 20));
+    CHECK(CheckLayout(atlas, 64u << 20) == 16);
+    CHECK(atlas.GetUsedTexels() == 512u * 512u);
+}
+
+TEST(ShadowAtlasLightsWithoutShadows)
+{
+    // Lights that are off want no tile, their share of the budget goes to the others
+    ShadowAtlas atlas(atlasSize);
+    atlas.SetTileSizeLimits(minTileSize, maxTileSize);
+    const uint64_t budget = 4u << 20;
+    float resolutions[3] = { 4096.0f, 0.0f, 4096.0f };
+    CHECK(atlas.Allocate(resolutions, 3, budget));
+    CHECK(CheckLayout(atlas, budget) == 1);
+    CHECK(atlas.GetTile(1).size == 0);
+    CHECK(atlas.GetTile(0).size == 1024 && atlas.GetTile(2).size == 1024);
+
+    float allOn[3] = { 4096.0f, 4096.0f, 4096.0f };
+    CHECK(atlas.Allocate(allOn, 3, budget));
+    CHECK(CheckLayout(atlas, budget) == 0);
+    CHECK(atlas.GetTile(1).size > 0);
+}
+
+TEST(ShadowAtlasRelativeImportance)
+{
+    // Every tile shrinks by the same share, so nearer cascades of every light keep more texels than farther ones
+    const uint32_t lightCount = 6;
+    std::vector<float> resolutions;
+    for (uint32_t light = 0; light < lightCount; ++light)
+    {
+        const float cascades[4] = { 4000.0f, 2000.0f, 1000.0f, 500.0f };
+        resolutions.insert(resolutions.end(), cascades, cascades + 4);
+    }
+    ShadowAtlas atlas(atlasSize);
+    atlas.SetTileSizeLimits(minTileSize, maxTileSize);
+    const uint64_t budget = 6u << 20;
+    atlas.Allocate(resolutions.data(), lightCount * 4, budget);
+    CHECK(CheckLayout(atlas, budget) == 0);
+    for (uint32_t light = 0; light < lightCount; ++light)
+        for (uint32_t cascade = 1; cascade < 4; ++cascade)
+            CHECK(atlas.GetTile(light * 4 + cascade - 1).size >= atlas.GetTile(light * 4 + cascade).size);
+}
+
+TEST(ShadowAtlasStableForAMovingCamera)
+{
+    // Cascades of several lights sized from a camera that moves a little every frame only repack a few times
+    CascadeCamera camera = { { 0.0f, 10.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }, 1.0f, 0.75f };
+    const float splits[5] = { 1.0f, 10.0f, 40.0f, 150.0f, 500.0f };
+    const uint32_t lightCount = 4;
+    ShadowAtlas atlas(atlasSize);
+    atlas.SetTileSizeLimits(minTileSize, maxTileSize);
+    const uint64_t budget = 8u << 20;
+    int layouts = 0;
+    std::vector<float> resolutions(lightCount * 4);
+    for (int frame = 0; frame < 300; ++frame)
+    {
+        camera.position.z = frame * 0.05f;
+        for (uint32_t light = 0; light < lightCount; ++light)
+        {
+            for (uint32_t split = 0; split < 4; ++split)
+            {
+                BoundingSphere sphere = FitCascadeSphere(camera, splits[split], splits[split + 1]);
+                resolutions[light * 4 + split] = EstimateShadowResolution(camera, 1080.0f, sphere, splits[split]) / (1.0f + light);
+            }
+        }
+        layouts += atlas.Allocate(resolutions.data(), lightCount * 4, budget) ? 1 : 0;
+        CHECK(CheckLayout(atlas, budget) == 0);
+    }
+    CHECK(layouts == 1);
+}
+
+TEST(ShadowAtlasEstimateResolution)
+{
+    CascadeCamera camera = { { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }, 1.0f, 1.0f };
+    BoundingSphere region = { { 0.0f, 0.0f, 100.0f }, 10.0f };
+    CHECK_NEAR(EstimateShadowResolution(camera, 1000.0f, region, 0.0f), 10.0f * 1000.0f / 90.0f, 1e-2f);
+
+    // Twice as far needs fewer texels, a region around the camera is clamped to the minimum distance
+    BoundingSphere farRegion = { { 0.0f, 0.0f, 190.0f }, 10.0f };
+    CHECK(EstimateShadowResolution(camera, 1000.0f, farRegion, 0.0f) < EstimateShadowResolution(camera, 1000.0f, region, 0.0f));
+    BoundingSphere around = { { 0.0f, 0.0f, 1.0f }, 10.0f };
+    CHECK_NEAR(EstimateShadowResolution(camera, 1000.0f, around, 5.0f), 10.0f * 1000.0f / 5.0f, 1e-2f);
+}
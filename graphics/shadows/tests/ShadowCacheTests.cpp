@@ -0,0 +1,93 @@
+#include "Test.h"
+#include "../shadows/ShadowCache.h"
+
+TEST(ShadowCacheTrackerDetectsChanges)
+{
+    ShadowCacheTracker tracker;
+    float matrix[16] = { 1.0f };
+
+    // The first frame has nothing to compare with
+    tracker.BeginFrame();
+    tracker.AddValue(matrix);
+    CHECK(tracker.EndFrame());
+
+    tracker.BeginFrame();
+    tracker.AddValue(matrix);
+    CHECK(!tracker.EndFrame());
+
+    matrix[3] = 2.0f;
+    tracker.BeginFrame();
+    tracker.AddValue(matrix);
+    CHECK(tracker.EndFrame());
+
+    // A value appended to the same state is a change as well
+    tracker.BeginFrame();
+    tracker.AddValue(matrix);
+    tracker.AddValue(1);
+    CHECK(tracker.EndFrame());
+
+    tracker.BeginFrame();
+    tracker.AddValue(matrix);
+    tracker.AddValue(1);
+    CHECK(!tracker.EndFrame());
+
+    tracker.Invalidate();
+    tracker.BeginFrame();
+    tracker.AddValue(matrix);
+    tracker.AddValue(1);
+    CHECK(tracker.EndFrame());
+}
+
+TEST(ShadowCascadeCacheKeepsBoundsWithinATexel)
+{
+    ShadowCascadeCache cache(2);
+    CHECK(cache.GetCascadeCount() == 2);
+
+    // 1024 units over 1024 texels, a texel is one unit
+    ShadowCascadeBounds bounds = { { 0.0f, 0.0f, 0.0f }, { 1024.0f, 1024.0f, 1024.0f } };
+    CHECK(cache.Update(0, bounds, 1024));
+    CHECK(!cache.Update(0, bounds, 1024));
+
+    bounds.minPoint[0] = 0.9f;
+    CHECK(!cache.Update(0, bounds, 1024));
+    CHECK(cache.GetBounds(0).minPoint[0] == 0.0f);
+
+    bounds.minPoint[0] = 1.5f;
+    CHECK(cache.Update(0, bounds, 1024));
+    CHECK(cache.GetBounds(0).minPoint[0] == 1.5f);
+
+    // A smaller map has larger texels
+    bounds.maxPoint[2] = 1030.0f;
+    CHECK(!cache.HasMoved(0, bounds, 64));
+    CHECK(cache.HasMoved(0, bounds, 1024));
+
+    CHECK(cache.Update(1, bounds, 1024));
+    cache.Invalidate();
+    CHECK(cache.Update(1, bounds, 1024));
+    CHECK(cache.HasMoved(0, bounds, 64));
+}
+
+TEST(ShadowCascadeCacheSeparateStore)
+{
+    // A moved cascade that isn't rendered this frame keeps reporting the move
+    ShadowCascadeCache cache(1);
+    ShadowCascadeBounds bounds = { { 0.0f, 0.0f, 0.0f }, { 100.0f, 100.0f, 100.0f } };
+    cache.Store(0, bounds);
+    bounds.maxPoint[1] = 120.0f;
+    CHECK(cache.HasMoved(0, bounds, 512));
+    CHECK(cache.HasMoved(0, bounds, 512));
+    cache.Store(0, bounds);
+    CHECK(!cache.HasMoved(0, bounds, 512));
+
+    cache.Resize(3);
+    CHECK(cache.HasMoved(2, bounds, 512));
+}
+
+TEST(ShadowCascadeCacheRejectsNaN)
+{
+    ShadowCascadeCache cache(1);
+    ShadowCascadeBounds bounds = { { 0.0f, 0.0f, 0.0f }, { 100.0f, 100.0f, 100.0f } };
+    cache.Store(0, bounds);
+    bounds.minPoint[1] = std::nanf("");
+    CHECK(cache.HasMoved(0, bounds, 512));
+}
@@ -0,0 +1,114 @@
+#include "Test.h"
+#include "../shadows/ShadowCascadePlanner.h"
+
+#include <random>
+
+namespace
+{
+    // Orthographic box over [x0, x1] in x and [-100, 100] in y and z
+    Frustum SlabFrustum(float x0, float x1)
+    {
+        const float matrix[4][4] = {
+            { 2.0f / (x1 - x0), 0.0f, 0.0f, 0.0f },
+            { 0.0f, 0.01f, 0.0f, 0.0f },
+            { 0.0f, 0.0f, 0.005f, 0.0f },
+            { -(x1 + x0) / (x1 - x0), 0.0f, 0.5f, 1.0f }
+        };
+        return FrustumFromMatrix(matrix);
+    }
+}
+
+TEST(ShadowCascadePlannerInstances)
+{
+    CascadeInstances instances = GetCascadeInstances(0xA);
+    CHECK(instances.count == 2);
+    CHECK(instances.slices[0] == 1);
+    CHECK(instances.slices[1] == 3);
+    CHECK(GetCascadeInstances(0).count == 0);
+    CHECK(GetCascadeInstances(0xF).count == 4);
+}
+
+TEST(ShadowCascadePlannerOverlappingCascades)
+{
+    // Boxes in a row along x, two cascades overlapping around x = 30
+    std::vector<AABB> boxes;
+    for (int i = 0; i < 8; ++i)
+    {
+        AABB box;
+        box.min = { i * 10.0f, 0.0f, 0.0f };
+        box.max = { i * 10.0f + 1.0f, 1.0f, 1.0f };
+        boxes.push_back(box);
+    }
+    BoundingVolumeHierarchy bvh;
+    bvh.Build(boxes);
+    const Frustum cascades[2] = { SlabFrustum(-5.0f, 35.0f), SlabFrustum(25.0f, 100.0f) };
+
+    ShadowCascadePlanner planner;
+    planner.Plan(bvh, cascades, 2, 3);
+    CHECK(planner.GetMasks()[0] == 1);
+    CHECK(planner.GetMasks()[3] == 3);
+    CHECK(planner.GetMasks()[7] == 2);
+    CHECK(planner.GetInstancedDrawCount() == 8);
+    CHECK(planner.GetInstanceCount() == 9);
+    CHECK(planner.GetPerCascadeDrawCount() == 16);
+
+    // A cached cascade isn't planned
+    planner.Plan(bvh, cascades, 2, 2);
+    CHECK(planner.GetMasks()[0] == 0);
+    CHECK(planner.GetMasks()[3] == 2);
+    CHECK(planner.GetInstancedDrawCount() == 5);
+    CHECK(planner.GetInstanceCount() == 5);
+    CHECK(planner.GetPerCascadeDrawCount() == 8);
+}
+
+TEST(ShadowCascadePlannerMatchesBruteForce)
+{
+    std::mt19937 random(4);
+    std::uniform_real_distribution<float> position(-150.0f, 150.0f);
+    std::uniform_real_distribution<float> extent(0.1f, 8.0f);
+    std::vector<AABB> boxes(3000);
+    for (AABB& box : boxes)
+    {
+        Float3 center = { position(random), position(random) * 0.5f, position(random) * 0.5f };
+        float half = extent(random);
+        box.min = { center.x - half, center.y - half, center.z - half };
+        box.max = { center.x + half, center.y + half, center.z + half };
+    }
+    BoundingVolumeHierarchy bvh;
+    bvh.Build(boxes);
+
+    const Frustum cascades[MAX_SHADOW_CASCADES] = {
+        SlabFrustum(-20.0f, 10.0f), SlabFrustum(0.0f, 40.0f), SlabFrustum(30.0f, 90.0f), SlabFrustum(-100.0f, 140.0f)
+    };
+    ShadowCascadePlanner planner;
+    for (uint32_t updateMask = 0; updateMask < 16; ++updateMask)
+    {
+        planner.Plan(bvh, cascades, MAX_SHADOW_CASCADES, updateMask);
+        uint32_t draws = 0;
+        uint32_t instances = 0;
+        for (size_t i = 0; i < boxes.size(); ++i)
+        {
+            uint32_t mask = 0;
+            for (uint32_t cascade = 0; cascade < MAX_SHADOW_CASCADES; ++cascade)
+                if ((updateMask & (1u << cascade)) && Intersects(boxes[i], cascades[cascade]))
+                    mask |= 1u << cascade;
+            CHECK(planner.GetMasks()[i] == mask);
+            draws += mask != 0 ? 1 : 0;
+            instances += GetCascadeInstances(mask).count;
+        }
+        CHECK(planner.GetInstancedDrawCount() == draws);
+        CHECK(planner.GetInstanceCount() == instances);
+        CHECK(planner.GetInstanceCount() <= planner.GetPerCascadeDrawCount());
+    }
+}
+
+TEST(ShadowCascadePlannerEmptyHierarchy)
+{
+    BoundingVolumeHierarchy bvh;
+    const Frustum cascades[1] = { SlabFrustum(0.0f, 1.0f) };
+    ShadowCascadePlanner planner;
+    planner.Plan(bvh, cascades, 1, 1);
+    CHECK(planner.GetMasks().empty());
+    CHECK(planner.GetInstancedDrawCount() == 0);
+    CHECK(planner.GetInstanceCount() == 0);
+}
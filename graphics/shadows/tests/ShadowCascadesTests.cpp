@@ -0,0 +1,129 @@
+#include "Test.h"
+#include "../shadows/ShadowCascades.h"
+
+#include <random>
+
+TEST(ShadowCascadesSplits)
+{
+    float splits[5];
+    ComputeCascadeSplits(CASCADE_SPLIT_SCHEME::UNIFORM, 0.3f, 0.1f, 1000.1f, 4, splits);
+    CHECK_NEAR(splits[1], 250.1f, 1e-2f);
+    CHECK(splits[0] == 0.1f);
+    CHECK(splits[4] == 1000.1f);
+
+    ComputeCascadeSplits(CASCADE_SPLIT_SCHEME::LOGARITHMIC, 0.0f, 1.0f, 10000.0f, 4, splits);
+    CHECK_NEAR(splits[1], 10.0f, 1e-3f);
+    CHECK_NEAR(splits[2], 100.0f, 1e-2f);
+
+    ComputeCascadeSplits(CASCADE_SPLIT_SCHEME::PRACTICAL, 0.5f, 1.0f, 10000.0f, 4, splits);
+    CHECK_NEAR(splits[2], 0.5f * 100.0f + 0.5f * 5000.5f, 0.1f);
+    for (int i = 1; i < 5; ++i)
+        CHECK(splits[i] > splits[i - 1]);
+}
+
+TEST(ShadowCascadesLightView)
+{
+    std::mt19937 random(6);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    const AABB box = { { -1.0f, -2.0f, -3.0f }, { 4.0f, 5.0f, 6.0f } };
+    for (int i = 0; i < 1000; ++i)
+    {
+        Float3 towardsLight = { unit(random), unit(random) * 0.5f + 0.5f, unit(random) };
+        float view[4][4];
+        ComputeLightView(towardsLight, view);
+
+        // The SSE corners match the scalar transform
+        AABB scalar = TransformAABB(box, view);
+        AABB corners = TransformAABBCorners(box, view);
+        CHECK_NEAR(scalar.min.x, corners.min.x, 1e-4f);
+        CHECK_NEAR(scalar.min.y, corners.min.y, 1e-4f);
+        CHECK_NEAR(scalar.min.z, corners.min.z, 1e-4f);
+        CHECK_NEAR(scalar.max.x, corners.max.x, 1e-4f);
+        CHECK_NEAR(scalar.max.y, corners.max.y, 1e-4f);
+        CHECK_NEAR(scalar.max.z, corners.max.z, 1e-4f);
+
+        // Points towards the light are closer to it, the view is a rotation
+        float length = sqrtf(towardsLight.x * towardsLight.x + towardsLight.y * towardsLight.y + towardsLight.z * towardsLight.z);
+        Float3 origin = { 0.0f, 0.0f, 0.0f };
+        Float3 lit = { towardsLight.x / length * 3.0f, towardsLight.y / length * 3.0f, towardsLight.z / length * 3.0f };
+        AABB originBox = TransformAABBCorners({ origin, origin }, view);
+        AABB litBox = TransformAABBCorners({ lit, lit }, view);
+        CHECK_NEAR(litBox.min.z - originBox.min.z, -3.0f, 1e-3f);
+        CHECK_NEAR(litBox.min.x, originBox.min.x, 1e-3f);
+        CHECK_NEAR(litBox.min.y, originBox.min.y, 1e-3f);
+    }
+}
+
+TEST(ShadowCascadesSphereCoversTheSlice)
+{
+    const float tangents[2] = { 1.5f, 1.0f };
+    CascadeCamera camera = { { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, -1.0f }, tangents[0], tangents[1] };
+    for (float nearSplit = 0.1f; nearSplit < 1000.0f; nearSplit *= 1.7f)
+    {
+        float farSplit = nearSplit * 2.3f;
+        BoundingSphere sphere = FitCascadeSphere(camera, nearSplit, farSplit);
+        for (int corner = 0; corner < 8; ++corner)
+        {
+            float distance = (corner & 4) ? farSplit : nearSplit;
+            float x = ((corner & 1) ? 1.0f : -1.0f) * distance * tangents[0] - sphere.center.x;
+            float y = ((corner & 2) ? 1.0f : -1.0f) * distance * tangents[1] - sphere.center.y;
+            float z = -distance - sphere.center.z;
+            CHECK(sqrtf(x * x + y * y + z * z) <= sphere.radius * 1.0001f);
+        }
+    }
+}
+
+TEST(ShadowCascadesBoundsSnapToTexels)
+{
+    float view[4][4];
+    ComputeLightView({ 0.3f, 1.0f, 0.2f }, view);
+    const AABB casters[1] = { { { -750.0f, 0.0f, -750.0f }, { 750.0f, 0.0f, 750.0f } } };
+    const uint32_t mapSize = 1024;
+    CascadeCamera camera = { { 0.0f, 10.0f, 0.0f }, { 0.0f, 0.0f, -1.0f }, 1.5f, 1.0f };
+    ShadowCascadeBounds previous = {};
+    for (int frame = 0; frame < 200; ++frame)
+    {
+        // Moving the camera only moves the window in whole texels, its size stays the same
+        camera.position = { frame * 0.37f, 10.0f, frame * 0.11f };
+        BoundingSphere sphere = FitCascadeSphere(camera, 10.0f, 100.0f);
+        ShadowCascadeBounds bounds = FitCascadeBounds(sphere, view, mapSize, casters, 1);
+        float texel = 2.0f * sphere.radius / (mapSize - 1);
+        for (int axis = 0; axis < 2; ++axis)
+        {
+            float texels = bounds.minPoint[axis] / texel;
+            CHECK_NEAR(texels, roundf(texels), 1e-2f);
+            if (frame > 0)
+                CHECK_NEAR(bounds.maxPoint[axis] - bounds.minPoint[axis], previous.maxPoint[axis] - previous.minPoint[axis], 1e-3f);
+        }
+
+        // The window still covers the sphere
+        AABB center = TransformAABBCorners({ sphere.center, sphere.center }, view);
+        CHECK(bounds.minPoint[0] <= center.min.x - sphere.radius && bounds.maxPoint[0] >= center.min.x + sphere.radius);
+        CHECK(bounds.minPoint[1] <= center.min.y - sphere.radius && bounds.maxPoint[1] >= center.min.y + sphere.radius);
+        CHECK(bounds.minPoint[2] < bounds.maxPoint[2]);
+        previous = bounds;
+    }
+}
+
+TEST(ShadowCascadesDepthFollowsCasters)
+{
+    float view[4][4];
+    ComputeLightView({ 0.0f, 1.0f, 0.0f }, view);
+    BoundingSphere sphere = { { 0.0f, 0.0f, 0.0f }, 10.0f };
+    AABB sphereBox = TransformAABBCorners({ sphere.center, sphere.center }, view);
+
+    // Without casters the depth range is the sphere
+    ShadowCascadeBounds bounds = FitCascadeBounds(sphere, view, 512, nullptr, 0);
+    CHECK_NEAR(bounds.minPoint[2], sphereBox.min.z - 10.0f, 1e-3f);
+    CHECK_NEAR(bounds.maxPoint[2], sphereBox.min.z + 10.0f, 1e-3f);
+
+    // A caster high above the sphere pulls the near plane towards the light, one outside of the window is ignored
+    const AABB casters[2] = {
+        { { -1.0f, 50.0f, -1.0f }, { 1.0f, 51.0f, 1.0f } },
+        { { 500.0f, 80.0f, 500.0f }, { 501.0f, 90.0f, 501.0f } }
+    };
+    bounds = FitCascadeBounds(sphere, view, 512, casters, 2);
+    AABB caster = TransformAABBCorners(casters[0], view);
+    CHECK_NEAR(bounds.minPoint[2], caster.min.z, 1e-3f);
+    CHECK_NEAR(bounds.maxPoint[2], caster.max.z, 1e-3f);
+}
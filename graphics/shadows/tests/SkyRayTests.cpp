@@ -0,0 +1,160 @@
+#include "Test.h"
+#include "../shadows/SkyRay.h"
+
+#include <cmath>
+#include <random>
+
+namespace
+{
+    // XMMatrixLookToRH
+    void LookTo(const float eye[3], const float direction[3], const float up[3], float view[4][4])
+    {
+        float z[3] = { -direction[0], -direction[1], -direction[2] };
+        float length = std::sqrt(z[0] * z[0] + z[1] * z[1] + z[2] * z[2]);
+        for (float& value : z)
+            value /= length;
+        float x[3] = { up[1] * z[2] - up[2] * z[1], up[2] * z[0] - up[0] * z[2], up[0] * z[1] - up[1] * z[0] };
+        length = std::sqrt(x[0] * x[0] + x[1] * x[1] + x[2] * x[2]);
+        for (float& value : x)
+            value /= length;
+        float y[3] = { z[1] * x[2] - z[2] * x[1], z[2] * x[0] - z[0] * x[2], z[0] * x[1] - z[1] * x[0] };
+        for (int i = 0; i < 3; ++i)
+        {
+            view[i][0] = x[i];
+            view[i][1] = y[i];
+            view[i][2] = z[i];
+            view[i][3] = 0.0f;
+        }
+        view[3][0] = -(x[0] * eye[0] + x[1] * eye[1] + x[2] * eye[2]);
+        view[3][1] = -(y[0] * eye[0] + y[1] * eye[1] + y[2] * eye[2]);
+        view[3][2] = -(z[0] * eye[0] + z[1] * eye[1] + z[2] * eye[2]);
+        view[3][3] = 1.0f;
+    }
+
+    // XMMatrixPerspectiveFovRH
+    void Perspective(float fov, float aspect, float nearZ, float farZ, float projection[4][4])
+    {
+        float height = 1.0f / std::tan(fov / 2.0f);
+        float range = farZ / (nearZ - farZ);
+        for (int i = 0; i < 4; ++i)
+        {
+            for (int j = 0; j < 4; ++j)
+                projection[i][j] = 0.0f;
+        }
+        projection[0][0] = height / aspect;
+        projection[1][1] = height;
+        projection[2][2] = range;
+        projection[2][3] = -1.0f;
+        projection[3][2] = range * nearZ;
+    }
+
+    void Transform(const double vector[4], const float matrix[4][4], double result[4])
+    {
+        for (int column = 0; column < 4; ++column)
+        {
+            result[column] = 0.0;
+            for (int row = 0; row < 4; ++row)
+                result[column] += vector[row] * matrix[row][column];
+        }
+    }
+}
+
+TEST(SkyRayTriangleCoversScreen)
+{
+    float vertices[3][4];
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        GetSkyTriangleVertex(i, vertices[i]);
+        // At the far plane
+        CHECK(vertices[i][2] == 1.0f && vertices[i][3] == 1.0f);
+    }
+
+    // Clockwise on screen with y up is a negative signed area
+    float area = (vertices[1][0] - vertices[0][0]) * (vertices[2][1] - vertices[0][1]) - (vertices[2][0] - vertices[0][0]) * (vertices[1][1] - vertices[0][1]);
+    CHECK(area < 0.0f);
+
+    // Every corner of the screen is inside all three edges
+    const float corners[4][2] = { { -1.0f, -1.0f }, { -1.0f, 1.0f }, { 1.0f, -1.0f }, { 1.0f, 1.0f } };
+    for (const float* corner : corners)
+    {
+        for (int edge = 0; edge < 3; ++edge)
+        {
+            const float* a = vertices[edge];
+            const float* b = vertices[(edge + 1) % 3];
+            float side = (b[0] - a[0]) * (corner[1] - a[1]) - (b[1] - a[1]) * (corner[0] - a[0]);
+            CHECK(side <= 0.0f);
+        }
+    }
+}
+
+TEST(SkyRayProjectsBack)
+{
+    // A point along the ray of a clip position projects back to it, in front of the camera, wherever the camera is
+    std::mt19937 random(3);
+    std::uniform_real_distribution<float> position(-10000.0f, 10000.0f);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    float projection[4][4];
+    Perspective(3.14159265f / 2.0f, 16.0f / 9.0f, 0.1f, 10000.0f, projection);
+    double maxError = 0.0;
+    for (int i = 0; i < 1000; ++i)
+    {
+        float eye[3] = { position(random), 0.1f * position(random), position(random) };
+        float direction[3] = { unit(random), unit(random), unit(random) };
+        float up[3] = { 0.0f, 1.0f, 0.0f };
+        if (std::fabs(direction[0]) + std::fabs(direction[2]) < 0.01f)
+            continue;
+        float view[4][4];
+        LookTo(eye, direction, up, view);
+        float transform[4][4];
+        CHECK(ComputeSkyRayTransform(view, projection, transform));
+
+        float x = unit(random);
+        float y = unit(random);
+        float ray[3];
+        ReconstructSkyRay(transform, x, y, ray);
+        double length = std::sqrt(static_cast<double>(ray[0]) * ray[0] + static_cast<double>(ray[1]) * ray[1] + static_cast<double>(ray[2]) * ray[2]);
+        double point[4] = { eye[0] + 50.0 * ray[0] / length, eye[1] + 50.0 * ray[1] / length, eye[2] + 50.0 * ray[2] / length, 1.0 };
+        double viewPoint[4];
+        Transform(point, view, viewPoint);
+        double clip[4];
+        Transform(viewPoint, projection, clip);
+        CHECK(clip[3] > 0.0);
+        maxError = std::fmax(maxError, std::fmax(std::fabs(clip[0] / clip[3] - x), std::fabs(clip[1] / clip[3] - y)));
+    }
+    CHECK(maxError < 1e-3);
+}
+
+TEST(SkyRayIgnoresTranslation)
+{
+    float projection[4][4];
+    Perspective(1.0f, 1.5f, 0.5f, 100.0f, projection);
+    const float direction[3] = { 0.3f, -0.2f, -1.0f };
+    const float up[3] = { 0.0f, 1.0f, 0.0f };
+    const float origin[3] = { 0.0f, 0.0f, 0.0f };
+    const float eye[3] = { 500.0f, 20.0f, -300.0f };
+    float view[4][4];
+    float movedView[4][4];
+    LookTo(origin, direction, up, view);
+    LookTo(eye, direction, up, movedView);
+    float transform[4][4];
+    float movedTransform[4][4];
+    CHECK(ComputeSkyRayTransform(view, projection, transform));
+    CHECK(ComputeSkyRayTransform(movedView, projection, movedTransform));
+    for (int i = 0; i < 4; ++i)
+    {
+        for (int j = 0; j < 4; ++j)
+            CHECK_NEAR(transform[i][j], movedTransform[i][j], 1e-4f);
+    }
+
+    // The center of the screen looks along the view direction
+    float ray[3];
+    ReconstructSkyRay(transform, 0.0f, 0.0f, ray);
+    float length = std::sqrt(ray[0] * ray[0] + ray[1] * ray[1] + ray[2] * ray[2]);
+    float directionLength = std::sqrt(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+    for (int i = 0; i < 3; ++i)
+        CHECK_NEAR(ray[i] / length, direction[i] / directionLength, 1e-5f);
+
+    // A singular projection has no rays
+    float singular[4][4] = {};
+    CHECK(!ComputeSkyRayTransform(view, singular, transform));
+}
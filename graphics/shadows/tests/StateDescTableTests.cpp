@@ -0,0 +1,84 @@
+#include "Test.h"
+#include "../shadows/StateDescTable.h"
+
+namespace
+{
+    struct RasterizerDesc
+    {
+        int   fillMode;
+        int   cullMode;
+        int   depthBias;
+        float slopeScaledDepthBias;
+    };
+
+    // Has padding after the byte
+    struct PaddedDesc
+    {
+        int     a;
+        uint8_t b;
+        int     c;
+    };
+}
+
+TEST(StateDescTableIds)
+{
+    StateDescTable<RasterizerDesc> table;
+    bool added = false;
+    const RasterizerDesc solid = { 1, 2, 0, 0.0f };
+    const RasterizerDesc culled = { 1, 3, 0, 0.0f };
+    CHECK(table.Insert(solid, &added) == 0);
+    CHECK(added);
+    CHECK(table.Insert(culled, &added) == 1);
+    CHECK(added);
+    RasterizerDesc same = { 1, 2, 0, 0.0f };
+    CHECK(table.Insert(same, &added) == 0);
+    CHECK(!added);
+
+    CHECK(table.Find(culled) == 1);
+    const RasterizerDesc biased = { 1, 2, 1, 0.0f };
+    CHECK(table.Find(biased) == StateDescTable<RasterizerDesc>::INVALID_ID);
+    CHECK(table.GetCount() == 2);
+    CHECK(table.Get(1).cullMode == 3);
+
+    table.Clear();
+    CHECK(table.GetCount() == 0);
+    CHECK(table.Find(solid) == StateDescTable<RasterizerDesc>::INVALID_ID);
+    CHECK(table.Insert(culled) == 0);
+}
+
+TEST(StateDescTableZeroedPadding)
+{
+    StateDescTable<PaddedDesc> table;
+    PaddedDesc first;
+    memset(&first, 0, sizeof(first));
+    first.a = 1;
+    first.b = 2;
+    first.c = 3;
+    PaddedDesc second;
+    memset(&second, 0, sizeof(second));
+    second.a = 1;
+    second.b = 2;
+    second.c = 3;
+    CHECK(table.Insert(first) == table.Insert(second));
+    CHECK(table.GetCount() == 1);
+}
+
+TEST(StateDescTableManyDescs)
+{
+    // Ids stay dense and in insertion order, every descriptor maps back to itself
+    StateDescTable<RasterizerDesc> table;
+    uint32_t expectedCount = 0;
+    for (int i = 0; i < 10000; ++i)
+    {
+        RasterizerDesc desc = { i % 7, i % 5, i % 11, static_cast<float>(i % 3) };
+        bool added = false;
+        uint32_t id = table.Insert(desc, &added);
+        if (added)
+            CHECK(id == expectedCount++);
+        CHECK(table.Find(desc) == id);
+        CHECK(memcmp(&table.Get(id), &desc, sizeof(desc)) == 0);
+    }
+    // 7, 5, 11 and 3 are coprime, every combination shows up within 10000 descriptors
+    CHECK(table.GetCount() == 7 * 5 * 11 * 3);
+    CHECK(table.GetCount() == expectedCount);
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cmath>
+#include <string>
+
+// Minimal test runner for the modules of the shadows project that don't depend on Direct3D
+typedef void (*TestFunction)();
+
+bool RegisterTest(const char* name, TestFunction function);
+void ReportFailure(const char* file, int line, const char* expression);
+
+// Looks for a file of the shadows project from the tests or the shadows directory
+std::string GetDataPath(const char* name);
+// Directory for files written by the tests, ends with a slash
+std::string GetTemporaryDirectory();
+
+#define TEST(name) \
+    static void name(); \
+    static const bool name##Registered = RegisterTest(#name, name); \
+    static void name()
+
+#define CHECK(expression) \
+    do { if (!(expression)) ReportFailure(__FILE__, __LINE__, #expression); } while (false)
+
+#define CHECK_NEAR(a, b, tolerance) CHECK(std::fabs((a) - (b)) <= (tolerance))
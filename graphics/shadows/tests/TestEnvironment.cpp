@@ -0,0 +1,62 @@
+#include "TestEnvironment.h"
+
+#include <cmath>
+
+namespace
+{
+    const float PI = 3.14159265358979323846f;
+}
+
+void EvaluateTestEnvironment(const float direction[3], float color[3])
+{
+    float length = std::sqrt(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+    float x = direction[0] / length;
+    float y = direction[1] / length;
+    float z = direction[2] / length;
+
+    float stripes = 0.5f + 0.5f * std::sin(6.0f * std::atan2(z, x));
+    if (y >= 0.0f)
+    {
+        color[0] = 0.3f + 0.2f * stripes;
+        color[1] = 0.5f + 0.2f * y;
+        color[2] = 0.9f + 0.3f * y;
+    }
+    else
+    {
+        color[0] = 0.25f + 0.1f * stripes;
+        color[1] = 0.2f;
+        color[2] = 0.1f - 0.05f * y;
+    }
+
+    const float sun[3] = { 0.3f, 0.8f, 0.52f };
+    float cosine = (x * sun[0] + y * sun[1] + z * sun[2]) / std::sqrt(sun[0] * sun[0] + sun[1] * sun[1] + sun[2] * sun[2]);
+    float glow = 40.0f * std::exp(60.0f * (cosine - 1.0f));
+    color[0] += glow;
+    color[1] += glow * 0.9f;
+    color[2] += glow * 0.7f;
+}
+
+EnvironmentImage MakeTestEnvironment(uint32_t width, uint32_t height)
+{
+    EnvironmentImage image;
+    image.width = width;
+    image.height = height;
+    image.pixels.resize(static_cast<size_t>(width) * height * 4);
+    for (uint32_t row = 0; row < height; ++row)
+    {
+        // v = 0.5 - asin(y) / pi and u = 1 - atan2(z, x) / 2pi
+        float v = (row + 0.5f) / height;
+        float y = std::sin((0.5f - v) * PI);
+        float radius = std::sqrt(1.0f - y * y);
+        for (uint32_t column = 0; column < width; ++column)
+        {
+            float u = (column + 0.5f) / width;
+            float angle = (1.0f - u) * 2.0f * PI;
+            float direction[3] = { radius * std::cos(angle), y, radius * std::sin(angle) };
+            float* pixel = &image.pixels[(static_cast<size_t>(row) * width + column) * 4];
+            EvaluateTestEnvironment(direction, pixel);
+            pixel[3] = 1.0f;
+        }
+    }
+    return image;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "../shadows/IBLBaker.h"
+
+// Procedural environment for the IBL tests: a sky gradient over a darker ground, a bright sun and stripes,
+// so every face of a cube made from it has detail up to its edges
+void EvaluateTestEnvironment(const float direction[3], float color[3]);
+
+// Equirectangular image of EvaluateTestEnvironment, texel centers use the lookup of SampleEquirect
+EnvironmentImage MakeTestEnvironment(uint32_t width, uint32_t height);
@@ -0,0 +1,93 @@
+#include "Test.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    struct TestEntry
+    {
+        const char* name;
+        TestFunction function;
+    };
+
+    std::vector<TestEntry>& GetTests()
+    {
+        static std::vector<TestEntry> tests;
+        return tests;
+    }
+
+    int g_failures = 0;
+    const int maxReportedFailures = 10;
+}
+
+bool RegisterTest(const char* name, TestFunction function)
+{
+    GetTests().push_back({ name, function });
+    return true;
+}
+
+void ReportFailure(const char* file, int line, const char* expression)
+{
+    // Checks inside of loops would repeat the same line for every element
+    if (g_failures < maxReportedFailures)
+        printf("  %s(%d): CHECK(%s) failed\n", file, line, expression);
+    ++g_failures;
+}
+
+std::string GetDataPath(const char* name)
+{
+    const char* directories[] = { "", "../shadows/", "../../shadows/" };
+    for (const char* directory : directories)
+    {
+        std::string path = std::string(directory) + name;
+        FILE* file = fopen(path.c_str(), "rb");
+        if (file)
+        {
+            fclose(file);
+            return path;
+        }
+    }
+    return name;
+}
+
+std::string GetTemporaryDirectory()
+{
+    const char* directory = getenv("TEMP");
+    if (!directory)
+        directory = getenv("TMPDIR");
+    std::string path = directory ? directory : "/tmp";
+    if (path.back() != '/' && path.back() != '\\')
+        path += '/';
+    return path;
+}
+
+// Runs every test, or the ones whose names contain one of the arguments
+int main(int argc, char** argv)
+{
+    int failedTests = 0;
+    int runTests = 0;
+    for (const TestEntry& test : GetTests())
+    {
+        bool selected = argc < 2;
+        for (int i = 1; i < argc && !selected; ++i)
+            selected = strstr(test.name, argv[i]) != nullptr;
+        if (!selected)
+            continue;
+
+        printf("%s\n", test.name);
+        fflush(stdout);
+        g_failures = 0;
+        test.function();
+        ++runTests;
+        if (g_failures > 0)
+        {
+            printf("  FAILED (%d checks)\n", g_failures);
+            ++failedTests;
+        }
+    }
+    printf("%d of %d tests passed\n", runTests - failedTests, runTests);
+    return failedTests;
+}
@@ -0,0 +1,126 @@
+#include "Test.h"
+#include "../shadows/TransparentSorter.h"
+
+#include <algorithm>
+#include <random>
+
+namespace
+{
+    void CheckSorted(const std::vector<uint32_t>& order, const std::vector<uint32_t>& values, const std::vector<float>& keys)
+    {
+        CHECK(order.size() == values.size());
+        for (size_t i = 1; i < order.size(); ++i)
+            CHECK(keys[order[i - 1]] >= keys[order[i]]);
+        std::vector<uint32_t> sortedOrder = order;
+        std::sort(sortedOrder.begin(), sortedOrder.end());
+        std::vector<uint32_t> sortedValues = values;
+        std::sort(sortedValues.begin(), sortedValues.end());
+        CHECK(sortedOrder == sortedValues);
+    }
+}
+
+TEST(TransparentSorterOrdersBackToFront)
+{
+    std::mt19937 random(2);
+    std::uniform_real_distribution<float> distance(-1000.0f, 1000.0f);
+    const size_t counts[] = { 0, 1, 2, 10, 1000, 20000 };
+    for (size_t count : counts)
+    {
+        TransparentSorter sorter;
+        std::vector<float> keys(count);
+        for (int frame = 0; frame < 30; ++frame)
+        {
+            // Small moves between frames and a cut every ten frames, some draws leave for a frame
+            bool cut = frame % 10 == 0;
+            for (float& key : keys)
+                key = cut ? distance(random) : key + distance(random) * 0.001f;
+            bool leaving = frame % 7 == 3;
+            std::vector<uint32_t> values;
+            for (uint32_t i = 0; i < count; ++i)
+                if (!leaving || i % 5 != 0)
+                    values.push_back(i);
+
+            sorter.Clear();
+            for (uint32_t value : values)
+                sorter.Add(value, keys[value]);
+            CheckSorted(sorter.Sort(), values, keys);
+
+            // Coherent frames with the same draws as the previous one are refined
+            bool returning = frame % 7 == 4;
+            if (!cut && !returning)
+                CHECK(!sorter.WasRadixSorted());
+            if (cut && count > 100)
+                CHECK(sorter.WasRadixSorted());
+        }
+    }
+}
+
+TEST(TransparentSorterSpecialKeys)
+{
+    TransparentSorter sorter;
+    const float keys[] = { -0.0f, 0.0f, -5.0f, 1e30f, -1e30f, 3.5f };
+    std::vector<uint32_t> values;
+    for (uint32_t i = 0; i < 6; ++i)
+    {
+        sorter.Add(i, keys[i]);
+        values.push_back(i);
+    }
+    std::vector<float> keyList(keys, keys + 6);
+    const std::vector<uint32_t>& order = sorter.Sort();
+    CheckSorted(order, values, keyList);
+    CHECK(order.front() == 3);
+    CHECK(order.back() == 4);
+}
+
+TEST(TransparentSorterEqualKeys)
+{
+    // The first frame keeps the order of the Add calls
+    TransparentSorter sorter;
+    sorter.Add(4, 1.0f);
+    sorter.Add(2, 1.0f);
+    sorter.Add(7, 2.0f);
+    sorter.Add(1, 1.0f);
+    std::vector<uint32_t> order = sorter.Sort();
+    CHECK((order == std::vector<uint32_t>{ 7, 4, 2, 1 }));
+
+    // The next frame refines the previous order, whatever the order of the Add calls
+    sorter.Clear();
+    sorter.Add(1, 1.0f);
+    sorter.Add(7, 2.0f);
+    sorter.Add(2, 1.0f);
+    sorter.Add(4, 1.0f);
+    order = sorter.Sort();
+    CHECK(!sorter.WasRadixSorted());
+    CHECK((order == std::vector<uint32_t>{ 7, 4, 2, 1 }));
+
+    // Too far from sorted to be refined, the radix sort keeps the order of the Add calls too
+    TransparentSorter radixSorter;
+    const uint32_t count = 3000;
+    for (uint32_t i = 0; i < count; ++i)
+        radixSorter.Add(count - 1 - i, static_cast<float>(i % 3));
+    order = radixSorter.Sort();
+    CHECK(radixSorter.WasRadixSorted());
+    for (uint32_t i = 1; i < count; ++i)
+    {
+        uint32_t previous = count - 1 - order[i - 1];
+        uint32_t current = count - 1 - order[i];
+        CHECK(previous % 3 > current % 3 || (previous % 3 == current % 3 && previous < current));
+    }
+}
+
+TEST(TransparentSorterDuplicatedValues)
+{
+    TransparentSorter sorter;
+    sorter.Add(0, 1.0f);
+    sorter.Add(1, 2.0f);
+    sorter.Sort();
+
+    // A value added twice can't be refined, every entry is still returned
+    sorter.Clear();
+    sorter.Add(0, 1.0f);
+    sorter.Add(1, 2.0f);
+    sorter.Add(0, 3.0f);
+    const std::vector<uint32_t>& order = sorter.Sort();
+    CHECK(sorter.WasRadixSorted());
+    CHECK((order == std::vector<uint32_t>{ 0, 1, 0 }));
+}
@@ -0,0 +1,123 @@
+#include "Test.h"
+#include "../shadows/WeightedBlendedOIT.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace
+{
+    struct Fragment
+    {
+        float color[3];
+        float alpha;
+        float viewDepth;
+    };
+
+    // Sorted over compositing, the result the blending approximates
+    void CompositeSorted(std::vector<Fragment> fragments, const float background[3], float result[3])
+    {
+        std::sort(fragments.begin(), fragments.end(), [](const Fragment& a, const Fragment& b) { return a.viewDepth > b.viewDepth; });
+        for (int i = 0; i < 3; ++i)
+            result[i] = background[i];
+        for (const Fragment& fragment : fragments)
+            for (int i = 0; i < 3; ++i)
+                result[i] = fragment.color[i] * fragment.alpha + result[i] * (1.0f - fragment.alpha);
+    }
+
+    void CompositeOIT(const std::vector<Fragment>& fragments, const float background[3], float result[3])
+    {
+        OITPixel pixel;
+        ClearOITPixel(pixel);
+        for (const Fragment& fragment : fragments)
+            AccumulateOIT(pixel, fragment.color, fragment.alpha, fragment.viewDepth);
+        ResolveOIT(pixel, background, result);
+    }
+}
+
+TEST(WeightedBlendedOITSingleLayerIsExact)
+{
+    const float background[3] = { 0.0f, 0.0f, 1.0f };
+    std::vector<Fragment> fragments = { { { 1.0f, 0.5f, 0.25f }, 0.4f, 30.0f } };
+    float expected[3];
+    float result[3];
+    CompositeSorted(fragments, background, expected);
+    CompositeOIT(fragments, background, result);
+    for (int i = 0; i < 3; ++i)
+        CHECK_NEAR(result[i], expected[i], 1e-6f);
+
+    CompositeOIT(std::vector<Fragment>(), background, result);
+    for (int i = 0; i < 3; ++i)
+        CHECK(result[i] == background[i]);
+}
+
+TEST(WeightedBlendedOITWeight)
+{
+    // Positive, decreasing with the distance and linear in alpha
+    float previous = OITWeight(1.0f, 0.1f);
+    for (float depth = 0.5f; depth < 2000.0f; depth *= 1.5f)
+    {
+        float weight = OITWeight(1.0f, depth);
+        CHECK(weight > 0.0f);
+        CHECK(weight <= previous);
+        CHECK_NEAR(OITWeight(0.25f, depth), 0.25f * weight, 1e-6f * weight);
+        previous = weight;
+    }
+    CHECK(OITWeight(1.0f, -20.0f) == OITWeight(1.0f, 20.0f));
+}
+
+// Random layers over a small image: the result doesn't depend on the draw order, the background shows
+// through exactly as much as with sorted blending, and the colors stay close to the sorted ones
+TEST(WeightedBlendedOITImage)
+{
+    std::mt19937 random(5);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::uniform_real_distribution<float> alpha(0.1f, 0.6f);
+    std::uniform_real_distribution<float> depth(1.0f, 100.0f);
+    const float black[3] = { 0.0f, 0.0f, 0.0f };
+    const float white[3] = { 1.0f, 1.0f, 1.0f };
+    const int size = 64;
+    double totalError = 0.0;
+    for (int pixel = 0; pixel < size * size; ++pixel)
+    {
+        std::vector<Fragment> fragments(1 + pixel % 4);
+        for (Fragment& fragment : fragments)
+            fragment = { { unit(random), unit(random), unit(random) }, alpha(random), depth(random) };
+
+        float result[3];
+        float shuffled[3];
+        float sorted[3];
+        CompositeOIT(fragments, black, result);
+        std::shuffle(fragments.begin(), fragments.end(), random);
+        CompositeOIT(fragments, black, shuffled);
+        CompositeSorted(fragments, black, sorted);
+        for (int i = 0; i < 3; ++i)
+        {
+            CHECK_NEAR(result[i], shuffled[i], 1e-5f);
+            CHECK(result[i] >= 0.0f && result[i] <= 1.0f);
+            totalError += std::fabs(result[i] - sorted[i]);
+        }
+
+        float overWhite[3];
+        float sortedOverWhite[3];
+        CompositeOIT(fragments, white, overWhite);
+        CompositeSorted(fragments, white, sortedOverWhite);
+        for (int i = 0; i < 3; ++i)
+            CHECK_NEAR(overWhite[i] - result[i], sortedOverWhite[i] - sorted[i], 1e-5f);
+    }
+    CHECK(totalError / (size * size * 3) < 0.05);
+}
+
+TEST(WeightedBlendedOITNearLayerDominates)
+{
+    // A red layer close to the camera in front of a far green one of the same alpha
+    const float background[3] = { 0.0f, 0.0f, 0.0f };
+    std::vector<Fragment> fragments = {
+        { { 0.0f, 1.0f, 0.0f }, 0.8f, 150.0f },
+        { { 1.0f, 0.0f, 0.0f }, 0.8f, 2.0f }
+    };
+    float result[3];
+    CompositeOIT(fragments, background, result);
+    CHECK(result[0] > 0.9f);
+    CHECK(result[1] < 0.05f);
+}